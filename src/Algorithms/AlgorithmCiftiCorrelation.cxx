@@ -28,6 +28,7 @@
 #include "CaretLogger.h"
 #include "MathFunctions.h"
 #include "CaretOMP.h"
+#include "DotProductKernels.h"
 #include "FileInformation.h"
 #include "CaretPointer.h"
 #include <fstream>
@@ -37,6 +38,12 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int PANEL_ROWS = 32;//moving rows read by a thread at once
+    const int CHUNK_TILE = 64;//output memory rows each panel is multiplied against at once
+}
+
 AString AlgorithmCiftiCorrelation::getCommandSwitch()
 {
     return "-cifti-correlation";
@@ -222,11 +229,13 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             cacheRow(i);
         }
     }
+    vector<int> chunkRows, chunkPosition(numRows, -1);
     for (int startrow = 0; startrow < numRows; startrow += numCacheRows)
     {
         int endrow = startrow + numCacheRows;
         if (endrow > numRows) endrow = numRows;
         outRows.resize(endrow - startrow);
+        chunkRows.resize(endrow - startrow);
         for (int i = startrow; i < endrow; ++i)
         {
             if (!cacheFullInput)
@@ -237,46 +246,20 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             {
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
+            chunkRows[i - startrow] = i;
+            chunkPosition[i] = i - startrow;
         }
-        int curRow = 0;//because we can't trust the order threads hit the critical section
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
-        {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
-            }
-            for (int j = startrow; j < endrow; ++j)
-            {
-                if (myrow >= startrow && myrow < endrow)//check whether we are in the output memory area
-                {
-                    if (j >= myrow)//if so, only compute one half, and store both places
-                    {
-                        float cacheRrs;
-                        const float* cacheRow = getRow(j, cacheRrs, true);
-                        outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[myrow - startrow][j] = outRows[j - startrow][myrow];
-                    }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(j, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                }
-            }
-        }
+        computeChunk(chunkRows, chunkPosition, outRows, fisherZ);
         for (int i = startrow; i < endrow; ++i)
         {
             myCiftiOut->setRow(outRows[i - startrow], i);
+            chunkPosition[i] = -1;
         }
         if (!cacheFullInput)
         {
             clearCache();//tell the cache we are going to preload a different set of rows now
         }
+        myProgress.reportProgress(((float)endrow) / numRows);
     }
     if (cacheFullInput)
     {
@@ -408,13 +391,13 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             cacheRow(i);
         }
     }
-    CaretArray<int> indexReverse(numRows, -1);
+    vector<int> chunkRows, chunkPosition(numRows, -1);
     for (int startrow = 0; startrow < numSelected; startrow += numCacheRows)
     {
         int endrow = startrow + numCacheRows;
         if (endrow > numSelected) endrow = numSelected;
         outRows.resize(endrow - startrow);
-        int curRow = 0;//because we can't trust the order threads hit the critical section
+        chunkRows.resize(endrow - startrow);
         for (int i = startrow; i < endrow; ++i)
         {
             if (!cacheFullInput)
@@ -425,47 +408,20 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
             {
                 outRows[i - startrow] = CaretArray<float>(numRows);
             }
-            indexReverse[ciftiIndexList[i].first] = i;
-        }
-#pragma omp CARET_PARFOR schedule(dynamic)
-        for (int i = 0; i < numRows; ++i)
-        {
-            float movingRrs;
-            int myrow;
-            const float* movingRow;
-#pragma omp critical
-            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
-                myrow = curRow;//so, manually force it to read sequentially
-                ++curRow;
-                movingRow = getRow(myrow, movingRrs);
-            }
-            for (int j = startrow; j < endrow; ++j)
-            {
-                if (indexReverse[myrow] != -1)//check if we are on a row that is in the output memory range
-                {
-                    if (indexReverse[myrow] <= j)//if so, only compute one of the elements, then store it both places
-                    {
-                        float cacheRrs;
-                        const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                        outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                        outRows[indexReverse[myrow] - startrow][ciftiIndexList[j].first] = outRows[j - startrow][myrow];
-                    }
-                } else {
-                    float cacheRrs;
-                    const float* cacheRow = getRow(ciftiIndexList[j].first, cacheRrs, true);
-                    outRows[j - startrow][myrow] = correlate(movingRow, movingRrs, cacheRow, cacheRrs, fisherZ);
-                }
-            }
+            chunkRows[i - startrow] = ciftiIndexList[i].first;
+            chunkPosition[ciftiIndexList[i].first] = i - startrow;
         }
+        computeChunk(chunkRows, chunkPosition, outRows, fisherZ);
         for (int i = startrow; i < endrow; ++i)
         {
             myCiftiOut->setRow(outRows[i - startrow], ciftiIndexList[i].second);
-            indexReverse[ciftiIndexList[i].first] = -1;
+            chunkPosition[ciftiIndexList[i].first] = -1;
         }
         if (!cacheFullInput)
         {
             clearCache();//tell the cache we are going to preload a different set of rows now
         }
+        myProgress.reportProgress(((float)endrow) / numSelected);
     }
     if (cacheFullInput)
     {
@@ -516,38 +472,107 @@ AlgorithmCiftiCorrelation::AlgorithmCiftiCorrelation(ProgressObject* myProgObj,
     AlgorithmCiftiCorrelation(myProgObj, myCifti, myCiftiOut, leftRoiPtr, rightRoiPtr, cerebRoiPtr, volRoiPtr, weights, fisherZ, memLimitGB, noDemean, covariance);//HACK: pass through our progress object
 }
 
-float AlgorithmCiftiCorrelation::correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ)
+void AlgorithmCiftiCorrelation::computeChunk(const vector<int>& chunkRows, const vector<int>& chunkPosition, vector<CaretArray<float> >& outRows, const bool& fisherZ)
+{
+    int numRows = m_inputCifti->getNumberOfRows(), numChunk = (int)chunkRows.size();
+    int dotLength = m_numCols;
+    if (m_weightedMode) dotLength = (int)m_weightIndexes.size();//because we compacted the data in the row to not include any zero weights
+    vector<const float*> chunkPtrs(numChunk);
+    vector<float> chunkRrs(numChunk);
+    for (int p = 0; p < numChunk; ++p)
+    {
+        chunkPtrs[p] = getRow(chunkRows[p], chunkRrs[p], true);
+    }
+    int numPanels = (numRows + PANEL_ROWS - 1) / PANEL_ROWS;
+    int curRow = 0;//because we can't trust the order threads hit the critical section
+#pragma omp CARET_PAR
+    {
+        vector<float> panelScratch(PANEL_ROWS * m_numCols);//getRow reuses one temp row per thread, so copy uncached rows out of it
+        vector<const float*> panelPtrs(PANEL_ROWS);
+        vector<float> panelRrs(PANEL_ROWS);
+        vector<int> panelIndices(PANEL_ROWS);
+        vector<double> tileOut(PANEL_ROWS * CHUNK_TILE);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int panel = 0; panel < numPanels; ++panel)
+        {
+            int panelSize;
+#pragma omp critical
+            {//CiftiFile may explode if we request multiple rows concurrently (needs mutexes), but we should force sequential requests anyway
+                panelSize = min(PANEL_ROWS, numRows - curRow);//so, manually force it to read sequentially
+                for (int a = 0; a < panelSize; ++a)
+                {
+                    int myrow = curRow + a;
+                    panelIndices[a] = myrow;
+                    const float* movingRow = getRow(myrow, panelRrs[a]);
+                    if (m_rowInfo[myrow].m_cacheIndex == -1)
+                    {
+                        float* scratchRow = panelScratch.data() + a * m_numCols;
+                        for (int k = 0; k < dotLength; ++k)
+                        {
+                            scratchRow[k] = movingRow[k];
+                        }
+                        movingRow = scratchRow;
+                    }
+                    panelPtrs[a] = movingRow;
+                }
+                curRow += panelSize;
+            }
+            int firstPos = numChunk;//rows that are in the output memory area only compute one half, so skip tiles that are entirely below all of them
+            for (int a = 0; a < panelSize; ++a)
+            {
+                int myPos = chunkPosition[panelIndices[a]];
+                if (myPos == -1) myPos = 0;
+                if (myPos < firstPos) firstPos = myPos;
+            }
+            for (int tileStart = firstPos; tileStart < numChunk; tileStart += CHUNK_TILE)
+            {
+                int tileSize = min(CHUNK_TILE, numChunk - tileStart);
+                dotProductTile(panelPtrs.data(), panelSize, chunkPtrs.data() + tileStart, tileSize, dotLength, tileOut.data());
+                for (int a = 0; a < panelSize; ++a)
+                {
+                    int myrow = panelIndices[a], myPos = chunkPosition[myrow];
+                    const double* tileRow = tileOut.data() + a * tileSize;
+                    for (int b = 0; b < tileSize; ++b)
+                    {
+                        int p = tileStart + b;
+                        if (myPos == -1)
+                        {
+                            outRows[p][myrow] = finishCorrelation(tileRow[b], panelRrs[a], chunkRrs[p], fisherZ, false);
+                        } else {
+                            if (myPos <= p)//if we are in the output memory area, only compute one half, and store both places
+                            {
+                                outRows[p][myrow] = finishCorrelation(tileRow[b], panelRrs[a], chunkRrs[p], fisherZ, myPos == p);
+                                outRows[myPos][chunkRows[p]] = outRows[p][myrow];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+float AlgorithmCiftiCorrelation::finishCorrelation(const double& accum, const float& rrs1, const float& rrs2, const bool& fisherZ, const bool& sameRow)
 {
     double r;
-    if (row1 == row2 && !m_covariance)
+    if (sameRow && !m_covariance)
     {
         r = 1.0;//short circuit for same row
     } else {
         if (m_weightedMode)
         {
-            int numWeights = (int)m_weightIndexes.size();
-            double accum = 0.0;
-            for (int i = 0; i < numWeights; ++i)//because we compacted the data in the row to not include any zero weights
-            {
-                accum += row1[i] * row2[i];//these have already had the weighted row means subtracted out, and weights applied
-            }
             if (m_covariance)
             {
                 if (m_binaryWeights)
                 {
-                    r = accum / numWeights;
+                    r = accum / m_weightIndexes.size();
                 } else {
                     r = accum / rrs1;//NOTE: will equal rrs2 as it only depends on weights, and is not square root
                 }
             } else {
-                r = accum / (rrs1 * rrs2);//as do these
+                r = accum / (rrs1 * rrs2);//rows have already had the weighted row means subtracted out, and weights applied
             }
         } else {
-            double accum = 0.0;
-            for (int i = 0; i < m_numCols; ++i)
-            {
-                accum += row1[i] * row2[i];//these have already had the row means subtracted out
-            }
             if (m_covariance)
             {
                 r = accum / m_numCols;
@@ -806,10 +831,11 @@ int AlgorithmCiftiCorrelation::numRowsForMem(const float& memLimitGB, bool& cach
     int inrowBytes = m_numCols * sizeof(float), outrowBytes = numRows * sizeof(float);
     int64_t targetBytes = (int64_t)(memLimitGB * 1024 * 1024 * 1024);
     if (m_inputCifti->isInMemory()) targetBytes -= numRows * m_numCols * 4;//count in-memory input against the total too
+    int64_t perThreadBytes = inrowBytes * (PANEL_ROWS + 1) + PANEL_ROWS * CHUNK_TILE * sizeof(double);//temp row, panel of moving rows, and dot product tile
 #ifdef CARET_OMP
-    targetBytes -= inrowBytes * omp_get_max_threads();
+    targetBytes -= perThreadBytes * omp_get_max_threads();
 #else
-    targetBytes -= inrowBytes;//1 row in memory that isn't a reference to cache
+    targetBytes -= perThreadBytes;
 #endif
     targetBytes -= numRows * sizeof(RowInfo);//storage for mean, stdev, and info about caching
     int64_t perRowBytes = inrowBytes + outrowBytes;//cache and memory collation for output rows
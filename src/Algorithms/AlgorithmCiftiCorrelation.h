@@ -61,7 +61,8 @@ namespace caret {
         void clearCache();
         const float* getRow(const int& ciftiIndex, float& rootResidSqr, const bool& mustBeCached = false);
         float* getTempRow();
-        float correlate(const float* row1, const float& rrs1, const float* row2, const float& rrs2, const bool& fisherZ);
+        float finishCorrelation(const double& accum, const float& rrs1, const float& rrs2, const bool& fisherZ, const bool& sameRow);
+        void computeChunk(const std::vector<int>& chunkRows, const std::vector<int>& chunkPosition, std::vector<CaretArray<float> >& outRows, const bool& fisherZ);
         void init(const CiftiFile* input, const std::vector<float>* weights, const bool& noDemean, const bool& covariance);
         int numRowsForMem(const float& memLimitGB, bool& cacheFullInput);
     protected:
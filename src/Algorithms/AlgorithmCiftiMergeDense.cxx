@@ -24,6 +24,7 @@
 #include "AlgorithmCiftiReplaceStructure.h"
 #include "AlgorithmCiftiSeparate.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 #include "LabelFile.h"
 #include "MetricFile.h"
 #include "VolumeFile.h"
@@ -31,6 +32,115 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    struct MergeElement
+    {
+        int m_source;
+        int64_t m_inIndex, m_outIndex;
+        MergeElement(const int& source, const int64_t& inIndex, const int64_t& outIndex) : m_source(source), m_inIndex(inIndex), m_outIndex(outIndex) { }
+    };
+    
+    //merging along row: each output row gathers from the same row of every input
+    class MergeRowStage : public CiftiRowPipeline::Stage
+    {
+        const vector<const CiftiFile*>* m_ciftiList;
+        const vector<MergeElement>* m_elements;
+        CiftiFile* m_ciftiOut;
+        vector<int64_t> m_sourceOffset;//-1 for inputs that don't contribute anything
+        int64_t m_inputLength, m_outputLength;
+        bool m_readOutput;//label surfaces were already written with cifti replace structure, so we have to read-modify-write
+    public:
+        MergeRowStage(const vector<const CiftiFile*>& ciftiList, const vector<MergeElement>& elements, CiftiFile* ciftiOut)
+        {
+            m_ciftiList = &ciftiList;
+            m_elements = &elements;
+            m_ciftiOut = ciftiOut;
+            m_outputLength = ciftiOut->getNumberOfColumns();
+            m_readOutput = ((int64_t)elements.size() != m_outputLength);
+            m_inputLength = (m_readOutput ? m_outputLength : 0);
+            m_sourceOffset.resize(ciftiList.size(), -1);
+            for (int64_t i = 0; i < (int64_t)elements.size(); ++i)
+            {
+                int source = elements[i].m_source;
+                if (m_sourceOffset[source] == -1)
+                {
+                    m_sourceOffset[source] = m_inputLength;
+                    m_inputLength += ciftiList[source]->getNumberOfColumns();
+                }
+            }
+        }
+        int64_t getInputLength() const { return m_inputLength; }
+        void readItem(const int64_t& item, float* inputOut)
+        {
+            if (m_readOutput)
+            {
+                m_ciftiOut->getRow(inputOut, item, true);
+            }
+            for (int i = 0; i < (int)m_sourceOffset.size(); ++i)
+            {
+                if (m_sourceOffset[i] != -1)
+                {
+                    (*m_ciftiList)[i]->getRow(inputOut + m_sourceOffset[i], item);
+                }
+            }
+        }
+        void computeItem(const int64_t&, const float* input, float* output, const int&)
+        {
+            if (m_readOutput)
+            {
+                for (int64_t i = 0; i < m_outputLength; ++i)
+                {
+                    output[i] = input[i];
+                }
+            }
+            const vector<MergeElement>& elements = *m_elements;
+            for (int64_t i = 0; i < (int64_t)elements.size(); ++i)
+            {
+                output[elements[i].m_outIndex] = input[m_sourceOffset[elements[i].m_source] + elements[i].m_inIndex];
+            }
+        }
+        void writeItem(const int64_t& item, const float* output)
+        {
+            m_ciftiOut->setRow(output, item);
+        }
+    };
+    
+    //merging along column: each output row is a copy of one input row
+    class MergeColumnStage : public CiftiRowPipeline::Stage
+    {
+        const vector<const CiftiFile*>* m_ciftiList;
+        const vector<MergeElement>* m_elements;
+        CiftiFile* m_ciftiOut;
+        int64_t m_rowLength;
+    public:
+        MergeColumnStage(const vector<const CiftiFile*>& ciftiList, const vector<MergeElement>& elements, CiftiFile* ciftiOut)
+        {
+            m_ciftiList = &ciftiList;
+            m_elements = &elements;
+            m_ciftiOut = ciftiOut;
+            m_rowLength = ciftiOut->getNumberOfColumns();
+        }
+        void readItem(const int64_t& item, float* inputOut)
+        {
+            const MergeElement& myElem = (*m_elements)[item];
+            CaretAssert((*m_ciftiList)[myElem.m_source]->getNumberOfColumns() == m_rowLength);
+            (*m_ciftiList)[myElem.m_source]->getRow(inputOut, myElem.m_inIndex);
+        }
+        void computeItem(const int64_t&, const float* input, float* output, const int&)
+        {
+            for (int64_t i = 0; i < m_rowLength; ++i)
+            {
+                output[i] = input[i];
+            }
+        }
+        void writeItem(const int64_t& item, const float* output)
+        {
+            m_ciftiOut->setRow(output, (*m_elements)[item].m_outIndex);
+        }
+    };
+}
+
 AString AlgorithmCiftiMergeDense::getCommandSwitch()
 {
     return "-cifti-merge-dense";
@@ -169,9 +279,11 @@ AlgorithmCiftiMergeDense::AlgorithmCiftiMergeDense(ProgressObject* myProgObj, co
     }
     CaretAssert((int)sourceCifti.size() == outXML.getNumberOfBrainModels(myDir));
     myCiftiOut->setCiftiXML(outXML);
+    vector<MergeElement> elements;//everything except label surfaces is a plain copy of rows or columns
     for (int i = 0; i < (int)sourceCifti.size(); ++i)
     {
         CiftiBrainModelInfo myInfo = outXML.getBrainModelInfo(myDir, i);
+        const CiftiXMLOld& otherXML = ciftiList[sourceCifti[i]]->getCiftiXMLOld();
         switch (myInfo.m_type)
         {
             case CIFTI_MODEL_TYPE_SURFACE:
@@ -183,31 +295,13 @@ AlgorithmCiftiMergeDense::AlgorithmCiftiMergeDense(ProgressObject* myProgObj, co
                     AlgorithmCiftiReplaceStructure(NULL, myCiftiOut, myDir, myInfo.m_structure, &tempFile);
                 } else {//for everything else, just use rows directly, because making large metric files in-memory is problematic
                     vector<CiftiSurfaceMap> inMap, outMap;
-                    const CiftiXMLOld& otherXML = ciftiList[sourceCifti[i]]->getCiftiXMLOld();
                     outXML.getSurfaceMap(myDir, outMap, myInfo.m_structure);
                     otherXML.getSurfaceMap(myDir, inMap, myInfo.m_structure);
                     CaretAssert(inMap.size() == outMap.size());
-                    vector<float> rowscratch(outXML.getNumberOfColumns()), otherscratch(otherXML.getNumberOfColumns());
-                    if (myDir == CiftiXMLOld::ALONG_ROW)
+                    for (int k = 0; k < (int)inMap.size(); ++k)
                     {
-                        for (int j = 0; j < outXML.getNumberOfRows(); ++j)
-                        {
-                            myCiftiOut->getRow(rowscratch.data(), j, true);
-                            ciftiList[sourceCifti[i]]->getRow(otherscratch.data(), j);
-                            for (int k = 0; k < (int)inMap.size(); ++k)
-                            {
-                                CaretAssert(inMap[k].m_surfaceNode == outMap[k].m_surfaceNode);
-                                rowscratch[outMap[k].m_ciftiIndex] = otherscratch[inMap[k].m_ciftiIndex];
-                            }
-                            myCiftiOut->setRow(rowscratch.data(), j);
-                        }
-                    } else {
-                        for (int k = 0; k < (int)inMap.size(); ++k)
-                        {
-                            CaretAssert(inMap[k].m_surfaceNode == outMap[k].m_surfaceNode);
-                            ciftiList[sourceCifti[i]]->getRow(otherscratch.data(), inMap[k].m_ciftiIndex);
-                            myCiftiOut->setRow(otherscratch.data(), outMap[k].m_ciftiIndex);
-                        }
+                        CaretAssert(inMap[k].m_surfaceNode == outMap[k].m_surfaceNode);
+                        elements.push_back(MergeElement(sourceCifti[i], inMap[k].m_ciftiIndex, outMap[k].m_ciftiIndex));
                     }
                 }
                 break;
@@ -215,35 +309,15 @@ AlgorithmCiftiMergeDense::AlgorithmCiftiMergeDense(ProgressObject* myProgObj, co
             case CIFTI_MODEL_TYPE_VOXELS:
             {
                 vector<CiftiVolumeMap> inMap, outMap;
-                const CiftiXMLOld& otherXML = ciftiList[sourceCifti[i]]->getCiftiXMLOld();
                 outXML.getVolumeStructureMap(myDir, outMap, myInfo.m_structure);
                 otherXML.getVolumeStructureMap(myDir, inMap, myInfo.m_structure);
                 CaretAssert(inMap.size() == outMap.size());
-                vector<float> rowscratch(outXML.getNumberOfColumns()), otherscratch(otherXML.getNumberOfColumns());
-                if (myDir == CiftiXMLOld::ALONG_ROW)
+                for (int k = 0; k < (int)inMap.size(); ++k)
                 {
-                    for (int j = 0; j < outXML.getNumberOfRows(); ++j)
-                    {
-                        myCiftiOut->getRow(rowscratch.data(), j, true);
-                        ciftiList[sourceCifti[i]]->getRow(otherscratch.data(), j);
-                        for (int k = 0; k < (int)inMap.size(); ++k)
-                        {
-                            CaretAssert(inMap[k].m_ijk[0] == outMap[k].m_ijk[0]);
-                            CaretAssert(inMap[k].m_ijk[1] == outMap[k].m_ijk[1]);
-                            CaretAssert(inMap[k].m_ijk[2] == outMap[k].m_ijk[2]);
-                            rowscratch[outMap[k].m_ciftiIndex] = otherscratch[inMap[k].m_ciftiIndex];
-                        }
-                        myCiftiOut->setRow(rowscratch.data(), j);
-                    }
-                } else {
-                    for (int k = 0; k < (int)inMap.size(); ++k)
-                    {
-                        CaretAssert(inMap[k].m_ijk[0] == outMap[k].m_ijk[0]);
-                        CaretAssert(inMap[k].m_ijk[1] == outMap[k].m_ijk[1]);
-                        CaretAssert(inMap[k].m_ijk[2] == outMap[k].m_ijk[2]);
-                        ciftiList[sourceCifti[i]]->getRow(otherscratch.data(), inMap[k].m_ciftiIndex);
-                        myCiftiOut->setRow(otherscratch.data(), outMap[k].m_ciftiIndex);
-                    }
+                    CaretAssert(inMap[k].m_ijk[0] == outMap[k].m_ijk[0]);
+                    CaretAssert(inMap[k].m_ijk[1] == outMap[k].m_ijk[1]);
+                    CaretAssert(inMap[k].m_ijk[2] == outMap[k].m_ijk[2]);
+                    elements.push_back(MergeElement(sourceCifti[i], inMap[k].m_ciftiIndex, outMap[k].m_ciftiIndex));
                 }
                 break;
             }
@@ -251,6 +325,14 @@ AlgorithmCiftiMergeDense::AlgorithmCiftiMergeDense(ProgressObject* myProgObj, co
                 throw AlgorithmException("encountered unknown model type in cifti merge dense");
         }
     }
+    if (myDir == CiftiXMLOld::ALONG_ROW)
+    {
+        MergeRowStage myStage(ciftiList, elements, myCiftiOut);
+        CiftiRowPipeline::run(&myStage, outXML.getNumberOfRows(), myStage.getInputLength(), outXML.getNumberOfColumns());
+    } else {
+        MergeColumnStage myStage(ciftiList, elements, myCiftiOut);
+        CiftiRowPipeline::run(&myStage, (int64_t)elements.size(), outXML.getNumberOfColumns(), outXML.getNumberOfColumns());
+    }
 }
 
 float AlgorithmCiftiMergeDense::getAlgorithmInternalWeight()
@@ -22,6 +22,7 @@
 #include "AlgorithmException.h"
 #include "CaretLogger.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 #include "GiftiLabel.h"
 #include "GiftiLabelTable.h"
 #include "MetricFile.h"
@@ -35,6 +36,117 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class ParcellateRowStage : public CiftiRowPipeline::RowStage
+    {
+        const vector<int>* m_indexToParcel;
+        const vector<vector<float> >* m_parcelWeights;//NULL when not weighted
+        ReductionEnum::Enum m_method;
+        float m_excludeLow, m_excludeHigh;
+        bool m_onlyNumeric, m_isLabel;
+        int m_labelDir, m_numParcels;
+        vector<float> m_unassignedKeys;//getUnassignedLabelKey() may modify the table, so get them before threading
+        vector<vector<vector<float> > > m_parcelData;//per thread, float so we can use ReductionOperation
+    public:
+        ParcellateRowStage(const vector<int>& indexToParcel, const vector<int64_t>& parcelCounts, const vector<vector<float> >* parcelWeights, const CiftiXML& myOutXML,
+                           const bool& isLabel, const int& labelDir, const ReductionEnum::Enum& method, const float& excludeLow, const float& excludeHigh, const bool& onlyNumeric)
+        {
+            m_indexToParcel = &indexToParcel;
+            m_parcelWeights = parcelWeights;
+            m_method = method;
+            m_excludeLow = excludeLow;
+            m_excludeHigh = excludeHigh;
+            m_onlyNumeric = onlyNumeric;
+            m_isLabel = isLabel;
+            m_labelDir = labelDir;
+            m_numParcels = (int)parcelCounts.size();
+            if (isLabel)
+            {//labelDir can't be 0 (row) because we are parcellating along row, so row must be dense
+                CaretAssert(labelDir > 0);
+                const CiftiLabelsMap& myLabelsMap = myOutXML.getLabelsMap(labelDir);
+                m_unassignedKeys.resize(myLabelsMap.getLength());
+                for (int64_t i = 0; i < myLabelsMap.getLength(); ++i)
+                {
+                    m_unassignedKeys[i] = myLabelsMap.getMapLabelTable(i)->getUnassignedLabelKey();
+                }
+            }
+            m_parcelData.resize(CiftiRowPipeline::getNumThreads(), vector<vector<float> >(m_numParcels));
+            for (int t = 0; t < (int)m_parcelData.size(); ++t)
+            {
+                for (int j = 0; j < m_numParcels; ++j)
+                {
+                    m_parcelData[t][j].reserve(parcelCounts[j]);
+                }
+            }
+        }
+        void computeRow(const vector<int64_t>& index, const float* inRow, float* outRow, const int& thread)
+        {
+            vector<vector<float> >& parcelData = m_parcelData[thread];
+            for (int j = 0; j < m_numParcels; ++j)
+            {
+                parcelData[j].clear();//doesn't change allocation
+            }
+            int64_t numCols = (int64_t)m_indexToParcel->size();
+            for (int64_t j = 0; j < numCols; ++j)
+            {
+                int parcel = (*m_indexToParcel)[j];
+                if (parcel != -1)
+                {
+                    if (m_isLabel)
+                    {
+                        parcelData[parcel].push_back(floor(inRow[j] + 0.5f));//round to nearest integer to be safe
+                    } else {
+                        parcelData[parcel].push_back(inRow[j]);
+                    }
+                }
+            }
+            for (int j = 0; j < m_numParcels; ++j)
+            {
+                int64_t count = (int64_t)parcelData[j].size();
+                if (count > 0 && (m_method != ReductionEnum::SAMPSTDEV || count > 1))
+                {
+                    if (m_parcelWeights != NULL)
+                    {
+                        const float* weights = (*m_parcelWeights)[j].data();
+                        CaretAssert((int64_t)(*m_parcelWeights)[j].size() == count);
+                        if (m_excludeLow > 0.0f && m_excludeHigh > 0.0f)
+                        {
+                            outRow[j] = ReductionOperation::reduceWeightedExcludeDev(parcelData[j].data(), weights, count, m_method, m_excludeLow, m_excludeHigh);
+                        } else {
+                            if (m_onlyNumeric)
+                            {
+                                outRow[j] = ReductionOperation::reduceWeightedOnlyNumeric(parcelData[j].data(), weights, count, m_method);
+                            } else {
+                                outRow[j] = ReductionOperation::reduceWeighted(parcelData[j].data(), weights, count, m_method);
+                            }
+                        }
+                    } else {
+                        if (m_excludeLow > 0.0f && m_excludeHigh > 0.0f)
+                        {
+                            outRow[j] = ReductionOperation::reduceExcludeDev(parcelData[j].data(), count, m_method, m_excludeLow, m_excludeHigh);
+                        } else {
+                            if (m_onlyNumeric)
+                            {
+                                outRow[j] = ReductionOperation::reduceOnlyNumeric(parcelData[j].data(), count, m_method);
+                            } else {
+                                outRow[j] = ReductionOperation::reduce(parcelData[j].data(), count, m_method);
+                            }
+                        }
+                    }
+                } else {
+                    if (m_isLabel)
+                    {
+                        outRow[j] = m_unassignedKeys[index[m_labelDir - 1]];
+                    } else {
+                        outRow[j] = 0.0f;
+                    }
+                }
+            }
+        }
+    };
+}
+
 AString AlgorithmCiftiParcellate::getCommandSwitch()
 {
     return "-cifti-parcellate";
@@ -272,59 +384,8 @@ AlgorithmCiftiParcellate::AlgorithmCiftiParcellate(ProgressObject* myProgObj, co
     }
     if (direction == CiftiXML::ALONG_ROW)
     {
-        vector<float> scratchOutRow(numParcels);
-        vector<vector<float> > parcelData(numParcels);//float so we can use ReductionOperation
-        for (int j = 0; j < numParcels; ++j)
-        {
-            parcelData[j].reserve(parcelCounts[j]);
-        }
-        for (MultiDimIterator<int64_t> iter(vector<int64_t>(dims.begin() + 1, dims.end())); !iter.atEnd(); ++iter)
-        {
-            for (int j = 0; j < numParcels; ++j)
-            {
-                parcelData[j].clear();//doesn't change allocation
-            }
-            myCiftiIn->getRow(scratchRow.data(), *iter);
-            for (int64_t j = 0; j < numCols; ++j)
-            {
-                int parcel = indexToParcel[j];
-                if (parcel != -1)
-                {
-                    if (isLabel)
-                    {
-                        parcelData[parcel].push_back(floor(scratchRow[j] + 0.5f));//round to nearest integer to be safe
-                    } else {
-                        parcelData[parcel].push_back(scratchRow[j]);
-                    }
-                }
-            }
-            for (int j = 0; j < numParcels; ++j)
-            {
-                CaretAssert(parcelCounts[j] == (int64_t)parcelData[j].size());
-                if (parcelCounts[j] > 0 && (method != ReductionEnum::SAMPSTDEV || parcelCounts[j] > 1))
-                {
-                    if (excludeLow > 0.0f && excludeHigh > 0.0f)
-                    {
-                        scratchOutRow[j] = ReductionOperation::reduceExcludeDev(parcelData[j].data(), parcelData[j].size(), method, excludeLow, excludeHigh);
-                    } else {
-                        if (onlyNumeric)
-                        {
-                            scratchOutRow[j] = ReductionOperation::reduceOnlyNumeric(parcelData[j].data(), parcelData[j].size(), method);
-                        } else {
-                            scratchOutRow[j] = ReductionOperation::reduce(parcelData[j].data(), parcelData[j].size(), method);
-                        }
-                    }
-                } else {//labelDir can't be 0 (row) because we are parcellating along row, so row must be dense
-                    if (isLabel)
-                    {
-                        scratchOutRow[j] = myOutXML.getLabelsMap(labelDir).getMapLabelTable((*iter)[labelDir - 1])->getUnassignedLabelKey();
-                    } else {
-                        scratchOutRow[j] = 0.0f;
-                    }
-                }
-            }
-            myCiftiOut->setRow(scratchOutRow.data(), *iter);
-        }
+        ParcellateRowStage myStage(indexToParcel, parcelCounts, NULL, myOutXML, isLabel, labelDir, method, excludeLow, excludeHigh, onlyNumeric);
+        CiftiRowPipeline::runOverRows(&myStage, myCiftiIn, myCiftiOut);
     } else {
         vector<float> scratchOutRow(numCols);
         vector<int64_t> otherDims = dims;
@@ -450,59 +511,13 @@ namespace
         vector<float> scratchRow(numCols);
         if (direction == CiftiXML::ALONG_ROW)
         {
-            vector<float> scratchOutRow(numParcels);
-            vector<vector<float> > parcelData(numParcels);//float so we can use ReductionOperation
+            vector<int64_t> parcelCounts(numParcels);
             for (int j = 0; j < numParcels; ++j)
             {
-                parcelData[j].reserve(parcelWeights[j].size());
-            }
-            for (MultiDimIterator<int64_t> iter(vector<int64_t>(dims.begin() + 1, dims.end())); !iter.atEnd(); ++iter)
-            {
-                for (int j = 0; j < numParcels; ++j)
-                {
-                    parcelData[j].clear();//doesn't change allocation
-                }
-                myCiftiIn->getRow(scratchRow.data(), *iter);
-                for (int64_t j = 0; j < numCols; ++j)
-                {
-                    int parcel = indexToParcel[j];
-                    if (parcel != -1)
-                    {
-                        if (isLabel)
-                        {
-                            parcelData[parcel].push_back(floor(scratchRow[j] + 0.5f));//round to nearest integer to be safe
-                        } else {
-                            parcelData[parcel].push_back(scratchRow[j]);
-                        }
-                    }
-                }
-                for (int j = 0; j < numParcels; ++j)
-                {
-                    CaretAssert(parcelWeights[j].size() == parcelData[j].size());
-                    if (parcelData[j].size() > 0 && (method != ReductionEnum::SAMPSTDEV || parcelData[j].size() > 1))
-                    {
-                        if (excludeLow > 0.0f && excludeHigh > 0.0f)
-                        {
-                            scratchOutRow[j] = ReductionOperation::reduceWeightedExcludeDev(parcelData[j].data(), parcelWeights[j].data(), parcelData[j].size(), method, excludeLow, excludeHigh);
-                        } else {
-                            if (onlyNumeric)
-                            {
-                                scratchOutRow[j] = ReductionOperation::reduceWeightedOnlyNumeric(parcelData[j].data(), parcelWeights[j].data(), parcelData[j].size(), method);
-                            } else {
-                                scratchOutRow[j] = ReductionOperation::reduceWeighted(parcelData[j].data(), parcelWeights[j].data(), parcelData[j].size(), method);
-                            }
-                        }
-                    } else {//labelDir can't be 0 (row) because we are parcellating along row, so row must be dense
-                        if (isLabel)
-                        {
-                            scratchOutRow[j] = myOutXML.getLabelsMap(labelDir).getMapLabelTable((*iter)[labelDir - 1])->getUnassignedLabelKey();
-                        } else {
-                            scratchOutRow[j] = 0.0f;
-                        }
-                    }
-                }
-                myCiftiOut->setRow(scratchOutRow.data(), *iter);
+                parcelCounts[j] = (int64_t)parcelWeights[j].size();
             }
+            ParcellateRowStage myStage(indexToParcel, parcelCounts, &parcelWeights, myOutXML, isLabel, labelDir, method, excludeLow, excludeHigh, onlyNumeric);
+            CiftiRowPipeline::runOverRows(&myStage, myCiftiIn, myCiftiOut);
         } else {
             vector<float> scratchOutRow(numCols);
             vector<int64_t> otherDims = dims;
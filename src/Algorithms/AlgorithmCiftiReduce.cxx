@@ -22,7 +22,9 @@
 #include "AlgorithmException.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 #include "MultiDimIterator.h"
 #include "ReductionOperation.h"
 
@@ -31,6 +33,47 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    class ReduceRowStage : public CiftiRowPipeline::RowStage
+    {
+        ReductionEnum::Enum m_reduce;
+        int64_t m_rowLength;
+        bool m_onlyNumeric, m_excludeDev;
+        float m_sigmaBelow, m_sigmaAbove;
+    public:
+        ReduceRowStage(const ReductionEnum::Enum& myReduce, const int64_t& rowLength, const bool& onlyNumeric)
+        {
+            m_reduce = myReduce;
+            m_rowLength = rowLength;
+            m_onlyNumeric = onlyNumeric;
+            m_excludeDev = false;
+            m_sigmaBelow = 0.0f;
+            m_sigmaAbove = 0.0f;
+        }
+        ReduceRowStage(const ReductionEnum::Enum& myReduce, const int64_t& rowLength, const float& sigmaBelow, const float& sigmaAbove)
+        {
+            m_reduce = myReduce;
+            m_rowLength = rowLength;
+            m_onlyNumeric = false;
+            m_excludeDev = true;
+            m_sigmaBelow = sigmaBelow;
+            m_sigmaAbove = sigmaAbove;
+        }
+        void computeRow(const vector<int64_t>&, const float* inRow, float* outRow, const int&)
+        {
+            if (m_excludeDev)
+            {
+                outRow[0] = ReductionOperation::reduceExcludeDev(inRow, m_rowLength, m_reduce, m_sigmaBelow, m_sigmaAbove);
+            } else if (m_onlyNumeric) {
+                outRow[0] = ReductionOperation::reduceOnlyNumeric(inRow, m_rowLength, m_reduce);
+            } else {
+                outRow[0] = ReductionOperation::reduce(inRow, m_rowLength, m_reduce);
+            }
+        }
+    };
+}
+
 AString AlgorithmCiftiReduce::getCommandSwitch()
 {
     return "-cifti-reduce";
@@ -108,22 +151,11 @@ AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const Cift
     vector<int64_t> inDims = inputXML.getDimensions();
     if (direction == CiftiXML::ALONG_ROW)
     {
-        vector<float> scratchInRow(inDims[0]);
-        for (MultiDimIterator<int64_t> iter(vector<int64_t>(inDims.begin() + 1, inDims.end())); !iter.atEnd(); ++iter)
-        {// + 1 to exclude row dimension, because getRow/setRow
-            ciftiIn->getRow(scratchInRow.data(), *iter);
-            float result = -1;
-            if (onlyNumeric)
-            {
-                result = ReductionOperation::reduceOnlyNumeric(scratchInRow.data(), inDims[0], myReduce);
-            } else {
-                result = ReductionOperation::reduce(scratchInRow.data(), inDims[0], myReduce);
-            }
-            ciftiOut->setRow(&result, *iter);//if reducing along row, length of output row is 1
-        }
+        ReduceRowStage myStage(myReduce, inDims[0], onlyNumeric);//if reducing along row, length of output row is 1
+        CiftiRowPipeline::runOverRows(&myStage, ciftiIn, ciftiOut);
     } else {
         vector<vector<float> > scratchInRows(inDims[direction], vector<float>(inDims[0]));
-        vector<float> outRow(inDims[0]), reduceScratch(inDims[direction]);//reduction isn't along row, so out rows will be same length as in rows
+        vector<float> outRow(inDims[0]);//reduction isn't along row, so out rows will be same length as in rows
         vector<int64_t> otherDims = inDims;
         otherDims.erase(otherDims.begin() + direction);//direction isn't 0
         otherDims.erase(otherDims.begin());//remove row direction because getRow/setRow
@@ -136,17 +168,22 @@ AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const Cift
                 indexvec[direction - 1] = i;
                 ciftiIn->getRow(scratchInRows[i].data(), indexvec);
             }
-            for (int64_t i = 0; i < inDims[0]; ++i)
+#pragma omp CARET_PAR
             {
-                for (int64_t j = 0; j < inDims[direction]; ++j)
-                {//need reduction input in contiguous array
-                    reduceScratch[j] = scratchInRows[j][i];
-                }
-                if (onlyNumeric)
+                vector<float> reduceScratch(inDims[direction]);
+#pragma omp CARET_FOR schedule(dynamic, 64)
+                for (int64_t i = 0; i < inDims[0]; ++i)
                 {
-                    outRow[i] = ReductionOperation::reduceOnlyNumeric(reduceScratch.data(), inDims[direction], myReduce);
-                } else {
-                    outRow[i] = ReductionOperation::reduce(reduceScratch.data(), inDims[direction], myReduce);
+                    for (int64_t j = 0; j < inDims[direction]; ++j)
+                    {//need reduction input in contiguous array
+                        reduceScratch[j] = scratchInRows[j][i];
+                    }
+                    if (onlyNumeric)
+                    {
+                        outRow[i] = ReductionOperation::reduceOnlyNumeric(reduceScratch.data(), inDims[direction], myReduce);
+                    } else {
+                        outRow[i] = ReductionOperation::reduce(reduceScratch.data(), inDims[direction], myReduce);
+                    }
                 }
             }
             indexvec[direction - 1] = 0;//only one element along reduce output direction
@@ -171,16 +208,11 @@ AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const Cift
     vector<int64_t> inDims = inputXML.getDimensions();
     if (direction == CiftiXML::ALONG_ROW)
     {
-        vector<float> scratchInRow(inDims[0]);
-        for (MultiDimIterator<int64_t> iter(vector<int64_t>(inDims.begin() + 1, inDims.end())); !iter.atEnd(); ++iter)
-        {// + 1 to exclude row dimension, because getRow/setRow
-            ciftiIn->getRow(scratchInRow.data(), *iter);
-            float result = ReductionOperation::reduceExcludeDev(scratchInRow.data(), inDims[0], myReduce, sigmaBelow, sigmaAbove);
-            ciftiOut->setRow(&result, *iter);//if reducing along row, length of output row is 1
-        }
+        ReduceRowStage myStage(myReduce, inDims[0], sigmaBelow, sigmaAbove);
+        CiftiRowPipeline::runOverRows(&myStage, ciftiIn, ciftiOut);
     } else {
         vector<vector<float> > scratchInRows(inDims[direction], vector<float>(inDims[0]));
-        vector<float> outRow(inDims[0]), reduceScratch(inDims[direction]);//reduction isn't along row, so out rows will be same length as in rows
+        vector<float> outRow(inDims[0]);//reduction isn't along row, so out rows will be same length as in rows
         vector<int64_t> otherDims = inDims;
         otherDims.erase(otherDims.begin() + direction);//direction isn't 0
         otherDims.erase(otherDims.begin());//remove row direction because getRow/setRow
@@ -193,13 +225,18 @@ AlgorithmCiftiReduce::AlgorithmCiftiReduce(ProgressObject* myProgObj, const Cift
                 indexvec[direction - 1] = i;
                 ciftiIn->getRow(scratchInRows[i].data(), indexvec);
             }
-            for (int64_t i = 0; i < inDims[0]; ++i)
+#pragma omp CARET_PAR
             {
-                for (int64_t j = 0; j < inDims[direction]; ++j)
-                {//need reduction input in contiguous array
-                    reduceScratch[j] = scratchInRows[j][i];
+                vector<float> reduceScratch(inDims[direction]);
+#pragma omp CARET_FOR schedule(dynamic, 64)
+                for (int64_t i = 0; i < inDims[0]; ++i)
+                {
+                    for (int64_t j = 0; j < inDims[direction]; ++j)
+                    {//need reduction input in contiguous array
+                        reduceScratch[j] = scratchInRows[j][i];
+                    }
+                    outRow[i] = ReductionOperation::reduceExcludeDev(reduceScratch.data(), inDims[direction], myReduce, sigmaBelow, sigmaAbove);
                 }
-                outRow[i] = ReductionOperation::reduceExcludeDev(reduceScratch.data(), inDims[direction], myReduce, sigmaBelow, sigmaAbove);
             }
             indexvec[direction - 1] = 0;//only one element along reduce output direction
             ciftiOut->setRow(outRow.data(), indexvec);
@@ -29,11 +29,15 @@
 #include "AlgorithmMetricResample.h"
 #include "AlgorithmVolumeAffineResample.h"
 #include "AlgorithmVolumeWarpfieldResample.h"
+#include "CaretAssert.h"
+#include "CaretOMP.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 #include "LabelFile.h"
 #include "MetricFile.h"
 #include "SurfaceFile.h"
 #include "SurfaceResamplingHelper.h"
+#include "Vector3D.h"
 #include "VolumeFile.h"
 #include "VolumePaddingHelper.h"
 #include "WarpfieldFile.h"
@@ -512,11 +516,65 @@ namespace
         vector<int64_t> inOffset;
         int64_t refDims[3], refOffset[3];
         vector<vector<float> > refSform;
+        vector<float> outSourceCoords;//for each output voxel, where to sample the (dilated) input volume, computed once instead of every row
+        vector<char> outSourceValid;
         bool copyMode;
     };
     
+    //the same math as AlgorithmVolumeWarpfieldResample and AlgorithmVolumeAffineResample, but only for the voxels in the output cifti
+    void computeVolumeSourceCoords(ResampleCache& myCache, const VolumeFile* warpfield, const FloatMatrix* affine)
+    {
+        CaretAssert((warpfield == NULL) != (affine == NULL));
+        VolumeSpace refSpace(myCache.refDims, myCache.refSform);
+        Vector3D xvec, yvec, zvec, offset;
+        if (affine != NULL)
+        {
+            FloatMatrix targetToSource = *affine;
+            targetToSource.resize(4, 4);
+            targetToSource[3][0] = 0.0f;
+            targetToSource[3][1] = 0.0f;
+            targetToSource[3][2] = 0.0f;
+            targetToSource[3][3] = 1.0f;
+            targetToSource = targetToSource.inverse();
+            xvec[0] = targetToSource[0][0]; xvec[1] = targetToSource[1][0]; xvec[2] = targetToSource[2][0];
+            yvec[0] = targetToSource[0][1]; yvec[1] = targetToSource[1][1]; yvec[2] = targetToSource[2][1];
+            zvec[0] = targetToSource[0][2]; zvec[1] = targetToSource[1][2]; zvec[2] = targetToSource[2][2];
+            offset[0] = targetToSource[0][3]; offset[1] = targetToSource[1][3]; offset[2] = targetToSource[2][3];
+        }
+        int64_t outMapSize = (int64_t)myCache.outVolMap.size();
+        myCache.outSourceCoords.resize(outMapSize * 3);
+        myCache.outSourceValid.resize(outMapSize);
+#pragma omp CARET_PARFOR schedule(dynamic, 1024)
+        for (int64_t j = 0; j < outMapSize; ++j)
+        {
+            float refIndex[3] = { (float)(myCache.outVolMap[j].m_ijk[0] - myCache.refOffset[0]),
+                                  (float)(myCache.outVolMap[j].m_ijk[1] - myCache.refOffset[1]),
+                                  (float)(myCache.outVolMap[j].m_ijk[2] - myCache.refOffset[2]) };
+            Vector3D outCoord, inCoord;
+            refSpace.indexToSpace(refIndex, outCoord);
+            bool valid = true;
+            if (warpfield != NULL)
+            {
+                Vector3D displacement;
+                displacement[0] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, &valid, 0);
+                if (valid)
+                {
+                    displacement[1] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 1);
+                    displacement[2] = warpfield->interpolateValue(outCoord, VolumeFile::TRILINEAR, NULL, 2);
+                    inCoord = outCoord + displacement;
+                }
+            } else {
+                inCoord = xvec * outCoord[0] + yvec * outCoord[1] + zvec * outCoord[2] + offset;
+            }
+            myCache.outSourceValid[j] = (valid ? 1 : 0);
+            myCache.outSourceCoords[j * 3] = inCoord[0];
+            myCache.outSourceCoords[j * 3 + 1] = inCoord[1];
+            myCache.outSourceCoords[j * 3 + 2] = inCoord[2];
+        }
+    }
+    
     void setupRowResampling(map<StructureEnum::Enum, ResampleCache>& surfCache, map<StructureEnum::Enum, ResampleCache>& volCache, const CiftiFile* myCiftiIn, CiftiFile* myCiftiOut,
-                            const SurfaceResamplingMethodEnum::Enum& mySurfMethod, const float& voldilatemm,
+                            const SurfaceResamplingMethodEnum::Enum& mySurfMethod, const float& voldilatemm, const VolumeFile* warpfield, const FloatMatrix* affine,
                             const SurfaceFile* curLeftSphere, const SurfaceFile* newLeftSphere, const MetricFile* curLeftAreas, const MetricFile* newLeftAreas,
                             const SurfaceFile* curRightSphere, const SurfaceFile* newRightSphere, const MetricFile* curRightAreas, const MetricFile* newRightAreas,
                             const SurfaceFile* curCerebSphere, const SurfaceFile* newCerebSphere, const MetricFile* curCerebAreas, const MetricFile* newCerebAreas)
@@ -607,6 +665,7 @@ namespace
             myCache.floatScratch1.resize(inDims[0] * inDims[1] * inDims[2]);
             AlgorithmCiftiSeparate::getCroppedVolSpace(myCiftiIn, CiftiXML::ALONG_ROW, volList[i], inDims.data(), sform, myCache.inOffset.data());
             AlgorithmCiftiSeparate::getCroppedVolSpace(myCiftiOut, CiftiXML::ALONG_ROW, volList[i], myCache.refDims, myCache.refSform, myCache.refOffset);
+            computeVolumeSourceCoords(myCache, warpfield, affine);
             if (labelMode)
             {
                 myCache.tempVol1.grabNew(new VolumeFile(inDims, sform, 1, SubvolumeAttributes::LABEL));
@@ -632,7 +691,7 @@ namespace
         }
     }
     
-    void processRowSurface(ResampleCache& myCache, const vector<float>& inRow, vector<float>& outRow, const CiftiXML& myInputXML,
+    void processRowSurface(ResampleCache& myCache, const float* inRow, float* outRow, const CiftiXML& myInputXML,
                            const float& surfdilatemm, const bool& surfLargest, const int& unassignedLabelKey, const int64_t& row,
                            const AlgorithmMetricDilate::Method& surfDilateMethod, const float& surfDilateExponent)
     {
@@ -701,6 +760,126 @@ namespace
             }
         }
     }
+    
+    void cloneTemporaryVolume(CaretPointer<VolumeFile>& myVol)
+    {//VolumeFile can't be copied, and the temporaries only have one frame
+        if (myVol == NULL) return;
+        CaretPointer<VolumeFile> newVol(new VolumeFile());
+        if (!myVol->isEmpty())
+        {
+            newVol->reinitialize(myVol->getVolumeSpace(), 1, 1, myVol->getType());
+            newVol->setFrame(myVol->getFrame());
+        }
+        myVol = newVol;
+    }
+    
+    void copyCacheForThread(const map<StructureEnum::Enum, ResampleCache>& from, map<StructureEnum::Enum, ResampleCache>& to)
+    {
+        to = from;
+        for (map<StructureEnum::Enum, ResampleCache>::iterator iter = to.begin(); iter != to.end(); ++iter)
+        {//copying a CaretPointer shares the volume, and the temporary volumes get modified for every row
+            ResampleCache& myCache = iter->second;
+            cloneTemporaryVolume(myCache.tempVol1);
+            cloneTemporaryVolume(myCache.tempVol2);
+            cloneTemporaryVolume(myCache.tempVol3);
+        }
+    }
+    
+    class ResampleRowStage : public CiftiRowPipeline::RowStage
+    {
+        vector<map<StructureEnum::Enum, ResampleCache> > m_surfCaches, m_volCaches;//one per thread
+        vector<StructureEnum::Enum> m_surfList, m_volList;
+        const CiftiXML* m_inputXML;
+        vector<int> m_unassignedLabelKey;
+        bool m_labelMode, m_surfLargest;
+        float m_voldilatemm, m_surfdilatemm, m_volDilateExponent, m_surfDilateExponent;
+        VolumeFile::InterpType m_volMethod;
+        AlgorithmVolumeDilate::Method m_volDilateMethod;
+        AlgorithmMetricDilate::Method m_surfDilateMethod;
+    public:
+        ResampleRowStage(const map<StructureEnum::Enum, ResampleCache>& surfCache, const map<StructureEnum::Enum, ResampleCache>& volCache, const CiftiXML& myInputXML,
+                         const vector<StructureEnum::Enum>& surfList, const vector<StructureEnum::Enum>& volList, const vector<int>& unassignedLabelKey,
+                         const VolumeFile::InterpType& myVolMethod, const bool& surfLargest, const float& voldilatemm, const float& surfdilatemm,
+                         const AlgorithmVolumeDilate::Method& volDilateMethod, const float& volDilateExponent,
+                         const AlgorithmMetricDilate::Method& surfDilateMethod, const float& surfDilateExponent)
+        {
+            int numThreads = CiftiRowPipeline::getNumThreads();
+            m_surfCaches.resize(numThreads);
+            m_volCaches.resize(numThreads);
+            m_surfCaches[0] = surfCache;//the first thread can share the original temporaries, as nothing else will use them
+            m_volCaches[0] = volCache;
+            for (int i = 1; i < numThreads; ++i)
+            {
+                copyCacheForThread(surfCache, m_surfCaches[i]);
+                copyCacheForThread(volCache, m_volCaches[i]);
+            }
+            m_inputXML = &myInputXML;
+            m_surfList = surfList;
+            m_volList = volList;
+            m_unassignedLabelKey = unassignedLabelKey;
+            m_labelMode = (myInputXML.getMappingType(CiftiXML::ALONG_COLUMN) == CiftiMappingType::LABELS);
+            m_volMethod = myVolMethod;
+            m_surfLargest = surfLargest;
+            m_voldilatemm = voldilatemm;
+            m_surfdilatemm = surfdilatemm;
+            m_volDilateMethod = volDilateMethod;
+            m_volDilateExponent = volDilateExponent;
+            m_surfDilateMethod = surfDilateMethod;
+            m_surfDilateExponent = surfDilateExponent;
+        }
+        void computeRow(const vector<int64_t>& index, const float* inRow, float* outRow, const int& thread)
+        {
+            int64_t row = index[0];
+            int unassignedKey = (m_labelMode ? m_unassignedLabelKey[row] : 0);
+            for (int i = 0; i < (int)m_surfList.size(); ++i)
+            {
+                map<StructureEnum::Enum, ResampleCache>::iterator iter = m_surfCaches[thread].find(m_surfList[i]);
+                CaretAssert(iter != m_surfCaches[thread].end());
+                processRowSurface(iter->second, inRow, outRow, *m_inputXML, m_surfdilatemm, m_surfLargest, unassignedKey, row, m_surfDilateMethod, m_surfDilateExponent);
+            }
+            for (int i = 0; i < (int)m_volList.size(); ++i)
+            {
+                map<StructureEnum::Enum, ResampleCache>::iterator iter = m_volCaches[thread].find(m_volList[i]);
+                CaretAssert(iter != m_volCaches[thread].end());
+                ResampleCache& myCache = iter->second;
+                if (m_labelMode)//gets initialized to 0 when not using labels
+                {
+                    myCache.tempVol1->setValueAllVoxels(unassignedKey);
+                }
+                int inMapSize = (int)myCache.inVolMap.size(), outMapSize = (int)myCache.outVolMap.size();
+                for (int j = 0; j < inMapSize; ++j)
+                {
+                    myCache.tempVol1->setValue(inRow[myCache.inVolMap[j].m_ciftiIndex], myCache.inVolMap[j].m_ijk[0] - myCache.inOffset[0],
+                                               myCache.inVolMap[j].m_ijk[1] - myCache.inOffset[1],
+                                               myCache.inVolMap[j].m_ijk[2] - myCache.inOffset[2]);
+                }
+                const VolumeFile* toResample = myCache.tempVol1;
+                if (m_voldilatemm > 0.0f)
+                {
+                    myCache.volPadding.doPadding(myCache.tempVol1, myCache.tempVol2);
+                    AlgorithmVolumeDilate(NULL, myCache.tempVol2, m_voldilatemm, m_volDilateMethod, myCache.tempVol3, myCache.volDilateRoi, NULL, -1, m_volDilateExponent);
+                    toResample = myCache.tempVol3;
+                }
+                if (m_volMethod == VolumeFile::CUBIC)
+                {
+                    toResample->validateSpline(0, 0);
+                }
+                for (int j = 0; j < outMapSize; ++j)
+                {//the warp or affine was already applied in setup, only interpolate the voxels that are in the output
+                    if (myCache.outSourceValid[j])
+                    {
+                        outRow[myCache.outVolMap[j].m_ciftiIndex] = toResample->interpolateValue(myCache.outSourceCoords.data() + j * 3, m_volMethod);
+                    } else {
+                        outRow[myCache.outVolMap[j].m_ciftiIndex] = VolumeFile::INVALID_INTERP_VALUE;
+                    }
+                }
+                if (m_volMethod == VolumeFile::CUBIC)
+                {
+                    toResample->freeSpline(0, 0);//the temporary volumes change every row
+                }
+            }
+        }
+    };
 }
 
 AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const CiftiFile* myCiftiIn, const int& direction, const CiftiFile* myTemplate, const int& templateDir,
@@ -722,7 +901,6 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
     const CiftiXML& myInputXML = myCiftiIn->getCiftiXML();
     CiftiXML myOutXML = myInputXML;
     myOutXML.setMap(direction, *(myTemplate->getCiftiXML().getMap(templateDir)));
-    bool labelMode = (myInputXML.getMappingType(CiftiXML::ALONG_COLUMN) == CiftiMappingType::LABELS);
     const CiftiBrainModelsMap& outModels = myOutXML.getBrainModelsMap(direction);
     vector<StructureEnum::Enum> surfList = outModels.getSurfaceStructureList(), volList = outModels.getVolumeStructureList();
     myCiftiOut->setCiftiXML(myOutXML);
@@ -764,7 +942,6 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
         }
     } else {//avoid cifti separate/replace with ALONG_ROW
         vector<StructureEnum::Enum> surfList = outModels.getSurfaceStructureList(), volList = outModels.getVolumeStructureList();
-        int numSurfStructs = (int)surfList.size(), numVolStructs = (int)volList.size();
         vector<int> unassignedLabelKey;
         if (myInputXML.getMappingType(CiftiXML::ALONG_COLUMN) == CiftiMappingType::LABELS)
         {
@@ -776,54 +953,13 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
             }
         }
         map<StructureEnum::Enum, ResampleCache> surfCache, volCache;//could make them different types, but whatever - two variables in case of structure overlap in surface and volume, as some members may get used by both
-        setupRowResampling(surfCache, volCache, myCiftiIn, myCiftiOut, mySurfMethod, voldilatemm,
+        setupRowResampling(surfCache, volCache, myCiftiIn, myCiftiOut, mySurfMethod, voldilatemm, warpfield, NULL,
                            curLeftSphere, newLeftSphere, curLeftAreas, newLeftAreas,
                            curRightSphere, newRightSphere, curRightAreas, newRightAreas,
                            curCerebSphere, newCerebSphere, curCerebAreas, newCerebAreas);
-        int64_t numRows = myInputXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
-        vector<float> inRow(myInputXML.getDimensionLength(CiftiXML::ALONG_ROW)), outRow(myOutXML.getDimensionLength(CiftiXML::ALONG_ROW));
-        for (int64_t row = 0; row < numRows; ++row)
-        {
-            myCiftiIn->getRow(inRow.data(), row);
-            for (int i = 0; i < numSurfStructs; ++i)
-            {
-                map<StructureEnum::Enum, ResampleCache>::iterator iter = surfCache.find(surfList[i]);
-                CaretAssert(iter != surfCache.end());
-                processRowSurface(iter->second, inRow, outRow, myInputXML, surfdilatemm, surfLargest, unassignedLabelKey[row], row, surfDilateMethod, surfDilateExponent);
-            }
-            for (int i = 0; i < numVolStructs; ++i)
-            {
-                map<StructureEnum::Enum, ResampleCache>::iterator iter = volCache.find(volList[i]);
-                CaretAssert(iter != volCache.end());
-                ResampleCache& myCache = iter->second;
-                if (labelMode)//gets initialized to 0 when not using labels
-                {
-                    myCache.tempVol1->setValueAllVoxels(unassignedLabelKey[row]);
-                }
-                int inMapSize = (int)myCache.inVolMap.size(), outMapSize = (int)myCache.outVolMap.size();
-                for (int j = 0; j < inMapSize; ++j)
-                {
-                    myCache.tempVol1->setValue(inRow[myCache.inVolMap[j].m_ciftiIndex], myCache.inVolMap[j].m_ijk[0] - myCache.inOffset[0],
-                                               myCache.inVolMap[j].m_ijk[1] - myCache.inOffset[1],
-                                               myCache.inVolMap[j].m_ijk[2] - myCache.inOffset[2]);
-                }
-                const VolumeFile* toResample = myCache.tempVol1;
-                if (voldilatemm > 0.0f)
-                {
-                    myCache.volPadding.doPadding(myCache.tempVol1, myCache.tempVol2);
-                    AlgorithmVolumeDilate(NULL, myCache.tempVol2, voldilatemm, volDilateMethod, myCache.tempVol3, myCache.volDilateRoi, NULL, -1, volDilateExponent);
-                    toResample = myCache.tempVol3;
-                }
-                AlgorithmVolumeWarpfieldResample(NULL, toResample, warpfield, myCache.refDims, myCache.refSform, myVolMethod, myCache.tempVol2);
-                for (int j = 0; j < outMapSize; ++j)
-                {
-                    outRow[myCache.outVolMap[j].m_ciftiIndex] = myCache.tempVol2->getValue(myCache.outVolMap[j].m_ijk[0] - myCache.refOffset[0],
-                                                                                           myCache.outVolMap[j].m_ijk[1] - myCache.refOffset[1],
-                                                                                           myCache.outVolMap[j].m_ijk[2] - myCache.refOffset[2]);
-                }
-            }
-            myCiftiOut->setRow(outRow.data(), row);
-        }
+        ResampleRowStage myStage(surfCache, volCache, myInputXML, surfList, volList, unassignedLabelKey, myVolMethod, surfLargest, voldilatemm, surfdilatemm,
+                                 volDilateMethod, volDilateExponent, surfDilateMethod, surfDilateExponent);
+        CiftiRowPipeline::runOverRows(&myStage, myCiftiIn, myCiftiOut);
     }
 }
 
@@ -887,7 +1023,6 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
         }
     } else {//avoid cifti separate/replace with ALONG_ROW
         vector<StructureEnum::Enum> surfList = outModels.getSurfaceStructureList(), volList = outModels.getVolumeStructureList();
-        int numSurfStructs = (int)surfList.size(), numVolStructs = (int)volList.size();
         vector<int> unassignedLabelKey;
         if (myInputXML.getMappingType(CiftiXML::ALONG_COLUMN) == CiftiMappingType::LABELS)
         {
@@ -899,50 +1034,13 @@ AlgorithmCiftiResample::AlgorithmCiftiResample(ProgressObject* myProgObj, const
             }
         }
         map<StructureEnum::Enum, ResampleCache> surfCache, volCache;//could make them different types, but whatever - two variables in case of structure overlap in surface and volume, as some members may get used by both
-        setupRowResampling(surfCache, volCache, myCiftiIn, myCiftiOut, mySurfMethod, voldilatemm,
+        setupRowResampling(surfCache, volCache, myCiftiIn, myCiftiOut, mySurfMethod, voldilatemm, NULL, &affine,
                            curLeftSphere, newLeftSphere, curLeftAreas, newLeftAreas,
                            curRightSphere, newRightSphere, curRightAreas, newRightAreas,
                            curCerebSphere, newCerebSphere, curCerebAreas, newCerebAreas);
-        int64_t numRows = myInputXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
-        vector<float> inRow(myInputXML.getDimensionLength(CiftiXML::ALONG_ROW)), outRow(myOutXML.getDimensionLength(CiftiXML::ALONG_ROW));
-        for (int64_t row = 0; row < numRows; ++row)
-        {
-            myCiftiIn->getRow(inRow.data(), row);
-            for (int i = 0; i < numSurfStructs; ++i)
-            {
-                map<StructureEnum::Enum, ResampleCache>::iterator iter = surfCache.find(surfList[i]);
-                CaretAssert(iter != surfCache.end());
-                processRowSurface(iter->second, inRow, outRow, myInputXML, surfdilatemm, surfLargest, unassignedLabelKey[row], row, surfDilateMethod, surfDilateExponent);
-            }
-            for (int i = 0; i < numVolStructs; ++i)
-            {
-                map<StructureEnum::Enum, ResampleCache>::iterator iter = volCache.find(volList[i]);
-                CaretAssert(iter != volCache.end());
-                ResampleCache& myCache = iter->second;
-                int inMapSize = (int)myCache.inVolMap.size(), outMapSize = (int)myCache.outVolMap.size();
-                for (int j = 0; j < inMapSize; ++j)
-                {
-                    myCache.tempVol1->setValue(inRow[myCache.inVolMap[j].m_ciftiIndex], myCache.inVolMap[j].m_ijk[0] - myCache.inOffset[0],
-                                               myCache.inVolMap[j].m_ijk[1] - myCache.inOffset[1],
-                                               myCache.inVolMap[j].m_ijk[2] - myCache.inOffset[2]);
-                }
-                const VolumeFile* toResample = myCache.tempVol1;
-                if (voldilatemm > 0.0f)
-                {
-                    myCache.volPadding.doPadding(myCache.tempVol1, myCache.tempVol2);
-                    AlgorithmVolumeDilate(NULL, myCache.tempVol2, voldilatemm, volDilateMethod, myCache.tempVol3, myCache.volDilateRoi, NULL, -1, volDilateExponent);
-                    toResample = myCache.tempVol3;
-                }
-                AlgorithmVolumeAffineResample(NULL, toResample, affine, myCache.refDims, myCache.refSform, myVolMethod, myCache.tempVol2);
-                for (int j = 0; j < outMapSize; ++j)
-                {
-                    outRow[myCache.outVolMap[j].m_ciftiIndex] = myCache.tempVol2->getValue(myCache.outVolMap[j].m_ijk[0] - myCache.refOffset[0],
-                                                                                           myCache.outVolMap[j].m_ijk[1] - myCache.refOffset[1],
-                                                                                           myCache.outVolMap[j].m_ijk[2] - myCache.refOffset[2]);
-                }
-            }
-            myCiftiOut->setRow(outRow.data(), row);
-        }
+        ResampleRowStage myStage(surfCache, volCache, myInputXML, surfList, volList, unassignedLabelKey, myVolMethod, surfLargest, voldilatemm, surfdilatemm,
+                                 volDilateMethod, volDilateExponent, surfDilateMethod, surfDilateExponent);
+        CiftiRowPipeline::runOverRows(&myStage, myCiftiIn, myCiftiOut);
     }
 }
 
@@ -24,6 +24,7 @@
 #include "AlgorithmVolumeSmoothing.h"
 #include "CiftiFile.h"
 #include "MetricFile.h"
+#include "MetricSmoothingObject.h"
 #include "VolumeFile.h"
 #include "SurfaceFile.h"
 #include "AlgorithmCiftiSeparate.h"
@@ -32,6 +33,45 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    //along column, each row of the cifti is one vertex, so the rows are already node-major and can go straight into the smoothing object without separating into a metric
+    void smoothSurfaceAlongColumn(const CiftiFile* myCifti, const StructureEnum::Enum& myStructure, const SurfaceFile* mySurf, const float& surfKern,
+                                  CiftiFile* myCiftiOut, const CiftiFile* roiCifti, const bool& fixZerosSurf, const MetricFile* myAreas)
+    {
+        vector<CiftiSurfaceMap> myMap;
+        myCifti->getCiftiXMLOld().getSurfaceMapForColumns(myMap, myStructure);
+        int32_t numNodes = mySurf->getNumberOfNodes();
+        int64_t rowSize = myCifti->getNumberOfColumns(), mapSize = (int64_t)myMap.size();
+        vector<float> roiValues, roiData(numNodes, 0.0f);
+        if (roiCifti != NULL)
+        {//first column of the roi, like separating it to a metric and using the first column as the roi
+            roiValues.resize(roiCifti->getNumberOfRows());
+            roiCifti->getColumns(roiValues.data(), vector<int64_t>(1, 0));
+        }
+        for (int64_t i = 0; i < mapSize; ++i)
+        {
+            roiData[myMap[i].m_surfaceNode] = (roiCifti != NULL ? roiValues[myMap[i].m_ciftiIndex] : 1.0f);
+        }
+        MetricFile myRoi;
+        myRoi.setNumberOfNodesAndColumns(numNodes, 1);
+        myRoi.setValuesForColumn(0, roiData.data());
+        const float* areaData = NULL;
+        if (myAreas != NULL) areaData = myAreas->getValuePointerForColumn(0);
+        MetricSmoothingObject mySmoothObj(mySurf, surfKern, &myRoi, MetricSmoothingObject::GEO_GAUSS_AREA, areaData);
+        vector<float> dataIn(numNodes * rowSize, 0.0f), dataOut(numNodes * rowSize);
+        for (int64_t i = 0; i < mapSize; ++i)
+        {
+            myCifti->getRow(dataIn.data() + myMap[i].m_surfaceNode * rowSize, myMap[i].m_ciftiIndex);
+        }
+        mySmoothObj.smoothNodeMajor(dataIn.data(), dataOut.data(), rowSize, roiData.data(), fixZerosSurf);
+        for (int64_t i = 0; i < mapSize; ++i)
+        {
+            myCiftiOut->setRow(dataOut.data() + myMap[i].m_surfaceNode * rowSize, myMap[i].m_ciftiIndex);
+        }
+    }
+}
+
 AString AlgorithmCiftiSmoothing::getCommandSwitch()
 {
     return "-cifti-smoothing";
@@ -247,6 +287,11 @@ AlgorithmCiftiSmoothing::AlgorithmCiftiSmoothing(ProgressObject* myProgObj, cons
             default:
                 break;
         }
+        if (surfKern > 0.0f && myDir == CiftiXMLOld::ALONG_COLUMN)
+        {
+            smoothSurfaceAlongColumn(myCifti, surfaceList[whichStruct], mySurf, surfKern, myCiftiOut, roiCifti, fixZerosSurf, myAreas);
+            continue;
+        }
         MetricFile myMetric, myRoi, myMetricOut;
         AlgorithmCiftiSeparate(NULL, myCifti, myDir, surfaceList[whichStruct], &myMetric, &myRoi);
         if (surfKern > 0.0f)
@@ -21,10 +21,45 @@
 #include "AlgorithmCiftiTranspose.h"
 #include "AlgorithmException.h"
 #include "CiftiFile.h"
+#include "FileInformation.h"
+
+#include <QDir>
+#include <QTemporaryFile>
+
+#include <algorithm>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int64_t SPILL_CHUNK_BYTES = ((int64_t)1) << 30;//QFile chokes on large single reads/writes in QT4
+    
+    void spillWrite(QTemporaryFile& spillFile, const int64_t& floatOffset, const float* data, const int64_t& count)
+    {
+        if (!spillFile.seek(floatOffset * sizeof(float))) throw AlgorithmException("failed to seek in temporary file '" + spillFile.fileName() + "'");
+        int64_t totalBytes = count * sizeof(float), done = 0;
+        while (done < totalBytes)
+        {
+            int64_t ret = spillFile.write(((const char*)data) + done, min(totalBytes - done, SPILL_CHUNK_BYTES));
+            if (ret < 1) throw AlgorithmException("failed to write to temporary file '" + spillFile.fileName() + "', disk may be full");
+            done += ret;
+        }
+    }
+    
+    void spillRead(QTemporaryFile& spillFile, const int64_t& floatOffset, float* data, const int64_t& count)
+    {
+        if (!spillFile.seek(floatOffset * sizeof(float))) throw AlgorithmException("failed to seek in temporary file '" + spillFile.fileName() + "'");
+        int64_t totalBytes = count * sizeof(float), done = 0;
+        while (done < totalBytes)
+        {
+            int64_t ret = spillFile.read(((char*)data) + done, min(totalBytes - done, SPILL_CHUNK_BYTES));
+            if (ret < 1) throw AlgorithmException("failed to read from temporary file '" + spillFile.fileName() + "'");
+            done += ret;
+        }
+    }
+}
+
 AString AlgorithmCiftiTranspose::getCommandSwitch()
 {
     return "-cifti-transpose";
@@ -47,7 +82,9 @@ OperationParameters* AlgorithmCiftiTranspose::getParameters()
     
     ret->setHelpText(
         AString("The input must be a 2-dimensional cifti file.  ") +
-        "The output is a cifti file where every row in the input is a column in the output."
+        "The output is a cifti file where every row in the input is a column in the output.\n\n" +
+        "When -mem-limit is smaller than the output and the input is on disk, the input is read only once, and the transposed blocks are staged in a temporary file " +
+        "in the same directory as the output, which needs about as much free space as the input file."
     );
     return ret;
 }
@@ -82,33 +119,107 @@ AlgorithmCiftiTranspose::AlgorithmCiftiTranspose(ProgressObject* myProgObj, cons
     outXML.setMap(0, *(inXML.getMap(1)));
     outXML.setMap(1, *(inXML.getMap(0)));
     ciftiOut->setCiftiXML(outXML);
-    int rowSize = outXML.getDimensionLength(CiftiXML::ALONG_ROW), colSize = outXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    int64_t rowSize = outXML.getDimensionLength(CiftiXML::ALONG_ROW), colSize = outXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
     int64_t outRowBytes = rowSize * sizeof(float);
-    int numCacheRows = colSize;
+    int64_t numCacheRows = colSize;
     if (memLimitGB >= 0.0f)
     {
-        numCacheRows = memLimitGB * 1024 * 1024 * 1024 / outRowBytes;
+        numCacheRows = (int64_t)(memLimitGB * 1024 * 1024 * 1024 / outRowBytes);
         if (numCacheRows < 1) numCacheRows = 1;
         if (numCacheRows > colSize) numCacheRows = colSize;
     }
+    if (numCacheRows < colSize && !ciftiIn->isInMemory())
+    {//re-reading the input once per chunk is O(chunks * filesize), so stage transposed tiles in a temporary file instead
+        transposeWithSpill(myProgress, ciftiIn, ciftiOut, memLimitGB);
+        return;
+    }
     vector<vector<float> > cacheRows(numCacheRows, vector<float>(rowSize));
     vector<float> scratchInRow(colSize);
-    for (int i = 0; i < colSize; i += numCacheRows)//loop through cache chunks
+    for (int64_t i = 0; i < colSize; i += numCacheRows)//loop through cache chunks
     {
-        int end = i + numCacheRows;
+        int64_t end = i + numCacheRows;
         if (end > colSize) end = colSize;
-        for (int j = 0; j < rowSize; ++j)//loop through all input rows
+        for (int64_t j = 0; j < rowSize; ++j)//loop through all input rows
         {
             ciftiIn->getRow(scratchInRow.data(), j);
-            for (int k = i; k < end; ++k)
+            for (int64_t k = i; k < end; ++k)
             {
                 cacheRows[k - i][j] = scratchInRow[k];
             }
         }
-        for (int k = i; k < end; ++k)
+        for (int64_t k = i; k < end; ++k)
         {
             ciftiOut->setRow(cacheRows[k - i].data(), k);
         }
+        myProgress.reportProgress(((float)end) / colSize);
+    }
+}
+
+void AlgorithmCiftiTranspose::transposeWithSpill(LevelProgress& myProgress, const CiftiFile* ciftiIn, CiftiFile* ciftiOut, const float& memLimitGB)
+{
+    const CiftiXML& outXML = ciftiOut->getCiftiXML();
+    int64_t rowSize = outXML.getDimensionLength(CiftiXML::ALONG_ROW), colSize = outXML.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    int64_t halfLimitBytes = (int64_t)(memLimitGB * 1024 * 1024 * 1024 / 2);//half for the rows being built, half for the tile being moved
+    //input rows are colSize long, output rows are rowSize long
+    int64_t blockRows = max((int64_t)1, min(rowSize, halfLimitBytes / (int64_t)(colSize * sizeof(float))));//input rows per read block
+    int64_t partRows = max((int64_t)1, min(colSize, halfLimitBytes / (int64_t)(rowSize * sizeof(float))));//output rows per partition
+    AString spillDir = QDir::tempPath();
+    if (!ciftiOut->isInMemory())
+    {
+        spillDir = FileInformation(ciftiOut->getFileName()).getAbsolutePath();//output filesystem is more likely to have room for a copy of the data than /tmp
+    }
+    if (!spillDir.endsWith('/')) spillDir += '/';
+    QTemporaryFile spillFile(spillDir + "wb_transpose_XXXXXX.tmp");
+    if (!spillFile.open()) throw AlgorithmException("failed to create temporary file in '" + spillDir + "'");
+    //layout: partition p covers output rows [p * partRows, p * partRows + partSize), and starts at float offset (p * partRows) * rowSize
+    //within a partition, the tile for input block starting at row b0 starts at b0 * partSize, and holds partSize output rows of blockSize elements each
+    //so, each tile is written with one call, and each partition is read back sequentially
+    vector<float> inBlock(blockRows * colSize), tile(blockRows * partRows);
+    myProgress.setTask("transposing blocks into temporary file");
+    for (int64_t b0 = 0; b0 < rowSize; b0 += blockRows)//the only pass over the input
+    {
+        int64_t blockSize = min(blockRows, rowSize - b0);
+        for (int64_t r = 0; r < blockSize; ++r)
+        {
+            ciftiIn->getRow(inBlock.data() + r * colSize, b0 + r);
+        }
+        for (int64_t p0 = 0; p0 < colSize; p0 += partRows)
+        {
+            int64_t partSize = min(partRows, colSize - p0);
+            for (int64_t k = 0; k < partSize; ++k)
+            {
+                for (int64_t r = 0; r < blockSize; ++r)
+                {
+                    tile[k * blockSize + r] = inBlock[r * colSize + p0 + k];
+                }
+            }
+            spillWrite(spillFile, p0 * rowSize + b0 * partSize, tile.data(), partSize * blockSize);
+        }
+        myProgress.reportProgress(0.5f * (b0 + blockSize) / rowSize);
+    }
+    inBlock = vector<float>();//release memory before allocating the output rows
+    vector<float> outRows(partRows * rowSize);
+    myProgress.setTask("writing output rows");
+    for (int64_t p0 = 0; p0 < colSize; p0 += partRows)
+    {
+        int64_t partSize = min(partRows, colSize - p0);
+        for (int64_t b0 = 0; b0 < rowSize; b0 += blockRows)//tiles of a partition are contiguous, so this is a sequential read
+        {
+            int64_t blockSize = min(blockRows, rowSize - b0);
+            spillRead(spillFile, p0 * rowSize + b0 * partSize, tile.data(), partSize * blockSize);
+            for (int64_t k = 0; k < partSize; ++k)
+            {
+                for (int64_t r = 0; r < blockSize; ++r)
+                {
+                    outRows[k * rowSize + b0 + r] = tile[k * blockSize + r];
+                }
+            }
+        }
+        for (int64_t k = 0; k < partSize; ++k)
+        {
+            ciftiOut->setRow(outRows.data() + k * rowSize, p0 + k);
+        }
+        myProgress.reportProgress(0.5f + 0.5f * (p0 + partSize) / colSize);
     }
 }
 
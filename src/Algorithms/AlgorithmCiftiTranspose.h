@@ -28,6 +28,7 @@ namespace caret {
     class AlgorithmCiftiTranspose : public AbstractAlgorithm
     {
         AlgorithmCiftiTranspose();
+        void transposeWithSpill(LevelProgress& myProgress, const CiftiFile* ciftiIn, CiftiFile* ciftiOut, const float& memLimitGB);
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
@@ -21,7 +21,10 @@
 #include "AlgorithmMetricFindClusters.h"
 #include "AlgorithmException.h"
 
+#include "CaretAssert.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
+#include "ClusterLabelingHelper.h"
 #include "GeodesicHelper.h"
 #include "MetricFile.h"
 #include "SurfaceFile.h"
@@ -145,19 +148,9 @@ void AlgorithmMetricFindClusters::useParameters(OperationParameters* myParams, P
 
 namespace
 {
-    struct Cluster
+    void markColumn(const float* data, const float* roiData, const int& numNodes, const float& threshVal, const bool& lessThan, vector<char>& marked)
     {
-        Cluster() { area = 0.0; }
-        vector<int32_t> members;
-        double area;
-    };
-    
-    void processColumn(const float* data, const float* roiData, const float* nodeAreas, TopologyHelper* myTopoHelp, GeodesicHelper* myGeoHelp,
-                       const float& threshVal, const float& minArea, const bool& lessThan, const float& areaRatio, const float& distanceCutoff,
-                       float* outData, int& markVal)
-    {
-        int numNodes = myTopoHelp->getNumberOfNodes();
-        vector<int> marked(numNodes, 0);
+        marked.assign(numNodes, 0);
         if (lessThan)
         {
             for (int i = 0; i < numNodes; ++i)
@@ -176,41 +169,40 @@ namespace
                 }
             }
         }
-        vector<Cluster> clusters;
+    }
+    
+    void getClusterMembers(const vector<int64_t>& memberStarts, const vector<int64_t>& members, const int64_t& cluster, vector<int32_t>& clusterOut)
+    {
+        clusterOut.clear();
+        for (int64_t m = memberStarts[cluster]; m < memberStarts[cluster + 1]; ++m)
+        {
+            clusterOut.push_back((int32_t)members[m]);
+        }
+    }
+    
+    void processColumn(const float* data, const float* roiData, const float* nodeAreas, TopologyHelper* myTopoHelp, GeodesicHelper* myGeoHelp,
+                       const float& threshVal, const float& minArea, const bool& lessThan, const float& areaRatio, const float& distanceCutoff,
+                       float* outData, int& markVal)
+    {
+        int numNodes = myTopoHelp->getNumberOfNodes();
+        vector<char> marked;
+        markColumn(data, roiData, numNodes, threshVal, lessThan, marked);
+        vector<int64_t> labels(numNodes);
+        vector<double> areas;
+        int64_t numFound = ClusterLabelingHelper::labelSurface(marked.data(), myTopoHelp, nodeAreas, labels.data(), areas);
+        vector<int64_t> clusters;//cluster numbers are in order of their lowest vertex
         float biggestSize = 0.0f;
         int biggestCluster = -1;
-        for (int i = 0; i < numNodes; ++i)
+        for (int64_t c = 0; c < numFound; ++c)
         {
-            if (marked[i])
+            if (areas[c] > minArea)
             {
-                Cluster newCluster;
-                newCluster.members.push_back(i);
-                marked[i] = 0;//unmark it when added to list to prevent multiples
-                for (int index = 0; index < (int)newCluster.members.size(); ++index)//NOTE: vector grows inside loop
-                {
-                    int node = newCluster.members[index];//keep list around so we can put it into the output immediately if it is large enough
-                    newCluster.area += nodeAreas[node];
-                    const vector<int32_t>& neighbors = myTopoHelp->getNodeNeighbors(node);
-                    int numNeigh = (int)neighbors.size();
-                    for (int n = 0; n < numNeigh; ++n)
-                    {
-                        const int32_t& neighbor = neighbors[n];
-                        if (marked[neighbor])
-                        {
-                            newCluster.members.push_back(neighbor);
-                            marked[neighbor] = 0;
-                        }
-                    }
-                }
-                if (newCluster.area > minArea)
+                if (areas[c] > biggestSize)
                 {
-                    if (newCluster.area > biggestSize)
-                    {
-                        biggestSize = newCluster.area;
-                        biggestCluster = (int)clusters.size();
-                    }
-                    clusters.push_back(newCluster);
+                    biggestSize = areas[c];
+                    biggestCluster = (int)clusters.size();
                 }
+                clusters.push_back(c);
             }
         }
         vector<int32_t> pathScratch;
@@ -218,6 +210,13 @@ namespace
         if (!clusters.empty() && biggestCluster == -1) CaretLogWarning("clusters found, but none have positive area, check your vertex areas for negatives");
         if (biggestCluster != -1 && (distanceCutoff > 0.0f || areaRatio > 0.0f))
         {
+            vector<int64_t> memberStarts, members;
+            vector<int32_t> biggestMembers, thisMembers;
+            if (distanceCutoff > 0.0f)
+            {
+                ClusterLabelingHelper::getMembers(labels.data(), numNodes, numFound, memberStarts, members);
+                getClusterMembers(memberStarts, members, clusters[biggestCluster], biggestMembers);
+            }
             for (size_t i = 0; i < clusters.size(); ++i)
             {
                 if ((int)i != biggestCluster)
@@ -225,7 +224,7 @@ namespace
                     bool erase = false;
                     if (areaRatio > 0.0f)
                     {
-                        if ((clusters[i].area / biggestSize) < areaRatio)
+                        if ((areas[clusters[i]] / biggestSize) < areaRatio)
                         {
                             erase = true;
                         }
@@ -233,7 +232,8 @@ namespace
                     if (!erase && distanceCutoff > 0.0f)
                     {
                         CaretAssert(myGeoHelp != NULL);
-                        myGeoHelp->getPathBetweenNodeLists(clusters[i].members, clusters[biggestCluster].members, distanceCutoff, pathScratch, distScratch, true);
+                        getClusterMembers(memberStarts, members, clusters[i], thisMembers);
+                        myGeoHelp->getPathBetweenNodeLists(thisMembers, biggestMembers, distanceCutoff, pathScratch, distScratch, true);
                         if (pathScratch.empty())//empty path means no path found
                         {
                             erase = true;
@@ -248,6 +248,7 @@ namespace
                 }
             }
         }
+        vector<float> clusterVals(numFound, 0.0f);
         for (size_t i = 0; i < clusters.size(); ++i)
         {
             if (markVal == 0)
@@ -257,13 +258,13 @@ namespace
             }
             float tempVal = markVal;
             if ((int)tempVal != markVal) throw AlgorithmException("too many clusters, unable to mark them uniquely");
-            int numMembers = (int)clusters[i].members.size();
-            for (int index = 0; index < numMembers; ++index)
-            {
-                outData[clusters[i].members[index]] = tempVal;
-            }
+            clusterVals[clusters[i]] = tempVal;
             ++markVal;
         }
+        for (int i = 0; i < numNodes; ++i)
+        {
+            if (labels[i] >= 0) outData[i] = clusterVals[labels[i]];
+        }
     }
 }
 
@@ -315,7 +316,6 @@ AlgorithmMetricFindClusters::AlgorithmMetricFindClusters(ProgressObject* myProgO
             myGeoHelp.grabNew(new GeodesicHelper(myGeoBase));
         }
     }
-    vector<int> toSearch;
     int markVal = startVal;//give each cluster a different value, including across maps
     if (columnNum == -1)
     {
@@ -341,6 +341,40 @@ AlgorithmMetricFindClusters::AlgorithmMetricFindClusters(ProgressObject* myProgO
     if (endVal != NULL) *endVal = markVal;
 }
 
+void AlgorithmMetricFindClusters::getClusterAreas(const SurfaceFile* mySurf, const MetricFile* myMetric, const float& threshVal, vector<vector<double> >& areasOut,
+                                                  const bool& lessThan, const MetricFile* myRoi, const MetricFile* myAreas)
+{
+    int numNodes = mySurf->getNumberOfNodes();
+    if (myMetric->getNumberOfNodes() != numNodes) throw AlgorithmException("metric does not match surface in number of vertices");
+    const float* roiData = NULL;
+    if (myRoi != NULL)
+    {
+        if (myRoi->getNumberOfNodes() != numNodes) throw AlgorithmException("roi metric does not match surface in number of vertices");
+        roiData = myRoi->getValuePointerForColumn(0);
+    }
+    vector<float> nodeAreasVec;
+    const float* nodeAreas = NULL;
+    if (myAreas == NULL)
+    {
+        mySurf->computeNodeAreas(nodeAreasVec);
+        nodeAreas = nodeAreasVec.data();
+    } else {
+        if (myAreas->getNumberOfNodes() != numNodes) throw AlgorithmException("corrected area metric does not match surface in number of vertices");
+        nodeAreas = myAreas->getValuePointerForColumn(0);
+    }
+    CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();
+    int numCols = myMetric->getNumberOfColumns();
+    areasOut.clear();
+    areasOut.resize(numCols);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int c = 0; c < numCols; ++c)
+    {//one column per thread, labeling runs single threaded inside a parallel region
+        vector<char> marked;
+        markColumn(myMetric->getValuePointerForColumn(c), roiData, numNodes, threshVal, lessThan, marked);
+        ClusterLabelingHelper::labelSurface(marked.data(), myTopoHelp, nodeAreas, NULL, areasOut[c]);
+    }
+}
+
 float AlgorithmMetricFindClusters::getAlgorithmInternalWeight()
 {
     return 1.0f;//override this if needed, if the progress bar isn't smooth
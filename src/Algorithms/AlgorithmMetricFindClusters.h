@@ -23,6 +23,8 @@
 
 #include "AbstractAlgorithm.h"
 
+#include <vector>
+
 namespace caret {
     
     class AlgorithmMetricFindClusters : public AbstractAlgorithm
@@ -35,6 +37,9 @@ namespace caret {
         AlgorithmMetricFindClusters(ProgressObject* myProgObj, const SurfaceFile* mySurf, const MetricFile* myMetric, const float& minVal, const float& minArea,
                                     MetricFile* myMetricOut, const bool& lessThan = false, const MetricFile* myRoi = NULL, const MetricFile* myAreas = NULL,
                                     const int& columnNum = -1, const int& startVal = 1, int* endVal = NULL, const float& areaRatio = -1.0f, const float& distanceCutoff = -1.0f);
+        ///size-only path for permutation testing: areas of every cluster in every column (in order of column, then cluster), without thresholding by area or making an output
+        static void getClusterAreas(const SurfaceFile* mySurf, const MetricFile* myMetric, const float& threshVal, std::vector<std::vector<double> >& areasOut,
+                                    const bool& lessThan = false, const MetricFile* myRoi = NULL, const MetricFile* myAreas = NULL);
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
@@ -0,0 +1,204 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AlgorithmSurfaceGeodesicDistanceAllToAll.h"
+#include "AlgorithmException.h"
+
+#include "CaretAssert.h"
+#include "CiftiFile.h"
+#include "GeodesicHelper.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t CHUNK_MEM_LIMIT = 256 * 1024 * 1024;//output rows to keep in memory at once, rows are written in order after each chunk
+    
+    class RowReceiver : public GeodesicBatchReceiver
+    {
+        float* m_chunkData;
+        const vector<int64_t>& m_nodeToIndex;
+        int64_t m_rowLength;
+    public:
+        RowReceiver(float* chunkData, const vector<int64_t>& nodeToIndex, const int64_t& rowLength) : m_nodeToIndex(nodeToIndex)
+        {
+            m_chunkData = chunkData;
+            m_rowLength = rowLength;
+        }
+        void receive(const int64_t& rootIndex, const vector<int32_t>& nodes, const vector<float>& dists)
+        {//each root has its own row, so no locking needed
+            float* row = m_chunkData + rootIndex * m_rowLength;
+            for (int64_t i = 0; i < m_rowLength; ++i)
+            {
+                row[i] = -1.0f;
+            }
+            for (int i = 0; i < (int)nodes.size(); ++i)
+            {
+                int64_t index = m_nodeToIndex[nodes[i]];
+                if (index >= 0) row[index] = dists[i];
+            }
+        }
+    };
+}
+
+AString AlgorithmSurfaceGeodesicDistanceAllToAll::getCommandSwitch()
+{
+    return "-surface-geodesic-distance-all-to-all";
+}
+
+AString AlgorithmSurfaceGeodesicDistanceAllToAll::getShortDescription()
+{
+    return "COMPUTE GEODESIC DISTANCE FROM EVERY VERTEX TO EVERY OTHER";
+}
+
+OperationParameters* AlgorithmSurfaceGeodesicDistanceAllToAll::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    ret->addSurfaceParameter(1, "surface", "the surface to compute on");
+    
+    ret->addCiftiOutputParameter(2, "cifti-out", "the output dconn");
+    
+    OptionalParameter* roiOpt = ret->createOptionalParameter(3, "-roi", "only compute distances between vertices inside an roi");
+    roiOpt->addMetricParameter(1, "roi-metric", "the roi, as a metric file");
+    
+    OptionalParameter* limitOpt = ret->createOptionalParameter(4, "-limit", "stop at a certain distance");
+    limitOpt->addDoubleParameter(1, "limit-mm", "distance in mm to stop at");
+    
+    ret->createOptionalParameter(5, "-naive", "use only neighbors, don't crawl triangles (not recommended)");
+    
+    OptionalParameter* corrAreaOpt = ret->createOptionalParameter(6, "-corrected-areas", "vertex areas to use instead of computing them from the surface");
+    corrAreaOpt->addMetricParameter(1, "area-metric", "the corrected vertex areas, as a metric");
+    
+    ret->setHelpText(
+        AString("Computes the geodesic distance from each vertex to every other vertex, and writes the result as a dconn, where each row contains the distances from one vertex.  ") +
+        "If -roi is specified, only vertices inside the roi are used, for both rows and columns.  " +
+        "If -limit is specified, distances are only computed out to the limit, and vertices beyond the limit have a value of -1, as do vertices that are not connected to the row's vertex.  " +
+        "Each row is a separate computation, and rows are computed in parallel.\n\n" +
+        "CIFTI has no sparse storage, so the output is a full dconn even with -limit, which makes it readable by every command and viewer that takes a dconn.  " +
+        "-limit reduces the computation, not the file size: without -roi, a 32k vertex surface makes a 4GB file.  " +
+        "The output is written in chunks of rows as it is computed, so memory use stays bounded, but use -roi to make the file smaller.\n\n" +
+        "If -naive is not specified, it uses not just immediate neighbors, but also neighbors derived from crawling across pairs of triangles that share an edge.\n\n" +
+        "The -corrected-areas option is intended for when it is unavoidable to use a group average surface, it is only an approximate correction " +
+        "for the reduction of structure in a group average surface."
+    );
+    return ret;
+}
+
+void AlgorithmSurfaceGeodesicDistanceAllToAll::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    SurfaceFile* mySurf = myParams->getSurface(1);
+    CiftiFile* myCiftiOut = myParams->getOutputCifti(2);
+    MetricFile* myRoi = NULL;
+    OptionalParameter* roiOpt = myParams->getOptionalParameter(3);
+    if (roiOpt->m_present)
+    {
+        myRoi = roiOpt->getMetric(1);
+    }
+    float limit = -1.0f;
+    OptionalParameter* limitOpt = myParams->getOptionalParameter(4);
+    if (limitOpt->m_present)
+    {
+        limit = (float)limitOpt->getDouble(1);
+        if (limit < 0.0f) throw AlgorithmException("limit must not be negative");
+    }
+    bool naive = myParams->getOptionalParameter(5)->m_present;
+    MetricFile* corrAreas = NULL;
+    OptionalParameter* corrAreaOpt = myParams->getOptionalParameter(6);
+    if (corrAreaOpt->m_present)
+    {
+        corrAreas = corrAreaOpt->getMetric(1);
+    }
+    AlgorithmSurfaceGeodesicDistanceAllToAll(myProgObj, mySurf, myCiftiOut, myRoi, limit, naive, corrAreas);
+}
+
+AlgorithmSurfaceGeodesicDistanceAllToAll::AlgorithmSurfaceGeodesicDistanceAllToAll(ProgressObject* myProgObj, const SurfaceFile* mySurf, CiftiFile* myCiftiOut, const MetricFile* myRoi,
+                                                                                   const float& limit, const bool& naive, const MetricFile* corrAreas) : AbstractAlgorithm(myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    int numNodes = mySurf->getNumberOfNodes();
+    const float* roiData = NULL;
+    if (myRoi != NULL)
+    {
+        if (myRoi->getNumberOfNodes() != numNodes) throw AlgorithmException("roi metric has a different number of vertices than the surface");
+        checkStructureMatch(myRoi, mySurf->getStructure(), "roi metric", "surface file has");
+        roiData = myRoi->getValuePointerForColumn(0);
+    }
+    float maxDist = numeric_limits<float>::max();//negative limit means no limit
+    if (limit >= 0.0f) maxDist = limit;
+    bool smooth = !naive;
+    CaretPointer<GeodesicHelper> myHelp;
+    if (corrAreas != NULL)
+    {
+        if (corrAreas->getNumberOfNodes() != numNodes) throw AlgorithmException("corrected areas metric has a different number of vertices than the surface");
+        checkStructureMatch(corrAreas, mySurf->getStructure(), "corrected areas metric", "surface file has");
+        CaretPointer<GeodesicHelperBase> myBase(new GeodesicHelperBase(mySurf, corrAreas->getValuePointerForColumn(0)));
+        myHelp.grabNew(new GeodesicHelper(myBase));
+    } else {
+        myHelp = mySurf->getGeodesicHelper();
+    }
+    CiftiBrainModelsMap myMap;
+    myMap.addSurfaceModel(numNodes, mySurf->getStructure(), roiData);
+    vector<CiftiBrainModelsMap::SurfaceMap> surfMap = myMap.getSurfaceMap(mySurf->getStructure());
+    int64_t rowLength = (int64_t)surfMap.size();
+    if (rowLength == 0) throw AlgorithmException("roi contains no vertices");
+    vector<int32_t> roiNodes(rowLength);
+    vector<int64_t> nodeToIndex(numNodes, -1);
+    for (int64_t i = 0; i < rowLength; ++i)
+    {
+        roiNodes[surfMap[i].m_ciftiIndex] = (int32_t)surfMap[i].m_surfaceNode;
+        nodeToIndex[surfMap[i].m_surfaceNode] = surfMap[i].m_ciftiIndex;
+    }
+    CiftiXML myXML;
+    myXML.setNumberOfDimensions(2);
+    myXML.setMap(CiftiXML::ALONG_ROW, myMap);
+    myXML.setMap(CiftiXML::ALONG_COLUMN, myMap);
+    myCiftiOut->setCiftiXML(myXML);
+    int64_t chunkRows = max((int64_t)1, min(rowLength, CHUNK_MEM_LIMIT / (rowLength * (int64_t)sizeof(float))));
+    vector<float> chunkData(chunkRows * rowLength);
+    vector<int32_t> chunkRoots;
+    for (int64_t chunkStart = 0; chunkStart < rowLength; chunkStart += chunkRows)
+    {
+        int64_t chunkEnd = min(rowLength, chunkStart + chunkRows);
+        chunkRoots.assign(roiNodes.begin() + chunkStart, roiNodes.begin() + chunkEnd);
+        RowReceiver myReceiver(chunkData.data(), nodeToIndex, rowLength);
+        myHelp->getNodesToGeoDistBatch(chunkRoots, maxDist, &myReceiver, smooth);
+        for (int64_t row = chunkStart; row < chunkEnd; ++row)
+        {
+            myCiftiOut->setRow(chunkData.data() + (row - chunkStart) * rowLength, row);
+        }
+        myProgress.reportProgress(((float)chunkEnd) / rowLength);
+    }
+}
+
+float AlgorithmSurfaceGeodesicDistanceAllToAll::getAlgorithmInternalWeight()
+{
+    return 1.0f;//override this if needed, if the progress bar isn't smooth
+}
+
+float AlgorithmSurfaceGeodesicDistanceAllToAll::getSubAlgorithmWeight()
+{
+    return 0.0f;
+}
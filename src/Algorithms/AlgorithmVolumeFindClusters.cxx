@@ -24,9 +24,10 @@
 #include "CaretAssert.h"
 #include "CaretLogger.h"
 #include "CaretPointer.h"
+#include "CaretOMP.h"
 #include "CaretPointLocator.h"
+#include "ClusterLabelingHelper.h"
 #include "VolumeFile.h"
-#include "VoxelIJK.h"
 
 #include <cmath>
 #include <vector>
@@ -72,6 +73,9 @@ OperationParameters* AlgorithmVolumeFindClusters::getParameters()
     OptionalParameter* startOpt = ret->createOptionalParameter(8, "-start", "start labeling clusters from a value other than 1");
     startOpt->addIntegerParameter(1, "startval", "the value to give the first cluster found");
     
+    OptionalParameter* connectOpt = ret->createOptionalParameter(11, "-connectivity", "use a different voxel neighborhood than face neighbors");
+    connectOpt->addIntegerParameter(1, "neighbors", "6 for face neighbors, 18 to include edge neighbors, 26 to include corner neighbors");
+    
     ret->setHelpText(
         AString("Outputs a volume with nonzero integers for all voxels within a large enough cluster, and zeros elsewhere.  ") +
         "The integers denote cluster membership (by default, first cluster found will use value 1, second cluster 2, etc).  " +
@@ -130,29 +134,24 @@ void AlgorithmVolumeFindClusters::useParameters(OperationParameters* myParams, P
             throw AlgorithmException("distance cutoff must be positive");
         }
     }
-    AlgorithmVolumeFindClusters(myProgObj, volIn, threshValue, minVolume, volOut, lessThan, myRoi, subvolNum, startVal, NULL, sizeRatio, distaceCutoff);
+    OptionalParameter* connectOpt = myParams->getOptionalParameter(11);
+    int connectivity = 6;
+    if (connectOpt->m_present)
+    {
+        connectivity = (int)connectOpt->getInteger(1);
+        if (connectivity != 6 && connectivity != 18 && connectivity != 26)
+        {
+            throw AlgorithmException("connectivity must be 6, 18, or 26");
+        }
+    }
+    AlgorithmVolumeFindClusters(myProgObj, volIn, threshValue, minVolume, volOut, lessThan, myRoi, subvolNum, startVal, NULL, sizeRatio, distaceCutoff, connectivity);
 }
 
 namespace
 {
-    void processSubvol(const float* inFrame, VolumeFile* volOut, const int64_t& outSubvol, const int64_t& outComponent, const float& threshValue, const float& minVolume,
-                       const bool& lessThan, const float* roiFrame, const float& sizeRatio, const float& distanceCutoff, int& markVal)
+    void markFrame(const float* inFrame, const int64_t& frameSize, const float& threshValue, const bool& lessThan, const float* roiFrame, vector<char>& marked)
     {
-        vector<int64_t> dims = volOut->getDimensions();
-        int64_t frameSize = dims[0] * dims[1] * dims[2];
-        const VolumeSpace& mySpace = volOut->getVolumeSpace();
-        Vector3D ivec, jvec, kvec, origin;
-        mySpace.getSpacingVectors(ivec, jvec, kvec, origin);
-        float voxelVolume = abs(ivec.dot(jvec.cross(kvec)));
-        int64_t minVoxels = (int64_t)ceil(minVolume / voxelVolume);
-        vector<VoxelIJK> neighbors;
-        neighbors.push_back(VoxelIJK(1, 0, 0));
-        neighbors.push_back(VoxelIJK(-1, 0, 0));
-        neighbors.push_back(VoxelIJK(0, 1, 0));
-        neighbors.push_back(VoxelIJK(0, -1, 0));
-        neighbors.push_back(VoxelIJK(0, 0, 1));
-        neighbors.push_back(VoxelIJK(0, 0, -1));
-        vector<char> marked(frameSize, 0);
+        marked.assign(frameSize, 0);
         if (lessThan)
         {
             for (int64_t i = 0; i < frameSize; ++i)
@@ -171,65 +170,58 @@ namespace
                 }
             }
         }
-        vector<vector<VoxelIJK> > clusters;
-        size_t biggestCount = 0;
+    }
+    
+    void indexToSpace(const VolumeSpace& mySpace, const int64_t& index, float coordOut[3])
+    {
+        const int64_t* dims = mySpace.getDims();
+        int64_t ijk[3] = { index % dims[0], (index / dims[0]) % dims[1], index / (dims[0] * dims[1]) };
+        mySpace.indexToSpace(ijk, coordOut);
+    }
+    
+    void processSubvol(const float* inFrame, VolumeFile* volOut, const int64_t& outSubvol, const int64_t& outComponent, const float& threshValue, const float& minVolume,
+                       const bool& lessThan, const float* roiFrame, const float& sizeRatio, const float& distanceCutoff, const int& connectivity, int& markVal)
+    {
+        vector<int64_t> dims = volOut->getDimensions();
+        int64_t frameSize = dims[0] * dims[1] * dims[2];
+        const VolumeSpace& mySpace = volOut->getVolumeSpace();
+        Vector3D ivec, jvec, kvec, origin;
+        mySpace.getSpacingVectors(ivec, jvec, kvec, origin);
+        float voxelVolume = abs(ivec.dot(jvec.cross(kvec)));
+        int64_t minVoxels = (int64_t)ceil(minVolume / voxelVolume);
+        vector<char> marked;
+        markFrame(inFrame, frameSize, threshValue, lessThan, roiFrame, marked);
+        vector<int64_t> labels(frameSize), sizes;
+        int64_t numFound = ClusterLabelingHelper::labelVolume(marked.data(), dims.data(), connectivity, labels.data(), sizes);
+        vector<int64_t> clusters;//cluster numbers are in the order a k, j, i scan finds them
+        int64_t biggestCount = 0;
         int64_t biggestCluster = -1;
-        for (int64_t k = 0; k < dims[2]; ++k)
+        for (int64_t c = 0; c < numFound; ++c)
         {
-            for (int64_t j = 0; j < dims[1]; ++j)
+            if (sizes[c] >= minVoxels)
             {
-                for (int64_t i = 0; i < dims[0]; ++i)
+                if (sizes[c] > biggestCount)
                 {
-                    int64_t myIndex = mySpace.getIndex(i, j, k);
-                    if (marked[myIndex])
-                    {
-                        vector<VoxelIJK> voxelList;
-                        voxelList.push_back(VoxelIJK(i, j, k));
-                        marked[myIndex] = 0;//don't let voxels get duplicated in the list
-                        for (int64_t index = 0; index < (int64_t)voxelList.size(); ++index)//NOTE: vector grows inside loop
-                        {
-                            const VoxelIJK& thisVoxel = voxelList[index];
-                            for (int n = 0; n < (int)neighbors.size(); ++n)
-                            {
-                                VoxelIJK neighVox(thisVoxel.m_ijk[0] + neighbors[n].m_ijk[0],
-                                                    thisVoxel.m_ijk[1] + neighbors[n].m_ijk[1],
-                                                    thisVoxel.m_ijk[2] + neighbors[n].m_ijk[2]);
-                                if (mySpace.indexValid(neighVox.m_ijk))
-                                {
-                                    int64_t neighIndex = mySpace.getIndex(neighVox.m_ijk);
-                                    if (marked[neighIndex])
-                                    {
-                                        voxelList.push_back(neighVox);
-                                        marked[neighIndex] = 0;
-                                    }
-                                }
-                            }
-                        }
-                        if ((int64_t)voxelList.size() >= minVoxels)
-                        {
-                            if (voxelList.size() > biggestCount)
-                            {
-                                biggestCount = voxelList.size();
-                                biggestCluster = (int64_t)clusters.size();
-                            }
-                            clusters.push_back(voxelList);
-                        }
-                    }
+                    biggestCount = sizes[c];
+                    biggestCluster = (int64_t)clusters.size();
                 }
+                clusters.push_back(c);
             }
         }
         if (!clusters.empty()) CaretAssert(biggestCluster != -1);
         if (biggestCluster != -1 && (distanceCutoff > 0.0f || sizeRatio > 0.0f))
         {
             CaretPointer<CaretPointLocator> myLocator;
+            vector<int64_t> memberStarts, members;
             if (distanceCutoff > 0.0f)
             {
+                ClusterLabelingHelper::getMembers(labels.data(), frameSize, numFound, memberStarts, members);
                 vector<float> biggestCoords;//gather coordinates of biggest cluster voxels
                 biggestCoords.reserve(biggestCount * 3);
-                for (size_t i = 0; i < clusters[biggestCluster].size(); ++i)
+                for (int64_t m = memberStarts[clusters[biggestCluster]]; m < memberStarts[clusters[biggestCluster] + 1]; ++m)
                 {
                     float thisCoord[3];
-                    mySpace.indexToSpace(clusters[biggestCluster][i].m_ijk, thisCoord);
+                    indexToSpace(mySpace, members[m], thisCoord);
                     biggestCoords.push_back(thisCoord[0]);
                     biggestCoords.push_back(thisCoord[1]);
                     biggestCoords.push_back(thisCoord[2]);
@@ -241,17 +233,17 @@ namespace
                 if ((int64_t)i != biggestCluster)
                 {
                     bool erase = false;
-                    if (sizeRatio > 0.0f && ((float)clusters[i].size()) / biggestCount < sizeRatio)
+                    if (sizeRatio > 0.0f && ((float)sizes[clusters[i]]) / biggestCount < sizeRatio)
                     {
                         erase = true;
                     }
                     if (!erase && distanceCutoff > 0.0f)
                     {
                         erase = true;//erase unless we find a point close enough to the biggest cluster
-                        for (size_t j = 0; j < clusters[i].size(); ++j)
+                        for (int64_t m = memberStarts[clusters[i]]; m < memberStarts[clusters[i] + 1]; ++m)
                         {
                             float thisCoord[3];
-                            mySpace.indexToSpace(clusters[i][j].m_ijk, thisCoord);
+                            indexToSpace(mySpace, members[m], thisCoord);
                             int32_t ret = myLocator->closestPointLimited(thisCoord, distanceCutoff);
                             if (ret == -1)
                             {
@@ -269,6 +261,8 @@ namespace
                 }
             }
         }
+        if (clusters.empty()) return;//output was already zeroed
+        vector<float> clusterVals(numFound, 0.0f);
         for (size_t i = 0; i < clusters.size(); ++i)
         {
             if (markVal == 0)
@@ -278,18 +272,21 @@ namespace
             }
             float tempVal = markVal;
             if ((int)tempVal != markVal) throw AlgorithmException("too many clusters, unable to mark them uniquely");
-            for (size_t index = 0; index < clusters[i].size(); ++index)
-            {
-                volOut->setValue(tempVal, clusters[i][index].m_ijk, outSubvol, outComponent);
-            }
+            clusterVals[clusters[i]] = tempVal;
             ++markVal;
         }
+        vector<float> outFrame(frameSize, 0.0f);
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            if (labels[i] >= 0) outFrame[i] = clusterVals[labels[i]];
+        }
+        volOut->setFrame(outFrame.data(), outSubvol, outComponent);
     }
 }
 
 AlgorithmVolumeFindClusters::AlgorithmVolumeFindClusters(ProgressObject* myProgObj, const VolumeFile* volIn, const float& threshValue, const float& minVolume, VolumeFile* volOut,
                                                          const bool& lessThan, const VolumeFile* myRoi, const int& subvolNum, const int& startVal, int* endVal,
-                                                         const float& sizeRatio, const float& distanceCutoff) : AbstractAlgorithm(myProgObj)
+                                                         const float& sizeRatio, const float& distanceCutoff, const int& connectivity) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     if (startVal == 0)
@@ -314,7 +311,7 @@ AlgorithmVolumeFindClusters::AlgorithmVolumeFindClusters(ProgressObject* myProgO
             for (int64_t s = 0; s < dims[3]; ++s)
             {
                 const float* inFrame = volIn->getFrame(s, c);
-                processSubvol(inFrame, volOut, s, c, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, markVal);
+                processSubvol(inFrame, volOut, s, c, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, connectivity, markVal);
             }
         }
     } else {
@@ -325,12 +322,47 @@ AlgorithmVolumeFindClusters::AlgorithmVolumeFindClusters(ProgressObject* myProgO
         for (int64_t c = 0; c < dims[4]; ++c)
         {
             const float* inFrame = volIn->getFrame(subvolNum, c);
-            processSubvol(inFrame, volOut, 0, c, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, markVal);
+            processSubvol(inFrame, volOut, 0, c, threshValue, minVolume, lessThan, roiFrame, sizeRatio, distanceCutoff, connectivity, markVal);
         }
     }
     if (endVal != NULL) *endVal = markVal;
 }
 
+void AlgorithmVolumeFindClusters::getClusterSizes(const VolumeFile* volIn, const float& threshValue, vector<vector<int64_t> >& sizesOut, const bool& lessThan,
+                                                  const VolumeFile* myRoi, const int& connectivity)
+{
+    const VolumeSpace& mySpace = volIn->getVolumeSpace();
+    const float* roiFrame = NULL;
+    if (myRoi != NULL)
+    {
+        if (!mySpace.matches(myRoi->getVolumeSpace())) throw AlgorithmException("roi volume space does not match input");
+        roiFrame = myRoi->getFrame();
+    }
+    vector<int64_t> dims = volIn->getDimensions();
+    int64_t frameSize = dims[0] * dims[1] * dims[2], numFrames = dims[3] * dims[4];
+    sizesOut.clear();
+    sizesOut.resize(numFrames);
+    bool failed = false;
+    AString failMessage;
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int64_t f = 0; f < numFrames; ++f)
+    {//one map per thread, labeling runs single threaded inside a parallel region
+        try
+        {
+            vector<char> marked;
+            markFrame(volIn->getFrame(f % dims[3], f / dims[3]), frameSize, threshValue, lessThan, roiFrame, marked);
+            ClusterLabelingHelper::labelVolume(marked.data(), dims.data(), connectivity, NULL, sizesOut[f]);
+        } catch (CaretException& e) {
+#pragma omp critical
+            {
+                if (!failed) failMessage = e.whatString();
+                failed = true;
+            }
+        }
+    }
+    if (failed) throw AlgorithmException(failMessage);
+}
+
 float AlgorithmVolumeFindClusters::getAlgorithmInternalWeight()
 {
     return 1.0f;//override this if needed, if the progress bar isn't smooth
@@ -23,6 +23,8 @@
 
 #include "AbstractAlgorithm.h"
 
+#include <vector>
+
 namespace caret {
     
     class AlgorithmVolumeFindClusters : public AbstractAlgorithm
@@ -34,7 +36,10 @@ namespace caret {
     public:
         AlgorithmVolumeFindClusters(ProgressObject* myProgObj, const VolumeFile* volIn, const float& threshValue, const float& minVolume,
                                     VolumeFile* volOut, const bool& lessThan = false, const VolumeFile* myRoi = NULL, const int& subvolNum = -1,
-                                    const int& startVal = 1, int* endVal = NULL, const float& sizeRatio = -1.0f, const float& distanceCutoff = -1.0f);
+                                    const int& startVal = 1, int* endVal = NULL, const float& sizeRatio = -1.0f, const float& distanceCutoff = -1.0f, const int& connectivity = 6);
+        ///size-only path for permutation testing: voxel counts of every cluster in every frame (in order of frame, then cluster), without thresholding by size or making an output
+        static void getClusterSizes(const VolumeFile* volIn, const float& threshValue, std::vector<std::vector<int64_t> >& sizesOut, const bool& lessThan = false,
+                                    const VolumeFile* myRoi = NULL, const int& connectivity = 6);
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
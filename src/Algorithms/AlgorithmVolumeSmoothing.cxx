@@ -25,11 +25,348 @@
 #include "CaretLogger.h"
 #include "CaretOMP.h"
 #include "CaretAssert.h"
+#include "CaretPointer.h"
+
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int DIRECT_MAX_RANGE = 8;//when all kernel half-widths (in voxels) are this small, use the direct loops, otherwise filter each axis as lines
+    
+    //filters a line of weighted data and its line of weights with the same kernel, treating everything outside the line as zero
+    class LineFilter
+    {
+    public:
+        virtual void filterLines(double* data, double* weights, vector<double>& scratch) const = 0;
+        virtual ~LineFilter() { }
+    };
+    
+    //the same truncated kernel as the direct loops, for axes with small kernels
+    class DirectLineFilter : public LineFilter
+    {
+        vector<double> m_kernel;
+        int64_t m_length;
+        int m_range;
+    public:
+        DirectLineFilter(const vector<double>& kernel, const int& range, const int64_t& length)
+        {
+            m_kernel = kernel;
+            m_range = range;
+            m_length = length;
+        }
+        static double cost(const int& range) { return 4.0 * (2 * range + 1); }//multiplies and adds per voxel, for data and weights
+        void filterLines(double* data, double* weights, vector<double>& scratch) const
+        {
+            scratch.resize(2 * m_length);
+            double* dataOut = scratch.data(), *weightsOut = scratch.data() + m_length;
+            for (int64_t i = 0; i < m_length; ++i)
+            {
+                int64_t kmin = max((int64_t)0, i - m_range), kmax = min(m_length, i + m_range + 1);
+                double sum = 0.0, weightsum = 0.0;
+                for (int64_t k = kmin; k < kmax; ++k)
+                {
+                    double weight = m_kernel[k - i + m_range];
+                    sum += weight * data[k];
+                    weightsum += weight * weights[k];
+                }
+                dataOut[i] = sum;
+                weightsOut[i] = weightsum;
+            }
+            copy(dataOut, dataOut + m_length, data);
+            copy(weightsOut, weightsOut + m_length, weights);
+        }
+    };
+    
+    //the same truncated kernel, by FFT with enough zero padding that nothing wraps around
+    //the kernel is real, so the data and weights go through one complex transform as its real and imaginary parts
+    class FFTLineFilter : public LineFilter
+    {
+        int64_t m_length, m_fftSize;
+        vector<double> m_kernelFFT, m_twiddle;//interleaved complex
+        vector<int64_t> m_bitReverse;
+        void transform(double* z, const bool& inverse) const
+        {//iterative radix 2
+            for (int64_t i = 0; i < m_fftSize; ++i)
+            {
+                int64_t r = m_bitReverse[i];
+                if (r > i)
+                {
+                    swap(z[2 * i], z[2 * r]);
+                    swap(z[2 * i + 1], z[2 * r + 1]);
+                }
+            }
+            for (int64_t half = 1; half < m_fftSize; half *= 2)
+            {
+                int64_t step = m_fftSize / (2 * half);
+                for (int64_t start = 0; start < m_fftSize; start += 2 * half)
+                {
+                    for (int64_t k = 0; k < half; ++k)
+                    {
+                        double wr = m_twiddle[2 * k * step], wi = (inverse ? -m_twiddle[2 * k * step + 1] : m_twiddle[2 * k * step + 1]);
+                        double* a = z + 2 * (start + k), *b = z + 2 * (start + k + half);
+                        double tr = b[0] * wr - b[1] * wi, ti = b[0] * wi + b[1] * wr;
+                        b[0] = a[0] - tr;
+                        b[1] = a[1] - ti;
+                        a[0] += tr;
+                        a[1] += ti;
+                    }
+                }
+            }
+        }
+        static int64_t fftSize(const int64_t& length, const int& range)
+        {
+            int64_t ret = 1;
+            while (ret < length + range) ret *= 2;
+            return ret;
+        }
+    public:
+        FFTLineFilter(const vector<double>& kernel, const int& range, const int64_t& length)
+        {
+            m_length = length;
+            m_fftSize = fftSize(length, range);
+            int bits = 0;
+            while (((int64_t)1 << bits) < m_fftSize) ++bits;
+            m_bitReverse.resize(m_fftSize);
+            for (int64_t i = 0; i < m_fftSize; ++i)
+            {
+                int64_t r = 0;
+                for (int b = 0; b < bits; ++b)
+                {
+                    if (i & ((int64_t)1 << b)) r |= (int64_t)1 << (bits - 1 - b);
+                }
+                m_bitReverse[i] = r;
+            }
+            m_twiddle.resize(m_fftSize);
+            for (int64_t k = 0; k < m_fftSize / 2; ++k)
+            {
+                double angle = -2.0 * 3.14159265358979323846 * k / m_fftSize;
+                m_twiddle[2 * k] = cos(angle);
+                m_twiddle[2 * k + 1] = sin(angle);
+            }
+            m_kernelFFT.resize(2 * m_fftSize, 0.0);
+            int useRange = (int)min((int64_t)range, length - 1);//taps farther than the line length never touch data, and could collide after wrapping
+            for (int k = -useRange; k <= useRange; ++k)
+            {
+                m_kernelFFT[2 * ((k + m_fftSize) % m_fftSize)] = kernel[k + range] / m_fftSize;//fold the inverse transform scaling into the kernel
+            }
+            transform(m_kernelFFT.data(), false);
+        }
+        static double cost(const int64_t& length, const int& range)
+        {//two transforms of about 5 * n * log2(n) flops, plus the complex multiply, spread over the voxels in the line
+            int64_t size = fftSize(length, range);
+            double logSize = log((double)size) / log(2.0);
+            return (10.0 * size * logSize + 6.0 * size) / length;
+        }
+        void filterLines(double* data, double* weights, vector<double>& scratch) const
+        {
+            scratch.resize(2 * m_fftSize);
+            double* z = scratch.data();
+            for (int64_t i = 0; i < m_length; ++i)
+            {
+                z[2 * i] = data[i];
+                z[2 * i + 1] = weights[i];
+            }
+            fill(z + 2 * m_length, z + 2 * m_fftSize, 0.0);
+            transform(z, false);
+            for (int64_t i = 0; i < m_fftSize; ++i)
+            {
+                double zr = z[2 * i], zi = z[2 * i + 1], kr = m_kernelFFT[2 * i], ki = m_kernelFFT[2 * i + 1];
+                z[2 * i] = zr * kr - zi * ki;
+                z[2 * i + 1] = zr * ki + zi * kr;
+            }
+            transform(z, true);
+            for (int64_t i = 0; i < m_length; ++i)
+            {
+                data[i] = z[2 * i];
+                weights[i] = z[2 * i + 1];
+            }
+        }
+    };
+    
+    //Young and van Vliet third order recursive gaussian, cost doesn't depend on kernel size
+    //approximates the untruncated gaussian, so only used when every voxel is in the mask (no ROI or -fix-zeros), otherwise the truncation matters at mask edges
+    class RecursiveLineFilter : public LineFilter
+    {
+        double m_B, m_b1, m_b2, m_b3;
+        int64_t m_length, m_pad;
+        void filterOne(double* line, vector<double>& scratch) const
+        {
+            int64_t total = m_length + m_pad;//run the causal pass out past the end so the backward pass starts from (nearly) zero
+            scratch.resize(total + 6);
+            double* w = scratch.data() + 3;
+            w[-3] = 0.0; w[-2] = 0.0; w[-1] = 0.0;
+            for (int64_t i = 0; i < total; ++i)
+            {
+                double x = (i < m_length ? line[i] : 0.0);
+                w[i] = m_B * x + m_b1 * w[i - 1] + m_b2 * w[i - 2] + m_b3 * w[i - 3];
+            }
+            w[total] = 0.0; w[total + 1] = 0.0; w[total + 2] = 0.0;
+            for (int64_t i = total - 1; i >= 0; --i)
+            {
+                w[i] = m_B * w[i] + m_b1 * w[i + 1] + m_b2 * w[i + 2] + m_b3 * w[i + 3];
+            }
+            copy(w, w + m_length, line);
+        }
+    public:
+        RecursiveLineFilter(const double& sigmaVoxels, const int64_t& length)
+        {
+            CaretAssert(sigmaVoxels >= 0.5);//the coefficient fit is only valid above this
+            double q;
+            if (sigmaVoxels >= 2.5)
+            {
+                q = 0.98711 * sigmaVoxels - 0.96330;
+            } else {
+                q = 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigmaVoxels);
+            }
+            double q2 = q * q, q3 = q2 * q;
+            double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+            m_b1 = (2.44413 * q + 2.85619 * q2 + 1.26661 * q3) / b0;
+            m_b2 = -(1.4281 * q2 + 1.26661 * q3) / b0;
+            m_b3 = 0.422205 * q3 / b0;
+            m_B = 1.0 - (m_b1 + m_b2 + m_b3);
+            m_length = length;
+            m_pad = (int64_t)ceil(6.0 * sigmaVoxels) + 3;
+        }
+        void filterLines(double* data, double* weights, vector<double>& scratch) const
+        {
+            filterOne(data, scratch);
+            filterOne(weights, scratch);
+        }
+    };
+    
+    //the kernel weights are the truncated box weights also used by the direct method
+    CaretPointer<LineFilter> makeLineFilter(const CaretArray<float>& kernelWeights, const int& range, const float& sigmaVoxels, const int64_t& length, const bool& exactKernel)
+    {
+        vector<double> kernel(2 * range + 1);
+        double kernelSum = 0.0;
+        for (int i = 0; i < 2 * range + 1; ++i)
+        {
+            kernelSum += kernelWeights[i];
+        }
+        for (int i = 0; i < 2 * range + 1; ++i)
+        {
+            kernel[i] = kernelWeights[i] / kernelSum;
+        }
+        CaretPointer<LineFilter> ret;
+        if (range > DIRECT_MAX_RANGE && !exactKernel && sigmaVoxels >= 0.5f)
+        {
+            ret.grabNew(new RecursiveLineFilter(sigmaVoxels, length));
+        } else if (range > DIRECT_MAX_RANGE && FFTLineFilter::cost(length, range) < DirectLineFilter::cost(range)) {
+            ret.grabNew(new FFTLineFilter(kernel, range, length));
+        } else {
+            ret.grabNew(new DirectLineFilter(kernel, range, length));
+        }
+        return ret;
+    }
+    
+    void filterAlongAxis(float* data, float* weights, const vector<int64_t>& myDims, const int& axis, const LineFilter* filter)
+    {
+        int64_t stride = 1;
+        for (int d = 0; d < axis; ++d)
+        {
+            stride *= myDims[d];
+        }
+        int64_t length = myDims[axis], numLines = myDims[0] * myDims[1] * myDims[2] / length;
+#pragma omp CARET_PAR
+        {
+            vector<double> dataLine(length), weightLine(length), scratch;
+#pragma omp CARET_FOR schedule(dynamic, 16)
+            for (int64_t line = 0; line < numLines; ++line)
+            {
+                int64_t start = (line / stride) * stride * length + line % stride;//consecutive lines are adjacent in memory for the strided axes
+                for (int64_t i = 0; i < length; ++i)
+                {
+                    dataLine[i] = data[start + i * stride];
+                    weightLine[i] = weights[start + i * stride];
+                }
+                filter->filterLines(dataLine.data(), weightLine.data(), scratch);
+                for (int64_t i = 0; i < length; ++i)
+                {
+                    data[start + i * stride] = dataLine[i];
+                    weights[start + i * stride] = weightLine[i];
+                }
+            }
+        }
+    }
+    
+    //marks voxels with a masked voxel within range along the axis, after all three axes this is where the direct loops have a nonzero weight sum
+    void dilateAlongAxis(unsigned char* support, const vector<int64_t>& myDims, const int& axis, const int& range)
+    {
+        int64_t stride = 1;
+        for (int d = 0; d < axis; ++d)
+        {
+            stride *= myDims[d];
+        }
+        int64_t length = myDims[axis], numLines = myDims[0] * myDims[1] * myDims[2] / length;
+#pragma omp CARET_PAR
+        {
+            vector<unsigned char> line(length);
+#pragma omp CARET_FOR schedule(dynamic, 16)
+            for (int64_t lineIndex = 0; lineIndex < numLines; ++lineIndex)
+            {
+                int64_t start = (lineIndex / stride) * stride * length + lineIndex % stride;
+                for (int64_t i = 0; i < length; ++i)
+                {
+                    line[i] = support[start + i * stride];
+                }
+                int64_t count = 0;//masked voxels in the window [i - range, i + range]
+                for (int64_t i = 0; i < min(length, (int64_t)range); ++i)
+                {
+                    count += line[i];
+                }
+                for (int64_t i = 0; i < length; ++i)
+                {
+                    if (i + range < length) count += line[i + range];
+                    if (i - range - 1 >= 0) count -= line[i - range - 1];
+                    support[start + i * stride] = (count > 0 ? 1 : 0);
+                }
+            }
+        }
+    }
+    
+    //normalized convolution: smooth the ROI/nonzero mask along with the masked data, then divide, same as what the direct loops compute
+    void smoothFrameLines(const float* inFrame, const vector<int64_t>& myDims, float* scratchFrame, float* scratchWeights, unsigned char* scratchSupport, const float* roiFrame,
+                          const CaretPointer<LineFilter> filters[3], const int ranges[3], const bool& fixZeros)
+    {
+        int64_t frameSize = myDims[0] * myDims[1] * myDims[2];
+#pragma omp CARET_PARFOR
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            if ((roiFrame == NULL || roiFrame[i] > 0.0f) && (!fixZeros || inFrame[i] != 0.0f))
+            {
+                scratchFrame[i] = inFrame[i];
+                scratchWeights[i] = 1.0f;
+                scratchSupport[i] = 1;
+            } else {
+                scratchFrame[i] = 0.0f;
+                scratchWeights[i] = 0.0f;
+                scratchSupport[i] = 0;
+            }
+        }
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            filterAlongAxis(scratchFrame, scratchWeights, myDims, axis, filters[axis]);
+            dilateAlongAxis(scratchSupport, myDims, axis, ranges[axis]);
+        }
+        //the filtered weights have rounding noise (and recursive filter tails) where the direct weight sum is exactly zero, so use the support for the zero rule
+#pragma omp CARET_PARFOR
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            if ((roiFrame == NULL || roiFrame[i] > 0.0f) && scratchSupport[i] != 0 && scratchWeights[i] > 0.0f)
+            {
+                scratchFrame[i] /= scratchWeights[i];
+            } else {
+                scratchFrame[i] = 0.0f;
+            }
+        }
+    }
+}
+
 //makes the program issue warning only once per launch, prevents repeated calls by other algorithms from spamming
 bool AlgorithmVolumeSmoothing::haveWarned = false;
 
@@ -64,6 +401,8 @@ OperationParameters* AlgorithmVolumeSmoothing::getParameters()
         AString("Gaussian smoothing for volumes.  By default, smooths all subvolumes with no ROI, if ROI is given, only ") +
         "positive voxels in the ROI volume have their values used, and all other voxels are set to zero.  Smoothing a non-orthogonal volume will " +
         "be significantly slower, because the operation cannot be separated into 1-dimensional smoothings without distorting the kernel shape.\n\n" +
+        "When the kernel is more than " + AString::number(DIRECT_MAX_RANGE) + " voxels wide in some direction (out to 3 sigma) on an orthogonal volume, smoothing without an ROI " +
+        "uses a recursive approximation of the gaussian whose cost doesn't depend on kernel size, and smoothing with an ROI uses FFT convolution along the directions where that is faster.\n\n" +
         "The -fix-zeros option causes the smoothing to not use an input value if it is zero, but still write a smoothed value to the voxel.  " +
         "This is useful for zeros that indicate lack of information, preventing them from pulling down the intensity of nearby voxels, while " +
         "giving the zero an extrapolated value."
@@ -126,11 +465,6 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
     const float ORTH_TOLERANCE = 0.001f;//tolerate this much deviation from orthogonal (dot product divided by product of lengths) to use orthogonal assumptions to smooth
     if (abs(ivec.dot(jvec.normal())) / ivec.length() < ORTH_TOLERANCE && abs(jvec.dot(kvec.normal())) / jvec.length() < ORTH_TOLERANCE && abs(kvec.dot(ivec.normal())) / kvec.length() < ORTH_TOLERANCE)
     {//if our axes are orthogonal, optimize by doing three 1-dimensional smoothings for O(voxels * (ki + kj + kk)) instead of O(voxels * (ki * kj * kk))
-        CaretArray<float> scratchFrame2(myDims[0] * myDims[1] * myDims[2]), scratchWeights(myDims[0] * myDims[1] * myDims[2]), scratchWeights2(myDims[0] * myDims[1] * myDims[2]), scratchFrame3;
-        if (roiVol != NULL)
-        {
-            scratchFrame3 = CaretArray<float> (myDims[0] * myDims[1] * myDims[2]);
-        }
         float ispace = ivec.length(), jspace = jvec.length(), kspace = kvec.length();
         int irange = (int)floor(kernBox / ispace);
         int jrange = (int)floor(kernBox / jspace);
@@ -157,6 +491,27 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
             float tempf = kspace * (k - krange) / kernel;
             kweights[k] = exp(-tempf * tempf / 2.0f);
         }
+        bool useLineFilters = (irange > DIRECT_MAX_RANGE || jrange > DIRECT_MAX_RANGE || krange > DIRECT_MAX_RANGE);
+        CaretPointer<LineFilter> lineFilters[3];
+        const int ranges[3] = { irange, jrange, krange };
+        const float* roiFrame = NULL;
+        CaretArray<float> scratchWeights(myDims[0] * myDims[1] * myDims[2]), scratchFrame2, scratchWeights2, scratchFrame3;
+        CaretArray<unsigned char> scratchSupport;
+        if (useLineFilters)
+        {//direct convolution cost grows with kernel width, so use recursive filtering, or FFT where it is cheaper and an ROI or -fix-zeros needs the exact kernel
+            scratchSupport = CaretArray<unsigned char>(myDims[0] * myDims[1] * myDims[2]);
+            lineFilters[0] = makeLineFilter(iweights, irange, kernel / ispace, myDims[0], roiVol != NULL || fixZeros);
+            lineFilters[1] = makeLineFilter(jweights, jrange, kernel / jspace, myDims[1], roiVol != NULL || fixZeros);
+            lineFilters[2] = makeLineFilter(kweights, krange, kernel / kspace, myDims[2], roiVol != NULL || fixZeros);
+            if (roiVol != NULL) roiFrame = roiVol->getFrame();
+        } else {
+            scratchFrame2 = CaretArray<float>(myDims[0] * myDims[1] * myDims[2]);
+            scratchWeights2 = CaretArray<float>(myDims[0] * myDims[1] * myDims[2]);
+            if (roiVol != NULL)
+            {
+                scratchFrame3 = CaretArray<float>(myDims[0] * myDims[1] * myDims[2]);
+            }
+        }
         if (subvol == -1)
         {
             vector<int64_t> origDims = inVol->getOriginalDimensions();
@@ -168,8 +523,10 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
                 for (int c = 0; c < myDims[4]; ++c)
                 {
                     const float* inFrame = inVol->getFrame(s, c);
-                    if (roiVol == NULL)
+                    if (useLineFilters)
                     {
+                        smoothFrameLines(inFrame, myDims, scratchFrame, scratchWeights, scratchSupport, roiFrame, lineFilters, ranges, fixZeros);
+                    } else if (roiVol == NULL) {
                         smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
                     } else {
                         smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
@@ -189,8 +546,10 @@ AlgorithmVolumeSmoothing::AlgorithmVolumeSmoothing(ProgressObject* myProgObj, co
             for (int c = 0; c < myDims[4]; ++c)
             {
                 const float* inFrame = inVol->getFrame(subvol, c);
-                if (roiVol == NULL)
+                if (useLineFilters)
                 {
+                    smoothFrameLines(inFrame, myDims, scratchFrame, scratchWeights, scratchSupport, roiFrame, lineFilters, ranges, fixZeros);
+                } else if (roiVol == NULL) {
                     smoothFrame(inFrame, myDims, scratchFrame, scratchFrame2, scratchWeights, scratchWeights2, inVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
                 } else {
                     smoothFrameROI(inFrame, myDims, scratchFrame, scratchFrame2, scratchFrame3, scratchWeights, scratchWeights2, lists, inVol, roiVol, iweights, jweights, kweights, irange, jrange, krange, fixZeros);
@@ -73,11 +73,18 @@ OperationParameters* AlgorithmVolumeToSurfaceMapping::getParameters()
     ribbonWeights->addVolumeOutputParameter(2, "weights-out", "volume to write the weights to");
     OptionalParameter* ribbonWeightsText = ribbonOpt->createOptionalParameter(6, "-output-weights-text", "write the voxel weights for all vertices to a text file");
     ribbonWeightsText->addStringParameter(1, "text-out", "output - the output text filename");//fake the output formatting
+    OptionalParameter* ribbonWeightsFile = ribbonOpt->createOptionalParameter(7, "-output-weights-file", "write the voxel weights for all vertices to a file for use with -weights-file");
+    ribbonWeightsFile->addStringParameter(1, "weights-out", "output - the output weights filename");//fake the output formatting
     
     OptionalParameter* myelinStyleOpt = ret->createOptionalParameter(9, "-myelin-style", "use the method from myelin mapping");
     myelinStyleOpt->addVolumeParameter(1, "ribbon-roi", "an roi volume of the cortical ribbon for this hemisphere");
     myelinStyleOpt->addMetricParameter(2, "thickness", "a metric file of cortical thickness");
     myelinStyleOpt->addDoubleParameter(3, "sigma", "gaussian kernel in mm for weighting voxels within range");
+    OptionalParameter* myelinWeightsFile = myelinStyleOpt->createOptionalParameter(4, "-output-weights-file", "write the voxel weights for all vertices to a file for use with -weights-file");
+    myelinWeightsFile->addStringParameter(1, "weights-out", "output - the output weights filename");//fake the output formatting
+    
+    OptionalParameter* weightsFileOpt = ret->createOptionalParameter(10, "-weights-file", "use voxel weights saved by ribbon constrained or myelin style mapping");
+    weightsFileOpt->addStringParameter(1, "weights-file", "the weights file");
     
     OptionalParameter* subvolumeSelect = ret->createOptionalParameter(7, "-subvol-select", "select a single subvolume to map");
     subvolumeSelect->addStringParameter(1, "subvol", "the subvolume number or name");
@@ -93,7 +100,11 @@ OperationParameters* AlgorithmVolumeToSurfaceMapping::getParameters()
         "voxels, consider increasing this if you get zeros in your output.\n\n" +
         "The myelin style method uses part of the caret5 myelin mapping command to do the mapping: for each surface vertex, take all voxels closer than the thickness at the vertex " +
         "that are within the ribbon ROI, and less than half the thickness value away from the vertex along the direction of the surface normal, and apply a gaussian kernel " +
-        "with the specified sigma to them to get the weights to use."
+        "with the specified sigma to them to get the weights to use.\n\n" +
+        "Ribbon constrained and myelin style mapping spend most of their time computing the voxel weights, which depend only on the surfaces, the volume space, " +
+        "and the ROI.  Use -output-weights-file to save the weights, and -weights-file to map other volumes in the same volume space onto the same surface " +
+        "without recomputing them.  The saved weights already include the effect of any ROI, and the results are identical to running the original method again.  " +
+        "Weights files are written in the byte order of the machine that created them."
     );
     return ret;
 }
@@ -108,6 +119,7 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
     OptionalParameter* cubicOpt = myParams->getOptionalParameter(8);
     OptionalParameter* ribbonOpt = myParams->getOptionalParameter(6);
     OptionalParameter* myelinStyleOpt = myParams->getOptionalParameter(9);
+    OptionalParameter* weightsFileOpt = myParams->getOptionalParameter(10);
     int64_t mySubVol = -1;
     OptionalParameter* subvolumeSelect = myParams->getOptionalParameter(7);
     if (subvolumeSelect->m_present)
@@ -165,6 +177,15 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
         haveMethod = true;
         myMethod = MYELIN_STYLE;
     }
+    if (weightsFileOpt->m_present)
+    {
+        if (haveMethod)
+        {
+            throw AlgorithmException("more than one mapping method specified");
+        }
+        haveMethod = true;
+        myMethod = WEIGHTS_FILE;
+    }
     if (!haveMethod)
     {
         throw AlgorithmException("no mapping method specified");
@@ -204,7 +225,15 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
                 weightsOutVertex = (int)ribbonWeights->getInteger(1);
                 weightsOut = ribbonWeights->getOutputVolume(2);
             }
-            AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, innerSurf, outerSurf, myRoiVol, subdivisions, mySubVol, weightsOutVertex, weightsOut);
+            OptionalParameter* ribbonWeightsFile = ribbonOpt->getOptionalParameter(7);
+            VertexVoxelWeights weightsTable;
+            VertexVoxelWeights* weightsTableOut = NULL;
+            if (ribbonWeightsFile->m_present) weightsTableOut = &weightsTable;
+            AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, innerSurf, outerSurf, myRoiVol, subdivisions, mySubVol, weightsOutVertex, weightsOut, weightsTableOut);
+            if (ribbonWeightsFile->m_present)
+            {
+                weightsTable.writeFile(ribbonWeightsFile->getString(1));
+            }
             OptionalParameter* ribbonWeightsText = ribbonOpt->getOptionalParameter(6);
             if (ribbonWeightsText->m_present)
             {//do this after the algorithm, to let it do the error condition checking
@@ -235,7 +264,22 @@ void AlgorithmVolumeToSurfaceMapping::useParameters(OperationParameters* myParam
             VolumeFile* roi = myelinStyleOpt->getVolume(1);
             MetricFile* thickness = myelinStyleOpt->getMetric(2);
             float sigma = (float)myelinStyleOpt->getDouble(3);
-            AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, roi, thickness, sigma, mySubVol);
+            OptionalParameter* myelinWeightsFile = myelinStyleOpt->getOptionalParameter(4);
+            VertexVoxelWeights weightsTable;
+            VertexVoxelWeights* weightsTableOut = NULL;
+            if (myelinWeightsFile->m_present) weightsTableOut = &weightsTable;
+            AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, roi, thickness, sigma, mySubVol, weightsTableOut);
+            if (myelinWeightsFile->m_present)
+            {
+                weightsTable.writeFile(myelinWeightsFile->getString(1));
+            }
+            break;
+        }
+        case WEIGHTS_FILE:
+        {
+            VertexVoxelWeights weightsTable;
+            weightsTable.readFile(weightsFileOpt->getString(1));
+            AlgorithmVolumeToSurfaceMapping(myProgObj, myVolume, mySurface, myMetricOut, weightsTable, mySubVol);
             break;
         }
         default:
@@ -340,7 +384,8 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
 //ribbon mapping
 AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
                                                                  const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const VolumeFile* roiVol,
-                                                                 const int32_t& subdivisions, const int64_t& mySubVol, const int& weightsOutVertex, VolumeFile* weightsOut) : AbstractAlgorithm(myProgObj)
+                                                                 const int32_t& subdivisions, const int64_t& mySubVol, const int& weightsOutVertex, VolumeFile* weightsOut,
+                                                                 VertexVoxelWeights* weightsTableOut) : AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     vector<int64_t> myVolDims;
@@ -388,82 +433,20 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
             weightsOut->setValue(vertexWeights[i].weight, vertexWeights[i].ijk);
         }
     }
-    CaretArray<float> myScratchArray(numNodes);
-    float* myScratch = myScratchArray.getArray();
-    if (mySubVol == -1)
+    VertexVoxelWeights myTable;
+    myTable.setWeights(myWeights, myVolume->getVolumeSpace(), false);
+    vector<vector<VoxelWeight> >().swap(myWeights);//don't keep both copies
+    applyWeights(myVolume, myMetricOut, myTable, mySubVol, " ribbon constrained");
+    if (weightsTableOut != NULL)
     {
-        for (int64_t i = 0; i < myVolDims[3]; ++i)
-        {
-            for (int64_t j = 0; j < myVolDims[4]; ++j)
-            {
-                int64_t thisCol = i * myVolDims[4] + j;
-                AString metricLabel = myVolume->getMapName(i);
-                if (myVolDims[4] != 1)
-                {
-                    metricLabel += " component " + AString::number(j);
-                }
-                metricLabel += " ribbon constrained";
-                myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-                for (int64_t node = 0; node < numNodes; ++node)
-                {
-                    myScratch[node] = 0.0f;
-                    float totalWeight = 0.0f;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        float thisWeight = myWeights[node][voxel].weight;
-                        totalWeight += thisWeight;
-                        myScratch[node] += thisWeight * myVolume->getValue(myWeights[node][voxel].ijk, i, j);
-                    }
-                    if (totalWeight != 0.0f)
-                    {
-                        myScratch[node] /= totalWeight;
-                    } else {
-                        myScratch[node] = 0.0f;
-                    }
-                }
-                myMetricOut->setValuesForColumn(thisCol, myScratch);
-            }
-        }
-    } else {
-        for (int64_t j = 0; j < myVolDims[4]; ++j)
-        {
-            AString metricLabel = myVolume->getMapName(mySubVol);
-            if (myVolDims[4] != 1)
-            {
-                metricLabel += " component " + AString::number(j);
-            }
-            metricLabel += " ribbon constrained";
-            int64_t thisCol = j;
-            myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-            for (int64_t node = 0; node < numNodes; ++node)
-            {
-                    myScratch[node] = 0.0f;
-                    float totalWeight = 0.0f;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        float thisWeight = myWeights[node][voxel].weight;
-                        totalWeight += thisWeight;
-                        myScratch[node] += thisWeight * myVolume->getValue(myWeights[node][voxel].ijk, mySubVol, j);
-                    }
-                    if (totalWeight != 0.0f)
-                    {
-                        myScratch[node] /= totalWeight;
-                    } else {
-                        myScratch[node] = 0.0f;
-                    }
-            }
-            myMetricOut->setValuesForColumn(thisCol, myScratch);
-        }
+        weightsTableOut->swap(myTable);
     }
 }
 
 //myelin style mapping
 AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
-                                                                 const VolumeFile* roiVol, const MetricFile* thickness, const float& sigma, const int64_t& mySubVol): AbstractAlgorithm(myProgObj)
+                                                                 const VolumeFile* roiVol, const MetricFile* thickness, const float& sigma, const int64_t& mySubVol,
+                                                                 VertexVoxelWeights* weightsTableOut): AbstractAlgorithm(myProgObj)
 {
     LevelProgress myProgress(myProgObj);
     vector<int64_t> myVolDims;
@@ -488,57 +471,74 @@ AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject*
     myMetricOut->setStructure(mySurface->getStructure());
     vector<vector<VoxelWeight> > myWeights;
     precomputeWeightsMyelin(myWeights, mySurface, roiVol, thickness, sigma);
-    vector<float> myScratch(numNodes);
+    VertexVoxelWeights myTable;
+    myTable.setWeights(myWeights, myVolume->getVolumeSpace(), true);//weights have already been normalized in precompute, for this method
+    vector<vector<VoxelWeight> >().swap(myWeights);
+    applyWeights(myVolume, myMetricOut, myTable, mySubVol, " ribbon constrained");
+    if (weightsTableOut != NULL)
+    {
+        weightsTableOut->swap(myTable);
+    }
+}
+
+//precomputed weights
+AlgorithmVolumeToSurfaceMapping::AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
+                                                                 const VertexVoxelWeights& myWeights, const int64_t& mySubVol) : AbstractAlgorithm(myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    vector<int64_t> myVolDims;
+    myVolume->getDimensions(myVolDims);
+    if (mySubVol >= myVolDims[3] || mySubVol < -1)
+    {
+        throw AlgorithmException("invalid subvolume specified");
+    }
+    if (!myVolume->getVolumeSpace().matches(myWeights.getVolumeSpace()))
+    {
+        throw AlgorithmException("input volume is not in the volume space the weights were computed for");
+    }
+    if (myWeights.getNumberOfNodes() != mySurface->getNumberOfNodes())
+    {
+        throw AlgorithmException("weights were computed for a surface with " + AString::number(myWeights.getNumberOfNodes()) + " vertices, but the surface has " +
+                                 AString::number(mySurface->getNumberOfNodes()));
+    }
+    myMetricOut->setStructure(mySurface->getStructure());
+    applyWeights(myVolume, myMetricOut, myWeights, mySubVol, " precomputed weights");
+}
+
+void AlgorithmVolumeToSurfaceMapping::applyWeights(const VolumeFile* myVolume, MetricFile* myMetricOut, const VertexVoxelWeights& myWeights, const int64_t& mySubVol,
+                                                   const AString& methodName)
+{
+    vector<int64_t> myVolDims;
+    myVolume->getDimensions(myVolDims);
+    int64_t numColumns;
     if (mySubVol == -1)
     {
-        for (int64_t i = 0; i < myVolDims[3]; ++i)
-        {
-            for (int64_t j = 0; j < myVolDims[4]; ++j)
-            {
-                int64_t thisCol = i * myVolDims[4] + j;
-                AString metricLabel = myVolume->getMapName(i);
-                if (myVolDims[4] != 1)
-                {
-                    metricLabel += " component " + AString::number(j);
-                }
-                metricLabel += " ribbon constrained";
-                myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-                for (int64_t node = 0; node < numNodes; ++node)
-                {
-                    double accum = 0.0;
-                    int numVoxels = (int)myWeights[node].size();
-                    for (int voxel = 0; voxel < numVoxels; ++voxel)
-                    {
-                        accum += myWeights[node][voxel].weight * myVolume->getValue(myWeights[node][voxel].ijk, i, j);//weights have already been normalized in precompute, for this method
-                    }
-                    myScratch[node] = accum;
-                }
-                myMetricOut->setValuesForColumn(thisCol, myScratch.data());
-            }
-        }
+        numColumns = myVolDims[3] * myVolDims[4];
     } else {
+        numColumns = myVolDims[4];
+    }
+    int64_t numNodes = myWeights.getNumberOfNodes();
+    myMetricOut->setNumberOfNodesAndColumns(numNodes, numColumns);
+    vector<float> myScratch(numNodes);
+    int64_t firstSubVol = 0, endSubVol = myVolDims[3];
+    if (mySubVol != -1)
+    {
+        firstSubVol = mySubVol;
+        endSubVol = mySubVol + 1;
+    }
+    for (int64_t i = firstSubVol; i < endSubVol; ++i)
+    {
         for (int64_t j = 0; j < myVolDims[4]; ++j)
         {
-            AString metricLabel = myVolume->getMapName(mySubVol);
+            int64_t thisCol = (i - firstSubVol) * myVolDims[4] + j;
+            AString metricLabel = myVolume->getMapName(i);
             if (myVolDims[4] != 1)
             {
                 metricLabel += " component " + AString::number(j);
             }
-            metricLabel += " ribbon constrained";
-            int64_t thisCol = j;
+            metricLabel += methodName;
             myMetricOut->setColumnName(thisCol, metricLabel);
-#pragma omp CARET_PARFOR schedule(dynamic)
-            for (int64_t node = 0; node < numNodes; ++node)
-            {
-                double accum = 0.0;
-                int numVoxels = (int)myWeights[node].size();
-                for (int voxel = 0; voxel < numVoxels; ++voxel)
-                {
-                    accum += myWeights[node][voxel].weight * myVolume->getValue(myWeights[node][voxel].ijk, mySubVol, j);//weights have already been normalized in precompute, for this method
-                }
-                myScratch[node] = accum;
-            }
+            myWeights.apply(myVolume->getFrame(i, j), myScratch.data());
             myMetricOut->setValuesForColumn(thisCol, myScratch.data());
         }
     }
@@ -548,7 +548,7 @@ void AlgorithmVolumeToSurfaceMapping::precomputeWeightsMyelin(vector<vector<Voxe
                                                               const MetricFile* thickness, const float& sigma)
 {
     int64_t numNodes = mySurface->getNumberOfNodes();
-    myWeights.clear();
+    vector<vector<VoxelWeight> >().swap(myWeights);
     myWeights.resize(numNodes);
     vector<int64_t> myDims;
     roiVol->getDimensions(myDims);
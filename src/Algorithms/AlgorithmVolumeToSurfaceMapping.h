@@ -41,8 +41,10 @@ namespace caret {
             ENCLOSING_VOXEL,
             RIBBON_CONSTRAINED,
             CUBIC,
-            MYELIN_STYLE
+            MYELIN_STYLE,
+            WEIGHTS_FILE
         };
+        void applyWeights(const VolumeFile* myVolume, MetricFile* myMetricOut, const VertexVoxelWeights& myWeights, const int64_t& mySubVol, const AString& methodName);
     protected:
         static float getSubAlgorithmWeight();
         static float getAlgorithmInternalWeight();
@@ -51,9 +53,13 @@ namespace caret {
                                         const int64_t& mySubVol = -1);
         AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
                                         const SurfaceFile* innerSurf, const SurfaceFile* outerSurf, const VolumeFile* roiVol = NULL, const int32_t& subdivisions = 3,
-                                        const int64_t& mySubVol = -1, const int& weightsOutVertex = -1, VolumeFile* weightsOut = NULL);
+                                        const int64_t& mySubVol = -1, const int& weightsOutVertex = -1, VolumeFile* weightsOut = NULL,
+                                        VertexVoxelWeights* weightsTableOut = NULL);
         AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
-                                        const VolumeFile* roiVol, const MetricFile* thickness, const float& sigma, const int64_t& mySubVol = -1);
+                                        const VolumeFile* roiVol, const MetricFile* thickness, const float& sigma, const int64_t& mySubVol = -1,
+                                        VertexVoxelWeights* weightsTableOut = NULL);
+        AlgorithmVolumeToSurfaceMapping(ProgressObject* myProgObj, const VolumeFile* myVolume, const SurfaceFile* mySurface, MetricFile* myMetricOut,
+                                        const VertexVoxelWeights& myWeights, const int64_t& mySubVol = -1);
         static OperationParameters* getParameters();
         static void useParameters(OperationParameters* myParams, ProgressObject* myProgObj);
         static AString getCommandSwitch();
@@ -43,10 +43,13 @@
 #include "Brain.h"
 #include "BrainOpenGLAnnotationDrawingFixedPipeline.h"
 #include "BrainOpenGLChartDrawingFixedPipeline.h"
+#include "BrainOpenGLIdentificationBufferCache.h"
 #include "BrainOpenGLPrimitiveDrawing.h"
+#include "BrainOpenGLSurfaceBufferCache.h"
 #include "BrainOpenGLTextureManager.h"
 #include "BrainOpenGLVolumeObliqueSliceDrawing.h"
 #include "BrainOpenGLVolumeSliceDrawing.h"
+#include "BrainOpenGLVolumeTextureCache.h"
 #include "BrainOpenGLShapeCone.h"
 #include "BrainOpenGLShapeCube.h"
 #include "BrainOpenGLShapeCylinder.h"
@@ -172,6 +175,9 @@ m_windowIndex(windowIndex)
     this->colorIdentification   = new IdentificationWithColor();
     m_annotationDrawing.grabNew(new BrainOpenGLAnnotationDrawingFixedPipeline(this));
     m_textureManager.grabNew(new BrainOpenGLTextureManager(m_windowIndex));
+    m_surfaceBufferCache.grabNew(new BrainOpenGLSurfaceBufferCache());
+    m_volumeTextureCache.grabNew(new BrainOpenGLVolumeTextureCache());
+    m_identificationBufferCache.grabNew(new BrainOpenGLIdentificationBufferCache());
                              
     m_shapeSphere = NULL;
     m_shapeCone   = NULL;
@@ -511,6 +517,10 @@ BrainOpenGLFixedPipeline::drawModels(Brain* brain,
     
     this->checkForOpenGLError(NULL, "At beginning of drawModels()");
     
+    m_surfaceBufferCache->releaseUnusedBuffers();
+    m_volumeTextureCache->releaseUnusedTextures();
+    m_identificationBufferCache->releaseUnusedBuffers();
+    
     /*
      * Default the background colors to first model
      * NOTE: If there are no models, the surface background color is used
@@ -1901,51 +1911,73 @@ BrainOpenGLFixedPipeline::drawSurfaceTriangles(Surface* surface,
             break;
     }
     
+    /*
+     * When selecting, the triangle may be found without drawing
+     */
+    bool triangleFoundWithoutDrawingFlag = false;
+    int32_t triangleIndex = -1;
+    float depth = -1.0;
     if (isSelect) {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        triangleFoundWithoutDrawingFlag = m_identificationBufferCache->findSurfaceTriangle(surface,
+                                                                                           this->mouseX,
+                                                                                           this->mouseY,
+                                                                                           triangleIndex,
+                                                                                           depth);
     }
     
-    uint8_t rgba[4];
-    
-    glBegin(GL_TRIANGLES);
-    for (int32_t i = 0; i < numTriangles; i++) {
-        const int32_t i3 = i * 3;
-        const int32_t n1 = triangles[i3];
-        const int32_t n2 = triangles[i3+1];
-        const int32_t n3 = triangles[i3+2];
-        
+    if ( ! triangleFoundWithoutDrawingFlag) {
         if (isSelect) {
-            this->colorIdentification->addItem(rgba, SelectionItemDataTypeEnum::SURFACE_TRIANGLE, i);
-            glColor3ubv(rgba);
-            glNormal3fv(&normals[n1*3]);
-            glVertex3fv(&coordinates[n1*3]);
-            glNormal3fv(&normals[n2*3]);
-            glVertex3fv(&coordinates[n2*3]);
-            glNormal3fv(&normals[n3*3]);
-            glVertex3fv(&coordinates[n3*3]);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         }
-        else {
-            glColor4fv(&nodeColoringRGBA[n1*4]);
-            glNormal3fv(&normals[n1*3]);
-            glVertex3fv(&coordinates[n1*3]);
-            glColor4fv(&nodeColoringRGBA[n2*4]);
-            glNormal3fv(&normals[n2*3]);
-            glVertex3fv(&coordinates[n2*3]);
-            glColor4fv(&nodeColoringRGBA[n3*4]);
-            glNormal3fv(&normals[n3*3]);
-            glVertex3fv(&coordinates[n3*3]);
+        
+        uint8_t rgba[4];
+        
+        glBegin(GL_TRIANGLES);
+        for (int32_t i = 0; i < numTriangles; i++) {
+            const int32_t i3 = i * 3;
+            const int32_t n1 = triangles[i3];
+            const int32_t n2 = triangles[i3+1];
+            const int32_t n3 = triangles[i3+2];
+        
+            if (isSelect) {
+                this->colorIdentification->addItem(rgba, SelectionItemDataTypeEnum::SURFACE_TRIANGLE, i);
+                glColor3ubv(rgba);
+                glNormal3fv(&normals[n1*3]);
+                glVertex3fv(&coordinates[n1*3]);
+                glNormal3fv(&normals[n2*3]);
+                glVertex3fv(&coordinates[n2*3]);
+                glNormal3fv(&normals[n3*3]);
+                glVertex3fv(&coordinates[n3*3]);
+            }
+            else {
+                glColor4fv(&nodeColoringRGBA[n1*4]);
+                glNormal3fv(&normals[n1*3]);
+                glVertex3fv(&coordinates[n1*3]);
+                glColor4fv(&nodeColoringRGBA[n2*4]);
+                glNormal3fv(&normals[n2*3]);
+                glVertex3fv(&coordinates[n2*3]);
+                glColor4fv(&nodeColoringRGBA[n3*4]);
+                glNormal3fv(&normals[n3*3]);
+                glVertex3fv(&coordinates[n3*3]);
+            }
         }
+        glEnd();
     }
-    glEnd();
     
     if (isSelect) {
-        int32_t triangleIndex = -1;
-        float depth = -1.0;
-        this->getIndexFromColorSelection(SelectionItemDataTypeEnum::SURFACE_TRIANGLE, 
-                                         this->mouseX, 
-                                         this->mouseY,
-                                         triangleIndex,
-                                         depth);
+        if ( ! triangleFoundWithoutDrawingFlag) {
+            /*
+             * Keep the triangles at all pixels for identifications
+             * until the view or surface changes.
+             */
+            m_identificationBufferCache->captureSurfaceTriangles(surface,
+                                                                 this->colorIdentification);
+            this->getIndexFromColorSelection(SelectionItemDataTypeEnum::SURFACE_TRIANGLE, 
+                                             this->mouseX, 
+                                             this->mouseY,
+                                             triangleIndex,
+                                             depth);
+        }
         
         
         if (triangleIndex >= 0) {
@@ -2307,6 +2339,16 @@ void
 BrainOpenGLFixedPipeline::drawSurfaceTrianglesWithVertexArrays(const Surface* surface,
                                                                const float* nodeColoringRGBA)
 {
+    /*
+     * Geometry and coloring are kept on the graphics card and
+     * only reloaded when they change.
+     */
+    if (m_surfaceBufferCache->drawTriangles(surface,
+                                            nodeColoringRGBA,
+                                            m_backgroundColorFloat)) {
+        return;
+    }
+    
     glEnableClientState(GL_VERTEX_ARRAY);
     if (nodeColoringRGBA != NULL) {
         glEnableClientState(GL_COLOR_ARRAY);
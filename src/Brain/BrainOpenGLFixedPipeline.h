@@ -50,14 +50,17 @@ namespace caret {
     class BoundingBox;
     class Brain;
     class BrainOpenGLAnnotationDrawingFixedPipeline;
+    class BrainOpenGLIdentificationBufferCache;
     class BrainOpenGLShapeCone;
     class BrainOpenGLShapeCube;
     class BrainOpenGLShapeCylinder;
     class BrainOpenGLShapeRing;
     class BrainOpenGLShapeRingOutline;
     class BrainOpenGLShapeSphere;
+    class BrainOpenGLSurfaceBufferCache;
     class BrainOpenGLTextureManager;
     class BrainOpenGLViewportContent;
+    class BrainOpenGLVolumeTextureCache;
     class BrowserTabContent;
     class CaretMappableDataFile;
     class ClippingPlaneGroup;
@@ -614,6 +617,15 @@ namespace caret {
         /** The texture manager. */
         CaretPointer<BrainOpenGLTextureManager> m_textureManager;
         
+        /** Vertex buffers for surface drawing. */
+        CaretPointer<BrainOpenGLSurfaceBufferCache> m_surfaceBufferCache;
+        
+        /** Textures for volume slice drawing. */
+        CaretPointer<BrainOpenGLVolumeTextureCache> m_volumeTextureCache;
+        
+        /** Finds identified surface triangles without redrawing. */
+        CaretPointer<BrainOpenGLIdentificationBufferCache> m_identificationBufferCache;
+        
         static bool s_staticInitialized;
 
         static const float s_gluLookAtCenterFromEyeOffsetDistance;
@@ -626,6 +638,7 @@ namespace caret {
         friend class BrainOpenGLChartDrawingFixedPipeline;
         friend class BrainOpenGLVolumeObliqueSliceDrawing;
         friend class BrainOpenGLVolumeSliceDrawing;
+        friend class BrainOpenGLVolumeTextureCache;
         friend class OldBrainOpenGLVolumeSliceDrawing;
     };
 
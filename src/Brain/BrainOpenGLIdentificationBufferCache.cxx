@@ -0,0 +1,493 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016 Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#define __BRAIN_OPEN_G_L_IDENTIFICATION_BUFFER_CACHE_DECLARE__
+#include "BrainOpenGLIdentificationBufferCache.h"
+#undef __BRAIN_OPEN_G_L_IDENTIFICATION_BUFFER_CACHE_DECLARE__
+
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretPointer.h"
+#include "IdentificationWithColor.h"
+#include "SignedDistanceHelper.h"
+#include "SurfaceFile.h"
+using namespace caret;
+
+
+
+/**
+ * \class caret::BrainOpenGLIdentificationBufferCache
+ * \brief Identifies surface triangles without redrawing the surface.
+ * \ingroup Brain
+ *
+ * Identification of a surface triangle (and projection to a surface)
+ * previously drew every triangle in a unique color and read back the
+ * color of the pixel under the mouse.  Instead, the triangle is found
+ * by, in order:
+ *
+ * (1) A buffer of triangles and depths for every pixel in the viewport
+ * that was captured the last time the surface was drawn for identification
+ * with the same transformations, clipping, and geometry.  Identification
+ * is then a lookup of one pixel.
+ *
+ * (2) Casting a ray, through the mouse, against the octree of the surface's
+ * triangles.  This is not possible when clipping planes are enabled.
+ *
+ * When neither is possible, the surface is drawn for identification
+ * and the caller captures the result for later identifications.
+ */
+
+/**
+ * Constructor.
+ */
+BrainOpenGLIdentificationBufferCache::BrainOpenGLIdentificationBufferCache()
+: CaretObject(),
+m_frameCounter(0)
+{
+
+}
+
+/**
+ * Destructor.
+ */
+BrainOpenGLIdentificationBufferCache::~BrainOpenGLIdentificationBufferCache()
+{
+}
+
+/**
+ * @return True if any clipping planes are enabled.
+ */
+bool
+BrainOpenGLIdentificationBufferCache::ViewState::isClippingEnabled() const
+{
+    for (int32_t i = 0; i < 6; i++) {
+        if (m_clipPlaneEnabled[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @return True if this view state is identical to the given view state.
+ * @param rhs
+ *    The other view state.
+ */
+bool
+BrainOpenGLIdentificationBufferCache::ViewState::operator==(const ViewState& rhs) const
+{
+    for (int32_t i = 0; i < 16; i++) {
+        if ((m_modelviewMatrix[i] != rhs.m_modelviewMatrix[i])
+            || (m_projectionMatrix[i] != rhs.m_projectionMatrix[i])) {
+            return false;
+        }
+    }
+    for (int32_t i = 0; i < 4; i++) {
+        if (m_viewport[i] != rhs.m_viewport[i]) {
+            return false;
+        }
+    }
+    for (int32_t i = 0; i < 6; i++) {
+        if (m_clipPlaneEnabled[i] != rhs.m_clipPlaneEnabled[i]) {
+            return false;
+        }
+        if (m_clipPlaneEnabled[i]) {
+            for (int32_t j = 0; j < 4; j++) {
+                if (m_clipPlanes[i][j] != rhs.m_clipPlanes[i][j]) {
+                    return false;
+                }
+            }
+        }
+    }
+    if ((m_cullFaceEnabled != rhs.m_cullFaceEnabled)
+        || (m_cullFaceMode != rhs.m_cullFaceMode)
+        || (m_frontFace != rhs.m_frontFace)) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Get the current transformations, clipping, and culling from OpenGL.
+ *
+ * @param viewStateOut
+ *    Output containing the view state.
+ */
+void
+BrainOpenGLIdentificationBufferCache::getViewState(ViewState& viewStateOut)
+{
+    glGetDoublev(GL_MODELVIEW_MATRIX, viewStateOut.m_modelviewMatrix);
+    glGetDoublev(GL_PROJECTION_MATRIX, viewStateOut.m_projectionMatrix);
+    glGetIntegerv(GL_VIEWPORT, viewStateOut.m_viewport);
+    for (int32_t i = 0; i < 6; i++) {
+        viewStateOut.m_clipPlaneEnabled[i] = glIsEnabled(GL_CLIP_PLANE0 + i);
+        if (viewStateOut.m_clipPlaneEnabled[i]) {
+            glGetClipPlane(GL_CLIP_PLANE0 + i,
+                           viewStateOut.m_clipPlanes[i]);
+        }
+        else {
+            for (int32_t j = 0; j < 4; j++) {
+                viewStateOut.m_clipPlanes[i][j] = 0.0;
+            }
+        }
+    }
+    viewStateOut.m_cullFaceEnabled = glIsEnabled(GL_CULL_FACE);
+    glGetIntegerv(GL_CULL_FACE_MODE, &viewStateOut.m_cullFaceMode);
+    glGetIntegerv(GL_FRONT_FACE, &viewStateOut.m_frontFace);
+}
+
+/**
+ * Find the surface triangle at a location in the window without drawing
+ * the surface.  Must be called with the surface's transformations,
+ * clipping, and culling in effect.
+ *
+ * @param surfaceFile
+ *    The surface.
+ * @param windowX
+ *    X-coordinate in the window.
+ * @param windowY
+ *    Y-coordinate in the window.
+ * @param triangleIndexOut
+ *    Output with index of the triangle or negative if there is no
+ *    triangle at the location.
+ * @param depthOut
+ *    Output with the screen depth of the triangle at the location.
+ * @return
+ *    True if the triangle was found (or it was determined that there is
+ *    no triangle at the location).  False if the surface must be drawn
+ *    for identification.
+ */
+bool
+BrainOpenGLIdentificationBufferCache::findSurfaceTriangle(const SurfaceFile* surfaceFile,
+                                                          const int32_t windowX,
+                                                          const int32_t windowY,
+                                                          int32_t& triangleIndexOut,
+                                                          float& depthOut)
+{
+    CaretAssert(surfaceFile);
+    triangleIndexOut = -1;
+    depthOut = -1.0;
+
+    ViewState viewState;
+    getViewState(viewState);
+
+    const GLint* viewport = viewState.m_viewport;
+    if ((windowX < viewport[0])
+        || (windowX >= (viewport[0] + viewport[2]))
+        || (windowY < viewport[1])
+        || (windowY >= (viewport[1] + viewport[3]))) {
+        return true;
+    }
+
+    for (std::vector<TriangleBuffer>::iterator iter = m_triangleBuffers.begin();
+         iter != m_triangleBuffers.end();
+         iter++) {
+        TriangleBuffer& buffer = *iter;
+        if ((buffer.m_surfaceFile == surfaceFile)
+            && (buffer.m_geometryStamp == surfaceFile->getGeometryModificationStamp())
+            && (buffer.m_viewState == viewState)) {
+            buffer.m_lastUsedFrame = m_frameCounter;
+            const int64_t pixelIndex = ((static_cast<int64_t>(windowY - viewport[1]) * viewport[2])
+                                        + (windowX - viewport[0]));
+            CaretAssertVectorIndex(buffer.m_triangleIndices, pixelIndex);
+            triangleIndexOut = buffer.m_triangleIndices[pixelIndex];
+            if (triangleIndexOut >= 0) {
+                depthOut = buffer.m_depths[pixelIndex];
+            }
+            return true;
+        }
+    }
+
+    if ( ! viewState.isClippingEnabled()) {
+        return rayCastSurfaceTriangle(surfaceFile,
+                                      viewState,
+                                      windowX,
+                                      windowY,
+                                      triangleIndexOut,
+                                      depthOut);
+    }
+
+    return false;
+}
+
+/**
+ * Find the surface triangle at a location in the window by
+ * casting a ray through the surface's triangles.
+ *
+ * @param surfaceFile
+ *    The surface.
+ * @param viewState
+ *    Transformations used to draw the surface.
+ * @param windowX
+ *    X-coordinate in the window.
+ * @param windowY
+ *    Y-coordinate in the window.
+ * @param triangleIndexOut
+ *    Output with index of the triangle or negative if there is no
+ *    triangle at the location.
+ * @param depthOut
+ *    Output with the screen depth of the triangle at the location.
+ * @return
+ *    True if the ray was cast (even if it missed the surface).
+ */
+bool
+BrainOpenGLIdentificationBufferCache::rayCastSurfaceTriangle(const SurfaceFile* surfaceFile,
+                                                             const ViewState& viewState,
+                                                             const int32_t windowX,
+                                                             const int32_t windowY,
+                                                             int32_t& triangleIndexOut,
+                                                             float& depthOut) const
+{
+    if (surfaceFile->getNumberOfTriangles() <= 0) {
+        return true;
+    }
+
+    /*
+     * Ray through the center of the pixel from the near
+     * to the far clipping plane
+     */
+    const double pixelX = windowX + 0.5;
+    const double pixelY = windowY + 0.5;
+    double nearXYZ[3];
+    double farXYZ[3];
+    if ( ! gluUnProject(pixelX, pixelY, 0.0,
+                        viewState.m_modelviewMatrix,
+                        viewState.m_projectionMatrix,
+                        viewState.m_viewport,
+                        &nearXYZ[0], &nearXYZ[1], &nearXYZ[2])) {
+        return false;
+    }
+    if ( ! gluUnProject(pixelX, pixelY, 1.0,
+                        viewState.m_modelviewMatrix,
+                        viewState.m_projectionMatrix,
+                        viewState.m_viewport,
+                        &farXYZ[0], &farXYZ[1], &farXYZ[2])) {
+        return false;
+    }
+
+    const float rayStart[3] = {
+        static_cast<float>(nearXYZ[0]),
+        static_cast<float>(nearXYZ[1]),
+        static_cast<float>(nearXYZ[2])
+    };
+    const float rayDirection[3] = {
+        static_cast<float>(farXYZ[0] - nearXYZ[0]),
+        static_cast<float>(farXYZ[1] - nearXYZ[1]),
+        static_cast<float>(farXYZ[2] - nearXYZ[2])
+    };
+
+    /*
+     * With culling, only triangles whose window winding matches
+     * the faces that are not culled are visible.  The winding seen
+     * from the start of the ray flips when the modelview or the
+     * projection mirrors the view.
+     */
+    SignedDistanceHelper::RaySide raySide = SignedDistanceHelper::EITHER_SIDE;
+    if (viewState.m_cullFaceEnabled) {
+        if (viewState.m_cullFaceMode == GL_FRONT_AND_BACK) {
+            return true;
+        }
+        bool visibleCounterClockwiseFlag = (viewState.m_frontFace == GL_CCW);
+        if (viewState.m_cullFaceMode == GL_FRONT) {
+            visibleCounterClockwiseFlag = ( ! visibleCounterClockwiseFlag);
+        }
+        const GLdouble* m = viewState.m_modelviewMatrix;
+        const double modelviewDeterminant = (m[0] * (m[5] * m[10] - m[9] * m[6])
+                                             - m[4] * (m[1] * m[10] - m[9] * m[2])
+                                             + m[8] * (m[1] * m[6] - m[5] * m[2]));
+        const double projectionXYScale = (viewState.m_projectionMatrix[0]
+                                          * viewState.m_projectionMatrix[5]);
+        if ((modelviewDeterminant * projectionXYScale) < 0.0) {
+            visibleCounterClockwiseFlag = ( ! visibleCounterClockwiseFlag);
+        }
+        raySide = (visibleCounterClockwiseFlag
+                   ? SignedDistanceHelper::COUNTERCLOCKWISE_SIDE
+                   : SignedDistanceHelper::CLOCKWISE_SIDE);
+    }
+    
+    CaretPointer<SignedDistanceHelper> distanceHelper = surfaceFile->getSignedDistanceHelper();
+    int32_t triangleIndex = -1;
+    float rayParameter = -1.0;
+    if ( ! distanceHelper->rayIntersection(rayStart,
+                                           rayDirection,
+                                           triangleIndex,
+                                           rayParameter,
+                                           raySide)) {
+        return true;
+    }
+
+    /*
+     * Beyond the far clipping plane, so not visible
+     */
+    if (rayParameter > 1.0) {
+        return true;
+    }
+
+    double windowXYZ[3];
+    if ( ! gluProject(nearXYZ[0] + rayParameter * (farXYZ[0] - nearXYZ[0]),
+                      nearXYZ[1] + rayParameter * (farXYZ[1] - nearXYZ[1]),
+                      nearXYZ[2] + rayParameter * (farXYZ[2] - nearXYZ[2]),
+                      viewState.m_modelviewMatrix,
+                      viewState.m_projectionMatrix,
+                      viewState.m_viewport,
+                      &windowXYZ[0], &windowXYZ[1], &windowXYZ[2])) {
+        return false;
+    }
+
+    triangleIndexOut = triangleIndex;
+    depthOut = static_cast<float>(windowXYZ[2]);
+
+    return true;
+}
+
+/**
+ * Capture the triangles and depths of the viewport after the
+ * surface was drawn for identification with the triangles
+ * encoded in colors.  Must be called before the colors are reset.
+ *
+ * @param surfaceFile
+ *    The surface.
+ * @param colorIdentification
+ *    Color encoding of the triangles.
+ */
+void
+BrainOpenGLIdentificationBufferCache::captureSurfaceTriangles(const SurfaceFile* surfaceFile,
+                                                              const IdentificationWithColor* colorIdentification)
+{
+    CaretAssert(surfaceFile);
+    CaretAssert(colorIdentification);
+
+    ViewState viewState;
+    getViewState(viewState);
+    const int64_t width  = viewState.m_viewport[2];
+    const int64_t height = viewState.m_viewport[3];
+    const int64_t numberOfPixels = width * height;
+    if (numberOfPixels <= 0) {
+        return;
+    }
+
+    /*
+     * Replace buffer for this surface and viewport or the least recently used buffer
+     */
+    TriangleBuffer* buffer = NULL;
+    for (std::vector<TriangleBuffer>::iterator iter = m_triangleBuffers.begin();
+         iter != m_triangleBuffers.end();
+         iter++) {
+        if ((iter->m_surfaceFile == surfaceFile)
+            && (iter->m_viewState.m_viewport[0] == viewState.m_viewport[0])
+            && (iter->m_viewState.m_viewport[1] == viewState.m_viewport[1])) {
+            buffer = &(*iter);
+            break;
+        }
+    }
+    if (buffer == NULL) {
+        if (static_cast<int32_t>(m_triangleBuffers.size()) < s_maximumNumberOfBuffers) {
+            m_triangleBuffers.push_back(TriangleBuffer());
+            buffer = &m_triangleBuffers.back();
+        }
+        else {
+            buffer = &m_triangleBuffers[0];
+            for (std::vector<TriangleBuffer>::iterator iter = m_triangleBuffers.begin();
+                 iter != m_triangleBuffers.end();
+                 iter++) {
+                if (iter->m_lastUsedFrame < buffer->m_lastUsedFrame) {
+                    buffer = &(*iter);
+                }
+            }
+        }
+    }
+
+    buffer->m_surfaceFile = surfaceFile;
+    buffer->m_geometryStamp = surfaceFile->getGeometryModificationStamp();
+    buffer->m_viewState = viewState;
+    buffer->m_lastUsedFrame = m_frameCounter;
+    buffer->m_triangleIndices.resize(numberOfPixels);
+    buffer->m_depths.resize(numberOfPixels);
+
+    /*
+     * Saves glPixelStore parameters
+     */
+    glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_PACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    std::vector<uint8_t> pixelsRGB(numberOfPixels * 3);
+    glReadPixels(viewState.m_viewport[0],
+                 viewState.m_viewport[1],
+                 width,
+                 height,
+                 GL_RGB,
+                 GL_UNSIGNED_BYTE,
+                 &pixelsRGB[0]);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(viewState.m_viewport[0],
+                 viewState.m_viewport[1],
+                 width,
+                 height,
+                 GL_DEPTH_COMPONENT,
+                 GL_FLOAT,
+                 &buffer->m_depths[0]);
+
+    glPopClientAttrib();
+
+    for (int64_t i = 0; i < numberOfPixels; i++) {
+        colorIdentification->getItem(&pixelsRGB[i * 3],
+                                     SelectionItemDataTypeEnum::SURFACE_TRIANGLE,
+                                     &buffer->m_triangleIndices[i]);
+    }
+
+    CaretLogFine("Captured identification buffer for "
+                 + surfaceFile->getFileNameNoPath());
+}
+
+/**
+ * Called once per frame to delete buffers that have not been
+ * used recently, such as those of closed surfaces.
+ */
+void
+BrainOpenGLIdentificationBufferCache::releaseUnusedBuffers()
+{
+    m_frameCounter++;
+
+    std::vector<TriangleBuffer>::iterator iter = m_triangleBuffers.begin();
+    while (iter != m_triangleBuffers.end()) {
+        if ((m_frameCounter - iter->m_lastUsedFrame) > s_unusedFrameLimit) {
+            iter = m_triangleBuffers.erase(iter);
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
+/**
+ * Get a description of this object's content.
+ * @return String describing this object's content.
+ */
+AString
+BrainOpenGLIdentificationBufferCache::toString() const
+{
+    return "BrainOpenGLIdentificationBufferCache";
+}
+
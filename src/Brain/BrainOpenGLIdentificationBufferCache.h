@@ -0,0 +1,137 @@
+#ifndef __BRAIN_OPEN_G_L_IDENTIFICATION_BUFFER_CACHE_H__
+#define __BRAIN_OPEN_G_L_IDENTIFICATION_BUFFER_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016 Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <stdint.h>
+#include <vector>
+
+#include "CaretObject.h"
+#include "CaretOpenGLInclude.h"
+
+
+namespace caret {
+
+    class IdentificationWithColor;
+    class SurfaceFile;
+
+    class BrainOpenGLIdentificationBufferCache : public CaretObject {
+
+    public:
+        BrainOpenGLIdentificationBufferCache();
+
+        virtual ~BrainOpenGLIdentificationBufferCache();
+
+        bool findSurfaceTriangle(const SurfaceFile* surfaceFile,
+                                 const int32_t windowX,
+                                 const int32_t windowY,
+                                 int32_t& triangleIndexOut,
+                                 float& depthOut);
+
+        void captureSurfaceTriangles(const SurfaceFile* surfaceFile,
+                                     const IdentificationWithColor* colorIdentification);
+
+        void releaseUnusedBuffers();
+
+        // ADD_NEW_METHODS_HERE
+
+        virtual AString toString() const;
+
+    private:
+        /**
+         * Transformations, clipping, and culling in effect when a surface is drawn.
+         */
+        struct ViewState {
+            GLdouble m_modelviewMatrix[16];
+
+            GLdouble m_projectionMatrix[16];
+
+            GLint m_viewport[4];
+
+            GLboolean m_clipPlaneEnabled[6];
+
+            GLdouble m_clipPlanes[6][4];
+
+            GLboolean m_cullFaceEnabled;
+
+            GLint m_cullFaceMode;
+
+            GLint m_frontFace;
+
+            bool isClippingEnabled() const;
+
+            bool operator==(const ViewState& rhs) const;
+        };
+
+        /**
+         * Triangle and depth at each pixel of a viewport from an
+         * identification drawing of a surface.
+         */
+        struct TriangleBuffer {
+            TriangleBuffer() : m_surfaceFile(NULL), m_geometryStamp(-1), m_lastUsedFrame(0) { }
+
+            const SurfaceFile* m_surfaceFile;
+
+            int64_t m_geometryStamp;
+
+            ViewState m_viewState;
+
+            std::vector<int32_t> m_triangleIndices;
+
+            std::vector<float> m_depths;
+
+            int64_t m_lastUsedFrame;
+        };
+
+        BrainOpenGLIdentificationBufferCache(const BrainOpenGLIdentificationBufferCache&);
+
+        BrainOpenGLIdentificationBufferCache& operator=(const BrainOpenGLIdentificationBufferCache&);
+
+        static void getViewState(ViewState& viewStateOut);
+
+        bool rayCastSurfaceTriangle(const SurfaceFile* surfaceFile,
+                                    const ViewState& viewState,
+                                    const int32_t windowX,
+                                    const int32_t windowY,
+                                    int32_t& triangleIndexOut,
+                                    float& depthOut) const;
+
+        std::vector<TriangleBuffer> m_triangleBuffers;
+
+        int64_t m_frameCounter;
+
+        /** Buffers not used for this many frames are deleted */
+        static const int64_t s_unusedFrameLimit;
+
+        /** Maximum number of buffers, least recently used is replaced */
+        static const int32_t s_maximumNumberOfBuffers;
+
+        // ADD_NEW_MEMBERS_HERE
+
+    };
+
+#ifdef __BRAIN_OPEN_G_L_IDENTIFICATION_BUFFER_CACHE_DECLARE__
+    const int64_t BrainOpenGLIdentificationBufferCache::s_unusedFrameLimit = 50;
+    const int32_t BrainOpenGLIdentificationBufferCache::s_maximumNumberOfBuffers = 8;
+#endif // __BRAIN_OPEN_G_L_IDENTIFICATION_BUFFER_CACHE_DECLARE__
+
+} // namespace
+#endif  //__BRAIN_OPEN_G_L_IDENTIFICATION_BUFFER_CACHE_H__
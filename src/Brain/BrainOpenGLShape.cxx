@@ -101,6 +101,16 @@ BrainOpenGLShape::setImmediateModeOverride(const bool override)
     s_immediateModeOverride = override;
 }
 
+/**
+ * @return True if immediate mode is being forced, such as
+ * during image capture, and buffers must not be used.
+ */
+bool
+BrainOpenGLShape::isImmediateModeOverride()
+{
+    return s_immediateModeOverride;
+}
+
 /**
  * Draw the shape.
  *
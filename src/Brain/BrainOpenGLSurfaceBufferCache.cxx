@@ -0,0 +1,350 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016 Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#define __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_DECLARE__
+#include "BrainOpenGLSurfaceBufferCache.h"
+#undef __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_DECLARE__
+
+#include "BrainOpenGL.h"
+#include "BrainOpenGLShape.h"
+#include "CaretAssert.h"
+#include "SurfaceFile.h"
+using namespace caret;
+
+
+
+/**
+ * \class caret::BrainOpenGLSurfaceBufferCache
+ * \brief Keeps surface geometry and coloring in OpenGL vertex buffers.
+ * \ingroup Brain
+ *
+ * Surface coordinates, normals, and triangles rarely change
+ * so they are loaded into buffers on the graphics card once
+ * and reloaded only when the surface's geometry stamp changes.
+ * Node coloring is loaded when the surface's coloring stamp
+ * changes.  Without the cache, every node's coordinate, normal,
+ * and color are sent to the graphics card for every frame.
+ *
+ * Buffers are only valid in the OpenGL context in which they
+ * were created, so there is one cache for each window and the
+ * cache is bypassed when immediate mode is forced (such as
+ * during image capture which may use a different context).
+ */
+
+/**
+ * Constructor.
+ */
+BrainOpenGLSurfaceBufferCache::BrainOpenGLSurfaceBufferCache()
+: CaretObject(),
+m_frameCounter(0)
+{
+
+}
+
+/**
+ * Destructor.
+ */
+BrainOpenGLSurfaceBufferCache::~BrainOpenGLSurfaceBufferCache()
+{
+    /*
+     * We do not need to worry about deleting the buffers
+     * since when a instance of this class is deleted, the
+     * OpenGL context is also deleted which deletes all
+     * of the buffers.
+     */
+}
+
+/**
+ * Draw the triangles of a surface using buffers, loading the
+ * buffers if they do not exist or are out of date.
+ *
+ * @param surfaceFile
+ *    Surface that is drawn.
+ * @param nodeColoringRGBA
+ *    RGBA coloring for the nodes.  If NULL, the surface is drawn
+ *    in the background color (used when drawing links).
+ * @param backgroundRGB
+ *    The background color.
+ * @return
+ *    True if the surface was drawn.  False if buffers are not
+ *    available and the caller must draw the surface.
+ */
+bool
+BrainOpenGLSurfaceBufferCache::drawTriangles(const SurfaceFile* surfaceFile,
+                                             const float* nodeColoringRGBA,
+                                             const float backgroundRGB[3])
+{
+    CaretAssert(surfaceFile);
+
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if ( ! BrainOpenGL::isVertexBuffersSupported()) {
+        return false;
+    }
+    if (BrainOpenGLShape::isImmediateModeOverride()) {
+        return false;
+    }
+    if ((surfaceFile->getNumberOfNodes() <= 0)
+        || (surfaceFile->getNumberOfTriangles() <= 0)) {
+        return false;
+    }
+
+    SurfaceBuffers& buffers = m_surfaceBuffers[surfaceFile];
+    buffers.m_lastUsedFrame = m_frameCounter;
+    if (buffers.m_geometryStamp != surfaceFile->getGeometryModificationStamp()) {
+        loadGeometry(surfaceFile,
+                     buffers);
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 buffers.m_coordinateBufferID);
+    glVertexPointer(3,
+                    GL_FLOAT,
+                    0,
+                    (GLvoid*)0);
+
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 buffers.m_normalBufferID);
+    glNormalPointer(GL_FLOAT,
+                    0,
+                    (GLvoid*)0);
+
+    if (nodeColoringRGBA != NULL) {
+        ColorBuffer& colorBuffer = buffers.m_colorBuffers[nodeColoringRGBA];
+        colorBuffer.m_lastUsedFrame = m_frameCounter;
+        if (colorBuffer.m_coloringStamp != surfaceFile->getNodeColoringModificationStamp()) {
+            loadColors(surfaceFile,
+                       nodeColoringRGBA,
+                       colorBuffer);
+        }
+        glEnableClientState(GL_COLOR_ARRAY);
+        glBindBuffer(GL_ARRAY_BUFFER,
+                     colorBuffer.m_bufferID);
+        glColorPointer(4,
+                       GL_FLOAT,
+                       0,
+                       (GLvoid*)0);
+    }
+    else {
+        glColor3fv(backgroundRGB);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 buffers.m_triangleBufferID);
+    glDrawElements(GL_TRIANGLES,
+                   (3 * buffers.m_numberOfTriangles),
+                   GL_UNSIGNED_INT,
+                   (GLvoid*)0);
+
+    /*
+     * Deselect active buffers so that any following
+     * vertex array drawing uses client memory.
+     */
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 0);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+
+    return true;
+#else // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    return false;
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Load a surface's coordinates, normals, and triangles into buffers.
+ *
+ * @param surfaceFile
+ *    The surface.
+ * @param buffers
+ *    Buffers for the surface, created if needed.
+ */
+void
+BrainOpenGLSurfaceBufferCache::loadGeometry(const SurfaceFile* surfaceFile,
+                                            SurfaceBuffers& buffers)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if (buffers.m_coordinateBufferID == 0) {
+        glGenBuffers(1, &buffers.m_coordinateBufferID);
+        glGenBuffers(1, &buffers.m_normalBufferID);
+        glGenBuffers(1, &buffers.m_triangleBufferID);
+    }
+
+    const int32_t numberOfNodes = surfaceFile->getNumberOfNodes();
+    const int32_t numberOfTriangles = surfaceFile->getNumberOfTriangles();
+
+    /*
+     * Normals are computed when requested so request
+     * them before the geometry stamp is saved.
+     */
+    const float* normals = surfaceFile->getNormalVector(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 buffers.m_coordinateBufferID);
+    glBufferData(GL_ARRAY_BUFFER,
+                 numberOfNodes * 3 * sizeof(GLfloat),
+                 surfaceFile->getCoordinate(0),
+                 GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 buffers.m_normalBufferID);
+    glBufferData(GL_ARRAY_BUFFER,
+                 numberOfNodes * 3 * sizeof(GLfloat),
+                 normals,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 buffers.m_triangleBufferID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 numberOfTriangles * 3 * sizeof(GLuint),
+                 surfaceFile->getTriangle(0),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+                 0);
+
+    /*
+     * Colors no longer match if the number of nodes changed.
+     */
+    if (numberOfNodes != buffers.m_numberOfNodes) {
+        for (std::map<const float*, ColorBuffer>::iterator iter = buffers.m_colorBuffers.begin();
+             iter != buffers.m_colorBuffers.end();
+             iter++) {
+            glDeleteBuffers(1, &iter->second.m_bufferID);
+        }
+        buffers.m_colorBuffers.clear();
+    }
+
+    buffers.m_numberOfNodes = numberOfNodes;
+    buffers.m_numberOfTriangles = numberOfTriangles;
+    buffers.m_geometryStamp = surfaceFile->getGeometryModificationStamp();
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Load node coloring into a buffer.
+ *
+ * @param surfaceFile
+ *    The surface.
+ * @param nodeColoringRGBA
+ *    RGBA coloring for the nodes.
+ * @param colorBuffer
+ *    Buffer for the coloring, created if needed.
+ */
+void
+BrainOpenGLSurfaceBufferCache::loadColors(const SurfaceFile* surfaceFile,
+                                          const float* nodeColoringRGBA,
+                                          ColorBuffer& colorBuffer)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if (colorBuffer.m_bufferID == 0) {
+        glGenBuffers(1, &colorBuffer.m_bufferID);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 colorBuffer.m_bufferID);
+    glBufferData(GL_ARRAY_BUFFER,
+                 surfaceFile->getNumberOfNodes() * 4 * sizeof(GLfloat),
+                 nodeColoringRGBA,
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER,
+                 0);
+    colorBuffer.m_coloringStamp = surfaceFile->getNodeColoringModificationStamp();
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+}
+
+/**
+ * Delete all buffers for a surface.
+ *
+ * @param buffers
+ *    Buffers for the surface.
+ */
+void
+BrainOpenGLSurfaceBufferCache::deleteSurfaceBuffers(SurfaceBuffers& buffers)
+{
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    if (buffers.m_coordinateBufferID != 0) {
+        glDeleteBuffers(1, &buffers.m_coordinateBufferID);
+        glDeleteBuffers(1, &buffers.m_normalBufferID);
+        glDeleteBuffers(1, &buffers.m_triangleBufferID);
+    }
+    for (std::map<const float*, ColorBuffer>::iterator iter = buffers.m_colorBuffers.begin();
+         iter != buffers.m_colorBuffers.end();
+         iter++) {
+        glDeleteBuffers(1, &iter->second.m_bufferID);
+    }
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+    buffers.m_colorBuffers.clear();
+}
+
+/**
+ * Called once per frame, with the OpenGL context current, to delete
+ * buffers of surfaces (or colorings) that have not been drawn
+ * recently, such as those of closed files or tabs.  Since surface
+ * files are only identified by their address, this also prevents
+ * the cache from growing as files are opened and closed.
+ */
+void
+BrainOpenGLSurfaceBufferCache::releaseUnusedBuffers()
+{
+    m_frameCounter++;
+
+    std::map<const SurfaceFile*, SurfaceBuffers>::iterator surfaceIter = m_surfaceBuffers.begin();
+    while (surfaceIter != m_surfaceBuffers.end()) {
+        SurfaceBuffers& buffers = surfaceIter->second;
+        if ((m_frameCounter - buffers.m_lastUsedFrame) > s_unusedFrameLimit) {
+            deleteSurfaceBuffers(buffers);
+            m_surfaceBuffers.erase(surfaceIter++);
+            continue;
+        }
+
+        std::map<const float*, ColorBuffer>::iterator colorIter = buffers.m_colorBuffers.begin();
+        while (colorIter != buffers.m_colorBuffers.end()) {
+            if ((m_frameCounter - colorIter->second.m_lastUsedFrame) > s_unusedFrameLimit) {
+#ifdef BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+                glDeleteBuffers(1, &colorIter->second.m_bufferID);
+#endif // BRAIN_OPENGL_INFO_SUPPORTS_VERTEX_BUFFERS
+                buffers.m_colorBuffers.erase(colorIter++);
+            }
+            else {
+                ++colorIter;
+            }
+        }
+        ++surfaceIter;
+    }
+}
+
+/**
+ * Get a description of this object's content.
+ * @return String describing this object's content.
+ */
+AString
+BrainOpenGLSurfaceBufferCache::toString() const
+{
+    return "BrainOpenGLSurfaceBufferCache";
+}
+
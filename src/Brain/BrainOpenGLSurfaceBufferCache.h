@@ -0,0 +1,121 @@
+#ifndef __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_H__
+#define __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016 Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+#include <stdint.h>
+
+#include "CaretObject.h"
+#include "CaretOpenGLInclude.h"
+
+
+namespace caret {
+
+    class SurfaceFile;
+
+    class BrainOpenGLSurfaceBufferCache : public CaretObject {
+
+    public:
+        BrainOpenGLSurfaceBufferCache();
+
+        virtual ~BrainOpenGLSurfaceBufferCache();
+
+        bool drawTriangles(const SurfaceFile* surfaceFile,
+                           const float* nodeColoringRGBA,
+                           const float backgroundRGB[3]);
+
+        void releaseUnusedBuffers();
+
+        // ADD_NEW_METHODS_HERE
+
+        virtual AString toString() const;
+
+    private:
+        /**
+         * Buffer holding node colors and the coloring stamp
+         * of the surface when the colors were loaded.
+         */
+        struct ColorBuffer {
+            ColorBuffer() : m_bufferID(0), m_coloringStamp(-1), m_lastUsedFrame(0) { }
+
+            GLuint m_bufferID;
+
+            int64_t m_coloringStamp;
+
+            int64_t m_lastUsedFrame;
+        };
+
+        /**
+         * Buffers holding a surface's geometry and colors.
+         */
+        struct SurfaceBuffers {
+            SurfaceBuffers() : m_coordinateBufferID(0), m_normalBufferID(0), m_triangleBufferID(0),
+            m_geometryStamp(-1), m_numberOfNodes(0), m_numberOfTriangles(0), m_lastUsedFrame(0) { }
+
+            GLuint m_coordinateBufferID;
+
+            GLuint m_normalBufferID;
+
+            GLuint m_triangleBufferID;
+
+            int64_t m_geometryStamp;
+
+            int32_t m_numberOfNodes;
+
+            int32_t m_numberOfTriangles;
+
+            int64_t m_lastUsedFrame;
+
+            /** Keyed by the coloring array, one per tab and model type that displays the surface */
+            std::map<const float*, ColorBuffer> m_colorBuffers;
+        };
+
+        BrainOpenGLSurfaceBufferCache(const BrainOpenGLSurfaceBufferCache&);
+
+        BrainOpenGLSurfaceBufferCache& operator=(const BrainOpenGLSurfaceBufferCache&);
+
+        void loadGeometry(const SurfaceFile* surfaceFile,
+                          SurfaceBuffers& buffers);
+
+        void loadColors(const SurfaceFile* surfaceFile,
+                        const float* nodeColoringRGBA,
+                        ColorBuffer& colorBuffer);
+
+        void deleteSurfaceBuffers(SurfaceBuffers& buffers);
+
+        std::map<const SurfaceFile*, SurfaceBuffers> m_surfaceBuffers;
+
+        int64_t m_frameCounter;
+
+        /** Buffers not used for this many frames are deleted */
+        static const int64_t s_unusedFrameLimit;
+
+        // ADD_NEW_MEMBERS_HERE
+
+    };
+
+#ifdef __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_DECLARE__
+    const int64_t BrainOpenGLSurfaceBufferCache::s_unusedFrameLimit = 50;
+#endif // __BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_DECLARE__
+
+} // namespace
+#endif  //__BRAIN_OPEN_G_L_SURFACE_BUFFER_CACHE_H__
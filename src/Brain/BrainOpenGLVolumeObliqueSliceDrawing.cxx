@@ -31,6 +31,7 @@
 #include "Brain.h"
 #include "BrainOpenGLAnnotationDrawingFixedPipeline.h"
 #include "BrainOpenGLPrimitiveDrawing.h"
+#include "BrainOpenGLVolumeTextureCache.h"
 #include "BrowserTabContent.h"
 #include "CaretAssert.h"
 #include "CaretLogger.h"
@@ -767,41 +768,54 @@ BrainOpenGLVolumeObliqueSliceDrawing::drawVolumeSliceViewProjection(const Volume
          */
         glDisable(GL_CULL_FACE);
         
-        switch (sliceProjectionType) {
-            case VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_ORTHOGONAL:
-                if (m_modelVolume != NULL) {
-                    const bool cullingFlag = true;
-                    if (cullingFlag) {
-                        drawOrthogonalSliceWithCulling(sliceViewPlane,
-                                                       sliceCoordinates,
-                                                       slicePlane);
+        /*
+         * When possible, draw each layer as one textured polygon
+         * instead of drawing the individual voxels.  Identification
+         * requires the individual voxels.
+         */
+        bool sliceDrawnWithTexturesFlag = false;
+        if ( ! m_identificationModeFlag) {
+            sliceDrawnWithTexturesFlag = m_fixedPipelineDrawing->m_volumeTextureCache->drawSliceLayers(m_volumeDrawInfo,
+                                                                                                        slicePlane,
+                                                                                                        (m_modelWholeBrain != NULL));
+        }
+        if ( ! sliceDrawnWithTexturesFlag) {
+            switch (sliceProjectionType) {
+                case VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_ORTHOGONAL:
+                    if (m_modelVolume != NULL) {
+                        const bool cullingFlag = true;
+                        if (cullingFlag) {
+                            drawOrthogonalSliceWithCulling(sliceViewPlane,
+                                                           sliceCoordinates,
+                                                           slicePlane);
+                        }
+                        else {
+                            drawOrthogonalSlice(sliceViewPlane,
+                                                sliceCoordinates,
+                                                slicePlane);
+                        }
                     }
-                    else {
+                    else if (m_modelWholeBrain != NULL) {
                         drawOrthogonalSlice(sliceViewPlane,
                                             sliceCoordinates,
                                             slicePlane);
                     }
-                }
-                else if (m_modelWholeBrain != NULL) {
-                    drawOrthogonalSlice(sliceViewPlane,
-                                        sliceCoordinates,
-                                        slicePlane);
-                }
-                break;
-            case VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_OBLIQUE:
-            {
-                /*
-                 * Create the oblique slice transformation matrix
-                 */
-                Matrix4x4 obliqueTransformationMatrix;
-                createObliqueTransformationMatrix(sliceCoordinates,
-                                                  obliqueTransformationMatrix);
+                    break;
+                case VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_OBLIQUE:
+                {
+                    /*
+                     * Create the oblique slice transformation matrix
+                     */
+                    Matrix4x4 obliqueTransformationMatrix;
+                    createObliqueTransformationMatrix(sliceCoordinates,
+                                                      obliqueTransformationMatrix);
                 
-                drawObliqueSlice(sliceViewPlane,
-                                 obliqueTransformationMatrix,
-                                 slicePlane);
+                    drawObliqueSlice(sliceViewPlane,
+                                     obliqueTransformationMatrix,
+                                     slicePlane);
+                }
+                    break;
             }
-                break;
         }
 
         /*
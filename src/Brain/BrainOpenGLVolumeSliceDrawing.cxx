@@ -31,6 +31,7 @@
 #include "Brain.h"
 #include "BrainOpenGLAnnotationDrawingFixedPipeline.h"
 #include "BrainOpenGLPrimitiveDrawing.h"
+#include "BrainOpenGLVolumeTextureCache.h"
 #include "BrainordinateRegionOfInterest.h"
 #include "BrowserTabContent.h"
 #include "CaretAssert.h"
@@ -769,51 +770,76 @@ BrainOpenGLVolumeSliceDrawing::drawVolumeSliceViewProjection(const VolumeSliceDr
         const bool cullingSliceViewFlag = true;
         const bool cullingWholeBrainViewFlag = false; // culling only works in a view looking along an axis (any rotation and slices disappear)
         
-        switch (sliceProjectionType) {
-            case VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_ORTHOGONAL:
-                if (m_modelVolume != NULL) {
-                    if (cullingSliceViewFlag) {
-                        drawOrthogonalSliceWithCulling(sliceViewPlane,
-                                                       sliceCoordinates,
-                                                       slicePlane);
+        /*
+         * When possible, draw each layer as one textured polygon
+         * instead of drawing the individual voxels.  Identification
+         * requires the individual voxels.
+         */
+        bool sliceDrawnWithTexturesFlag = false;
+        if ( ! m_identificationModeFlag) {
+            sliceDrawnWithTexturesFlag = m_fixedPipelineDrawing->m_volumeTextureCache->drawSliceLayers(m_volumeDrawInfo,
+                                                                                                        slicePlane,
+                                                                                                        (m_modelWholeBrain != NULL));
+        }
+        if (sliceDrawnWithTexturesFlag) {
+            /*
+             * Only the orthogonal voxel drawing highlights the region of interest
+             */
+            if (sliceProjectionType == VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_ORTHOGONAL) {
+                float sliceNormalVector[3];
+                slicePlane.getNormalVector(sliceNormalVector);
+                showBrainordinateHighlightRegionOfInterest(sliceViewPlane,
+                                                           sliceCoordinates,
+                                                           sliceNormalVector);
+            }
+        }
+        else {
+            switch (sliceProjectionType) {
+                case VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_ORTHOGONAL:
+                    if (m_modelVolume != NULL) {
+                        if (cullingSliceViewFlag) {
+                            drawOrthogonalSliceWithCulling(sliceViewPlane,
+                                                           sliceCoordinates,
+                                                           slicePlane);
+                        }
+                        else {
+                            drawOrthogonalSlice_LPI_ONLY(sliceViewPlane,
+                                                sliceCoordinates,
+                                                slicePlane);
+                        }
                     }
-                    else {
-                        drawOrthogonalSlice_LPI_ONLY(sliceViewPlane,
-                                            sliceCoordinates,
-                                            slicePlane);
+                    else if (m_modelWholeBrain != NULL) {
+                        /*
+                         * At this time (Aug 4, 2016) culled drawing does not
+                         * work for ALL (whole brain) view.
+                         */
+                        if (cullingWholeBrainViewFlag) {
+                            drawOrthogonalSliceWithCulling(sliceViewPlane,
+                                                           sliceCoordinates,
+                                                           slicePlane);
+                        }
+                        else {
+                            drawOrthogonalSlice_LPI_ONLY(sliceViewPlane,
+                                                sliceCoordinates,
+                                                slicePlane);
+                        }
                     }
-                }
-                else if (m_modelWholeBrain != NULL) {
+                    break;
+                case VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_OBLIQUE:
+                {
                     /*
-                     * At this time (Aug 4, 2016) culled drawing does not
-                     * work for ALL (whole brain) view.
+                     * Create the oblique slice transformation matrix
                      */
-                    if (cullingWholeBrainViewFlag) {
-                        drawOrthogonalSliceWithCulling(sliceViewPlane,
-                                                       sliceCoordinates,
-                                                       slicePlane);
-                    }
-                    else {
-                        drawOrthogonalSlice_LPI_ONLY(sliceViewPlane,
-                                            sliceCoordinates,
-                                            slicePlane);
-                    }
-                }
-                break;
-            case VolumeSliceProjectionTypeEnum::VOLUME_SLICE_PROJECTION_OBLIQUE:
-            {
-                /*
-                 * Create the oblique slice transformation matrix
-                 */
-                Matrix4x4 obliqueTransformationMatrix;
-                createObliqueTransformationMatrix(sliceCoordinates,
-                                                  obliqueTransformationMatrix);
+                    Matrix4x4 obliqueTransformationMatrix;
+                    createObliqueTransformationMatrix(sliceCoordinates,
+                                                      obliqueTransformationMatrix);
                 
-                drawObliqueSlice(sliceViewPlane,
-                                 obliqueTransformationMatrix,
-                                 slicePlane);
+                    drawObliqueSlice(sliceViewPlane,
+                                     obliqueTransformationMatrix,
+                                     slicePlane);
+                }
+                    break;
             }
-                break;
         }
         
         /*
@@ -0,0 +1,564 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016 Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <algorithm>
+#include <cmath>
+
+#define __BRAIN_OPEN_G_L_VOLUME_TEXTURE_CACHE_DECLARE__
+#include "BrainOpenGLVolumeTextureCache.h"
+#undef __BRAIN_OPEN_G_L_VOLUME_TEXTURE_CACHE_DECLARE__
+
+#include "BrainOpenGL.h"
+#include "BrainOpenGLShape.h"
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+#include "CaretPreferences.h"
+#include "MathFunctions.h"
+#include "Plane.h"
+#include "SessionManager.h"
+#include "VolumeFile.h"
+using namespace caret;
+
+/*
+ * 3D textures are core in OpenGL 1.2 and clamping to a
+ * transparent border is core in OpenGL 1.3.
+ */
+#ifdef GL_VERSION_1_3
+#define BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED 1
+#endif // GL_VERSION_1_3
+
+
+/**
+ * \class caret::BrainOpenGLVolumeTextureCache
+ * \brief Draws volume slices with 3D textures.
+ * \ingroup Brain
+ *
+ * The coloring of each displayed map is loaded into a 3D texture
+ * and each layer of a slice, orthogonal or oblique, is drawn as
+ * a single textured polygon that is blended with the layers below
+ * it.  A texture is reloaded only when the coloring of its map
+ * changes (data, palette, or thresholding) so redrawing, panning,
+ * and montages do not build a polygon for every voxel.
+ *
+ * Label volumes are not drawn with textures since the selection
+ * of labels for display varies by tab and label outlines are
+ * created for each slice.  When any layer cannot be drawn with
+ * a texture, no layers are drawn and the caller draws the voxels.
+ *
+ * Textures are only valid in the OpenGL context in which they
+ * were created, so there is one cache for each window and the
+ * cache is bypassed when immediate mode is forced (such as
+ * during image capture which may use a different context).
+ */
+
+/**
+ * Constructor.
+ */
+BrainOpenGLVolumeTextureCache::BrainOpenGLVolumeTextureCache()
+: CaretObject(),
+m_frameCounter(0),
+m_textureBytes(0),
+m_supportedStatus(0),
+m_maximumTextureDimension(0)
+{
+
+}
+
+/**
+ * Destructor.
+ */
+BrainOpenGLVolumeTextureCache::~BrainOpenGLVolumeTextureCache()
+{
+    /*
+     * We do not need to worry about deleting the textures
+     * since when a instance of this class is deleted, the
+     * OpenGL context is also deleted which deletes all
+     * of the textures.
+     */
+}
+
+/**
+ * @return True if the OpenGL library supports the 3D textures
+ * used by this cache.  Tested the first time it is called, when
+ * an OpenGL context is current.
+ */
+bool
+BrainOpenGLVolumeTextureCache::isTextureDrawingSupported()
+{
+#ifdef BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+    if (m_supportedStatus == 0) {
+        m_supportedStatus = -1;
+        if (BrainOpenGL::testForVersionOfOpenGLSupported("1.3")) {
+            glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE,
+                          &m_maximumTextureDimension);
+            if (m_maximumTextureDimension > 0) {
+                m_supportedStatus = 1;
+            }
+        }
+    }
+    return (m_supportedStatus > 0);
+#else // BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+    return false;
+#endif // BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+}
+
+/**
+ * Get the volume file for a layer if the layer can be drawn with a texture.
+ *
+ * @param volumeDrawInfo
+ *    Info for the layer.
+ * @return
+ *    The volume file or NULL if the layer cannot be drawn with a texture.
+ */
+const VolumeFile*
+BrainOpenGLVolumeTextureCache::getTextureVolumeFile(const BrainOpenGLFixedPipeline::VolumeDrawInfo& volumeDrawInfo) const
+{
+    const VolumeFile* volumeFile = dynamic_cast<const VolumeFile*>(volumeDrawInfo.volumeFile);
+    if (volumeFile == NULL) {
+        return NULL;
+    }
+    if (volumeFile->isMappedWithLabelTable()) {
+        return NULL;
+    }
+
+    std::vector<int64_t> dims;
+    volumeFile->getDimensions(dims);
+    for (int32_t i = 0; i < 3; i++) {
+        if ((dims[i] < 1)
+            || (dims[i] > m_maximumTextureDimension)) {
+            return NULL;
+        }
+    }
+
+    return volumeFile;
+}
+
+/**
+ * Draw the layers of a volume slice, in order, with each layer drawn
+ * as one textured polygon.
+ *
+ * @param volumeDrawInfo
+ *    The layers of the slice.
+ * @param plane
+ *    Plane of the slice (orthogonal or oblique).
+ * @param offsetLayersFlag
+ *    If true, use polygon offset to push lower layers away from
+ *    the viewer (used in the ALL view where lines are drawn
+ *    over the slices).
+ * @return
+ *    True if the layers were drawn.  False if texture drawing is
+ *    disabled or not possible for all layers and nothing was drawn.
+ */
+bool
+BrainOpenGLVolumeTextureCache::drawSliceLayers(const std::vector<BrainOpenGLFixedPipeline::VolumeDrawInfo>& volumeDrawInfo,
+                                               const Plane& plane,
+                                               const bool offsetLayersFlag)
+{
+#ifdef BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+    if ( ! SessionManager::get()->getCaretPreferences()->isVolumeSliceTextureDrawingEnabled()) {
+        return false;
+    }
+    if (BrainOpenGLShape::isImmediateModeOverride()) {
+        return false;
+    }
+    if ( ! isTextureDrawingSupported()) {
+        return false;
+    }
+    if (volumeDrawInfo.empty()
+        || ( ! plane.isValidPlane())) {
+        return false;
+    }
+
+    /*
+     * Verify all layers can be drawn and find a bounding box
+     * that contains all of the volumes.
+     */
+    const int32_t numberOfLayers = static_cast<int32_t>(volumeDrawInfo.size());
+    std::vector<const VolumeFile*> layerVolumeFiles;
+    float bounds[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    for (int32_t iLayer = 0; iLayer < numberOfLayers; iLayer++) {
+        const VolumeFile* volumeFile = getTextureVolumeFile(volumeDrawInfo[iLayer]);
+        if (volumeFile == NULL) {
+            return false;
+        }
+        layerVolumeFiles.push_back(volumeFile);
+
+        std::vector<int64_t> dims;
+        volumeFile->getDimensions(dims);
+        for (int32_t iCorner = 0; iCorner < 8; iCorner++) {
+            const float cornerIJK[3] = {
+                ((iCorner & 1) ? (dims[0] - 0.5f) : -0.5f),
+                ((iCorner & 2) ? (dims[1] - 0.5f) : -0.5f),
+                ((iCorner & 4) ? (dims[2] - 0.5f) : -0.5f)
+            };
+            float xyz[3];
+            volumeFile->indexToSpace(cornerIJK, xyz);
+            for (int32_t j = 0; j < 3; j++) {
+                if (((iLayer == 0) && (iCorner == 0))
+                    || (xyz[j] < bounds[j * 2])) {
+                    bounds[j * 2] = xyz[j];
+                }
+                if (((iLayer == 0) && (iCorner == 0))
+                    || (xyz[j] > bounds[j * 2 + 1])) {
+                    bounds[j * 2 + 1] = xyz[j];
+                }
+            }
+        }
+    }
+
+    /*
+     * A square in the plane, centered at the point in the plane nearest
+     * the center of the volumes, that is large enough to cover any slice
+     * through the volumes.  Texture coordinates outside of a volume get
+     * the transparent border color.  All layers use the same square so
+     * that their depth values are identical.
+     */
+    const float boundsCenter[3] = {
+        (bounds[0] + bounds[1]) / 2.0f,
+        (bounds[2] + bounds[3]) / 2.0f,
+        (bounds[4] + bounds[5]) / 2.0f
+    };
+    float center[3];
+    plane.projectPointToPlane(boundsCenter,
+                              center);
+    const float halfSize = std::sqrt(((bounds[1] - bounds[0]) * (bounds[1] - bounds[0]))
+                                     + ((bounds[3] - bounds[2]) * (bounds[3] - bounds[2]))
+                                     + ((bounds[5] - bounds[4]) * (bounds[5] - bounds[4]))) / 2.0f;
+
+    float normal[3];
+    plane.getNormalVector(normal);
+    float axis[3] = { 0.0, 0.0, 0.0 };
+    if (std::fabs(normal[0]) <= std::min(std::fabs(normal[1]), std::fabs(normal[2]))) {
+        axis[0] = 1.0;
+    }
+    else if (std::fabs(normal[1]) <= std::fabs(normal[2])) {
+        axis[1] = 1.0;
+    }
+    else {
+        axis[2] = 1.0;
+    }
+    float uVector[3];
+    MathFunctions::crossProduct(normal, axis, uVector);
+    MathFunctions::normalizeVector(uVector);
+    float vVector[3];
+    MathFunctions::crossProduct(normal, uVector, vVector);
+    MathFunctions::normalizeVector(vVector);
+
+    float corners[4][3];
+    const float cornerSigns[4][2] = { { -1.0, -1.0 }, { 1.0, -1.0 }, { 1.0, 1.0 }, { -1.0, 1.0 } };
+    for (int32_t iCorner = 0; iCorner < 4; iCorner++) {
+        for (int32_t j = 0; j < 3; j++) {
+            corners[iCorner][j] = (center[j]
+                                   + (cornerSigns[iCorner][0] * halfSize * uVector[j])
+                                   + (cornerSigns[iCorner][1] * halfSize * vVector[j]));
+        }
+    }
+
+    /*
+     * Load textures before drawing anything so that nothing is
+     * drawn if any layer's texture is unavailable.
+     */
+    for (int32_t iLayer = 0; iLayer < numberOfLayers; iLayer++) {
+        if ( ! bindMapTexture(layerVolumeFiles[iLayer],
+                              volumeDrawInfo[iLayer].mapIndex)) {
+            glBindTexture(GL_TEXTURE_3D, 0);
+            return false;
+        }
+    }
+
+    /*
+     * Enable alpha blending so voxels that are not drawn from higher layers
+     * allow voxels from lower layers to be seen.
+     */
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_TEXTURE_3D);
+    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    for (int32_t iLayer = 0; iLayer < numberOfLayers; iLayer++) {
+        const VolumeFile* volumeFile = layerVolumeFiles[iLayer];
+        bindMapTexture(volumeFile,
+                       volumeDrawInfo[iLayer].mapIndex);
+
+        if (offsetLayersFlag) {
+            /*
+             * Same offsets as voxel drawing in the ALL view (WB-414)
+             */
+            const float inverseSliceIndex = numberOfLayers - iLayer;
+            const float factor  = inverseSliceIndex * 1.0 + 1.0;
+            const float units  = inverseSliceIndex * 1.0 + 1.0;
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(factor, units);
+        }
+
+        std::vector<int64_t> dims;
+        volumeFile->getDimensions(dims);
+
+        /*
+         * Texture alpha is zero or one, overlay opacity is applied by modulation
+         */
+        glColor4f(1.0, 1.0, 1.0, volumeDrawInfo[iLayer].opacity);
+        glNormal3fv(normal);
+        glBegin(GL_QUADS);
+        for (int32_t iCorner = 0; iCorner < 4; iCorner++) {
+            float ijk[3];
+            volumeFile->spaceToIndex(corners[iCorner], ijk);
+            glTexCoord3f((ijk[0] + 0.5f) / dims[0],
+                         (ijk[1] + 0.5f) / dims[1],
+                         (ijk[2] + 0.5f) / dims[2]);
+            glVertex3fv(corners[iCorner]);
+        }
+        glEnd();
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+    }
+
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glDisable(GL_TEXTURE_3D);
+    glDisable(GL_BLEND);
+
+    return true;
+#else // BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+    return false;
+#endif // BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+}
+
+/**
+ * Bind the texture for a map, loading the texture if it does not
+ * exist or the map's coloring has changed.
+ *
+ * @param volumeFile
+ *    The volume file.
+ * @param mapIndex
+ *    Index of the map.
+ * @return
+ *    True if the texture is bound.
+ */
+bool
+BrainOpenGLVolumeTextureCache::bindMapTexture(const VolumeFile* volumeFile,
+                                              const int32_t mapIndex)
+{
+#ifdef BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+    int64_t coloringStamp = -1;
+    const uint8_t* mapRGBA = volumeFile->getVoxelColorsForMap(mapIndex,
+                                                              coloringStamp);
+    if (mapRGBA == NULL) {
+        return false;
+    }
+
+    MapTexture& mapTexture = m_mapTextures[std::make_pair(volumeFile, mapIndex)];
+    mapTexture.m_lastUsedFrame = m_frameCounter;
+    if ((mapTexture.m_textureName == 0)
+        || (mapTexture.m_coloringStamp != coloringStamp)) {
+        if ( ! loadMapTexture(volumeFile,
+                              mapIndex,
+                              mapRGBA,
+                              mapTexture)) {
+            deleteMapTexture(mapTexture);
+            m_mapTextures.erase(std::make_pair(volumeFile, mapIndex));
+            return false;
+        }
+        mapTexture.m_coloringStamp = coloringStamp;
+    }
+
+    glBindTexture(GL_TEXTURE_3D,
+                  mapTexture.m_textureName);
+    return true;
+#else // BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+    return false;
+#endif // BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+}
+
+/**
+ * Load a map's coloring into its texture.
+ *
+ * @param volumeFile
+ *    The volume file.
+ * @param mapIndex
+ *    Index of the map.
+ * @param mapRGBA
+ *    Coloring of the map's voxels.
+ * @param mapTexture
+ *    Texture for the map, created if needed.
+ * @return
+ *    True if the texture was loaded.
+ */
+bool
+BrainOpenGLVolumeTextureCache::loadMapTexture(const VolumeFile* volumeFile,
+                                              const int32_t mapIndex,
+                                              const uint8_t* mapRGBA,
+                                              MapTexture& mapTexture)
+{
+#ifdef BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+    std::vector<int64_t> dims;
+    volumeFile->getDimensions(dims);
+    const int64_t numberOfVoxels = dims[0] * dims[1] * dims[2];
+    const int64_t numberOfBytes = numberOfVoxels * 4;
+
+    m_textureBytes -= mapTexture.m_numberOfBytes;
+    mapTexture.m_numberOfBytes = 0;
+    releaseLeastRecentlyUsedTextures(numberOfBytes);
+    if ((m_textureBytes + numberOfBytes) > s_maximumTextureBytes) {
+        return false;
+    }
+
+    if (mapTexture.m_textureName == 0) {
+        glGenTextures(1, &mapTexture.m_textureName);
+    }
+
+    /*
+     * Voxel drawing uses the overlay opacity for any voxel that is
+     * displayed, so any nonzero alpha becomes fully opaque.
+     */
+    std::vector<uint8_t> textureRGBA(mapRGBA,
+                                     mapRGBA + numberOfBytes);
+    for (int64_t i = 3; i < numberOfBytes; i += 4) {
+        if (textureRGBA[i] > 0) {
+            textureRGBA[i] = 255;
+        }
+    }
+
+    const GLfloat transparentBorder[4] = { 0.0, 0.0, 0.0, 0.0 };
+    glBindTexture(GL_TEXTURE_3D,
+                  mapTexture.m_textureName);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_3D, GL_TEXTURE_BORDER_COLOR, transparentBorder);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    while (glGetError() != GL_NO_ERROR) {
+        /* clear errors from earlier drawing */
+    }
+    glTexImage3D(GL_TEXTURE_3D,
+                 0,
+                 GL_RGBA8,
+                 dims[0],
+                 dims[1],
+                 dims[2],
+                 0,
+                 GL_RGBA,
+                 GL_UNSIGNED_BYTE,
+                 &textureRGBA[0]);
+    const GLenum errorCode = glGetError();
+    glBindTexture(GL_TEXTURE_3D, 0);
+    if (errorCode != GL_NO_ERROR) {
+        CaretLogWarning("Unable to load map "
+                        + AString::number(mapIndex + 1)
+                        + " of "
+                        + volumeFile->getFileNameNoPath()
+                        + " into a texture, voxels will be drawn individually.");
+        return false;
+    }
+
+    mapTexture.m_numberOfBytes = numberOfBytes;
+    m_textureBytes += numberOfBytes;
+
+    return true;
+#else // BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+    return false;
+#endif // BRAIN_OPENGL_VOLUME_TEXTURE_CACHE_SUPPORTED
+}
+
+/**
+ * Delete least recently used textures, that are not used in the
+ * current frame, until a texture of the given size fits.
+ *
+ * @param numberOfBytesNeeded
+ *    Size of the texture that is to be loaded.
+ */
+void
+BrainOpenGLVolumeTextureCache::releaseLeastRecentlyUsedTextures(const int64_t numberOfBytesNeeded)
+{
+    while ((m_textureBytes + numberOfBytesNeeded) > s_maximumTextureBytes) {
+        std::map<MapKey, MapTexture>::iterator oldestIter = m_mapTextures.end();
+        for (std::map<MapKey, MapTexture>::iterator iter = m_mapTextures.begin();
+             iter != m_mapTextures.end();
+             iter++) {
+            if ((iter->second.m_lastUsedFrame < m_frameCounter)
+                && (iter->second.m_numberOfBytes > 0)) {
+                if ((oldestIter == m_mapTextures.end())
+                    || (iter->second.m_lastUsedFrame < oldestIter->second.m_lastUsedFrame)) {
+                    oldestIter = iter;
+                }
+            }
+        }
+        if (oldestIter == m_mapTextures.end()) {
+            return;
+        }
+        deleteMapTexture(oldestIter->second);
+        m_mapTextures.erase(oldestIter);
+    }
+}
+
+/**
+ * Delete a map's texture.
+ *
+ * @param mapTexture
+ *    The map's texture.
+ */
+void
+BrainOpenGLVolumeTextureCache::deleteMapTexture(MapTexture& mapTexture)
+{
+    if (mapTexture.m_textureName != 0) {
+        glDeleteTextures(1, &mapTexture.m_textureName);
+        mapTexture.m_textureName = 0;
+    }
+    m_textureBytes -= mapTexture.m_numberOfBytes;
+    mapTexture.m_numberOfBytes = 0;
+}
+
+/**
+ * Called once per frame, with the OpenGL context current, to delete
+ * textures of maps that have not been drawn recently, such as those
+ * of closed files or maps no longer selected in a layer.  Since volume
+ * files are only identified by their address, this also prevents
+ * the cache from growing as files are opened and closed.
+ */
+void
+BrainOpenGLVolumeTextureCache::releaseUnusedTextures()
+{
+    m_frameCounter++;
+
+    std::map<MapKey, MapTexture>::iterator iter = m_mapTextures.begin();
+    while (iter != m_mapTextures.end()) {
+        if ((m_frameCounter - iter->second.m_lastUsedFrame) > s_unusedFrameLimit) {
+            deleteMapTexture(iter->second);
+            m_mapTextures.erase(iter++);
+        }
+        else {
+            ++iter;
+        }
+    }
+}
+
+/**
+ * Get a description of this object's content.
+ * @return String describing this object's content.
+ */
+AString
+BrainOpenGLVolumeTextureCache::toString() const
+{
+    return "BrainOpenGLVolumeTextureCache";
+}
+
@@ -0,0 +1,122 @@
+#ifndef __BRAIN_OPEN_G_L_VOLUME_TEXTURE_CACHE_H__
+#define __BRAIN_OPEN_G_L_VOLUME_TEXTURE_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016 Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <map>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "BrainOpenGLFixedPipeline.h"
+#include "CaretObject.h"
+#include "CaretOpenGLInclude.h"
+
+
+namespace caret {
+
+    class Plane;
+    class VolumeFile;
+
+    class BrainOpenGLVolumeTextureCache : public CaretObject {
+
+    public:
+        BrainOpenGLVolumeTextureCache();
+
+        virtual ~BrainOpenGLVolumeTextureCache();
+
+        bool drawSliceLayers(const std::vector<BrainOpenGLFixedPipeline::VolumeDrawInfo>& volumeDrawInfo,
+                             const Plane& plane,
+                             const bool offsetLayersFlag);
+
+        void releaseUnusedTextures();
+
+        // ADD_NEW_METHODS_HERE
+
+        virtual AString toString() const;
+
+    private:
+        /**
+         * 3D texture containing the coloring of one map.
+         */
+        struct MapTexture {
+            MapTexture() : m_textureName(0), m_coloringStamp(-1), m_lastUsedFrame(0), m_numberOfBytes(0) { }
+
+            GLuint m_textureName;
+
+            int64_t m_coloringStamp;
+
+            int64_t m_lastUsedFrame;
+
+            int64_t m_numberOfBytes;
+        };
+
+        /** Identifies a map by its file and map index */
+        typedef std::pair<const VolumeFile*, int32_t> MapKey;
+
+        BrainOpenGLVolumeTextureCache(const BrainOpenGLVolumeTextureCache&);
+
+        BrainOpenGLVolumeTextureCache& operator=(const BrainOpenGLVolumeTextureCache&);
+
+        bool isTextureDrawingSupported();
+
+        const VolumeFile* getTextureVolumeFile(const BrainOpenGLFixedPipeline::VolumeDrawInfo& volumeDrawInfo) const;
+
+        bool bindMapTexture(const VolumeFile* volumeFile,
+                            const int32_t mapIndex);
+
+        bool loadMapTexture(const VolumeFile* volumeFile,
+                            const int32_t mapIndex,
+                            const uint8_t* mapRGBA,
+                            MapTexture& mapTexture);
+
+        void releaseLeastRecentlyUsedTextures(const int64_t numberOfBytesNeeded);
+
+        void deleteMapTexture(MapTexture& mapTexture);
+
+        std::map<MapKey, MapTexture> m_mapTextures;
+
+        int64_t m_frameCounter;
+
+        int64_t m_textureBytes;
+
+        /** Zero if not yet tested, positive if 3D textures may be used, negative if not */
+        int32_t m_supportedStatus;
+
+        GLint m_maximumTextureDimension;
+
+        /** Textures not used for this many frames are deleted */
+        static const int64_t s_unusedFrameLimit;
+
+        /** Textures are deleted, least recently used first, to stay within this size */
+        static const int64_t s_maximumTextureBytes;
+
+        // ADD_NEW_MEMBERS_HERE
+
+    };
+
+#ifdef __BRAIN_OPEN_G_L_VOLUME_TEXTURE_CACHE_DECLARE__
+    const int64_t BrainOpenGLVolumeTextureCache::s_unusedFrameLimit = 50;
+    const int64_t BrainOpenGLVolumeTextureCache::s_maximumTextureBytes = 512 * 1024 * 1024;
+#endif // __BRAIN_OPEN_G_L_VOLUME_TEXTURE_CACHE_DECLARE__
+
+} // namespace
+#endif  //__BRAIN_OPEN_G_L_VOLUME_TEXTURE_CACHE_H__
@@ -37,6 +37,7 @@
 #include "ScenePrimitiveArray.h"
 #include "Surface.h"
 #include "SurfaceFile.h"
+#include "TopologyHelper.h"
 
 using namespace caret;
 
@@ -268,6 +269,12 @@ CiftiConnectivityMatrixDataFileManager::loadDataForSurfaceNode(Brain* brain,
     
     PaletteFile* paletteFile = brain->getPaletteFile();
     
+    /*
+     * Nodes near the identified node whose rows are read in the
+     * background since the user is likely to identify them next
+     */
+    std::vector<int32_t> neighboringNodeIndices;
+    
     bool haveData = false;
     for (std::vector<CiftiMappableConnectivityMatrixDataFile*>::iterator iter = ciftiMatrixFiles.begin();
          iter != ciftiMatrixFiles.end();
@@ -288,6 +295,16 @@ CiftiConnectivityMatrixDataFileManager::loadDataForSurfaceNode(Brain* brain,
             haveData = true;
             
             if (rowIndex >= 0) {
+                if (neighboringNodeIndices.empty()) {
+                    const int32_t neighborDepth = 2;
+                    surfaceFile->getTopologyHelper()->getNodeNeighborsToDepth(nodeIndex,
+                                                                              neighborDepth,
+                                                                              neighboringNodeIndices);
+                }
+                cmf->prefetchRowsForSurfaceNodes(surfaceFile->getNumberOfNodes(),
+                                                 surfaceFile->getStructure(),
+                                                 neighboringNodeIndices);
+                
                 /*
                  * Get row/column info for node
                  */
@@ -30,6 +30,8 @@
 #include "MultiDimIterator.h"
 #include "NiftiIO.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace caret;
 
@@ -38,6 +40,7 @@ namespace
 {
     class CiftiOnDiskImpl : public CiftiFile::WriteImplInterface
     {
+    protected:
         mutable NiftiIO m_nifti;//because file objects aren't stateless (current position), so reading "changes" them
         CiftiXML m_xml;//because we need to parse it to set up the dimensions anyway
     public:
@@ -45,11 +48,27 @@ namespace
         CiftiOnDiskImpl(const QString& filename, const CiftiXML& xml, const CiftiVersion& version, const bool& swapEndian);//make new empty file with read/write
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
         void getColumn(float* dataOut, const int64_t& index) const;
+        void getColumns(float* dataOut, const std::vector<int64_t>& indices, const int64_t& memLimitBytes) const;
         const CiftiXML& getCiftiXML() const { return m_xml; }
         QString getFilename() const { return m_nifti.getFilename(); }
         bool isSwapped() const { return m_nifti.getHeader().isSwapped(); }
         void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
         void setColumn(const float* dataIn, const int64_t& index);
+        void setColumns(const float* dataIn, const std::vector<int64_t>& indices);
+    };
+    
+    //read-only, uses a memory map of the data section when the on-disk format is already what we want (uncompressed native float32), otherwise behaves exactly like CiftiOnDiskImpl
+    class CiftiMappedImpl : public CiftiOnDiskImpl
+    {
+        const float* m_data;//NULL when mapping wasn't possible
+        int64_t m_rowSize;
+        int64_t getRowOffset(const std::vector<int64_t>& indexSelect) const;
+    public:
+        CiftiMappedImpl(const QString& filename);//read-only
+        void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
+        void getColumn(float* dataOut, const int64_t& index) const;
+        void getColumns(float* dataOut, const std::vector<int64_t>& indices, const int64_t& memLimitBytes) const;
+        const float* getRowPointer(const std::vector<int64_t>& indexSelect) const;
     };
     
     class CiftiMemoryImpl : public CiftiFile::WriteImplInterface
@@ -59,9 +78,12 @@ namespace
         CiftiMemoryImpl(const CiftiXML& xml);
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
         void getColumn(float* dataOut, const int64_t& index) const;
+        void getColumns(float* dataOut, const std::vector<int64_t>& indices, const int64_t& memLimitBytes) const;
+        const float* getRowPointer(const std::vector<int64_t>& indexSelect) const { return m_array.get(1, indexSelect); }
         bool isInMemory() const { return true; }
         void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
         void setColumn(const float* dataIn, const int64_t& index);
+        void setColumns(const float* dataIn, const std::vector<int64_t>& indices);
     };
     
     class CiftiXnatImpl : public CiftiFile::ReadImplInterface
@@ -76,6 +98,7 @@ namespace
         CiftiXnatImpl(const QString& url);//reuse existing user/pass, or access non-protected url - in the future, maybe only the second use (private http manager)
         void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const;
         void getColumn(float* dataOut, const int64_t& index) const;
+        void getColumns(float* dataOut, const std::vector<int64_t>& indices, const int64_t& memLimitBytes) const;
         const CiftiXML& getCiftiXML() const { return m_xml; }
     };
     
@@ -95,6 +118,57 @@ namespace
         return (endian == CiftiFile::ANY);
     }
     
+    //a contiguous piece of a row to read or write in one call, and where it goes in the scratch row
+    struct ColumnSpan
+    {
+        int64_t m_start, m_length, m_scratchOffset;
+    };
+    
+    //group the requested columns into spans, joining spans separated by no more than maxGap unrequested columns (it is cheaper to read a few extra elements than to do another seek)
+    //also computes where each requested column ends up in the packed scratch row, returns the total scratch length
+    int64_t makeColumnSpans(const vector<int64_t>& indices, const int64_t& maxGap, vector<ColumnSpan>& spansOut, vector<int64_t>& scratchPosOut)
+    {
+        vector<int64_t> sortedCols = indices;
+        sort(sortedCols.begin(), sortedCols.end());
+        sortedCols.erase(unique(sortedCols.begin(), sortedCols.end()), sortedCols.end());
+        spansOut.clear();
+        int64_t scratchLength = 0;
+        for (size_t i = 0; i < sortedCols.size(); ++i)
+        {
+            if (spansOut.empty() || sortedCols[i] > spansOut.back().m_start + spansOut.back().m_length + maxGap)
+            {
+                ColumnSpan newSpan;
+                newSpan.m_start = sortedCols[i];
+                newSpan.m_length = 1;
+                newSpan.m_scratchOffset = scratchLength;
+                spansOut.push_back(newSpan);
+                scratchLength += 1;
+            } else {
+                int64_t newLength = sortedCols[i] - spansOut.back().m_start + 1;
+                scratchLength += newLength - spansOut.back().m_length;
+                spansOut.back().m_length = newLength;
+            }
+        }
+        scratchPosOut.resize(indices.size());
+        for (size_t j = 0; j < indices.size(); ++j)
+        {
+            size_t low = 0, high = spansOut.size();//find the last span starting at or before this column
+            while (high - low > 1)
+            {
+                size_t mid = (low + high) / 2;
+                if (spansOut[mid].m_start <= indices[j])
+                {
+                    low = mid;
+                } else {
+                    high = mid;
+                }
+            }
+            CaretAssert(indices[j] >= spansOut[low].m_start && indices[j] < spansOut[low].m_start + spansOut[low].m_length);
+            scratchPosOut[j] = spansOut[low].m_scratchOffset + indices[j] - spansOut[low].m_start;
+        }
+        return scratchLength;
+    }
+    
 }
 
 CiftiFile::ReadImplInterface::~ReadImplInterface()
@@ -105,9 +179,12 @@ CiftiFile::WriteImplInterface::~WriteImplInterface()
 {
 }
 
+const int64_t CiftiFile::DEFAULT_COLUMN_MEM_LIMIT = ((int64_t)1) << 28;//256MiB
+
 CiftiFile::CiftiFile(const QString& fileName)
 {
     m_endianPref = NATIVE;
+    m_columnMemLimit = DEFAULT_COLUMN_MEM_LIMIT;
     openFile(fileName);
 }
 
@@ -116,7 +193,7 @@ void CiftiFile::openFile(const QString& fileName)
     m_writingImpl.grabNew(NULL);
     m_readingImpl.grabNew(NULL);//to make sure it closes everything first, even if the open throws
     m_dims.clear();
-    CaretPointer<CiftiOnDiskImpl> newRead(new CiftiOnDiskImpl(FileInformation(fileName).getAbsoluteFilePath()));//this constructor opens existing file read-only
+    CaretPointer<CiftiOnDiskImpl> newRead(new CiftiMappedImpl(FileInformation(fileName).getAbsoluteFilePath()));//opens existing file read-only, falls back to normal reads if it can't map it
     m_readingImpl = newRead;//it should be noted that if the constructor throws (if the file isn't readable), new guarantees the memory allocated for the object will be freed
     m_xml = newRead->getCiftiXML();
     m_dims = m_xml.getDimensions();
@@ -224,6 +301,35 @@ void CiftiFile::getColumn(float* dataOut, const int64_t& index) const
     m_readingImpl->getColumn(dataOut, index);
 }
 
+void CiftiFile::getColumns(float* dataOut, const vector<int64_t>& indices) const
+{
+    if (m_dims.empty()) throw DataFileException("getColumns called on uninitialized CiftiFile");
+    if (m_dims.size() != 2) throw DataFileException("getColumns called on non-2D CiftiFile");
+    for (size_t j = 0; j < indices.size(); ++j)
+    {
+        if (indices[j] < 0 || indices[j] >= m_dims[0]) throw DataFileException("getColumns called with out of range column index");
+    }
+    if (m_readingImpl == NULL) return;//NOT an error because we are pretending to have a matrix already, while we are waiting for setRow to actually start writing the file
+    if (indices.empty()) return;
+    m_readingImpl->getColumns(dataOut, indices, m_columnMemLimit);
+}
+
+const float* CiftiFile::getRowPointer(const vector<int64_t>& indexSelect) const
+{
+    if (m_dims.empty()) throw DataFileException("getRowPointer called on uninitialized CiftiFile");
+    if (m_readingImpl == NULL) return NULL;//no data yet, caller must use getRow
+    return m_readingImpl->getRowPointer(indexSelect);
+}
+
+const float* CiftiFile::getRowPointer(const int64_t& index) const
+{
+    if (m_dims.empty()) throw DataFileException("getRowPointer called on uninitialized CiftiFile");
+    if (m_dims.size() != 2) throw DataFileException("getRowPointer with single index called on non-2D CiftiFile");
+    if (m_readingImpl == NULL) return NULL;
+    vector<int64_t> tempvec(1, index);
+    return m_readingImpl->getRowPointer(tempvec);
+}
+
 void CiftiFile::setCiftiXML(const CiftiXML& xml, const bool useOldMetadata)
 {
     m_readingImpl.grabNew(NULL);//drop old implementation, as it is now invalid due to XML (and therefore matrix size) change
@@ -287,6 +393,18 @@ void CiftiFile::setColumn(const float* dataIn, const int64_t& index)
     m_writingImpl->setColumn(dataIn, index);
 }
 
+void CiftiFile::setColumns(const float* dataIn, const vector<int64_t>& indices)
+{
+    verifyWriteImpl();
+    if (m_dims.size() != 2) throw DataFileException("setColumns called on non-2D CiftiFile");
+    for (size_t j = 0; j < indices.size(); ++j)
+    {
+        if (indices[j] < 0 || indices[j] >= m_dims[0]) throw DataFileException("setColumns called with out of range column index");
+    }
+    if (indices.empty()) return;
+    m_writingImpl->setColumns(dataIn, indices);
+}
+
 //compatibility with old interface
 void CiftiFile::getRow(float* dataOut, const int64_t& index, const bool& tolerateShortRead) const
 {
@@ -400,6 +518,24 @@ void CiftiMemoryImpl::getColumn(float* dataOut, const int64_t& index) const
     }
 }
 
+void CiftiMemoryImpl::getColumns(float* dataOut, const vector<int64_t>& indices, const int64_t&) const
+{
+    CaretAssert(m_array.getDimensions().size() == 2);//otherwise, CiftiFile shouldn't have called this
+    const float* ref = m_array.get(2, vector<int64_t>());
+    int64_t rowSize = m_array.getDimensions()[0];
+    int64_t colSize = m_array.getDimensions()[1];
+    int64_t numCols = (int64_t)indices.size();
+    for (int64_t i = 0; i < colSize; ++i)//go in memory order
+    {
+        const float* rowRef = ref + rowSize * i;
+        for (int64_t j = 0; j < numCols; ++j)
+        {
+            CaretAssert(indices[j] >= 0 && indices[j] < rowSize);
+            dataOut[i + colSize * j] = rowRef[indices[j]];
+        }
+    }
+}
+
 void CiftiMemoryImpl::setRow(const float* dataIn, const vector<int64_t>& indexSelect)
 {
     float* ref = m_array.get(1, indexSelect);
@@ -423,6 +559,24 @@ void CiftiMemoryImpl::setColumn(const float* dataIn, const int64_t& index)
     }
 }
 
+void CiftiMemoryImpl::setColumns(const float* dataIn, const vector<int64_t>& indices)
+{
+    CaretAssert(m_array.getDimensions().size() == 2);//otherwise, CiftiFile shouldn't have called this
+    float* ref = m_array.get(2, vector<int64_t>());
+    int64_t rowSize = m_array.getDimensions()[0];
+    int64_t colSize = m_array.getDimensions()[1];
+    int64_t numCols = (int64_t)indices.size();
+    for (int64_t i = 0; i < colSize; ++i)
+    {
+        float* rowRef = ref + rowSize * i;
+        for (int64_t j = 0; j < numCols; ++j)
+        {
+            CaretAssert(indices[j] >= 0 && indices[j] < rowSize);
+            rowRef[indices[j]] = dataIn[i + colSize * j];
+        }
+    }
+}
+
 CiftiOnDiskImpl::CiftiOnDiskImpl(const QString& filename)
 {//opens existing file for reading
     m_nifti.openRead(filename);//read-only, so we don't need write permission to read a cifti file
@@ -617,13 +771,61 @@ void CiftiOnDiskImpl::getColumn(float* dataOut, const int64_t& index) const
     CaretAssert(m_xml.getNumberOfDimensions() == 2);//otherwise this shouldn't be called
     CaretAssert(index >= 0 && index < m_xml.getDimensionLength(CiftiXML::ALONG_ROW));
     CaretLogFine("getColumn called on CiftiOnDiskImpl, this will be slow");//generate logging messages at a low priority
-    vector<int64_t> indexSelect(2);
-    indexSelect[0] = index;
+    getColumns(dataOut, vector<int64_t>(1, index), 0);//assume if they really want getColumn on disk, they don't want their pagecache obliterated, a single column reads 1 element per row
+}
+
+void CiftiOnDiskImpl::getColumns(float* dataOut, const vector<int64_t>& indices, const int64_t& memLimitBytes) const
+{
+    CaretAssert(m_xml.getNumberOfDimensions() == 2);//otherwise this shouldn't be called
+    const int64_t MAX_GAP = 1024;//4KiB of floats, about the size of a page
+    int64_t rowSize = m_xml.getDimensionLength(CiftiXML::ALONG_ROW);
     int64_t colLength = m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN);
-    for (int64_t i = 0; i < colLength; ++i)//assume if they really want getColumn on disk, they don't want their pagecache obliterated, so read it 1 element at a time
-    {
-        indexSelect[1] = i;
-        m_nifti.readData(dataOut + i, 4, indexSelect);//4 means just the 4 reserved dimensions, so 1 element of the matrix
+    int64_t numCols = (int64_t)indices.size();
+    vector<ColumnSpan> spans;
+    vector<int64_t> scratchPos;
+    int64_t scratchLength = makeColumnSpans(indices, MAX_GAP, spans, scratchPos);
+    if (spans.size() > 1 && scratchLength * 2 >= rowSize)
+    {//reading the whole row in one call is better than many calls that cover most of it
+        spans.resize(1);
+        spans[0].m_start = 0;
+        spans[0].m_length = rowSize;
+        spans[0].m_scratchOffset = 0;
+        scratchLength = rowSize;
+        for (int64_t j = 0; j < numCols; ++j)
+        {
+            scratchPos[j] = indices[j];
+        }
+    }
+    if (spans.size() == 1 && spans[0].m_length == rowSize)
+    {//whole rows are contiguous in the file, so read as many as the memory limit allows in each call
+        int64_t rowsPerBlock = max((int64_t)1, min(colLength, memLimitBytes / (int64_t)(rowSize * sizeof(float))));
+        vector<float> scratch(rowsPerBlock * rowSize);
+        for (int64_t blockStart = 0; blockStart < colLength; blockStart += rowsPerBlock)
+        {
+            int64_t blockRows = min(rowsPerBlock, colLength - blockStart);
+            m_nifti.readRange(scratch.data(), blockStart * rowSize, blockRows * rowSize);
+            for (int64_t i = 0; i < blockRows; ++i)
+            {
+                const float* rowRef = scratch.data() + i * rowSize;
+                for (int64_t j = 0; j < numCols; ++j)
+                {
+                    dataOut[blockStart + i + colLength * j] = rowRef[scratchPos[j]];
+                }
+            }
+        }
+    } else {
+        vector<float> scratch(scratchLength);
+        for (int64_t i = 0; i < colLength; ++i)
+        {
+            for (size_t s = 0; s < spans.size(); ++s)
+            {
+                m_nifti.readRange(scratch.data() + spans[s].m_scratchOffset, i * rowSize + spans[s].m_start, spans[s].m_length);
+            }
+            for (int64_t j = 0; j < numCols; ++j)
+            {
+                dataOut[i + colLength * j] = scratch[scratchPos[j]];
+            }
+        }
     }
 }
 
@@ -637,14 +839,112 @@ void CiftiOnDiskImpl::setColumn(const float* dataIn, const int64_t& index)
     CaretAssert(m_xml.getNumberOfDimensions() == 2);//otherwise this shouldn't be called
     CaretAssert(index >= 0 && index < m_xml.getDimensionLength(CiftiXML::ALONG_ROW));
     CaretLogFine("setColumn called on CiftiOnDiskImpl, this will be slow");//generate logging messages at a low priority
-    vector<int64_t> indexSelect(2);
-    indexSelect[0] = index;
+    setColumns(dataIn, vector<int64_t>(1, index));
+}
+
+void CiftiOnDiskImpl::setColumns(const float* dataIn, const vector<int64_t>& indices)
+{
+    CaretAssert(m_xml.getNumberOfDimensions() == 2);//otherwise this shouldn't be called
+    int64_t rowSize = m_xml.getDimensionLength(CiftiXML::ALONG_ROW);
     int64_t colLength = m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN);
-    for (int64_t i = 0; i < colLength; ++i)//don't do RMW, so write it 1 element at a time
+    int64_t numCols = (int64_t)indices.size();
+    vector<ColumnSpan> spans;
+    vector<int64_t> scratchPos;
+    int64_t scratchLength = makeColumnSpans(indices, 0, spans, scratchPos);//don't do RMW, so only adjacent columns can be written together
+    vector<float> scratch(scratchLength);
+    for (int64_t i = 0; i < colLength; ++i)
+    {
+        for (int64_t j = 0; j < numCols; ++j)
+        {
+            scratch[scratchPos[j]] = dataIn[i + colLength * j];
+        }
+        for (size_t s = 0; s < spans.size(); ++s)
+        {
+            m_nifti.writeRange(scratch.data() + spans[s].m_scratchOffset, i * rowSize + spans[s].m_start, spans[s].m_length);
+        }
+    }
+}
+
+CiftiMappedImpl::CiftiMappedImpl(const QString& filename) : CiftiOnDiskImpl(filename)
+{
+    m_rowSize = m_xml.getDimensionLength(CiftiXML::ALONG_ROW);
+    m_data = NULL;
+    if (filename.endsWith(".gz")) return;//don't even try
+    m_data = m_nifti.mapFloatData();//checks the type, endianness and scaling
+    if (m_data != NULL)
+    {
+        CaretLogFine("using memory mapped reading for cifti file '" + filename + "'");
+    }
+}
+
+int64_t CiftiMappedImpl::getRowOffset(const vector<int64_t>& indexSelect) const
+{//same math as NiftiIO::readData with fullDims = 5, but the first 4 nifti dimensions are always 1
+    const vector<int64_t>& dims = m_nifti.getDimensions();
+    CaretAssert(indexSelect.size() + 5 == dims.size());
+    int64_t numDimSkip = m_rowSize, ret = 0;
+    for (int i = 5; i < (int)dims.size(); ++i)
     {
-        indexSelect[1] = i;
-        m_nifti.writeData(dataIn + i, 4, indexSelect);//4 means just the 4 reserved dimensions, so 1 element of the matrix
+        CaretAssert(indexSelect[i - 5] >= 0 && indexSelect[i - 5] < dims[i]);
+        ret += indexSelect[i - 5] * numDimSkip;
+        numDimSkip *= dims[i];
     }
+    return ret;
+}
+
+void CiftiMappedImpl::getRow(float* dataOut, const vector<int64_t>& indexSelect, const bool& tolerateShortRead) const
+{
+    if (m_data == NULL)
+    {
+        CiftiOnDiskImpl::getRow(dataOut, indexSelect, tolerateShortRead);
+        return;
+    }
+    const float* rowStart = m_data + getRowOffset(indexSelect);//only mapped when the file contains all of the data, so there is no short read to tolerate
+    for (int64_t i = 0; i < m_rowSize; ++i)
+    {
+        dataOut[i] = rowStart[i];
+    }
+}
+
+void CiftiMappedImpl::getColumn(float* dataOut, const int64_t& index) const
+{
+    if (m_data == NULL)
+    {
+        CiftiOnDiskImpl::getColumn(dataOut, index);
+        return;
+    }
+    CaretAssert(m_xml.getNumberOfDimensions() == 2);
+    CaretAssert(index >= 0 && index < m_rowSize);
+    int64_t colLength = m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    for (int64_t i = 0; i < colLength; ++i)//still touches a page per row, but no syscalls
+    {
+        dataOut[i] = m_data[index + m_rowSize * i];
+    }
+}
+
+void CiftiMappedImpl::getColumns(float* dataOut, const vector<int64_t>& indices, const int64_t& memLimitBytes) const
+{
+    if (m_data == NULL)
+    {
+        CiftiOnDiskImpl::getColumns(dataOut, indices, memLimitBytes);
+        return;
+    }
+    CaretAssert(m_xml.getNumberOfDimensions() == 2);
+    int64_t colLength = m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    int64_t numCols = (int64_t)indices.size();
+    for (int64_t i = 0; i < colLength; ++i)//go in file order, so each page is only faulted in once
+    {
+        const float* rowRef = m_data + m_rowSize * i;
+        for (int64_t j = 0; j < numCols; ++j)
+        {
+            dataOut[i + colLength * j] = rowRef[indices[j]];
+        }
+    }
+}
+
+const float* CiftiMappedImpl::getRowPointer(const vector<int64_t>& indexSelect) const
+{
+    if (m_data == NULL) return NULL;
+    return m_data + getRowOffset(indexSelect);
 }
 
 CiftiXnatImpl::CiftiXnatImpl(const QString& url, const QString& user, const QString& pass)
@@ -794,3 +1094,12 @@ void CiftiXnatImpl::getColumn(float* dataOut, const int64_t& index) const
     columnRequest.m_queries.push_back(make_pair(AString("column-index"), AString::number(index)));
     getReqAsFloats(dataOut, m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN), columnRequest);
 }
+
+void CiftiXnatImpl::getColumns(float* dataOut, const vector<int64_t>& indices, const int64_t&) const
+{//the server gives us columns directly, no way to batch them
+    int64_t colLength = m_xml.getDimensionLength(CiftiXML::ALONG_COLUMN);
+    for (size_t j = 0; j < indices.size(); ++j)
+    {
+        getColumn(dataOut + colLength * j, indices[j]);
+    }
+}
@@ -45,7 +45,7 @@ namespace caret
             BIG
         };
 
-        CiftiFile() { m_endianPref = NATIVE; }
+        CiftiFile() { m_endianPref = NATIVE; m_columnMemLimit = DEFAULT_COLUMN_MEM_LIMIT; }
         explicit CiftiFile(const QString &fileName);//calls openFile
         void openFile(const QString& fileName);//starts on-disk reading
         void openURL(const QString& url, const QString& user, const QString& pass);//open from XNAT
@@ -63,11 +63,21 @@ namespace caret
             return MultiDimIterator<int64_t>(std::vector<int64_t>(m_dims.begin() + 1, m_dims.end()));
         }
         void getColumn(float* dataOut, const int64_t& index) const;//for 2D only, will be slow if on disk!
+        //for 2D only, gathers all requested columns in one pass over the file, column j of the output starts at dataOut + j * getNumberOfRows()
+        void getColumns(float* dataOut, const std::vector<int64_t>& indices) const;
+        //limits the scratch memory getColumns uses on disk, larger allows reading more rows per read call
+        void setColumnMemoryLimit(const int64_t& bytes) { m_columnMemLimit = bytes; }
+        int64_t getColumnMemoryLimit() const { return m_columnMemLimit; }
+        //zero-copy access for read-only use, returns NULL when the data can't be used directly (compressed, byteswapped, non-float32 on disk, etc), so always have a getRow fallback
+        //the pointer is invalidated by any open...(), set...(), writeFile() or convertToInMemory() call
+        const float* getRowPointer(const std::vector<int64_t>& indexSelect) const;
+        const float* getRowPointer(const int64_t& index) const;//for 2D only
         
         void setCiftiXML(const CiftiXML& xml, const bool useOldMetadata = true);
         void setCiftiXML(const CiftiXMLOld &xml, const bool useOldMetadata = true);//set xml from old implementation
         void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect);
         void setColumn(const float* dataIn, const int64_t& index);//for 2D only, will be slow if on disk!
+        void setColumns(const float* dataIn, const std::vector<int64_t>& indices);//for 2D only, same layout as getColumns, adjacent indices are written together
         
         void getRow(float* dataOut, const int64_t& index, const bool& tolerateShortRead) const;//backwards compatibility for old CiftiFile/CiftiInterface
         void getRow(float* dataOut, const int64_t& index) const;
@@ -81,6 +91,8 @@ namespace caret
         public:
             virtual void getRow(float* dataOut, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead) const = 0;
             virtual void getColumn(float* dataOut, const int64_t& index) const = 0;
+            virtual void getColumns(float* dataOut, const std::vector<int64_t>& indices, const int64_t& memLimitBytes) const = 0;
+            virtual const float* getRowPointer(const std::vector<int64_t>&) const { return NULL; }//default is no zero-copy access
             virtual bool isInMemory() const { return false; }
             virtual ~ReadImplInterface();
         };
@@ -90,6 +102,7 @@ namespace caret
         public:
             virtual void setRow(const float* dataIn, const std::vector<int64_t>& indexSelect) = 0;
             virtual void setColumn(const float* dataIn, const int64_t& index) = 0;
+            virtual void setColumns(const float* dataIn, const std::vector<int64_t>& indices) = 0;
             virtual ~WriteImplInterface();
         };
     private:
@@ -100,6 +113,8 @@ namespace caret
         //CiftiXML m_xml;//uncomment when we drop CiftiInterface
         CiftiVersion m_onDiskVersion;
         ENDIAN m_endianPref;
+        int64_t m_columnMemLimit;
+        static const int64_t DEFAULT_COLUMN_MEM_LIMIT;
         
         void verifyWriteImpl();
         static void copyImplData(const ReadImplInterface* from, WriteImplInterface* to, const std::vector<int64_t>& dims);
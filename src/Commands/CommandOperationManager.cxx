@@ -101,6 +101,7 @@
 #include "AlgorithmSurfaceDistortion.h"
 #include "AlgorithmSurfaceFlipLR.h"
 #include "AlgorithmSurfaceGenerateInflated.h"
+#include "AlgorithmSurfaceGeodesicDistanceAllToAll.h"
 #include "AlgorithmSurfaceInflation.h"
 #include "AlgorithmSurfaceMatch.h"
 #include "AlgorithmSurfaceModifySphere.h"
@@ -176,6 +177,7 @@
 #include "OperationLabelMerge.h"
 #include "OperationMetadataRemoveProvenance.h"
 #include "OperationMetadataStringReplace.h"
+#include "OperationMetricClusterAreas.h"
 #include "OperationMetricConvert.h"
 #include "OperationMetricLabelImport.h"
 #include "OperationMetricMask.h"
@@ -205,6 +207,7 @@
 #include "OperationSurfaceNormals.h"
 #include "OperationSurfaceVertexAreas.h"
 #include "OperationVolumeCapturePlane.h"
+#include "OperationVolumeClusterSizes.h"
 #include "OperationVolumeCopyExtensions.h"
 #include "OperationVolumeCreate.h"
 #include "OperationVolumeLabelExportTable.h"
@@ -234,8 +237,11 @@
 #include "CommandUnitTest.h"
 #include "ProgramParameters.h"
 
+#include "CaretBinaryFile.h"
 #include "CaretLogger.h"
+#include "MetricSmoothingObject.h"
 #include "StructureEnum.h"
+#include "SurfaceResamplingHelper.h"
 
 #include <iostream>
 
@@ -353,6 +359,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmSurfaceDistortion()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmSurfaceFlipLR()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmSurfaceGenerateInflated()));
+    this->commandOperations.push_back(new CommandParser(new AutoAlgorithmSurfaceGeodesicDistanceAllToAll()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmSurfaceInflation()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmSurfaceMatch()));
     this->commandOperations.push_back(new CommandParser(new AutoAlgorithmSurfaceModifySphere()));
@@ -423,6 +430,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationLabelMerge()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetadataRemoveProvenance()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetadataStringReplace()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationMetricClusterAreas()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetricConvert()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetricLabelImport()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationMetricMask()));
@@ -452,6 +460,7 @@ CommandOperationManager::CommandOperationManager()
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceNormals()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationSurfaceVertexAreas()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeCapturePlane()));
+    this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeClusterSizes()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeCopyExtensions()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeCreate()));
     this->commandOperations.push_back(new CommandParser(new AutoOperationVolumeLabelExportTable()));
@@ -524,6 +533,18 @@ CommandOperationManager::runCommand(ProgramParameters& parameters)
         if (!valid) throw CommandException("unrecognized logging level: '" + globalOptionArgs[0] + "'");
         CaretLogger::getLogger()->setLevel(level);
     }
+    if (getGlobalOption(parameters, "-gzip-index-cache", 0, globalOptionArgs))
+    {
+        CaretBinaryFile::setGzipIndexCaching(true);
+    }
+    if (getGlobalOption(parameters, "-smoothing-weight-cache", 1, globalOptionArgs))
+    {
+        MetricSmoothingObject::setWeightCacheDirectory(globalOptionArgs[0]);
+    }
+    if (getGlobalOption(parameters, "-resampling-weight-cache", 1, globalOptionArgs))
+    {
+        SurfaceResamplingHelper::setWeightCacheDirectory(globalOptionArgs[0]);
+    }
 
     const uint64_t numberOfCommands = this->commandOperations.size();
     const uint64_t numberOfDeprecated = this->deprecatedOperations.size();
@@ -786,6 +807,8 @@ void CommandOperationManager::printHelpInfo()
     cout << "                                  info - VERY LONG" << endl;
     cout << endl << "Global options (can be added to any command):" << endl;
     cout << "   -disable-provenance         don't generate provenance info in output files" << endl;
+    cout << "   -gzip-index-cache           save seek indexes of .gz files as <name>.gzidx, to" << endl;
+    cout << "                                  speed up random access in later commands" << endl;
     cout << "   -logging <level>            set the logging level, valid values are:" << endl;
     vector<LogLevelEnum::Enum> logLevels;
     LogLevelEnum::getAllEnums(logLevels);
@@ -794,6 +817,12 @@ void CommandOperationManager::printHelpInfo()
          iter++) {
         cout << "            " << LogLevelEnum::toName(*iter) << endl;
     }
+    cout << "   -smoothing-weight-cache <directory>" << endl;
+    cout << "                               save surface smoothing weights in <directory>, and" << endl;
+    cout << "                                  reuse them for the same surface and settings" << endl;
+    cout << "   -resampling-weight-cache <directory>" << endl;
+    cout << "                               save surface resampling weights in <directory>, and" << endl;
+    cout << "                                  reuse them for the same spheres and settings" << endl;
     cout << endl;
     cout << "To get the help information of a processing subcommand, run it without any" << endl;
     cout << "   additional arguments." << endl;
@@ -28,12 +28,18 @@
 #include "CaretAssert.h"
 #include "CaretBinaryFile.h"
 #include "CaretLogger.h"
+#include "CaretOMP.h"
 #include "DataFileException.h"
 
+#include <QDataStream>
+#include <QDateTime>
 #include <QFile>
+#include <QFileInfo>
 #include "zlib.h"
 
 #include <algorithm>
+#include <cstring>
+#include <vector>
 
 using namespace caret;
 using namespace std;
@@ -44,10 +50,57 @@ namespace caret
 #ifdef ZLIB_VERSION
     class ZFileImpl : public CaretBinaryFile::ImplInterface
     {
-        gzFile m_zfile;
-        const static int64_t CHUNK_SIZE;
+        //zran-style index, inflate can be restarted at any of these points instead of from the start of the file
+        struct AccessPoint
+        {
+            int64_t m_uncompressedOffset, m_compressedOffset;
+            int m_bits;//number of bits of the byte before m_compressedOffset that belong to the next block
+            bool m_memberStart;//start of a gzip member, doesn't need the window or bits
+            vector<unsigned char> m_window;//the 32KiB of output preceding the point, oldest first
+        };
+        QFile m_rawFile;//we do the gzip framing ourselves, so that reading can stop at deflate block boundaries, and so that members can be compressed in parallel
+        bool m_writing;
+        //reading
+        z_stream m_strm;
+        bool m_strmInit, m_plain, m_rawDeflate, m_atEnd, m_atMemberStart, m_indexComplete;
+        int64_t m_pos, m_outTotal, m_pending, m_inBufFileStart, m_uncompressedSize;
+        const unsigned char* m_pendingData;//points into m_window or m_batchOut
+        vector<unsigned char> m_inBuf, m_window;//m_window is also the circular output buffer for inflate
+        vector<unsigned char> m_batchOut;
+        vector<vector<unsigned char> > m_memberData;
+        vector<AccessPoint> m_index;
+        //writing
+        int64_t m_writeTotal;
+        vector<unsigned char> m_writeBuf;
+        vector<vector<unsigned char> > m_compressed[2];//so that the previous batch can be written while the current batch is compressed
+        int64_t m_numCompressed[2];
+        int m_curCompressed;
+        const static int64_t CHUNK_SIZE, INDEX_SPAN, IN_BUF_SIZE, WINDOW_SIZE, MEMBER_SIZE, MAX_MEMBER_OUTPUT, MEMBERS_PER_THREAD;
+        const static int MEMBER_HEADER_SIZE;
+        static int getNumThreads();
+        void openRead();
+        bool ensureInput(const int64_t& count);
+        void readCompressed(unsigned char* dataOut, const int64_t& count);
+        void setInputPos(const int64_t& position);
+        int64_t compressedPos() const { return m_inBufFileStart + (m_strm.next_in - m_inBuf.data()); }
+        int64_t peekMemberSize();
+        void inflateMore(const int64_t& wanted);
+        bool inflateMembers(const int64_t& wanted);
+        int64_t skipMembers(const int64_t& maxSkip);
+        void endOfMember();
+        void checkNextMember();
+        void addAccessPoint(const bool& memberStart);
+        void restoreAccessPoint(const AccessPoint& point);
+        int64_t readInternal(char* dataOut, const int64_t& count);//NULL dataOut discards
+        QString getIndexFileName() const { return m_fileName + ".gzidx"; }
+        void loadIndex();
+        void saveIndex();
+        static void compressMember(const unsigned char* dataIn, const int64_t& count, vector<unsigned char>& memberOut);
+        void flushWriteBuffer();
+        void compressBatch(const unsigned char* data, const int64_t& count);
+        void writeCompressed(const int& which);
     public:
-        ZFileImpl() { m_zfile = NULL; }
+        ZFileImpl();
         void open(const QString& filename, const CaretBinaryFile::OpenMode& opmode);
         void close();
         void seek(const int64_t& position);
@@ -58,6 +111,13 @@ namespace caret
     };
     
     const int64_t ZFileImpl::CHUNK_SIZE = 1<<26;//64MiB, large enough for good performance, small enough for zlib, must convert to uint32
+    const int64_t ZFileImpl::INDEX_SPAN = 1<<22;//4MiB of uncompressed data between access points, so index memory is under 1% of the uncompressed size
+    const int64_t ZFileImpl::IN_BUF_SIZE = 1<<20;
+    const int64_t ZFileImpl::WINDOW_SIZE = 1<<15;//maximum deflate distance
+    const int64_t ZFileImpl::MEMBER_SIZE = 1<<20;//uncompressed data per gzip member we write, large enough that restarting the dictionary costs very little compression
+    const int64_t ZFileImpl::MAX_MEMBER_OUTPUT = 1<<26;//don't allocate batch output for tagged members claiming more than this, inflate them serially instead
+    const int64_t ZFileImpl::MEMBERS_PER_THREAD = 4;
+    const int ZFileImpl::MEMBER_HEADER_SIZE = 20;//10 byte gzip header, 2 byte extra length, 8 byte "WB" subfield
 #endif //ZLIB_VERSION
 
     class QFileImpl : public CaretBinaryFile::ImplInterface
@@ -71,11 +131,14 @@ namespace caret
         int64_t pos();
         void read(void* dataOut, const int64_t& count, int64_t* numRead);
         void write(const void* dataIn, const int64_t& count);
+        const char* mapReadOnly(const int64_t& offset, const int64_t& size);
     };
     
     const int64_t QFileImpl::CHUNK_SIZE = 1<<30;//1GiB, QT4 apparently chokes at more than 2GiB via buffer.read using int32
 }
 
+bool CaretBinaryFile::s_gzipIndexCaching = false;
+
 CaretBinaryFile::ImplInterface::~ImplInterface()
 {
 }
@@ -154,67 +217,584 @@ void CaretBinaryFile::write(const void* dataIn, const int64_t& count)
     m_impl->write(dataIn, count);
 }
 
+const char* CaretBinaryFile::mapReadOnly(const int64_t& offset, const int64_t& size)
+{
+    CaretAssert(offset >= 0 && size > 0);
+    if (!getOpenForRead()) throw DataFileException("file is not open for reading");
+    return m_impl->mapReadOnly(offset, size);
+}
+
+void CaretBinaryFile::setGzipIndexCaching(const bool& enabled)
+{
+    s_gzipIndexCaching = enabled;
+}
+
+bool CaretBinaryFile::getGzipIndexCaching()
+{
+    return s_gzipIndexCaching;
+}
+
 #ifdef ZLIB_VERSION
+namespace
+{
+    void putLE32(unsigned char* out, const uint32_t& value)
+    {
+        out[0] = value & 0xff;
+        out[1] = (value >> 8) & 0xff;
+        out[2] = (value >> 16) & 0xff;
+        out[3] = (value >> 24) & 0xff;
+    }
+    
+    uint32_t getLE32(const unsigned char* in)
+    {
+        return ((uint32_t)in[0]) | (((uint32_t)in[1]) << 8) | (((uint32_t)in[2]) << 16) | (((uint32_t)in[3]) << 24);
+    }
+}
+
+ZFileImpl::ZFileImpl()
+{
+    m_writing = false;
+    m_strmInit = false;
+    m_plain = false;
+    m_rawDeflate = false;
+    m_atEnd = false;
+    m_atMemberStart = false;
+    m_indexComplete = false;
+    m_pos = 0;
+    m_outTotal = 0;
+    m_pending = 0;
+    m_pendingData = NULL;
+    m_inBufFileStart = 0;
+    m_uncompressedSize = -1;
+    m_writeTotal = 0;
+    m_numCompressed[0] = 0;
+    m_numCompressed[1] = 0;
+    m_curCompressed = 0;
+}
+
+int ZFileImpl::getNumThreads()
+{
+#ifdef CARET_OMP
+    return max(1, omp_get_max_threads());
+#else
+    return 1;
+#endif
+}
+
 void ZFileImpl::open(const QString& filename, const CaretBinaryFile::OpenMode& opmode)
 {
     close();//don't need to, but just because
     m_fileName = filename;
-    const char* mode = NULL;
-    switch (opmode)//we only support a limited number of combinations, and the string modes are quirky
+    switch (opmode)//we only support a limited number of combinations
     {
         case CaretBinaryFile::READ:
-            mode = "rb";
-            break;
+            openRead();
+            return;
         case CaretBinaryFile::WRITE_TRUNCATE:
-            mode = "wb";//you have to do "r+b" in order to ask it to not truncate, which zlib doesn't support anyway
             break;
         default:
             throw DataFileException("compressed file only supports READ and WRITE_TRUNCATE modes");
     }
-#if !defined(CARET_OS_MACOSX) && ZLIB_VERNUM > 0x1232
-    m_zfile = gzopen64(filename.toLocal8Bit().constData(), mode);
-#else
-    m_zfile = gzopen(filename.toLocal8Bit().constData(), mode);
-#endif
-    if (m_zfile == NULL)
+    m_rawFile.setFileName(filename);
+    if (!m_rawFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
     {
-        if (!QFile::exists(filename))
+        throw DataFileException("failed to open compressed file '" + filename + "', unable to create file");
+    }
+    m_writing = true;
+    m_writeTotal = 0;
+}
+
+void ZFileImpl::openRead()
+{
+    m_rawFile.setFileName(m_fileName);
+    if (!m_rawFile.open(QIODevice::ReadOnly))
+    {
+        if (!m_rawFile.exists())
         {
-            if (!(opmode & CaretBinaryFile::TRUNCATE))
+            throw DataFileException("failed to open compressed file '" + m_fileName + "', file does not exist, or folder permissions prevent seeing it");
+        }
+        throw DataFileException("failed to open compressed file '" + m_fileName + "'");
+    }
+    m_inBuf.resize(IN_BUF_SIZE);
+    m_window.assign(WINDOW_SIZE, 0);//zeros are fine as a dictionary before the start of the stream, since nothing can refer to it
+    m_strm.zalloc = Z_NULL;
+    m_strm.zfree = Z_NULL;
+    m_strm.opaque = Z_NULL;
+    m_strm.next_in = m_inBuf.data();
+    m_strm.avail_in = 0;
+    m_inBufFileStart = 0;
+    if (!ensureInput(2) || m_strm.next_in[0] != 0x1f || m_strm.next_in[1] != 0x8b)
+    {//like gzread, read files without the gzip magic as uncompressed
+        m_plain = true;
+        if (!m_rawFile.seek(0)) throw DataFileException("seek failed in file '" + m_fileName + "'");
+        return;
+    }
+    if (inflateInit2(&m_strm, 15 + 32) != Z_OK) throw DataFileException("failed to initialize zlib for reading compressed file '" + m_fileName + "'");//15 + 32 means max window, autodetect header
+    m_strmInit = true;
+    m_rawDeflate = false;
+    m_atMemberStart = true;
+    m_strm.next_out = m_window.data();
+    m_strm.avail_out = 0;//window is "full", so the first inflate starts at the beginning
+    AccessPoint start;
+    start.m_uncompressedOffset = 0;
+    start.m_compressedOffset = 0;
+    start.m_bits = 0;
+    start.m_memberStart = true;
+    m_index.push_back(start);
+    if (CaretBinaryFile::getGzipIndexCaching()) loadIndex();
+}
+
+bool ZFileImpl::ensureInput(const int64_t& count)
+{
+    CaretAssert(count <= IN_BUF_SIZE);
+    if (m_strm.avail_in >= count) return true;
+    int64_t remaining = m_strm.avail_in;
+    if (remaining > 0) memmove(m_inBuf.data(), m_strm.next_in, remaining);
+    m_inBufFileStart = compressedPos();
+    m_strm.next_in = m_inBuf.data();
+    while (remaining < count)
+    {
+        int64_t readret = m_rawFile.read((char*)m_inBuf.data() + remaining, IN_BUF_SIZE - remaining);
+        if (readret < 0) throw DataFileException("error while reading compressed file '" + m_fileName + "'");
+        if (readret == 0) break;
+        remaining += readret;
+    }
+    m_strm.avail_in = remaining;
+    return remaining >= count;
+}
+
+void ZFileImpl::readCompressed(unsigned char* dataOut, const int64_t& count)
+{//for whole members, which can be larger than the input buffer
+    int64_t fromBuffer = min(count, (int64_t)m_strm.avail_in);
+    memcpy(dataOut, m_strm.next_in, fromBuffer);
+    m_strm.next_in += fromBuffer;
+    m_strm.avail_in -= fromBuffer;
+    if (fromBuffer == count) return;
+    int64_t total = fromBuffer;
+    while (total < count)
+    {
+        int64_t readret = m_rawFile.read((char*)dataOut + total, count - total);
+        if (readret < 0) throw DataFileException("error while reading compressed file '" + m_fileName + "'");
+        if (readret == 0) throw DataFileException("premature end of file in compressed file '" + m_fileName + "'");
+        total += readret;
+    }
+    m_inBufFileStart = m_rawFile.pos();//buffer is empty
+    m_strm.next_in = m_inBuf.data();
+}
+
+void ZFileImpl::setInputPos(const int64_t& position)
+{
+    int64_t bufferEnd = compressedPos() + m_strm.avail_in;
+    if (position >= m_inBufFileStart && position <= bufferEnd)
+    {//already in the buffer
+        m_strm.next_in = m_inBuf.data() + (position - m_inBufFileStart);
+        m_strm.avail_in = bufferEnd - position;
+        return;
+    }
+    if (!m_rawFile.seek(position)) throw DataFileException("seek failed in compressed file '" + m_fileName + "'");
+    m_inBufFileStart = position;
+    m_strm.next_in = m_inBuf.data();
+    m_strm.avail_in = 0;
+}
+
+int64_t ZFileImpl::peekMemberSize()
+{//members we write have their total compressed size in a "WB" extra subfield, so we can find them without inflating, returns -1 if not present
+    if (!ensureInput(12)) return -1;
+    const unsigned char* header = m_strm.next_in;
+    if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || !(header[3] & 4)) return -1;//4 is FEXTRA
+    int64_t extraEnd = 12 + (header[10] | (header[11] << 8));
+    if (!ensureInput(extraEnd)) return -1;
+    header = m_strm.next_in;//ensureInput can move things
+    int64_t subfield = 12;
+    while (subfield + 4 <= extraEnd)
+    {
+        int64_t subLength = header[subfield + 2] | (header[subfield + 3] << 8);
+        if (header[subfield] == 'W' && header[subfield + 1] == 'B' && subLength == 4 && subfield + 8 <= extraEnd)
+        {
+            int64_t memberSize = getLE32(header + subfield + 4);
+            if (memberSize < extraEnd + 8) return -1;//not even room for the trailer, let inflate complain about it
+            return memberSize;
+        }
+        subfield += 4 + subLength;
+    }
+    return -1;
+}
+
+void ZFileImpl::inflateMore(const int64_t& wanted)
+{
+    CaretAssert(m_pending == 0 && !m_atEnd);
+    if (m_atMemberStart && inflateMembers(wanted)) return;
+    if (!ensureInput(1))
+    {//truncated file, give the caller what we have, like gzread
+        m_atEnd = true;
+        return;
+    }
+    m_atMemberStart = false;
+    if (m_strm.avail_out == 0)
+    {
+        m_strm.next_out = m_window.data();
+        m_strm.avail_out = WINDOW_SIZE;
+    }
+    unsigned char* outStart = m_strm.next_out;
+    int ret = inflate(&m_strm, Z_BLOCK);//stop at block boundaries so we can add access points
+    m_pendingData = outStart;
+    m_pending = m_strm.next_out - outStart;
+    m_outTotal += m_pending;
+    if (ret == Z_STREAM_END)
+    {
+        endOfMember();
+        return;
+    }
+    if (ret != Z_OK)
+    {
+        AString msg = "error decompressing file '" + m_fileName + "'";
+        if (m_strm.msg != NULL) msg += ": " + AString(m_strm.msg);
+        throw DataFileException(msg);
+    }
+    if ((m_strm.data_type & 128) && !(m_strm.data_type & 64) && !m_indexComplete &&
+        m_outTotal - m_index.back().m_uncompressedOffset >= INDEX_SPAN)
+    {//at the end of a block that isn't the last, and far enough past the last point
+        addAccessPoint(false);
+    }
+}
+
+bool ZFileImpl::inflateMembers(const int64_t& wanted)
+{//decode a batch of tagged members at once, each with its own inflate, in parallel
+    int64_t memberSize = peekMemberSize();
+    if (memberSize < 0) return false;
+    int64_t maxMembers = MEMBERS_PER_THREAD * getNumThreads();
+    vector<int64_t> outOffsets(1, 0);
+    int64_t numMembers = 0;
+    while (true)
+    {
+        if ((int64_t)m_memberData.size() <= numMembers) m_memberData.resize(numMembers + 1);
+        vector<unsigned char>& thisMember = m_memberData[numMembers];
+        if (numMembers > 0 && !m_indexComplete && m_outTotal > m_index.back().m_uncompressedOffset) addAccessPoint(true);
+        int64_t memberStart = compressedPos();
+        setInputPos(memberStart + memberSize - 4);//check the trailer before reading the member, so an oversized one stays in the input
+        if (!ensureInput(4)) throw DataFileException("premature end of file in compressed file '" + m_fileName + "'");
+        int64_t memberOutput = getLE32(m_strm.next_in);
+        setInputPos(memberStart);
+        if (memberOutput > MAX_MEMBER_OUTPUT) break;//the normal inflate path handles it, without trusting its size for an output buffer
+        thisMember.resize(memberSize);
+        readCompressed(thisMember.data(), memberSize);
+        outOffsets.push_back(outOffsets.back() + memberOutput);
+        m_outTotal += memberOutput;
+        ++numMembers;
+        if (numMembers >= maxMembers || outOffsets.back() >= wanted) break;
+        memberSize = peekMemberSize();
+        if (memberSize < 0) break;
+    }
+    if (numMembers == 0) return false;
+    m_batchOut.resize(outOffsets.back());
+    bool failed = false;
+#pragma omp CARET_PARFOR schedule(dynamic) if (numMembers > 1)
+    for (int64_t i = 0; i < numMembers; ++i)
+    {
+        z_stream memberStrm;
+        memberStrm.zalloc = Z_NULL;
+        memberStrm.zfree = Z_NULL;
+        memberStrm.opaque = Z_NULL;
+        memberStrm.next_in = m_memberData[i].data();
+        memberStrm.avail_in = m_memberData[i].size();
+        bool success = false;
+        if (inflateInit2(&memberStrm, 15 + 16) == Z_OK)//16 means gzip header, so zlib checks the crc
+        {
+            unsigned char dummy;//inflate rejects NULL next_out, which an empty vector might give
+            int64_t outSize = outOffsets[i + 1] - outOffsets[i];
+            memberStrm.next_out = (outSize > 0 ? m_batchOut.data() + outOffsets[i] : &dummy);
+            memberStrm.avail_out = outSize;
+            int ret = inflate(&memberStrm, Z_FINISH);
+            success = (ret == Z_STREAM_END && memberStrm.avail_out == 0 && memberStrm.avail_in == 0);
+            inflateEnd(&memberStrm);
+        }
+        if (!success)
+        {
+#pragma omp critical
+            failed = true;
+        }
+    }
+    if (failed) throw DataFileException("error decompressing file '" + m_fileName + "'");
+    m_pendingData = m_batchOut.data();
+    m_pending = outOffsets.back();
+    checkNextMember();
+    return true;
+}
+
+int64_t ZFileImpl::skipMembers(const int64_t& maxSkip)
+{//for seeking forward, whole tagged members can be skipped using only their trailers
+    CaretAssert(m_pending == 0);
+    int64_t skipped = 0;
+    while (m_atMemberStart && !m_atEnd)
+    {
+        int64_t memberSize = peekMemberSize();
+        if (memberSize < 0) break;
+        int64_t memberStart = compressedPos();
+        setInputPos(memberStart + memberSize - 4);
+        if (!ensureInput(4)) throw DataFileException("premature end of file in compressed file '" + m_fileName + "'");
+        int64_t memberOutput = getLE32(m_strm.next_in);
+        if (memberOutput > maxSkip - skipped || memberOutput > MAX_MEMBER_OUTPUT)
+        {
+            setInputPos(memberStart);
+            break;
+        }
+        m_strm.next_in += 4;
+        m_strm.avail_in -= 4;
+        m_outTotal += memberOutput;
+        m_pos += memberOutput;
+        skipped += memberOutput;
+        checkNextMember();
+    }
+    return skipped;
+}
+
+void ZFileImpl::endOfMember()
+{
+    if (m_rawDeflate)
+    {//when started from an access point, inflate doesn't know about the crc and length trailer
+        if (!ensureInput(8))
+        {
+            m_atEnd = true;
+            return;
+        }
+        m_strm.next_in += 8;
+        m_strm.avail_in -= 8;
+    }
+    checkNextMember();
+}
+
+void ZFileImpl::checkNextMember()
+{
+    if (ensureInput(2) && m_strm.next_in[0] == 0x1f && m_strm.next_in[1] == 0x8b)
+    {//concatenated gzip members are one file
+        if (inflateReset2(&m_strm, 15 + 32) != Z_OK) throw DataFileException("failed to reset zlib while reading compressed file '" + m_fileName + "'");
+        m_rawDeflate = false;
+        m_atMemberStart = true;
+        if (!m_indexComplete && m_outTotal > m_index.back().m_uncompressedOffset) addAccessPoint(true);
+        return;
+    }
+    m_atEnd = true;//like gzread, ignore trailing garbage
+    if (!m_indexComplete)
+    {//we only add points going forward from the previous last point, so reaching the end means the index covers the whole file
+        m_indexComplete = true;
+        m_uncompressedSize = m_outTotal;
+        if (CaretBinaryFile::getGzipIndexCaching()) saveIndex();
+    }
+}
+
+void ZFileImpl::addAccessPoint(const bool& memberStart)
+{
+    AccessPoint newPoint;
+    newPoint.m_uncompressedOffset = m_outTotal;
+    newPoint.m_compressedOffset = compressedPos();
+    newPoint.m_memberStart = memberStart;
+    newPoint.m_bits = 0;
+    if (!memberStart)
+    {
+        newPoint.m_bits = m_strm.data_type & 7;
+        newPoint.m_window.resize(WINDOW_SIZE);
+        int64_t oldestStart = WINDOW_SIZE - m_strm.avail_out;//circular buffer, the oldest byte is where inflate writes next
+        memcpy(newPoint.m_window.data(), m_window.data() + oldestStart, WINDOW_SIZE - oldestStart);
+        memcpy(newPoint.m_window.data() + WINDOW_SIZE - oldestStart, m_window.data(), oldestStart);
+    }
+    m_index.push_back(newPoint);
+}
+
+void ZFileImpl::restoreAccessPoint(const AccessPoint& point)
+{
+    int64_t seekTo = point.m_compressedOffset;
+    if (point.m_bits != 0) --seekTo;
+    setInputPos(seekTo);
+    int ret;
+    if (point.m_memberStart)
+    {
+        ret = inflateReset2(&m_strm, 15 + 32);
+        m_rawDeflate = false;
+    } else {
+        ret = inflateReset2(&m_strm, -15);//raw deflate, no header
+        m_rawDeflate = true;
+        if (ret == Z_OK && point.m_bits != 0)
+        {
+            if (!ensureInput(1)) throw DataFileException("premature end of file in compressed file '" + m_fileName + "'");
+            int partial = m_strm.next_in[0];
+            ++m_strm.next_in;
+            --m_strm.avail_in;
+            ret = inflatePrime(&m_strm, point.m_bits, partial >> (8 - point.m_bits));
+        }
+        if (ret == Z_OK) ret = inflateSetDictionary(&m_strm, point.m_window.data(), WINDOW_SIZE);
+        memcpy(m_window.data(), point.m_window.data(), WINDOW_SIZE);
+    }
+    if (ret != Z_OK) throw DataFileException("failed to restart zlib while seeking in compressed file '" + m_fileName + "'");
+    m_strm.next_out = m_window.data();
+    m_strm.avail_out = 0;//the window is in order, so the oldest byte is at the start
+    m_pending = 0;
+    m_outTotal = point.m_uncompressedOffset;
+    m_pos = m_outTotal;
+    m_atEnd = false;
+    m_atMemberStart = point.m_memberStart;
+}
+
+int64_t ZFileImpl::readInternal(char* dataOut, const int64_t& count)
+{
+    int64_t total = 0;
+    while (total < count)
+    {
+        if (m_pending > 0)
+        {
+            int64_t toCopy = min(m_pending, count - total);
+            if (dataOut != NULL) memcpy(dataOut + total, m_pendingData, toCopy);
+            m_pendingData += toCopy;
+            m_pending -= toCopy;
+            m_pos += toCopy;
+            total += toCopy;
+        } else {
+            if (m_atEnd) break;
+            if (dataOut == NULL)
             {
-                throw DataFileException("failed to open compressed file '" + filename + "', file does not exist, or folder permissions prevent seeing it");
-            } else {//use same logic as QFile impl for now
-                throw DataFileException("failed to open compressed file '" + filename + "', unable to create file");
+                total += skipMembers(count - total);
+                if (total == count || m_atEnd) break;
             }
-        }//TODO: check gzerror and errno for more informative error messages
-        throw DataFileException("failed to open compressed file '" + filename + "'");
+            inflateMore(count - total);
+        }
+    }
+    return total;
+}
+
+void ZFileImpl::loadIndex()
+{
+    QFile indexFile(getIndexFileName());
+    if (!indexFile.open(QIODevice::ReadOnly)) return;
+    QFileInfo dataInfo(m_fileName);
+    QDataStream myStream(&indexFile);
+    quint32 magic = 0, version = 0;
+    qint64 compressedSize = 0, modTime = 0, span = 0, uncompressedSize = 0, numPoints = 0;
+    myStream >> magic >> version >> compressedSize >> modTime >> span >> uncompressedSize >> numPoints;
+    if (myStream.status() != QDataStream::Ok || magic != 0x575A4958 || version != 1 || compressedSize != dataInfo.size() ||
+        modTime != (qint64)dataInfo.lastModified().toTime_t() || span != INDEX_SPAN || numPoints < 1)
+    {
+        CaretLogFine("ignoring stale or unrecognized gzip index file '" + getIndexFileName() + "'");
+        return;
+    }
+    vector<AccessPoint> newIndex(numPoints);
+    for (qint64 i = 0; i < numPoints; ++i)
+    {
+        qint64 uncompOffset = 0, compOffset = 0;
+        qint32 bits = 0;
+        bool memberStart = false;
+        myStream >> uncompOffset >> compOffset >> bits >> memberStart;
+        newIndex[i].m_uncompressedOffset = uncompOffset;
+        newIndex[i].m_compressedOffset = compOffset;
+        newIndex[i].m_bits = bits;
+        newIndex[i].m_memberStart = memberStart;
+        if (!memberStart)
+        {
+            newIndex[i].m_window.resize(WINDOW_SIZE);
+            if (myStream.readRawData((char*)newIndex[i].m_window.data(), WINDOW_SIZE) != WINDOW_SIZE) break;
+        }
+        if (myStream.status() != QDataStream::Ok || bits < 0 || bits > 7) break;
+        if (i == 0 ? uncompOffset != 0 : uncompOffset <= newIndex[i - 1].m_uncompressedOffset) break;
+        if (i + 1 == numPoints)
+        {
+            m_index.swap(newIndex);
+            m_indexComplete = true;
+            m_uncompressedSize = uncompressedSize;
+            return;
+        }
+    }
+    CaretLogFine("ignoring corrupt gzip index file '" + getIndexFileName() + "'");
+}
+
+void ZFileImpl::saveIndex()
+{//the index is only a cache, so failures here are not errors
+    QFile indexFile(getIndexFileName());
+    if (!indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        CaretLogFine("unable to write gzip index file '" + getIndexFileName() + "'");
+        return;
+    }
+    QFileInfo dataInfo(m_fileName);
+    QDataStream myStream(&indexFile);
+    myStream << (quint32)0x575A4958 << (quint32)1 << (qint64)dataInfo.size() << (qint64)dataInfo.lastModified().toTime_t()
+             << (qint64)INDEX_SPAN << (qint64)m_uncompressedSize << (qint64)m_index.size();
+    for (size_t i = 0; i < m_index.size(); ++i)
+    {
+        const AccessPoint& thisPoint = m_index[i];
+        myStream << (qint64)thisPoint.m_uncompressedOffset << (qint64)thisPoint.m_compressedOffset << (qint32)thisPoint.m_bits << thisPoint.m_memberStart;
+        if (!thisPoint.m_memberStart) myStream.writeRawData((const char*)thisPoint.m_window.data(), WINDOW_SIZE);
+    }
+    if (myStream.status() != QDataStream::Ok)
+    {
+        indexFile.close();
+        indexFile.remove();
+        CaretLogFine("failed writing gzip index file '" + getIndexFileName() + "'");
     }
 }
 
 void ZFileImpl::close()
 {
-    if (m_zfile == NULL) return;//happens when closed and then destroyed, error opening
-    if (gzclose(m_zfile) != 0) throw DataFileException("error closing compressed file '" + m_fileName + "'");
-    m_zfile = NULL;
+    if (m_writing)
+    {
+        m_writing = false;//don't try again from the destructor if this throws
+        if (m_writeTotal == 0)
+        {//an empty gzip file still needs a member
+            m_compressed[m_curCompressed].resize(1);
+            compressMember(NULL, 0, m_compressed[m_curCompressed][0]);
+            m_numCompressed[m_curCompressed] = 1;
+            m_curCompressed = 1 - m_curCompressed;
+        } else if (!m_writeBuf.empty()) {
+            flushWriteBuffer();
+        }
+        writeCompressed(1 - m_curCompressed);
+        if (!m_rawFile.flush()) throw DataFileException("error closing compressed file '" + m_fileName + "'");
+    }
+    if (m_strmInit)
+    {
+        inflateEnd(&m_strm);
+        m_strmInit = false;
+    }
+    m_rawFile.close();
+    m_plain = false;
+    m_atEnd = false;
+    m_atMemberStart = false;
+    m_indexComplete = false;
+    m_pos = 0;
+    m_outTotal = 0;
+    m_pending = 0;
+    m_uncompressedSize = -1;
+    m_index.clear();
+    m_inBuf.clear();
+    m_window.clear();
+    m_batchOut.clear();
+    m_memberData.clear();
+    m_writeTotal = 0;
+    m_writeBuf.clear();
+    m_compressed[0].clear();
+    m_compressed[1].clear();
+    m_numCompressed[0] = 0;
+    m_numCompressed[1] = 0;
 }
 
 void ZFileImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
 {
-    if (m_zfile == NULL) throw DataFileException("read called on unopened ZFileImpl");//shouldn't happen
+    if (!m_rawFile.isOpen() || m_writing) throw DataFileException("read called on ZFileImpl not opened for reading");//shouldn't happen
     int64_t totalRead = 0;
-    int readret = 0;//to preserve the info of the read that broke early
-    while (totalRead < count)
+    if (m_plain)
     {
-        int64_t iterSize = min(count - totalRead, CHUNK_SIZE);
-        readret = gzread(m_zfile, ((char*)dataOut) + totalRead, iterSize);
-        if (readret < 1) break;//0 or -1 indicate eof or error
-        totalRead += readret;
+        int64_t readret = 0;
+        while (totalRead < count)
+        {
+            readret = m_rawFile.read(((char*)dataOut) + totalRead, min(count - totalRead, CHUNK_SIZE));
+            if (readret < 1) break;
+            totalRead += readret;
+        }
+        if (readret < 0 && numRead == NULL) throw DataFileException("error while reading file '" + m_fileName + "'");
+    } else {
+        totalRead = readInternal((char*)dataOut, count);
     }
     if (numRead == NULL)
     {
         if (totalRead != count)
         {
-            if (readret < 0) throw DataFileException("error while reading compressed file '" + m_fileName + "'");
             throw DataFileException("premature end of file in compressed file '" + m_fileName + "'");
         }
     } else {
@@ -224,38 +804,187 @@ void ZFileImpl::read(void* dataOut, const int64_t& count, int64_t* numRead)
 
 void ZFileImpl::seek(const int64_t& position)
 {
-    if (m_zfile == NULL) throw DataFileException("seek called on unopened ZFileImpl");//shouldn't happen
-    if (pos() == position) return;//slight hack, since gzseek is slow or nonfunctional for some cases, so don't try it unless necessary
-#if !defined(CARET_OS_MACOSX) && ZLIB_VERNUM > 0x1232
-    int64_t ret = gzseek64(m_zfile, position, SEEK_SET);
-#else
-    int64_t ret = gzseek(m_zfile, position, SEEK_SET);
-#endif
-    if (ret != position) throw DataFileException("seek failed in compressed file '" + m_fileName + "'");
+    if (!m_rawFile.isOpen()) throw DataFileException("seek called on unopened ZFileImpl");//shouldn't happen
+    if (m_writing)
+    {//like gzseek, only forward, by writing zeros
+        if (position < m_writeTotal) throw DataFileException("seek failed in compressed file '" + m_fileName + "', can't seek backwards while writing");
+        vector<char> zeros(min(position - m_writeTotal, MEMBER_SIZE), 0);
+        while (m_writeTotal < position)
+        {
+            write(zeros.data(), min(position - m_writeTotal, (int64_t)zeros.size()));
+        }
+        return;
+    }
+    if (m_plain)
+    {
+        if (!m_rawFile.seek(position)) throw DataFileException("seek failed in file '" + m_fileName + "'");
+        return;
+    }
+    if (position == m_pos) return;
+    if (m_indexComplete && position > m_uncompressedSize) throw DataFileException("seek failed in compressed file '" + m_fileName + "'");
+    int64_t low = 0, high = m_index.size();//find the last point at or before position
+    while (high - low > 1)
+    {
+        int64_t guess = (low + high) / 2;
+        if (m_index[guess].m_uncompressedOffset > position)
+        {
+            high = guess;
+        } else {
+            low = guess;
+        }
+    }
+    if (position < m_pos || m_pos < m_index[low].m_uncompressedOffset)
+    {//if we are already between the best point and the target, keep going instead
+        restoreAccessPoint(m_index[low]);
+    }
+    int64_t toSkip = position - m_pos;
+    if (readInternal(NULL, toSkip) != toSkip) throw DataFileException("seek failed in compressed file '" + m_fileName + "'");
 }
 
 int64_t ZFileImpl::pos()
 {
-    if (m_zfile == NULL) throw DataFileException("pos called on unopened ZFileImpl");//shouldn't happen
-#if !defined(CARET_OS_MACOSX) && ZLIB_VERNUM > 0x1232
-    return gztell64(m_zfile);
-#else
-    return gztell(m_zfile);
-#endif
+    if (!m_rawFile.isOpen()) throw DataFileException("pos called on unopened ZFileImpl");//shouldn't happen
+    if (m_writing) return m_writeTotal;
+    if (m_plain) return m_rawFile.pos();
+    return m_pos;
 }
 
 void ZFileImpl::write(const void* dataIn, const int64_t& count)
 {
-    if (m_zfile == NULL) throw DataFileException("read called on unopened ZFileImpl");//shouldn't happen
-    int64_t totalWritten = 0;
-    while (totalWritten < count)
+    if (!m_writing) throw DataFileException("write called on ZFileImpl not opened for writing");//shouldn't happen
+    const unsigned char* data = (const unsigned char*)dataIn;
+    int64_t batchSize = MEMBER_SIZE * MEMBERS_PER_THREAD * getNumThreads();
+    int64_t total = 0;
+    while (total < count)
     {
-        int64_t iterSize = min(count - totalWritten, CHUNK_SIZE);
-        int writeret = gzwrite(m_zfile, ((const char*)dataIn) + totalWritten, iterSize);
-        if (writeret < 1) break;//0 or -1 indicate eof or error
-        totalWritten += writeret;
+        if (m_writeBuf.empty() && count - total >= batchSize)
+        {//compress large writes directly from the caller's memory
+            compressBatch(data + total, batchSize);
+            total += batchSize;
+            m_writeTotal += batchSize;
+            continue;
+        }
+        int64_t toCopy = min(count - total, batchSize - (int64_t)m_writeBuf.size());
+        m_writeBuf.insert(m_writeBuf.end(), data + total, data + total + toCopy);
+        total += toCopy;
+        m_writeTotal += toCopy;
+        if ((int64_t)m_writeBuf.size() == batchSize) flushWriteBuffer();
     }
-    if (totalWritten != count) throw DataFileException("failed to write to compressed file '" + m_fileName + "'");
+}
+
+void ZFileImpl::flushWriteBuffer()
+{
+    compressBatch(m_writeBuf.data(), m_writeBuf.size());
+    m_writeBuf.clear();
+}
+
+void ZFileImpl::compressBatch(const unsigned char* data, const int64_t& count)
+{//compress into the current set of members while the previous set is written, same pattern as CiftiRowPipeline
+    int which = m_curCompressed;
+    int64_t numMembers = (count + MEMBER_SIZE - 1) / MEMBER_SIZE;
+    if ((int64_t)m_compressed[which].size() < numMembers) m_compressed[which].resize(numMembers);
+    m_numCompressed[which] = numMembers;
+    bool failed = false;
+    AString failMessage;
+#pragma omp CARET_PAR
+    {
+#pragma omp CARET_SINGLE nowait
+        {
+            try
+            {
+                writeCompressed(1 - which);
+            } catch (CaretException& e) {
+#pragma omp critical
+                {
+                    if (!failed) failMessage = e.whatString();
+                    failed = true;
+                }
+            } catch (exception& e) {
+#pragma omp critical
+                {
+                    if (!failed) failMessage = e.what();
+                    failed = true;
+                }
+            }
+        }
+#pragma omp CARET_FOR schedule(dynamic) nowait
+        for (int64_t i = 0; i < numMembers; ++i)
+        {
+            try
+            {
+                compressMember(data + i * MEMBER_SIZE, min(MEMBER_SIZE, count - i * MEMBER_SIZE), m_compressed[which][i]);
+            } catch (CaretException& e) {
+#pragma omp critical
+                {
+                    if (!failed) failMessage = e.whatString();
+                    failed = true;
+                }
+            } catch (exception& e) {
+#pragma omp critical
+                {
+                    if (!failed) failMessage = e.what();
+                    failed = true;
+                }
+            }
+        }
+    }
+    if (failed) throw DataFileException(failMessage);
+    m_curCompressed = 1 - which;
+}
+
+void ZFileImpl::writeCompressed(const int& which)
+{
+    for (int64_t i = 0; i < m_numCompressed[which]; ++i)
+    {
+        const vector<unsigned char>& member = m_compressed[which][i];
+        if (m_rawFile.write((const char*)member.data(), member.size()) != (int64_t)member.size())
+        {
+            throw DataFileException("failed to write to compressed file '" + m_fileName + "'");
+        }
+    }
+    m_numCompressed[which] = 0;
+}
+
+void ZFileImpl::compressMember(const unsigned char* dataIn, const int64_t& count, vector<unsigned char>& memberOut)
+{//a complete gzip member, with its total size in the header so readers can find the next one without inflating
+    z_stream deflStrm;
+    deflStrm.zalloc = Z_NULL;
+    deflStrm.zfree = Z_NULL;
+    deflStrm.opaque = Z_NULL;
+    if (deflateInit2(&deflStrm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)//same settings as gzopen "wb", but raw so we can write our own header
+    {
+        throw DataFileException("failed to initialize zlib compression");
+    }
+    int64_t bound = deflateBound(&deflStrm, count);
+    memberOut.resize(MEMBER_HEADER_SIZE + bound + 8);
+    unsigned char* header = memberOut.data();
+    deflStrm.next_in = (Bytef*)dataIn;
+    deflStrm.avail_in = count;
+    deflStrm.next_out = header + MEMBER_HEADER_SIZE;
+    deflStrm.avail_out = bound;
+    int ret = deflate(&deflStrm, Z_FINISH);
+    int64_t deflatedSize = deflStrm.total_out;
+    deflateEnd(&deflStrm);
+    if (ret != Z_STREAM_END) throw DataFileException("zlib compression failed");
+    int64_t memberSize = MEMBER_HEADER_SIZE + deflatedSize + 8;
+    header[0] = 0x1f;//magic
+    header[1] = 0x8b;
+    header[2] = 8;//deflate
+    header[3] = 4;//FEXTRA
+    putLE32(header + 4, 0);//no mtime
+    header[8] = 0;//extra flags
+    header[9] = 255;//unknown OS
+    header[10] = 8;//extra field length
+    header[11] = 0;
+    header[12] = 'W';//subfield ID
+    header[13] = 'B';
+    header[14] = 4;//subfield length
+    header[15] = 0;
+    putLE32(header + 16, memberSize);
+    unsigned char* trailer = header + MEMBER_HEADER_SIZE + deflatedSize;
+    putLE32(trailer, crc32(crc32(0, Z_NULL, 0), dataIn, count));
+    putLE32(trailer + 4, count);
+    memberOut.resize(memberSize);
 }
 
 ZFileImpl::~ZFileImpl()
@@ -361,3 +1090,19 @@ void QFileImpl::write(const void* dataIn, const int64_t& count)
                          + " bytes.");
     if (total != count) throw DataFileException(msg);
 }
+
+const char* QFileImpl::mapReadOnly(const int64_t& offset, const int64_t& size)
+{
+    if (sizeof(void*) < 8 && size > (((int64_t)1) << 30)) return NULL;//don't try to eat most of a 32-bit address space
+    if (offset < 0 || size < 1 || m_file.size() < offset + size)
+    {//on unix, QFile maps a range past the end of the file anyway, and touching those pages raises SIGBUS, so let the read path report the short file
+        CaretLogFine("file '" + m_fileName + "' is shorter than the range to memory map, falling back to reading");
+        return NULL;
+    }
+    uchar* ret = m_file.map(offset, size);//QFile unmaps everything when closed
+    if (ret == NULL)
+    {
+        CaretLogFine("unable to memory map file '" + m_fileName + "', falling back to reading");
+    }
+    return (const char*)ret;
+}
@@ -55,6 +55,10 @@ namespace caret {
         int64_t pos();
         void read(void* dataOut, const int64_t& count, int64_t* numRead = NULL);//throw if numRead is NULL and (error or end of file reached early)
         void write(const void* dataIn, const int64_t& count);//failure to complete write is always an exception
+        const char* mapReadOnly(const int64_t& offset, const int64_t& size);//returns NULL if the file can't be mapped (compressed, not enough address space, shorter than the range, etc), mapping is valid until close
+        ///when enabled, the seek index built while reading a .gz file is saved as <filename>.gzidx once it covers the whole file, and reused by later opens
+        static void setGzipIndexCaching(const bool& enabled);
+        static bool getGzipIndexCaching();
         class ImplInterface
         {
         protected:
@@ -67,11 +71,13 @@ namespace caret {
             virtual int64_t pos() = 0;
             virtual void read(void* dataOut, const int64_t& count, int64_t* numRead) = 0;
             virtual void write(const void* dataIn, const int64_t& count) = 0;
+            virtual const char* mapReadOnly(const int64_t&, const int64_t&) { return NULL; }//default is to not support mapping
             virtual ~ImplInterface();
         };
     private:
         CaretPointer<ImplInterface> m_impl;
         OpenMode m_curMode;//so implementation classes don't have to track it
+        static bool s_gzipIndexCaching;
     };
 } //namespace caret
 
@@ -22,7 +22,9 @@
 #include "CaretException.h"
 #include "CaretLogger.h"
 #include "CaretMathExpression.h"
+#include "CaretOMP.h"
 
+#include <algorithm>
 #include <cmath>
 
 using namespace caret;
@@ -39,6 +41,8 @@ CaretMathExpression::CaretMathExpression(const AString& expression)
         throw CaretException("extra characters on end of expression input: '" + m_input.mid(m_position) + "'");
     }
     CaretLogFiner("parsed '" + expression + "' as '" + toString() + "'");
+    m_numRegisters = 0;
+    compile(*m_root, 0);
 }
 
 double CaretMathExpression::evaluate(const vector<float>& variableValues) const
@@ -47,6 +51,341 @@ double CaretMathExpression::evaluate(const vector<float>& variableValues) const
     return m_root->eval(variableValues);
 }
 
+namespace
+{
+    const int EVAL_BLOCK_SIZE = 4096;//elements per register, so the registers for typical expressions stay in cache
+}
+
+void CaretMathExpression::evaluate(const vector<const float*>& variableData, const int64_t& numElements, float* dataOut) const
+{
+    evaluate(variableData, vector<int64_t>(variableData.size(), 1), numElements, dataOut);
+}
+
+void CaretMathExpression::evaluate(const vector<const float*>& variableData, const vector<int64_t>& variableStrides, const int64_t& numElements, float* dataOut) const
+{
+    CaretAssert(variableData.size() == m_varNames.size());
+    CaretAssert(variableStrides.size() == m_varNames.size());
+    int64_t numBlocks = (numElements + EVAL_BLOCK_SIZE - 1) / EVAL_BLOCK_SIZE;
+#pragma omp CARET_PAR if (numBlocks > 1)
+    {
+        vector<double> registers(m_numRegisters * EVAL_BLOCK_SIZE);
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t block = 0; block < numBlocks; ++block)
+        {
+            int64_t start = block * EVAL_BLOCK_SIZE;
+            int count = (int)min((int64_t)EVAL_BLOCK_SIZE, numElements - start);
+            runProgram(variableData, variableStrides, start, count, registers.data());
+            for (int i = 0; i < count; ++i)
+            {
+                dataOut[start + i] = (float)registers[i];//result is always in the first register
+            }
+        }
+    }
+}
+
+void CaretMathExpression::compile(const MathNode& node, const int& dest)
+{//registers are used like a stack, arguments of a node go into the registers after its destination
+    if (dest + 1 > m_numRegisters) m_numRegisters = dest + 1;
+    int numArgs = (int)node.m_arguments.size();
+    switch (node.m_type)
+    {
+        case MathNode::OR:
+        case MathNode::AND:
+        case MathNode::EQUAL:
+        case MathNode::GREATERLESS:
+        case MathNode::ADDSUB:
+        case MathNode::MULTDIV:
+        {
+            CaretAssert(numArgs > 1);
+            compile(*(node.m_arguments[0]), dest);
+            for (int i = 1; i < numArgs; ++i)
+            {
+                compile(*(node.m_arguments[i]), dest + 1);
+                Instruction::OpCode myOp = Instruction::ADD;
+                switch (node.m_type)
+                {
+                    case MathNode::OR:
+                        myOp = Instruction::OR;
+                        break;
+                    case MathNode::AND:
+                        myOp = Instruction::AND;
+                        break;
+                    case MathNode::EQUAL:
+                        myOp = (node.m_invert[i] ? Instruction::NOT_EQUAL : Instruction::EQUAL);
+                        break;
+                    case MathNode::GREATERLESS:
+                        if (node.m_invert[i])
+                        {
+                            myOp = (node.m_inclusive[i] ? Instruction::LESS_EQUAL : Instruction::LESS);
+                        } else {
+                            myOp = (node.m_inclusive[i] ? Instruction::GREATER_EQUAL : Instruction::GREATER);
+                        }
+                        break;
+                    case MathNode::ADDSUB:
+                        myOp = (node.m_invert[i] ? Instruction::SUBTRACT : Instruction::ADD);
+                        break;
+                    case MathNode::MULTDIV:
+                        myOp = (node.m_invert[i] ? Instruction::DIVIDE : Instruction::MULTIPLY);
+                        break;
+                    default:
+                        CaretAssert(0);
+                        break;
+                }
+                m_program.push_back(Instruction(myOp, dest));
+            }
+            break;
+        }
+        case MathNode::NOT:
+        case MathNode::NEGATE:
+            CaretAssert(numArgs == 1);
+            compile(*(node.m_arguments[0]), dest);
+            m_program.push_back(Instruction(node.m_type == MathNode::NOT ? Instruction::NOT : Instruction::NEGATE, dest));
+            break;
+        case MathNode::POW:
+            CaretAssert(numArgs == 2);
+            compile(*(node.m_arguments[0]), dest);
+            compile(*(node.m_arguments[1]), dest + 1);
+            m_program.push_back(Instruction(Instruction::POW, dest));
+            break;
+        case MathNode::FUNC:
+        {
+            if (node.m_function == MathFunctionEnum::INVALID) throw CaretException("parsing problem in CaretMathExpression");
+            for (int i = 0; i < numArgs; ++i)
+            {
+                compile(*(node.m_arguments[i]), dest + i);
+            }
+            Instruction myInstr(Instruction::FUNC, dest);
+            myInstr.m_function = node.m_function;
+            m_program.push_back(myInstr);
+            break;
+        }
+        case MathNode::VAR:
+        {
+            Instruction myInstr(Instruction::LOAD_VAR, dest);
+            myInstr.m_varIndex = node.m_varIndex;
+            m_program.push_back(myInstr);
+            break;
+        }
+        case MathNode::CONST:
+        {
+            Instruction myInstr(Instruction::LOAD_CONST, dest);
+            myInstr.m_constVal = node.m_constVal;
+            m_program.push_back(myInstr);
+            break;
+        }
+        case MathNode::INVALID:
+            throw CaretException("parsing problem in CaretMathExpression");
+    }
+}
+
+void CaretMathExpression::runProgram(const vector<const float*>& variableData, const vector<int64_t>& variableStrides, const int64_t& start, const int& count,
+                                     double* registers) const
+{//each operation must do exactly what MathNode::eval() does, so that results are identical
+    int numInstructions = (int)m_program.size();
+    for (int instr = 0; instr < numInstructions; ++instr)
+    {
+        const Instruction& myInstr = m_program[instr];
+        double* out = registers + myInstr.m_dest * EVAL_BLOCK_SIZE;
+        const double* arg1 = out + EVAL_BLOCK_SIZE;//only used by instructions that have these arguments
+        const double* arg2 = arg1 + EVAL_BLOCK_SIZE;
+        switch (myInstr.m_op)
+        {
+            case Instruction::LOAD_VAR:
+            {
+                CaretAssertVectorIndex(variableData, myInstr.m_varIndex);
+                int64_t stride = variableStrides[myInstr.m_varIndex];
+                const float* data = variableData[myInstr.m_varIndex] + start * stride;
+                if (stride == 1)
+                {
+                    for (int i = 0; i < count; ++i) out[i] = data[i];
+                } else {
+                    for (int i = 0; i < count; ++i) out[i] = data[i * stride];
+                }
+                break;
+            }
+            case Instruction::LOAD_CONST:
+                for (int i = 0; i < count; ++i) out[i] = myInstr.m_constVal;
+                break;
+            case Instruction::OR:
+                for (int i = 0; i < count; ++i) out[i] = ((out[i] > 0.0 || arg1[i] > 0.0) ? 1.0 : 0.0);
+                break;
+            case Instruction::AND:
+                for (int i = 0; i < count; ++i) out[i] = ((out[i] > 0.0 && arg1[i] > 0.0) ? 1.0 : 0.0);
+                break;
+            case Instruction::EQUAL:
+            case Instruction::NOT_EQUAL:
+            {
+                double equalVal = (myInstr.m_op == Instruction::EQUAL ? 1.0 : 0.0), notEqualVal = 1.0 - equalVal;
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(out[i]), abs(arg1[i])) / 1000000;//same fudge factor as eval()
+                    out[i] = ((out[i] >= arg1[i] - adjust) && (out[i] <= arg1[i] + adjust)) ? equalVal : notEqualVal;
+                }
+                break;
+            }
+            case Instruction::GREATER:
+                for (int i = 0; i < count; ++i) out[i] = (out[i] > arg1[i] ? 1.0 : 0.0);
+                break;
+            case Instruction::LESS:
+                for (int i = 0; i < count; ++i) out[i] = (out[i] < arg1[i] ? 1.0 : 0.0);
+                break;
+            case Instruction::GREATER_EQUAL:
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(out[i]), abs(arg1[i])) / 1000000;
+                    out[i] = (out[i] >= arg1[i] - adjust ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::LESS_EQUAL:
+                for (int i = 0; i < count; ++i)
+                {
+                    float adjust = min(abs(out[i]), abs(arg1[i])) / 1000000;
+                    out[i] = (out[i] <= arg1[i] + adjust ? 1.0 : 0.0);
+                }
+                break;
+            case Instruction::ADD:
+                for (int i = 0; i < count; ++i) out[i] += arg1[i];
+                break;
+            case Instruction::SUBTRACT:
+                for (int i = 0; i < count; ++i) out[i] -= arg1[i];
+                break;
+            case Instruction::MULTIPLY:
+                for (int i = 0; i < count; ++i) out[i] *= arg1[i];
+                break;
+            case Instruction::DIVIDE:
+                for (int i = 0; i < count; ++i) out[i] /= arg1[i];
+                break;
+            case Instruction::NOT:
+                for (int i = 0; i < count; ++i) out[i] = (out[i] > 0.0 ? 0.0 : 1.0);
+                break;
+            case Instruction::NEGATE:
+                for (int i = 0; i < count; ++i) out[i] = -out[i];
+                break;
+            case Instruction::POW:
+                for (int i = 0; i < count; ++i) out[i] = pow(out[i], arg1[i]);
+                break;
+            case Instruction::FUNC:
+                switch (myInstr.m_function)
+                {
+                    case MathFunctionEnum::SIN:
+                        for (int i = 0; i < count; ++i) out[i] = sin(out[i]);
+                        break;
+                    case MathFunctionEnum::COS:
+                        for (int i = 0; i < count; ++i) out[i] = cos(out[i]);
+                        break;
+                    case MathFunctionEnum::TAN:
+                        for (int i = 0; i < count; ++i) out[i] = tan(out[i]);
+                        break;
+                    case MathFunctionEnum::ASIN:
+                        for (int i = 0; i < count; ++i) out[i] = asin(out[i]);
+                        break;
+                    case MathFunctionEnum::ACOS:
+                        for (int i = 0; i < count; ++i) out[i] = acos(out[i]);
+                        break;
+                    case MathFunctionEnum::ATAN:
+                        for (int i = 0; i < count; ++i) out[i] = atan(out[i]);
+                        break;
+                    case MathFunctionEnum::SINH:
+                        for (int i = 0; i < count; ++i) out[i] = sinh(out[i]);
+                        break;
+                    case MathFunctionEnum::COSH:
+                        for (int i = 0; i < count; ++i) out[i] = cosh(out[i]);
+                        break;
+                    case MathFunctionEnum::TANH:
+                        for (int i = 0; i < count; ++i) out[i] = tanh(out[i]);
+                        break;
+                    case MathFunctionEnum::ASINH:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            double arg = out[i];
+                            if (arg > 0)
+                            {
+                                out[i] = log(arg + sqrt(arg * arg + 1));
+                            } else {
+                                out[i] = -log(-arg + sqrt(arg * arg + 1));
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::ACOSH:
+                        for (int i = 0; i < count; ++i) out[i] = log(out[i] + sqrt(out[i] * out[i] - 1));
+                        break;
+                    case MathFunctionEnum::ATANH:
+                        for (int i = 0; i < count; ++i) out[i] = 0.5 * log((1 + out[i]) / (1 - out[i]));
+                        break;
+                    case MathFunctionEnum::LN:
+                        for (int i = 0; i < count; ++i) out[i] = log(out[i]);
+                        break;
+                    case MathFunctionEnum::EXP:
+                        for (int i = 0; i < count; ++i) out[i] = exp(out[i]);
+                        break;
+                    case MathFunctionEnum::LOG:
+                        for (int i = 0; i < count; ++i) out[i] = log10(out[i]);
+                        break;
+                    case MathFunctionEnum::SQRT:
+                        for (int i = 0; i < count; ++i) out[i] = sqrt(out[i]);
+                        break;
+                    case MathFunctionEnum::ABS:
+                        for (int i = 0; i < count; ++i) out[i] = abs(out[i]);
+                        break;
+                    case MathFunctionEnum::FLOOR:
+                        for (int i = 0; i < count; ++i) out[i] = floor(out[i]);
+                        break;
+                    case MathFunctionEnum::ROUND:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (out[i] > 0.0)
+                            {
+                                out[i] = floor(out[i] + 0.5);
+                            } else {
+                                out[i] = ceil(out[i] - 0.5);
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::CEIL:
+                        for (int i = 0; i < count; ++i) out[i] = ceil(out[i]);
+                        break;
+                    case MathFunctionEnum::ATAN2:
+                        for (int i = 0; i < count; ++i) out[i] = atan2(out[i], arg1[i]);
+                        break;
+                    case MathFunctionEnum::MIN:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (out[i] > arg1[i]) out[i] = arg1[i];
+                        }
+                        break;
+                    case MathFunctionEnum::MAX:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (out[i] < arg1[i]) out[i] = arg1[i];
+                        }
+                        break;
+                    case MathFunctionEnum::MOD:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (arg1[i] == 0.0)
+                            {
+                                out[i] = 0.0;
+                            } else {
+                                out[i] = out[i] - arg1[i] * floor(out[i] / arg1[i]);
+                            }
+                        }
+                        break;
+                    case MathFunctionEnum::CLAMP:
+                        for (int i = 0; i < count; ++i)
+                        {
+                            if (out[i] < arg1[i]) out[i] = arg1[i];
+                            if (out[i] > arg2[i]) out[i] = arg2[i];
+                        }
+                        break;
+                    case MathFunctionEnum::INVALID:
+                        CaretAssertMessage(0, "compile() let through an INVALID function");
+                        break;
+                }
+                break;
+        }
+    }
+}
+
 vector<AString> CaretMathExpression::getVarNames() const
 {
     vector<AString> ret(m_varNames.size());
@@ -63,6 +63,40 @@ class CaretMathExpression
         double eval(const std::vector<float>& values) const;
         AString toString(const std::vector<AString>& varNames) const;
     };
+    struct Instruction
+    {//flattened form of the tree for evaluating many elements at once, each instruction operates on a block of elements in each register
+        enum OpCode
+        {
+            LOAD_VAR,
+            LOAD_CONST,
+            OR,
+            AND,
+            EQUAL,
+            NOT_EQUAL,
+            GREATER,
+            GREATER_EQUAL,
+            LESS,
+            LESS_EQUAL,
+            ADD,
+            SUBTRACT,
+            MULTIPLY,
+            DIVIDE,
+            NOT,
+            NEGATE,
+            POW,
+            FUNC
+        };
+        OpCode m_op;
+        MathFunctionEnum::Enum m_function;
+        int m_dest;//binary operations use m_dest and m_dest + 1, and put the result in m_dest, clamp also uses m_dest + 2
+        int m_varIndex;
+        double m_constVal;
+        Instruction(const OpCode& op, const int& dest) { m_op = op; m_dest = dest; m_function = MathFunctionEnum::INVALID; m_varIndex = -1; m_constVal = 0.0; }
+    };
+    std::vector<Instruction> m_program;
+    int m_numRegisters;
+    void compile(const MathNode& node, const int& dest);
+    void runProgram(const std::vector<const float*>& variableData, const std::vector<int64_t>& variableStrides, const int64_t& start, const int& count, double* registers) const;
     std::map<AString, int> m_varNames;
     AString m_input;
     int m_position, m_end;
@@ -86,6 +120,11 @@ public:
     static bool getNamedConstant(const AString& name, double& valueOut);
     CaretMathExpression(const AString& expression);
     double evaluate(const std::vector<float>& variableValues) const;
+    ///evaluate at numElements positions, variable v at element i is variableData[v][i * variableStrides[v]], so use a stride of 0 for a variable that is constant over the array
+    ///results are identical to calling evaluate() on each element and converting to float, but much faster, and multithreaded for large arrays
+    void evaluate(const std::vector<const float*>& variableData, const std::vector<int64_t>& variableStrides, const int64_t& numElements, float* dataOut) const;
+    ///same, with all strides 1
+    void evaluate(const std::vector<const float*>& variableData, const int64_t& numElements, float* dataOut) const;
     std::vector<AString> getVarNames() const;
     AString toString() const;//the expression, with a lot of parentheses added
 };
@@ -21,8 +21,11 @@
  */
 /*LICENSE_END*/
 
-#include "CaretMutex.h"
 #include "CaretAssert.h"
+#include "CaretMutex.h"
+
+#include <QAtomicInt>
+#include <QThread>
 
 //NOTE: AFAIK, shared_ptr and raw pointers don't get along (can't pass to an old ownership-taking object without changing it to use shared_ptr)
 //      so, these smart pointers have .releasePointer() which stops any smart pointer from deleting it (via an extra variable alongside the refcount)
@@ -45,16 +48,75 @@ namespace caret
         };
 
         struct CaretPointerSyncShare
-        {//same, but with mutex
-            int64_t m_refCount;
-            CaretMutex m_mutex;//protects m_refCount, m_doNotDelete
+        {//same, but with atomic refcount
+            QAtomicInt m_refCount;
             bool m_doNotDelete;
-            CaretPointerSyncShare()
+            CaretPointerSyncShare() : m_refCount(1)
             {
-                m_refCount = 1;
                 m_doNotDelete = false;
             }
         };
+        
+        class CaretPointerLock
+        {//reader/writer spinlock for the members of one pointer instance - copying from an instance is only an atomic add, so threads copying the same pointer don't wait on each other
+            QAtomicInt m_state;//number of readers, plus WRITER if a writer has it or is waiting for readers to leave
+            enum { WRITER = 1 << 30 };
+            static void pause(int& spins)
+            {
+                ++spins;
+                if (spins > 64)//it is only held for a few instructions, but don't burn a core if the holder got descheduled
+                {
+                    QThread::yieldCurrentThread();
+                    spins = 0;
+                }
+            }
+        public:
+            CaretPointerLock() : m_state(0) { }
+            CaretPointerLock(const CaretPointerLock&) : m_state(0) { }//like CaretMutex, copy and assign do nothing other than default construct
+            CaretPointerLock& operator=(const CaretPointerLock&) { return *this; }
+            void lockRead()
+            {
+                int spins = 0;
+                while (m_state.fetchAndAddAcquire(1) & WRITER)
+                {//back out, wait for the writer to finish, and try again
+                    m_state.fetchAndAddRelaxed(-1);
+                    while (m_state & WRITER) pause(spins);
+                }
+            }
+            void unlockRead() { m_state.fetchAndAddRelease(-1); }
+            void lockWrite()
+            {
+                int spins = 0;
+                for (;;)
+                {
+                    int current = m_state;
+                    if (!(current & WRITER) && m_state.testAndSetAcquire(current, current | WRITER)) break;
+                    pause(spins);
+                }
+                while (!m_state.testAndSetAcquire(WRITER, WRITER)) pause(spins);//new readers back out, wait for existing ones to finish (atomic so it also orders with their unlock)
+            }
+            void unlockWrite() { m_state.fetchAndAddRelease(-WRITER); }
+        };
+        
+        class CaretPointerReadLocker
+        {
+            CaretPointerLock* m_lock;
+            CaretPointerReadLocker(const CaretPointerReadLocker&);
+            CaretPointerReadLocker& operator=(const CaretPointerReadLocker&);
+        public:
+            CaretPointerReadLocker(CaretPointerLock* lock) { m_lock = lock; m_lock->lockRead(); }
+            ~CaretPointerReadLocker() { m_lock->unlockRead(); }
+        };
+        
+        class CaretPointerWriteLocker
+        {
+            CaretPointerLock* m_lock;
+            CaretPointerWriteLocker(const CaretPointerWriteLocker&);
+            CaretPointerWriteLocker& operator=(const CaretPointerWriteLocker&);
+        public:
+            CaretPointerWriteLocker(CaretPointerLock* lock) { m_lock = lock; m_lock->lockWrite(); }
+            ~CaretPointerWriteLocker() { m_lock->unlockWrite(); }
+        };
 
         template <typename T>
         class CaretPointerCommon
@@ -151,7 +213,7 @@ namespace caret
     {
         using _caret_pointer_impl::CaretPointerCommon<T>::m_pointer;
         _caret_pointer_impl::CaretPointerSyncShare* m_share;
-        mutable CaretMutex m_mutex;//protects members from modification while reading, or from reading while modifying
+        mutable _caret_pointer_impl::CaretPointerLock m_lock;//protects members from modification while reading, or from reading while modifying
     public:
         CaretPointer();
         ~CaretPointer();
@@ -199,7 +261,7 @@ namespace caret
         using _caret_pointer_impl::CaretPointerCommon<T>::m_pointer;
         using _caret_pointer_impl::CaretArrayBase<T>::m_size;
         _caret_pointer_impl::CaretPointerSyncShare* m_share;//same share because it doesn't contain any specific information about what it is counting
-        mutable CaretMutex m_mutex;//protects members from modification while reading, or from reading while modifying
+        mutable _caret_pointer_impl::CaretPointerLock m_lock;//protects members from modification while reading, or from reading while modifying
     public:
         CaretArray();
         ~CaretArray();
@@ -342,14 +404,13 @@ namespace caret
     template <typename T>
     CaretPointer<T>::CaretPointer(const CaretPointer<T>& right) : _caret_pointer_impl::CaretPointerBase<T>()
     {//don't need to lock self during constructor
-        CaretMutexLocker locked(&(right.m_mutex));//don't let right modify its share until our reference is counted
+        _caret_pointer_impl::CaretPointerReadLocker locked(&(right.m_lock));//don't let right modify its share until our reference is counted
         if (right.m_share == NULL)//guarantees it won't be deleted, because right has a counted reference
         {
             m_share = NULL;
             m_pointer = NULL;
         } else {
-            CaretMutexLocker locked2(&(right.m_share->m_mutex));
-            ++(right.m_share->m_refCount);
+            right.m_share->m_refCount.ref();
             m_share = right.m_share;//now our reference is counted and we have the share, we can unlock everything
             m_pointer = right.m_pointer;
         }
@@ -358,14 +419,13 @@ namespace caret
     template <typename T> template <typename T2>
     CaretPointer<T>::CaretPointer(const CaretPointer<T2>& right) : _caret_pointer_impl::CaretPointerBase<T>()
     {//don't need to lock self during constructor
-        CaretMutexLocker locked(&(right.m_mutex));//don't let right modify its share until our reference is counted
+        _caret_pointer_impl::CaretPointerReadLocker locked(&(right.m_lock));//don't let right modify its share until our reference is counted
         if (right.m_share == NULL)//guarantees it won't be deleted, because right has a counted reference
         {
             m_share = NULL;
             m_pointer = NULL;
         } else {
-            CaretMutexLocker locked2(&(right.m_share->m_mutex));
-            ++(right.m_share->m_refCount);
+            right.m_share->m_refCount.ref();
             m_share = right.m_share;//now our reference is counted and we have the share, we can unlock everything
             m_pointer = right.m_pointer;
         }
@@ -397,7 +457,7 @@ namespace caret
         CaretPointer<T> temp(right);//copy construct from it, takes care of locking and type checking
         _caret_pointer_impl::CaretPointerSyncShare* tempShare = temp.m_share;//prepare to swap the members
         T* tempPointer = temp.m_pointer;
-        CaretMutexLocker locked(&m_mutex);//lock myself before using internal state
+        _caret_pointer_impl::CaretPointerWriteLocker locked(&m_lock);//lock myself before using internal state
         temp.m_share = m_share;
         temp.m_pointer = m_pointer;
         m_share = tempShare;
@@ -411,7 +471,7 @@ namespace caret
         CaretPointer<T> temp(right);//copy construct from it, takes care of locking and type checking
         _caret_pointer_impl::CaretPointerSyncShare* tempShare = temp.m_share;//prepare to swap the members
         T* tempPointer = temp.m_pointer;
-        CaretMutexLocker locked(&m_mutex);//lock myself before using internal state
+        _caret_pointer_impl::CaretPointerWriteLocker locked(&m_lock);//lock myself before using internal state
         temp.m_share = m_share;
         temp.m_pointer = m_pointer;
         m_share = tempShare;
@@ -425,7 +485,7 @@ namespace caret
         CaretPointer<T> temp(right);//construct from the pointer
         _caret_pointer_impl::CaretPointerSyncShare* tempShare = temp.m_share;//prepare to swap the members
         T* tempPointer = temp.m_pointer;
-        CaretMutexLocker locked(&m_mutex);//lock myself before using internal state
+        _caret_pointer_impl::CaretPointerWriteLocker locked(&m_lock);//lock myself before using internal state
         temp.m_share = m_share;
         temp.m_pointer = m_pointer;
         m_share = tempShare;
@@ -436,18 +496,9 @@ namespace caret
     CaretPointer<T>::~CaretPointer()
     {//access during destructor is programmer error, don't lock self
         if (m_share == NULL) return;
-        bool deleteShare = false;
-        {
-            CaretMutexLocker locked(&(m_share->m_mutex));//do lock the refcount, though
-            --(m_share->m_refCount);
-            if (m_share->m_refCount == 0)
-            {
-                deleteShare = true;
-                if (!m_share->m_doNotDelete) delete m_pointer;
-            }
-        }//unlock refcount mutex before deleting the object that contains it, otherwise Very Bad Things
-        if (deleteShare)
+        if (!m_share->m_refCount.deref())//atomic, returns false when it reaches zero, so only one instance will see it
         {
+            if (!m_share->m_doNotDelete) delete m_pointer;
             delete m_share;
         }
     }
@@ -455,18 +506,18 @@ namespace caret
     template <typename T>
     int64_t CaretPointer<T>::getReferenceCount() const
     {
-        CaretMutexLocker locked(&m_mutex);//lock so that m_share can't be deleted in the middle
+        _caret_pointer_impl::CaretPointerReadLocker locked(&m_lock);//lock so that m_share can't be deleted in the middle
         if (m_share == NULL)
         {
             return 0;
         }
-        return m_share->m_refCount;
+        return (int)m_share->m_refCount;
     }
 
     template <typename T>
     T*const& CaretPointer<T>::releasePointer()
     {
-        CaretMutexLocker locked(&m_mutex);//lock to keep m_share and m_pointer coherent until after return - must return the pointer that was released
+        _caret_pointer_impl::CaretPointerReadLocker locked(&m_lock);//lock to keep m_share and m_pointer coherent until after return - must return the pointer that was released
         if (m_share != NULL)
         {
             m_share->m_doNotDelete = true;
@@ -626,15 +677,14 @@ namespace caret
     template <typename T>
     CaretArray<T>::CaretArray(const CaretArray<T>& right) : _caret_pointer_impl::CaretArrayBase<T>()
     {//don't need to lock self during constructor
-        CaretMutexLocker locked(&(right.m_mutex));//don't let right modify its share until our reference is counted
+        _caret_pointer_impl::CaretPointerReadLocker locked(&(right.m_lock));//don't let right modify its share until our reference is counted
         if (right.m_share == NULL)//guarantees it won't be deleted, because right has a counted reference
         {
             m_share = NULL;
             m_pointer = NULL;
             m_size = 0;
         } else {
-            CaretMutexLocker locked2(&(right.m_share->m_mutex));
-            ++(right.m_share->m_refCount);
+            right.m_share->m_refCount.ref();
             m_share = right.m_share;//now our reference is counted and we have the share, we can unlock everything
             m_pointer = right.m_pointer;
             m_size = right.m_size;
@@ -644,15 +694,14 @@ namespace caret
     template <typename T> template <typename T2>
     CaretArray<T>::CaretArray(const CaretArray<T2>& right) : _caret_pointer_impl::CaretArrayBase<T>()
     {//don't need to lock self during constructor
-        CaretMutexLocker locked(&(right.m_mutex));//don't let right modify its share until our reference is counted
+        _caret_pointer_impl::CaretPointerReadLocker locked(&(right.m_lock));//don't let right modify its share until our reference is counted
         if (right.m_share == NULL)//guarantees it won't be deleted, because right has a counted reference
         {
             m_share = NULL;
             m_pointer = NULL;
             m_size = 0;
         } else {
-            CaretMutexLocker locked2(&(right.m_share->m_mutex));
-            ++(right.m_share->m_refCount);
+            right.m_share->m_refCount.ref();
             m_share = right.m_share;//now our reference is counted and we have the share, we can unlock everything
             this->m_pointer = right.m_pointer;
             m_size = right.m_size;
@@ -715,7 +764,7 @@ namespace caret
         _caret_pointer_impl::CaretPointerSyncShare* tempShare = temp.m_share;//prepare to swap the shares and fill members
         T* tempPointer = temp.m_pointer;
         int64_t tempSize = temp.m_size;
-        CaretMutexLocker locked(&m_mutex);//lock myself before using internal state
+        _caret_pointer_impl::CaretPointerWriteLocker locked(&m_lock);//lock myself before using internal state
         temp.m_share = m_share;
         temp.m_pointer = m_pointer;
         temp.m_size = m_size;
@@ -732,7 +781,7 @@ namespace caret
         _caret_pointer_impl::CaretPointerSyncShare* tempShare = temp.m_share;//prepare to swap the shares and fill members
         T* tempPointer = temp.m_pointer;
         int64_t tempSize = temp.m_size;
-        CaretMutexLocker locked(&m_mutex);//lock myself before using internal state
+        _caret_pointer_impl::CaretPointerWriteLocker locked(&m_lock);//lock myself before using internal state
         temp.m_share = m_share;
         temp.m_pointer = m_pointer;
         temp.m_size = m_size;
@@ -746,18 +795,9 @@ namespace caret
     CaretArray<T>::~CaretArray()
     {//access during destructor is programmer error, don't lock self
         if (m_share == NULL) return;
-        bool deleteShare = false;
-        {
-            CaretMutexLocker locked(&(m_share->m_mutex));//do lock the refcount, though
-            --(m_share->m_refCount);
-            if (m_share->m_refCount == 0)
-            {
-                deleteShare = true;
-                if (!m_share->m_doNotDelete) delete[] m_pointer;
-            }
-        }//left refcount unlock before deleting the object that contains it
-        if (deleteShare)
+        if (!m_share->m_refCount.deref())//atomic, returns false when it reaches zero
         {
+            if (!m_share->m_doNotDelete) delete[] m_pointer;
             delete m_share;
         }
     }
@@ -765,18 +805,18 @@ namespace caret
     template <typename T>
     int64_t CaretArray<T>::getReferenceCount() const
     {
-        CaretMutexLocker locked(&m_mutex);//lock to keep m_share from being deleted
+        _caret_pointer_impl::CaretPointerReadLocker locked(&m_lock);//lock to keep m_share from being deleted
         if (m_share == NULL)
         {
             return 0;
         }
-        return m_share->m_refCount;
+        return (int)m_share->m_refCount;
     }
 
     template <typename T>
     T*const& CaretArray<T>::releasePointer()
     {
-        CaretMutexLocker locked(&m_mutex);//lock because m_pointer and m_share need to remain coherent
+        _caret_pointer_impl::CaretPointerReadLocker locked(&m_lock);//lock because m_pointer and m_share need to remain coherent
         if (m_share != NULL)
         {
             m_share->m_doNotDelete = true;
@@ -976,6 +976,31 @@ CaretPreferences::setDynamicConnectivityDefaultedOn(const bool defaultedOn)
                      defaultedOn);
 }
 
+/**
+ * @return Are volume slices drawn with 3D textures?  Each colored
+ * map is loaded into the graphics card once and a slice is drawn as a
+ * single textured polygon instead of a polygon for each voxel.
+ */
+bool
+CaretPreferences::isVolumeSliceTextureDrawingEnabled() const
+{
+    return this->volumeSliceTextureDrawingEnabled;
+}
+
+/**
+ * Set volume slices drawn with 3D textures.
+ *
+ * @param enabled
+ *     New status.
+ */
+void
+CaretPreferences::setVolumeSliceTextureDrawingEnabled(const bool enabled)
+{
+    this->volumeSliceTextureDrawingEnabled = enabled;
+    this->setBoolean(NAME_VOLUME_SLICE_TEXTURE_DRAWING,
+                     enabled);
+}
+
 
 /**
  * @return The image capture method.
@@ -1482,6 +1507,9 @@ CaretPreferences::readPreferences()
     this->dynamicConnectivityDefaultedOn = this->getBoolean(CaretPreferences::NAME_DYNAMIC_CONNECTIVITY_ON,
                                                             true);
     
+    this->volumeSliceTextureDrawingEnabled = this->getBoolean(CaretPreferences::NAME_VOLUME_SLICE_TEXTURE_DRAWING,
+                                                              false);
+    
     this->remoteFileUserName = this->getString(NAME_REMOTE_FILE_USER_NAME);
     this->remoteFilePassword = this->getString(NAME_REMOTE_FILE_PASSWORD);
     this->remoteFileLoginSaved = this->getBoolean(NAME_REMOTE_FILE_LOGIN_SAVED,
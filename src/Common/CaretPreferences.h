@@ -186,6 +186,10 @@ namespace caret {
         
         void setDynamicConnectivityDefaultedOn(const bool defaultedOn);
         
+        bool isVolumeSliceTextureDrawingEnabled() const;
+        
+        void setVolumeSliceTextureDrawingEnabled(const bool enabled);
+        
     private:
         CaretPreferences(const CaretPreferences&);
 
@@ -281,6 +285,8 @@ namespace caret {
         
         bool dynamicConnectivityDefaultedOn;
         
+        bool volumeSliceTextureDrawingEnabled;
+        
         bool yokingDefaultedOn;
         
         AString remoteFileUserName;
@@ -324,6 +330,7 @@ namespace caret {
         static const AString NAME_SHOW_VOLUME_IDENTIFICATION_SYMBOLS;
         static const AString NAME_TILE_TABS_CONFIGURATIONS;
         static const AString NAME_VOLUME_IDENTIFICATION_DEFAULTED_ON;
+        static const AString NAME_VOLUME_SLICE_TEXTURE_DRAWING;
         static const AString NAME_YOKING_DEFAULT_ON;
         
     };
@@ -364,6 +371,7 @@ namespace caret {
     const AString CaretPreferences::NAME_SHOW_VOLUME_IDENTIFICATION_SYMBOLS = "showVolumeIdentificationSymbols";
     const AString CaretPreferences::NAME_TILE_TABS_CONFIGURATIONS = "tileTabsConfigurations";
     const AString CaretPreferences::NAME_VOLUME_IDENTIFICATION_DEFAULTED_ON = "volumeIdentificationDefaultedOn";
+    const AString CaretPreferences::NAME_VOLUME_SLICE_TEXTURE_DRAWING = "volumeSliceTextureDrawing";
     const AString CaretPreferences::NAME_YOKING_DEFAULT_ON = "yokingDefaultedOn";
 #endif // __CARET_PREFERENCES_DECLARE__
 
@@ -0,0 +1,126 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "DotProductKernels.h"
+
+#include <algorithm>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int32_t DOT_LANES = 16;
+    const int32_t DOT_KBLOCK = 256;
+}
+
+//pairs of A rows are done 2x2 against B, so each element loaded is used twice, a last unpaired A row is done 1x4 against B
+//accumulates in float across independent lanes within blocks of DOT_KBLOCK elements so the compiler can vectorize it, then sums the blocks in double
+CARET_DOT_TARGETS
+void caret::dotProductTile(const float* const* aRows, const int32_t& numA, const float* const* bRows, const int32_t& numB, const int32_t& length, double* out)
+{
+    for (int32_t i = 0; i < numA * numB; ++i)
+    {
+        out[i] = 0.0;
+    }
+    const int32_t numPairedA = (numA / 2) * 2;
+    for (int32_t k0 = 0; k0 < length; k0 += DOT_KBLOCK)
+    {
+        int32_t kEnd = min(length, k0 + DOT_KBLOCK);
+        int32_t kVecEnd = k0 + ((kEnd - k0) / DOT_LANES) * DOT_LANES;
+        for (int32_t a = 0; a < numPairedA; a += 2)
+        {
+            const float* a0 = aRows[a], *a1 = aRows[a + 1];
+            for (int32_t b = 0; b < numB; b += 2)
+            {
+                const float* b0 = bRows[b], *b1 = bRows[min(b + 1, numB - 1)];//on odd counts, compute the last row twice and store it once
+                float acc00[DOT_LANES], acc01[DOT_LANES], acc10[DOT_LANES], acc11[DOT_LANES];
+                for (int32_t l = 0; l < DOT_LANES; ++l)
+                {
+                    acc00[l] = 0.0f; acc01[l] = 0.0f; acc10[l] = 0.0f; acc11[l] = 0.0f;
+                }
+                for (int32_t k = k0; k < kVecEnd; k += DOT_LANES)
+                {
+                    for (int32_t l = 0; l < DOT_LANES; ++l)
+                    {
+                        acc00[l] += a0[k + l] * b0[k + l];
+                        acc01[l] += a0[k + l] * b1[k + l];
+                        acc10[l] += a1[k + l] * b0[k + l];
+                        acc11[l] += a1[k + l] * b1[k + l];
+                    }
+                }
+                double s00 = 0.0, s01 = 0.0, s10 = 0.0, s11 = 0.0;
+                for (int32_t l = 0; l < DOT_LANES; ++l)
+                {
+                    s00 += acc00[l]; s01 += acc01[l]; s10 += acc10[l]; s11 += acc11[l];
+                }
+                for (int32_t k = kVecEnd; k < kEnd; ++k)
+                {
+                    s00 += a0[k] * b0[k]; s01 += a0[k] * b1[k]; s10 += a1[k] * b0[k]; s11 += a1[k] * b1[k];
+                }
+                out[a * numB + b] += s00;
+                out[(a + 1) * numB + b] += s10;
+                if (b + 1 < numB)
+                {
+                    out[a * numB + b + 1] += s01;
+                    out[(a + 1) * numB + b + 1] += s11;
+                }
+            }
+        }
+        if (numPairedA < numA)
+        {//a single row, such as correlating one row with many, so use each element of it 4 times instead
+            const float* a0 = aRows[numPairedA];
+            double* rowOut = out + numPairedA * numB;
+            for (int32_t b = 0; b < numB; b += 4)
+            {
+                const float* b0 = bRows[b], *b1 = bRows[min(b + 1, numB - 1)], *b2 = bRows[min(b + 2, numB - 1)], *b3 = bRows[min(b + 3, numB - 1)];
+                float acc0[DOT_LANES], acc1[DOT_LANES], acc2[DOT_LANES], acc3[DOT_LANES];
+                for (int32_t l = 0; l < DOT_LANES; ++l)
+                {
+                    acc0[l] = 0.0f; acc1[l] = 0.0f; acc2[l] = 0.0f; acc3[l] = 0.0f;
+                }
+                for (int32_t k = k0; k < kVecEnd; k += DOT_LANES)
+                {
+                    for (int32_t l = 0; l < DOT_LANES; ++l)
+                    {
+                        const float v = a0[k + l];
+                        acc0[l] += v * b0[k + l];
+                        acc1[l] += v * b1[k + l];
+                        acc2[l] += v * b2[k + l];
+                        acc3[l] += v * b3[k + l];
+                    }
+                }
+                double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+                for (int32_t l = 0; l < DOT_LANES; ++l)
+                {
+                    s0 += acc0[l]; s1 += acc1[l]; s2 += acc2[l]; s3 += acc3[l];
+                }
+                for (int32_t k = kVecEnd; k < kEnd; ++k)
+                {
+                    s0 += a0[k] * b0[k]; s1 += a0[k] * b1[k]; s2 += a0[k] * b2[k]; s3 += a0[k] * b3[k];
+                }
+                rowOut[b] += s0;
+                if (b + 1 < numB) rowOut[b + 1] += s1;
+                if (b + 2 < numB) rowOut[b + 2] += s2;
+                if (b + 3 < numB) rowOut[b + 3] += s3;
+            }
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef __DOT_PRODUCT_KERNELS_H__
+#define __DOT_PRODUCT_KERNELS_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <stdint.h>
+
+//gcc can build the dot product kernels for several instruction sets and pick one at load time
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 && defined(__x86_64__) && defined(CARET_OS_LINUX)
+#define CARET_DOT_TARGETS __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define CARET_DOT_TARGETS
+#endif
+
+namespace caret {
+
+    ///out[a * numB + b] = dot(aRows[a], bRows[b]) for every pair of rows, each row has length elements
+    void dotProductTile(const float* const* aRows, const int32_t& numA, const float* const* bRows, const int32_t& numB, const int32_t& length, double* out);
+    
+}
+
+#endif //__DOT_PRODUCT_KERNELS_H__
@@ -0,0 +1,47 @@
+#ifndef __MODIFICATION_STAMP_H__
+#define __MODIFICATION_STAMP_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <stdint.h>
+
+namespace caret {
+
+    /**
+     * \brief Hands out stamps that are unique across the whole process.
+     * \ingroup Common
+     *
+     * Data that changes stores a new stamp, and anything derived from it
+     * (such as a GPU texture or buffer) remembers the stamp it was made from,
+     * so a mismatch means the derived data is stale.
+     */
+    class ModificationStamp {
+        
+    public:
+        static int64_t newStamp();
+        
+    private:
+        ModificationStamp();
+        
+    };
+    
+} // namespace
+#endif  //__MODIFICATION_STAMP_H__
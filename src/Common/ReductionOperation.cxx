@@ -25,12 +25,159 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 #include <vector>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int64_t RADIX_MIN_ELEMS = 256;//below this, a comparison sort is faster than the radix passes
+    
+    //the sum-based reductions use several independent accumulators, so the additions don't form one long dependency chain, and the compiler can vectorize them
+    double sumValues(const float* data, const int64_t& numElems)
+    {
+        double accum[4] = { 0.0, 0.0, 0.0, 0.0 };
+        int64_t i = 0;
+        for (; i + 3 < numElems; i += 4)
+        {
+            accum[0] += data[i];
+            accum[1] += data[i + 1];
+            accum[2] += data[i + 2];
+            accum[3] += data[i + 3];
+        }
+        for (; i < numElems; ++i) accum[0] += data[i];
+        return (accum[0] + accum[1]) + (accum[2] + accum[3]);
+    }
+    
+    double sumSquaredResiduals(const float* data, const int64_t& numElems, const float& mean)
+    {
+        double accum[4] = { 0.0, 0.0, 0.0, 0.0 };
+        int64_t i = 0;
+        for (; i + 3 < numElems; i += 4)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                float tempf = data[i + j] - mean;
+                accum[j] += tempf * tempf;
+            }
+        }
+        for (; i < numElems; ++i)
+        {
+            float tempf = data[i] - mean;
+            accum[0] += tempf * tempf;
+        }
+        return (accum[0] + accum[1]) + (accum[2] + accum[3]);
+    }
+    
+    //all lanes start from data[0], so a NaN in the first element still propagates and later NaNs are still ignored, like the simple loop
+    float maxValue(const float* data, const int64_t& numElems)
+    {
+        float lanes[4] = { data[0], data[0], data[0], data[0] };
+        int64_t i = 1;
+        for (; i + 3 < numElems; i += 4)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                if (data[i + j] > lanes[j]) lanes[j] = data[i + j];
+            }
+        }
+        for (; i < numElems; ++i) if (data[i] > lanes[0]) lanes[0] = data[i];
+        float ret = lanes[0];
+        for (int j = 1; j < 4; ++j) if (lanes[j] > ret) ret = lanes[j];
+        return ret;
+    }
+    
+    float minValue(const float* data, const int64_t& numElems)
+    {
+        float lanes[4] = { data[0], data[0], data[0], data[0] };
+        int64_t i = 1;
+        for (; i + 3 < numElems; i += 4)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                if (data[i + j] < lanes[j]) lanes[j] = data[i + j];
+            }
+        }
+        for (; i < numElems; ++i) if (data[i] < lanes[0]) lanes[0] = data[i];
+        float ret = lanes[0];
+        for (int j = 1; j < 4; ++j) if (lanes[j] < ret) ret = lanes[j];
+        return ret;
+    }
+    
+    struct ValWeight
+    {//for sorting based only on value, but keeping weight associated
+        float value, weight;
+        ValWeight() { }
+        ValWeight(float v, float w)
+        {
+            value = v;
+            weight = w;
+        }
+        inline bool operator<(const ValWeight& rhs) const
+        {
+            return value < rhs.value;
+        }
+    };
+    
+    inline float getSortValue(const float& item) { return item; }
+    inline float getSortValue(const ValWeight& item) { return item.value; }
+    
+    inline uint32_t getSortKey(const float& value)
+    {//unsigned integers that sort in the same order as the floats, -0 and 0 get the same key because operator< considers them equal
+        float normalized = value + 0.0f;
+        uint32_t bits;
+        memcpy(&bits, &normalized, sizeof(uint32_t));
+        if ((bits & 0x80000000u) != 0) return ~bits;
+        return bits | 0x80000000u;
+    }
+    
+    ///stable sort by value, same order as stable_sort, but linear time
+    template <typename T>
+    void sortByValue(vector<T>& items)
+    {
+        int64_t numItems = (int64_t)items.size();
+        if (numItems < RADIX_MIN_ELEMS)
+        {
+            stable_sort(items.begin(), items.end());
+            return;
+        }
+        vector<uint32_t> keys(numItems), keyScratch(numItems);
+        vector<T> itemScratch(numItems);
+        vector<int64_t> counts(4 * 256, 0);
+        for (int64_t i = 0; i < numItems; ++i)
+        {
+            keys[i] = getSortKey(getSortValue(items[i]));
+            for (int pass = 0; pass < 4; ++pass)
+            {
+                ++counts[pass * 256 + ((keys[i] >> (pass * 8)) & 255)];
+            }
+        }
+        for (int pass = 0; pass < 4; ++pass)
+        {//least significant byte first, each pass is stable
+            int shift = pass * 8;
+            int64_t* passCounts = counts.data() + pass * 256;
+            if (passCounts[(keys[0] >> shift) & 255] == numItems) continue;//every key has the same byte here, common with integer-valued data
+            int64_t offsets[256], total = 0;
+            for (int b = 0; b < 256; ++b)
+            {
+                offsets[b] = total;
+                total += passCounts[b];
+            }
+            for (int64_t i = 0; i < numItems; ++i)
+            {
+                int64_t dest = offsets[(keys[i] >> shift) & 255]++;
+                keyScratch[dest] = keys[i];
+                itemScratch[dest] = items[i];
+            }
+            keys.swap(keyScratch);
+            items.swap(itemScratch);
+        }
+    }
+}
+
 float ReductionOperation::reduce(const float* data, const int64_t& numElems, const ReductionEnum::Enum& type)
 {
     CaretAssert(numElems > 0);
@@ -47,8 +194,7 @@ float ReductionOperation::reduce(const float* data, const int64_t& numElems, con
         case ReductionEnum::VARIANCE:
         case ReductionEnum::SUM:
         {
-            double sum = 0.0;
-            for (int64_t i = 0; i < numElems; ++i) sum += data[i];
+            double sum = sumValues(data, numElems);
             switch (type)
             {
                 case ReductionEnum::SUM:
@@ -58,12 +204,7 @@ float ReductionOperation::reduce(const float* data, const int64_t& numElems, con
                 default:
                 {
                     float mean = sum / numElems;
-                    double residsqr = 0.0;
-                    for (int64_t i = 0; i < numElems; ++i)
-                    {
-                        float tempf = data[i] - mean;
-                        residsqr += tempf * tempf;
-                    }
+                    double residsqr = sumSquaredResiduals(data, numElems, mean);
                     switch(type)
                     {
                         case ReductionEnum::STDEV:
@@ -90,17 +231,9 @@ float ReductionOperation::reduce(const float* data, const int64_t& numElems, con
             return prod;
         }
         case ReductionEnum::MAX:
-        {
-            float max = data[0];
-            for (int64_t i = 1; i < numElems; ++i) if (data[i] > max) max = data[i];
-            return max;
-        }
+            return maxValue(data, numElems);
         case ReductionEnum::MIN:
-        {
-            float min = data[0];
-            for (int64_t i = 1; i < numElems; ++i) if (data[i] < min) min = data[i];
-            return min;
-        }
+            return minValue(data, numElems);
         case ReductionEnum::INDEXMAX:
         {
             float max = data[0];
@@ -131,21 +264,21 @@ float ReductionOperation::reduce(const float* data, const int64_t& numElems, con
         }
         case ReductionEnum::MEDIAN:
         {
-            vector<float> dataCopy(numElems);
-            for (int64_t i = 0; i < numElems; ++i) dataCopy[i] = data[i];
-            sort(dataCopy.begin(), dataCopy.end());
+            vector<float> dataCopy(data, data + numElems);
+            int64_t half = numElems / 2;
+            nth_element(dataCopy.begin(), dataCopy.begin() + half, dataCopy.end());//no need to sort everything
             if ((numElems & 1) == 0)//if even, average middle two
             {
-                return (dataCopy[numElems / 2 - 1] + dataCopy[numElems / 2]) / 2.0f;
+                float lowerMiddle = *max_element(dataCopy.begin(), dataCopy.begin() + half);//the elements before the nth are all less or equal
+                return (lowerMiddle + dataCopy[half]) / 2.0f;
             } else {
-                return dataCopy[numElems / 2];//otherwise, take the center
+                return dataCopy[half];//otherwise, take the center
             }
         }
         case ReductionEnum::MODE:
         {
-            vector<float> dataCopy(numElems);
-            for (int64_t i = 0; i < numElems; ++i) dataCopy[i] = data[i];
-            sort(dataCopy.begin(), dataCopy.end());//sort to put same-value next to each other, a hash based map could be faster for large arrays, but oh well
+            vector<float> dataCopy(data, data + numElems);
+            sortByValue(dataCopy);//sort to put same-value next to each other
             int bestCount = 0, curCount = 1;
             float bestval = -1.0f, curval = dataCopy[0];
             for (int64_t i = 1; i < numElems; ++i)//search for largest contiguous region
@@ -313,23 +446,6 @@ float ReductionOperation::reduceOnlyNumeric(const float* data, const int64_t& nu
     return reduce(excluded.data(), excluded.size(), type);
 }
 
-namespace
-{
-    struct ValWeight
-    {//for sorting based only on value, but keeping weight associated
-        float value, weight;
-        ValWeight(float v, float w)
-        {
-            value = v;
-            weight = w;
-        }
-        inline bool operator<(const ValWeight& rhs) const
-        {
-            return value < rhs.value;
-        }
-    };
-}
-
 float ReductionOperation::reduceWeighted(const float* data, const float* weights, const int64_t& numElems, const ReductionEnum::Enum& type)
 {
     CaretAssert(numElems > 0);
@@ -395,7 +511,7 @@ float ReductionOperation::reduceWeighted(const float* data, const float* weights
             {
                 toSort.push_back(ValWeight(data[i], weights[i]));
             }
-            stable_sort(toSort.begin(), toSort.end());
+            sortByValue(toSort);
             vector<double> weightaccum(numElems);
             weightaccum[0] = toSort[0].weight;
             for (int i = 1; i < numElems; ++i)
@@ -420,7 +536,7 @@ float ReductionOperation::reduceWeighted(const float* data, const float* weights
             {
                 toSort.push_back(ValWeight(data[i], weights[i]));
             }
-            stable_sort(toSort.begin(), toSort.end());
+            sortByValue(toSort);
             float bestweight = -numeric_limits<float>::infinity(), curweight = toSort[0].weight;
             float bestval = toSort[0].value, curval = toSort[0].value;
             for (int i = 1; i < numElems; ++i)
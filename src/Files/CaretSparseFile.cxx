@@ -28,18 +28,27 @@
 
 #include <QByteArray>
 
+#include <algorithm>
+
 using namespace caret;
 using namespace std;
 
 const char magic[] = "\0\0\0\0cst\0";
+const size_t ROW_CACHE_SIZE = 16;//only used when the file can't be mapped
+
+bool CaretSparseFile::s_memoryMapping = true;
 
 CaretSparseFile::CaretSparseFile(const AString& fileName)
 {
+    m_mappedValues = NULL;
+    m_cacheClock = 0;
     readFile(fileName);
 }
 
 void CaretSparseFile::readFile(const AString& filename)
 {
+    m_mappedValues = NULL;
+    m_rowCache.clear();
     m_file.close();
     if (filename.endsWith(".gz"))
     {
@@ -94,36 +103,73 @@ void CaretSparseFile::readFile(const AString& filename)
     {
         throw DataFileException("cifti XML doesn't match dimensions of sparse file");
     }
+    int64_t numValues = m_indexArray[m_dims[1]] * 2;
+    if (numValues > 0 && s_memoryMapping && !ByteOrderEnum::isSystemBigEndian())
+    {//the file is little endian, so the mapping is only usable as-is if we don't need to swap, and the truncation check above ensures the whole values section exists
+        m_mappedValues = (const int64_t*)m_file.mapReadOnly(m_valuesOffset, numValues * sizeof(int64_t));
+    }
 }
 
 CaretSparseFile::~CaretSparseFile()
 {
 }
 
-void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
+const int64_t* CaretSparseFile::getRowPairs(const int64_t& index, vector<int64_t>& scratch, int64_t& numNonzeroOut)
 {
     CaretAssert(index >= 0 && index < m_dims[1]);
     int64_t start = m_indexArray[index], end = m_indexArray[index + 1];
-    int64_t numToRead = (end - start) * 2;
-    m_scratchArray.resize(numToRead);
+    numNonzeroOut = end - start;
+    if (m_mappedValues != NULL) return m_mappedValues + start * 2;
+    int64_t numToRead = numNonzeroOut * 2;
+    scratch.resize(numToRead);
+    if (numToRead == 0) return scratch.data();
+    CaretMutexLocker locked(&m_readMutex);
+    ++m_cacheClock;
+    size_t replace = 0;
+    for (size_t i = 0; i < m_rowCache.size(); ++i)
+    {
+        if (m_rowCache[i].m_row == index)
+        {
+            m_rowCache[i].m_lastUsed = m_cacheClock;
+            copy(m_rowCache[i].m_pairs.begin(), m_rowCache[i].m_pairs.end(), scratch.begin());
+            return scratch.data();
+        }
+        if (m_rowCache[i].m_lastUsed < m_rowCache[replace].m_lastUsed) replace = i;
+    }
     m_file.seek(m_valuesOffset + start * sizeof(int64_t) * 2);
-    m_file.read(m_scratchArray.data(), numToRead * sizeof(int64_t));
+    m_file.read(scratch.data(), numToRead * sizeof(int64_t));
     if (ByteOrderEnum::isSystemBigEndian())
     {
-        ByteSwapping::swapBytes(m_scratchArray.data(), numToRead);
+        ByteSwapping::swapBytes(scratch.data(), numToRead);
     }
+    if (m_rowCache.size() < ROW_CACHE_SIZE)
+    {
+        replace = m_rowCache.size();
+        m_rowCache.push_back(CachedRow());
+    }
+    m_rowCache[replace].m_row = index;
+    m_rowCache[replace].m_lastUsed = m_cacheClock;
+    m_rowCache[replace].m_pairs = scratch;
+    return scratch.data();
+}
+
+void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
+{
+    vector<int64_t> scratch;
+    int64_t numNonzero = 0;
+    const int64_t* pairs = getRowPairs(index, scratch, numNonzero);
     int64_t curIndex = 0;
-    for (int64_t i = 0; i < numToRead; i += 2)
+    for (int64_t i = 0; i < numNonzero; ++i)
     {
-        int64_t index = m_scratchArray[i];
-        if (index < curIndex || index >= m_dims[0]) throw DataFileException("impossible index value found in file");
-        while (curIndex < index)
+        int64_t colIndex = pairs[i * 2];
+        if (colIndex < curIndex || colIndex >= m_dims[0]) throw DataFileException("impossible index value found in file");
+        while (curIndex < colIndex)
         {
             rowOut[curIndex] = 0;
             ++curIndex;
         }
         ++curIndex;
-        rowOut[index] = m_scratchArray[i + 1];
+        rowOut[colIndex] = pairs[i * 2 + 1];
     }
     while (curIndex < m_dims[0])
     {
@@ -134,23 +180,16 @@ void CaretSparseFile::getRow(const int64_t& index, int64_t* rowOut)
 
 void CaretSparseFile::getRowSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<int64_t>& valuesOut)
 {
-    CaretAssert(index >= 0 && index < m_dims[1]);
-    int64_t start = m_indexArray[index], end = m_indexArray[index + 1];
-    int64_t numToRead = (end - start) * 2, numNonzero = end - start;
-    m_scratchArray.resize(numToRead);
-    m_file.seek(m_valuesOffset + start * sizeof(int64_t) * 2);
-    m_file.read(m_scratchArray.data(), numToRead * sizeof(int64_t));
-    if (ByteOrderEnum::isSystemBigEndian())
-    {
-        ByteSwapping::swapBytes(m_scratchArray.data(), numToRead);
-    }
+    vector<int64_t> scratch;
+    int64_t numNonzero = 0;
+    const int64_t* pairs = getRowPairs(index, scratch, numNonzero);
     indicesOut.resize(numNonzero);
     valuesOut.resize(numNonzero);
     int64_t lastIndex = -1;
     for (int64_t i = 0; i < numNonzero; ++i)
     {
-        indicesOut[i] = m_scratchArray[i * 2];
-        valuesOut[i] = m_scratchArray[i * 2 + 1];
+        indicesOut[i] = pairs[i * 2];
+        valuesOut[i] = pairs[i * 2 + 1];
         if (indicesOut[i] <= lastIndex || indicesOut[i] >= m_dims[0]) throw DataFileException("impossible index value found in file");
         lastIndex = indicesOut[i];
     }
@@ -158,27 +197,28 @@ void CaretSparseFile::getRowSparse(const int64_t& index, vector<int64_t>& indice
 
 void CaretSparseFile::getFibersRow(const int64_t& index, FiberFractions* rowOut)
 {
-    if (m_scratchRow.size() != (size_t)m_dims[0]) m_scratchRow.resize(m_dims[0]);
-    getRow(index, (int64_t*)m_scratchRow.data());
+    vector<uint64_t> scratchRow(m_dims[0]);
+    getRow(index, (int64_t*)scratchRow.data());
     for (int64_t i = 0; i < m_dims[0]; ++i)
     {
-        if (m_scratchRow[i] == 0)
+        if (scratchRow[i] == 0)
         {
             rowOut[i].zero();
         } else {
-             decodeFibers(m_scratchRow[i], rowOut[i]);
+             decodeFibers(scratchRow[i], rowOut[i]);
         }
     }
 }
 
 void CaretSparseFile::getFibersRowSparse(const int64_t& index, vector<int64_t>& indicesOut, vector<FiberFractions>& valuesOut)
 {
-    getRowSparse(index, indicesOut, m_scratchSparseRow);
-    size_t numNonzero = m_scratchSparseRow.size();
+    vector<int64_t> scratchValues;
+    getRowSparse(index, indicesOut, scratchValues);
+    size_t numNonzero = scratchValues.size();
     valuesOut.resize(numNonzero);
     for (size_t i = 0; i < numNonzero; ++i)
     {
-        decodeFibers(((uint64_t*)m_scratchSparseRow.data())[i], valuesOut[i]);
+        decodeFibers(((uint64_t*)scratchValues.data())[i], valuesOut[i]);
     }
 }
 
@@ -26,6 +26,7 @@
 
 #include "AString.h"
 #include "CaretBinaryFile.h"
+#include "CaretMutex.h"
 #include "CiftiXML.h"
 #include "DataFile.h"
 #include "DataFileException.h"
@@ -42,17 +43,27 @@ namespace caret {
     
     class CaretSparseFile /* : public DataFile */
     {
+        struct CachedRow
+        {
+            int64_t m_row, m_lastUsed;
+            std::vector<int64_t> m_pairs;
+        };
         static void decodeFibers(const uint64_t& coded, FiberFractions& decoded);//takes a uint because right shift on signed is implementation dependent
         CaretBinaryFile m_file;
         int64_t m_dims[2], m_valuesOffset;
-        std::vector<uint64_t> m_indexArray, m_scratchRow;
-        std::vector<int64_t> m_scratchArray, m_scratchSparseRow;
+        std::vector<uint64_t> m_indexArray;
+        const int64_t* m_mappedValues;//the whole values section as index, value pairs, when the file could be memory mapped, which makes m_indexArray and this a CSR matrix
+        CaretMutex m_readMutex;//protects m_file and the row cache, which are only used when the file isn't mapped
+        std::vector<CachedRow> m_rowCache;
+        int64_t m_cacheClock;
+        static bool s_memoryMapping;
         CaretSparseFile(const CaretSparseFile& rhs);
         CiftiXML m_xml;
+        const int64_t* getRowPairs(const int64_t& index, std::vector<int64_t>& scratch, int64_t& numNonzeroOut);//pointer is into the mapping or scratch
     public:
         const int64_t* getDimensions() { return m_dims; }
 
-        CaretSparseFile() {};
+        CaretSparseFile() { m_mappedValues = NULL; m_cacheClock = 0; }
         
         virtual void readFile(const AString& filename);
         
@@ -63,6 +74,14 @@ namespace caret {
         ///get a reference to the XML data
         const CiftiXML& getCiftiXML() const { return m_xml; }
         
+        ///whether the values are memory mapped, otherwise rows are read from the file through a small cache
+        bool isMapped() const { return m_mappedValues != NULL; }
+        
+        ///whether files opened afterwards try to memory map their values, turning it off is mainly for testing the cached reads
+        static void setMemoryMapping(const bool& enabled) { s_memoryMapping = enabled; }
+        static bool getMemoryMapping() { return s_memoryMapping; }
+        
+        ///the row getters may be called from multiple threads at once
         void getRow(const int64_t& index, int64_t* rowOut);
         
         void getRowSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<int64_t>& valuesOut);
@@ -70,6 +89,7 @@ namespace caret {
         void getFibersRow(const int64_t& index, FiberFractions* rowOut);
         
         void getFibersRowSparse(const int64_t& index, std::vector<int64_t>& indicesOut, std::vector<FiberFractions>& valuesOut);
+        
 
         virtual ~CaretSparseFile();
     };
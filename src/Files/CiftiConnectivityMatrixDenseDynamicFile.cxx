@@ -19,8 +19,11 @@
  */
 /*LICENSE_END*/
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <new>
 
 #define __CIFTI_CONNECTIVITY_MATRIX_DENSE_DYNAMIC_FILE_DECLARE__
 #include "CiftiConnectivityMatrixDenseDynamicFile.h"
@@ -31,11 +34,38 @@
 #include "CaretOMP.h"
 #include "CiftiBrainordinateDataSeriesFile.h"
 #include "CiftiFile.h"
+#include "DotProductKernels.h"
 #include "FileInformation.h"
 #include "SceneClassAssistant.h"
 
 using namespace caret;
 
+namespace
+{
+    const int32_t BLOCK_ROWS = 64;//rows of the data matrix a thread correlates at once
+    const int32_t DOT_ROWS = 4;//rows converted from bfloat16 at once
+    
+    //bfloat16 is the upper half of a float32, round to nearest even when dropping the lower half
+    uint16_t floatToBFloat16(const float& value)
+    {
+        union { float f; uint32_t u; } bits;
+        bits.f = value;
+        const uint32_t rounding = 0x7FFF + ((bits.u >> 16) & 1);
+        return (uint16_t)((bits.u + rounding) >> 16);
+    }
+    
+    CARET_DOT_TARGETS
+    void bfloat16ToFloat(const uint16_t* in, const int32_t& length, float* out)
+    {
+        union { float f; uint32_t u; } bits;
+        for (int32_t k = 0; k < length; ++k)
+        {
+            bits.u = ((uint32_t)in[k]) << 16;
+            out[k] = bits.f;
+        }
+    }
+}
+
 /**
  * \class caret::CiftiConnectivityMatrixDenseDynamicFile 
  * \brief Connectivity Dynamic Dense x Dense File version of data-series
@@ -61,7 +91,7 @@ m_numberOfBrainordinates(-1),
 m_numberOfTimePoints(-1),
 m_validDataFlag(false),
 m_enabledAsLayer(true),
-m_cacheDataFlag(false)
+m_maximumFloatDataBytes(s_defaultMaximumFloatDataBytes)
 {
     CaretAssert(m_parentDataSeriesFile);
 
@@ -95,6 +125,19 @@ CiftiConnectivityMatrixDenseDynamicFile::getParentBrainordinateDataSeriesFile()
     return m_parentDataSeriesFile;
 }
 
+/**
+ * Set the size above which the normalized data is stored as bfloat16
+ * instead of float.  Takes effect at the next updateAfterReading().
+ *
+ * @param maximumFloatDataBytes
+ *     Maximum size, in bytes, of normalized data stored as float.
+ */
+void
+CiftiConnectivityMatrixDenseDynamicFile::setMaximumFloatDataBytes(const int64_t maximumFloatDataBytes)
+{
+    m_maximumFloatDataBytes = maximumFloatDataBytes;
+}
+
 /**
  * @return True if enabled as a layer.
  */
@@ -164,30 +207,67 @@ CiftiConnectivityMatrixDenseDynamicFile::updateAfterReading(const CiftiFile* cif
     m_numberOfBrainordinates = ciftiXML.getBrainModelsMap(CiftiXML::ALONG_COLUMN).getLength();
     m_numberOfTimePoints     = ciftiXML.getSeriesMap(CiftiXML::ALONG_ROW).getLength();
     
-    m_rowData.clear();
+    m_normalizedData.clear();
+    m_normalizedDataBFloat16.clear();
     
     if ((m_numberOfBrainordinates > 0)
         && (m_numberOfTimePoints > 0)) {
-        m_rowData.resize(m_numberOfBrainordinates);
-        
-        if (m_cacheDataFlag) {
-            /*
-             * Read all of the data.  Time-series type files are not
-             * too large and by caching the data, it eliminates
-             * numerous calls to read the data when correlation
-             * is performed.
-             *
-             * READ DATA FROM PARENT FILE
-             */
-            for (int32_t i = 0; i < m_numberOfBrainordinates; i++) {
-                CaretAssertVectorIndex(m_rowData, i);
-                m_rowData[i].m_data.resize(m_numberOfTimePoints);
-                m_parentDataSeriesCiftiFile->getRow(&m_rowData[i].m_data[0],
-                                                    i);
+        /*
+         * Each row is normalized to zero mean and unit length so that
+         * the correlation of two rows is the dot product of the rows
+         * and loading a row is one matrix-vector product.
+         */
+        const int64_t numberOfValues = (static_cast<int64_t>(m_numberOfBrainordinates)
+                                        * m_numberOfTimePoints);
+        const bool bfloat16Flag = ((numberOfValues * static_cast<int64_t>(sizeof(float)))
+                                   > m_maximumFloatDataBytes);
+        try {
+            if (bfloat16Flag) {
+                m_normalizedDataBFloat16.resize(numberOfValues);
+                CaretLogInfo("Dense dynamic data for "
+                             + getFileNameNoPath()
+                             + " is stored as bfloat16 to reduce memory usage");
             }
+            else {
+                m_normalizedData.resize(numberOfValues);
+            }
+        }
+        catch (const std::bad_alloc&) {
+            m_normalizedData.clear();
+            m_normalizedDataBFloat16.clear();
+            CaretLogSevere("Unable to allocate memory for dense dynamic data of "
+                           + getFileNameNoPath());
+            return;
         }
         
-        preComputeRowMeanAndSumSquared();
+        /*
+         * TSC: hyperthreading means some cores end up "faster" than others, so "static" scheduling is generally not as fast
+         * there is almost no overhead to dynamic scheduling
+         */
+#pragma omp CARET_PAR
+        {
+            std::vector<float> data(m_numberOfTimePoints);
+            std::vector<float> normalizedData(m_numberOfTimePoints);
+#pragma omp CARET_FOR schedule(dynamic)
+            for (int32_t iRow = 0; iRow < m_numberOfBrainordinates; iRow++) {
+#pragma omp critical
+                {//TSC: this can do disk access, which is not currently thread-safe
+                    m_parentDataSeriesCiftiFile->getRow(&data[0], iRow);
+                }
+                const int64_t rowOffset = static_cast<int64_t>(iRow) * m_numberOfTimePoints;
+                if (bfloat16Flag) {
+                    normalizeData(&data[0],
+                                  &normalizedData[0]);
+                    for (int32_t i = 0; i < m_numberOfTimePoints; i++) {
+                        m_normalizedDataBFloat16[rowOffset + i] = floatToBFloat16(normalizedData[i]);
+                    }
+                }
+                else {
+                    normalizeData(&data[0],
+                                  &m_normalizedData[rowOffset]);
+                }
+            }
+        }
         
         m_validDataFlag = true;
     }
@@ -267,25 +347,19 @@ CiftiConnectivityMatrixDenseDynamicFile::getProcessedDataForRow(float* dataOut,
         return;
     }
     
-    std::vector<float> rowData(m_numberOfTimePoints);
-    m_parentDataSeriesCiftiFile->getRow(&rowData[0], index);
-    const float mean = m_rowData[index].m_mean;
-    const float ssxx = m_rowData[index].m_sqrt_ssxx;
-    
-    /*
-     * TSC: hyperthreading means some cores end up "faster" than others, so "static" scheduling is generally not as fast
-     * there is almost no overhead to dynamic scheduling
-     */
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int32_t iRow = 0; iRow < m_numberOfBrainordinates; iRow++) {
-        float coefficient = 1.0;
-        
-        if (iRow != index) {
-            coefficient = correlation(rowData, mean, ssxx, iRow, m_numberOfTimePoints);
-        }
-        
-        dataOut[iRow] = coefficient;
+    if ( ! m_validDataFlag) {
+        return;
     }
+    CaretAssert((index >= 0) && (index < m_numberOfBrainordinates));
+    
+    std::vector<float> normalizedData(m_numberOfTimePoints);
+    getNormalizedRow(index,
+                     &normalizedData[0]);
+    
+    correlateWithAllRows(&normalizedData[0],
+                         dataOut);
+    
+    dataOut[index] = 1.0;
 }
 
 /**
@@ -315,260 +389,155 @@ CiftiConnectivityMatrixDenseDynamicFile::processRowAverageData(std::vector<float
         return;
     }
     
-    float mean = 0.0;
-    float sumSquared = 0.0;
-    computeDataMeanAndSumSquared(&rowAverageDataInOut[0],
-                                 dataLength,
-                                 mean,
-                                 sumSquared);
+    if ( ! m_validDataFlag) {
+        return;
+    }
     
-    std::vector<float> processedRowAverageData(m_numberOfBrainordinates);
+    std::vector<float> normalizedData(dataLength);
+    normalizeData(&rowAverageDataInOut[0],
+                  &normalizedData[0]);
     
-    /*
-     * TSC: hyperthreading means some cores end up "faster" than others, so "static" scheduling is generally not as fast
-     * there is almost no overhead to dynamic scheduling
-     */
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int32_t iRow = 0; iRow < m_numberOfBrainordinates; iRow++) {
-        const float coefficient = correlation(rowAverageDataInOut,
-                                              mean,
-                                              sumSquared,
-                                              iRow,
-                                              dataLength);
-        CaretAssertVectorIndex(processedRowAverageData, iRow);
-        processedRowAverageData[iRow] = coefficient;
-    }
+    std::vector<float> processedRowAverageData(m_numberOfBrainordinates);
+    correlateWithAllRows(&normalizedData[0],
+                         &processedRowAverageData[0]);
     
     rowAverageDataInOut = processedRowAverageData;
 }
 
-
 /**
- * Compute the mean and sum-squared for each row so that they
- * are only calculated once.
- */
-void
-CiftiConnectivityMatrixDenseDynamicFile::preComputeRowMeanAndSumSquared()
-{
-    CaretAssert(m_numberOfBrainordinates > 0);
-    CaretAssert(m_numberOfTimePoints > 0);
-
-    /*
-     * TSC: hyperthreading means some cores end up "faster" than others, so "static" scheduling is generally not as fast
-     * there is almost no overhead to dynamic scheduling
-     */
-#pragma omp CARET_PARFOR schedule(dynamic)
-    for (int32_t iRow = 0; iRow < m_numberOfBrainordinates; iRow++) {
-
-        CaretAssertVectorIndex(m_rowData, iRow);
-        
-        if (m_cacheDataFlag) {
-            CaretAssertVectorIndex(m_rowData[iRow].m_data, (m_numberOfTimePoints - 1));
-            computeDataMeanAndSumSquared(&m_rowData[iRow].m_data[0],
-                                         m_numberOfTimePoints,
-                                         m_rowData[iRow].m_mean,
-                                         m_rowData[iRow].m_sqrt_ssxx);
-        }
-        else {
-            std::vector<float> data(m_numberOfTimePoints);
-#pragma omp critical
-            {//TSC: this can do disk access, which is not currently thread-safe
-                m_parentDataSeriesCiftiFile->getRow(&data[0], iRow);
-            }
-            computeDataMeanAndSumSquared(&data[0],
-                                         m_numberOfTimePoints,
-                                         m_rowData[iRow].m_mean,
-                                         m_rowData[iRow].m_sqrt_ssxx);
-        }
-        
-//        double sum = 0.0;
-//        double sumSquared = 0.0;
-//        if (m_cacheDataFlag) {
-//            for (int32_t iPoint = 0; iPoint < m_numberOfTimePoints; iPoint++) {
-//                CaretAssertVectorIndex(m_rowData[iRow].m_data, iPoint);
-//                const float d = m_rowData[iRow].m_data[iPoint];
-//                sum        += d;
-//                sumSquared += (d * d);
-//            }
-//        }
-//        else {
-//            std::vector<float> data(m_numberOfTimePoints);
-//            m_parentDataSeriesCiftiFile->getRow(&data[0], iRow);
-//            for (int32_t iPoint = 0; iPoint < m_numberOfTimePoints; iPoint++) {
-//                CaretAssertVectorIndex(data, iPoint);
-//                const float d = data[iPoint];
-//                sum        += d;
-//                sumSquared += (d * d);
-//            }
-//        }
-//        
-//        const float mean       = (sum / numPointsFloat);
-//        const float ssxx = (sumSquared - (numPointsFloat * mean * mean));
-//        CaretAssert(ssxx >= 0.0);
-//        
-//        const float meanDiff = std::fabs(mean - m_rowData[iRow].m_mean);
-//        const float ssDiff   = std::fabs(std::sqrt(ssxx) - m_rowData[iRow].m_sqrt_ssxx);
-//        if ((meanDiff > 0.0001) || (ssDiff > 0.0001)) {
-//            std::cout << "Mean/SS diff" << std::endl;
-//        }
-//        
-//        m_rowData[iRow].m_mean = mean;
-//        m_rowData[iRow].m_sqrt_ssxx = std::sqrt(ssxx);
-    }
-}
-
-/**
- * Compute data's mean and sum-squared
+ * Normalize data, with a length of the number of time points, to zero
+ * mean and unit length.  If the data does not vary, or contains a
+ * non-finite value, the output is all zeros so that its correlation
+ * with any other data is zero.
  *
  * @param data
- *     Data on which mean and sum-squared are calculated
- * @param dataLength
- *     Number of items in data.
- * @param meanOut
- *     Output with mean of data.
- * @param sumSquaredOut
- *     Output with sum-squared.
+ *     Data that is normalized.
+ * @param normalizedDataOut
+ *     Output with normalized data.
  */
 void
-CiftiConnectivityMatrixDenseDynamicFile::computeDataMeanAndSumSquared(const float* data,
-                                                                      const int32_t dataLength,
-                                                                      float& meanOut,
-                                                                      float& sumSquaredOut) const
+CiftiConnectivityMatrixDenseDynamicFile::normalizeData(const float* data,
+                                                       float* normalizedDataOut) const
 {
-    meanOut = 0.0;
-    sumSquaredOut = 0.0;
-    if (dataLength <= 0) {
-        return;
-    }
+    const int32_t dataLength = m_numberOfTimePoints;
+    CaretAssert(dataLength > 0);
     
     double sum = 0.0;
-    double sumSquared = 0.0;
+    for (int32_t i = 0; i < dataLength; i++) {
+        sum += data[i];
+    }
+    const double mean = sum / dataLength;
     
+    double sumSquared = 0.0;
     for (int32_t i = 0; i < dataLength; i++) {
-        const float d = data[i];
-        sum        += d;
+        const double d = data[i] - mean;
         sumSquared += (d * d);
     }
+    const double length = std::sqrt(sumSquared);
     
-    meanOut = (sum / dataLength);
-    const float ssxx = (sumSquared - (dataLength * meanOut * meanOut));
-    //TSC: do not assert things that depend on input file content (a NaN in the data will trip it), you could print a warning instead
-    //CaretAssert(ssxx >= 0.0);
-    sumSquaredOut = std::sqrt(ssxx);
+    //TSC: do not assert things that depend on input file content (a NaN in the data will trip it)
+    if ((length > 0.0)
+        && (length == length)
+        && (length < std::numeric_limits<double>::infinity())) {
+        for (int32_t i = 0; i < dataLength; i++) {
+            normalizedDataOut[i] = (data[i] - mean) / length;
+        }
+    }
+    else {
+        std::fill(normalizedDataOut,
+                  normalizedDataOut + dataLength,
+                  0.0f);
+    }
 }
 
-
 /**
- * Correlation from https://en.wikipedia.org/wiki/Pearson_product-moment_correlation_coefficient
+ * Get the normalized data for a row.
  *
- * @param data
- *     Data for correlation
- * @param mean
- *     Mean of data
- * @param sumSquared
- *     Sum squared of data.
- * @param otherRowIndex
- *     Index of another row
- * @param numberOfPoints
- *     Number of points int the two arrays
- * @return
- *     The correlation coefficient computed on the two arrays.
+ * @param rowIndex
+ *     Index of the row.
+ * @param normalizedDataOut
+ *     Output with normalized data, length is number of time points.
  */
-float
-CiftiConnectivityMatrixDenseDynamicFile::correlation(const std::vector<float>& data,
-                                                     const float mean,
-                                                     const float sumSquared,
-                                                     const int32_t otherRowIndex,
-                                                     const int32_t numberOfPoints) const
+void
+CiftiConnectivityMatrixDenseDynamicFile::getNormalizedRow(const int64_t rowIndex,
+                                                          float* normalizedDataOut) const
 {
-    const double numFloat = numberOfPoints;
-    double xySum = 0.0;
-    
-    CaretAssertVectorIndex(m_rowData, otherRowIndex);
-    const RowData& otherData = m_rowData[otherRowIndex];
-    
-    if (m_cacheDataFlag) {
-        for (int i = 0; i < numberOfPoints; i++) {
-            CaretAssertVectorIndex(data, i);
-            CaretAssertVectorIndex(otherData.m_data, i);
-            xySum += data[i] * otherData.m_data[i];
-        }
+    const int64_t rowOffset = rowIndex * m_numberOfTimePoints;
+    if ( ! m_normalizedDataBFloat16.empty()) {
+        CaretAssertVectorIndex(m_normalizedDataBFloat16, rowOffset + m_numberOfTimePoints - 1);
+        bfloat16ToFloat(&m_normalizedDataBFloat16[rowOffset],
+                        m_numberOfTimePoints,
+                        normalizedDataOut);
     }
     else {
-        std::vector<float> otherDataVector(m_numberOfTimePoints);
-        m_parentDataSeriesCiftiFile->getRow(&otherDataVector[0], otherRowIndex);
-        
-        for (int i = 0; i < numberOfPoints; i++) {
-            CaretAssertVectorIndex(data, i);
-            CaretAssertVectorIndex(otherDataVector, i);
-            xySum += data[i] * otherDataVector[i];
-        }
+        CaretAssertVectorIndex(m_normalizedData, rowOffset + m_numberOfTimePoints - 1);
+        std::copy(m_normalizedData.begin() + rowOffset,
+                  m_normalizedData.begin() + rowOffset + m_numberOfTimePoints,
+                  normalizedDataOut);
     }
-    
-    const double ssxy = xySum - (numFloat * mean * otherData.m_mean);
-    
-    float correlationCoefficient = 0.0;
-    if ((sumSquared > 0.0)
-        && (otherData.m_sqrt_ssxx > 0.0)) {
-        correlationCoefficient = (ssxy / (sumSquared * otherData.m_sqrt_ssxx));
-    }
-    return correlationCoefficient;
 }
 
 /**
- * Correlation from https://en.wikipedia.org/wiki/Pearson_product-moment_correlation_coefficient
+ * Correlate normalized data with every row.  Since the rows are also
+ * normalized, each correlation is a dot product and all of them are
+ * one matrix-vector product, which is computed in blocks of rows.
  *
- * @param rowIndex
- *     Index of a row
- * @param otherRowIndex
- *     Index of another row
- * @param numberOfPoints
- *     Number of points int the two arrays
- * @return
- *     The correlation coefficient computed on the two arrays.
+ * @param normalizedData
+ *     Normalized data, length is number of time points.
+ * @param dataOut
+ *     Output with correlation to each row, length is number of brainordinates.
  */
-float
-CiftiConnectivityMatrixDenseDynamicFile::correlation(const int32_t rowIndex,
-                                                     const int32_t otherRowIndex,
-                                                     const int32_t numberOfPoints) const
+void
+CiftiConnectivityMatrixDenseDynamicFile::correlateWithAllRows(const float* normalizedData,
+                                                              float* dataOut) const
 {
-    const double numFloat = numberOfPoints;
-    double xySum = 0.0;
-    
-    CaretAssertVectorIndex(m_rowData, rowIndex);
-    CaretAssertVectorIndex(m_rowData, otherRowIndex);
-    const RowData& data = m_rowData[rowIndex];
-    const RowData& otherData = m_rowData[otherRowIndex];
+    const int32_t numberOfRows = m_numberOfBrainordinates;
+    const int32_t dataLength = m_numberOfTimePoints;
+    const bool bfloat16Flag = ( ! m_normalizedDataBFloat16.empty());
+    const int32_t numberOfBlocks = (numberOfRows + BLOCK_ROWS - 1) / BLOCK_ROWS;
     
-    if (m_cacheDataFlag) {
-        for (int i = 0; i < numberOfPoints; i++) {
-            CaretAssertVectorIndex(data.m_data, i);
-            CaretAssertVectorIndex(otherData.m_data, i);
-            xySum += data.m_data[i] * otherData.m_data[i];
-        }
-    }
-    else {
-        std::vector<float> dataVector(m_numberOfTimePoints);
-        std::vector<float> otherDataVector(m_numberOfTimePoints);
-        m_parentDataSeriesCiftiFile->getRow(&dataVector[0], rowIndex);
-        m_parentDataSeriesCiftiFile->getRow(&otherDataVector[0], otherRowIndex);
-        
-        for (int i = 0; i < numberOfPoints; i++) {
-            CaretAssertVectorIndex(dataVector, i);
-            CaretAssertVectorIndex(otherDataVector, i);
-            xySum += dataVector[i] * otherDataVector[i];
+    /*
+     * TSC: hyperthreading means some cores end up "faster" than others, so "static" scheduling is generally not as fast
+     * there is almost no overhead to dynamic scheduling
+     */
+#pragma omp CARET_PAR
+    {
+        std::vector<float> rowScratch(bfloat16Flag ? (DOT_ROWS * dataLength) : 0);//bfloat16 rows are converted to float before the dot product
+        const float* rowPointers[DOT_ROWS];
+        double dotOut[DOT_ROWS];
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int32_t iBlock = 0; iBlock < numberOfBlocks; iBlock++) {
+            const int32_t blockStart = iBlock * BLOCK_ROWS;
+            const int32_t blockEnd = std::min(numberOfRows, blockStart + BLOCK_ROWS);
+            for (int32_t iRow = blockStart; iRow < blockEnd; iRow += DOT_ROWS) {
+                const int32_t numDotRows = std::min(DOT_ROWS, blockEnd - iRow);
+                for (int32_t r = 0; r < numDotRows; r++) {
+                    const int64_t rowOffset = static_cast<int64_t>(iRow + r) * dataLength;
+                    if (bfloat16Flag) {
+                        float* scratchRow = &rowScratch[r * dataLength];
+                        bfloat16ToFloat(&m_normalizedDataBFloat16[rowOffset],
+                                        dataLength,
+                                        scratchRow);
+                        rowPointers[r] = scratchRow;
+                    }
+                    else {
+                        rowPointers[r] = &m_normalizedData[rowOffset];
+                    }
+                }
+                dotProductTile(&normalizedData,
+                               1,
+                               rowPointers,
+                               numDotRows,
+                               dataLength,
+                               dotOut);
+                for (int32_t r = 0; r < numDotRows; r++) {
+                    dataOut[iRow + r] = dotOut[r];
+                }
+            }
         }
     }
-    
-    const double ssxy = xySum - (numFloat * data.m_mean * otherData.m_mean);
-    
-    float correlationCoefficient = 0.0;
-    if ((data.m_sqrt_ssxx > 0.0)
-        && (otherData.m_sqrt_ssxx > 0.0)) {
-        correlationCoefficient = (ssxy / (data.m_sqrt_ssxx * otherData.m_sqrt_ssxx));
-    }
-    return correlationCoefficient;
 }
+
 /**
  * Save subclass data to the scene.
  *
@@ -49,6 +49,8 @@ namespace caret {
         
         const CiftiBrainordinateDataSeriesFile* getParentBrainordinateDataSeriesFile() const;
         
+        void setMaximumFloatDataBytes(const int64_t maximumFloatDataBytes);
+        
     private:
         CiftiConnectivityMatrixDenseDynamicFile(const CiftiConnectivityMatrixDenseDynamicFile&);
 
@@ -72,33 +74,14 @@ namespace caret {
                                                   const SceneClass* sceneClass);
         
     private:
-        class RowData {
-        public:
-            RowData() { }
-            
-            ~RowData() { }
-            
-            std::vector<float> m_data;
-            float m_mean;
-            float m_sqrt_ssxx;
-        };
-        
-        float correlation(const int32_t rowIndex,
-                          const int32_t otherRowIndex,
-                          const int32_t numberOfPoints) const;
-        
-        float correlation(const std::vector<float>& data,
-                          const float mean,
-                          const float sumSquared,
-                          const int32_t otherRowIndex,
-                          const int32_t numberOfPoints) const;
-        
-        void preComputeRowMeanAndSumSquared();
-        
-        void computeDataMeanAndSumSquared(const float* data,
-                                          const int32_t dataLength,
-                                          float& meanOut,
-                                          float& sumSquaredOut) const;
+        void normalizeData(const float* data,
+                           float* normalizedDataOut) const;
+        
+        void getNormalizedRow(const int64_t rowIndex,
+                              float* normalizedDataOut) const;
+        
+        void correlateWithAllRows(const float* normalizedData,
+                                  float* dataOut) const;
         
         CiftiBrainordinateDataSeriesFile* m_parentDataSeriesFile;
         
@@ -108,13 +91,20 @@ namespace caret {
         
         int32_t m_numberOfTimePoints;
         
-        std::vector<RowData> m_rowData;
+        /** Each row's time-series with zero mean and unit length, one row after another */
+        std::vector<float> m_normalizedData;
+        
+        /** Used instead of m_normalizedData, as bfloat16 values, when the data is large */
+        std::vector<uint16_t> m_normalizedDataBFloat16;
         
         bool m_validDataFlag;
         
         bool m_enabledAsLayer;
         
-        const bool m_cacheDataFlag;
+        /** Larger normalized data is stored as bfloat16 */
+        int64_t m_maximumFloatDataBytes;
+        
+        static const int64_t s_defaultMaximumFloatDataBytes;
         
         CaretPointer<SceneClassAssistant> m_sceneAssistant;
         
@@ -123,7 +113,7 @@ namespace caret {
     };
     
 #ifdef __CIFTI_CONNECTIVITY_MATRIX_DENSE_DYNAMIC_FILE_DECLARE__
-    // <PLACE DECLARATIONS OF STATIC MEMBERS HERE>
+    const int64_t CiftiConnectivityMatrixDenseDynamicFile::s_defaultMaximumFloatDataBytes = 1024 * 1024 * 1024;
 #endif // __CIFTI_CONNECTIVITY_MATRIX_DENSE_DYNAMIC_FILE_DECLARE__
 
 } // namespace
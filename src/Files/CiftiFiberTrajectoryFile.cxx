@@ -1389,8 +1389,14 @@ CiftiFiberTrajectoryFile::loadRowsForAveraging(const std::vector<int64_t>& rowIn
     const CiftiXML& trajXML = m_sparseFile->getCiftiXML();
     const int64_t numberOfColumns = trajXML.getDimensionLength(CiftiXML::ALONG_ROW);
     
-    std::vector<FiberFractions> fiberFractionsForRowVector(numberOfColumns);
-    FiberFractions* fiberFractionsForRow = &fiberFractionsForRowVector[0];
+    /*
+     * Rows are read sparse, so only nonzero entries are decoded,
+     * zero entries still count toward the average
+     */
+    std::vector<int64_t> fiberIndicesForRow;
+    std::vector<FiberFractions> fiberFractionsForRow;
+    FiberFractions zeroFiberFractions;
+    zeroFiberFractions.zero();
     
     const int64_t numberOfRowsToLoad = static_cast<int64_t>(rowIndices.size());
     if (numberOfRowsToLoad <= 0) {
@@ -1429,12 +1435,23 @@ CiftiFiberTrajectoryFile::loadRowsForAveraging(const std::vector<int64_t>& rowIn
             }
         }
         
-        m_sparseFile->getFibersRow(rowIndex,
-                                   fiberFractionsForRow);
+        m_sparseFile->getFibersRowSparse(rowIndex,
+                                         fiberIndicesForRow,
+                                         fiberFractionsForRow);
+        CaretAssert(fiberIndicesForRow.size() == fiberFractionsForRow.size());
         
+        const int64_t numberOfNonzero = static_cast<int64_t>(fiberIndicesForRow.size());
+        int64_t iSparse = 0;
         for (int64_t iCol = 0; iCol < numberOfColumns; iCol++) {
             FiberOrientationTrajectory* fot = m_fiberOrientationTrajectories[iCol];
-            fot->addFiberFractionsForAveraging(fiberFractionsForRow[iCol]);
+            if ((iSparse < numberOfNonzero)
+                && (fiberIndicesForRow[iSparse] == iCol)) {
+                fot->addFiberFractionsForAveraging(fiberFractionsForRow[iSparse]);
+                iSparse++;
+            }
+            else {
+                fot->addFiberFractionsForAveraging(zeroFiberFractions);
+            }
         }
     }
     
@@ -28,6 +28,8 @@
 #include "CaretLogger.h"
 #include "ChartableMatrixParcelInterface.h"
 #include "ConnectivityDataLoaded.h"
+#include "ConnectivityMatrixRowCache.h"
+#include "DataFileContentInformation.h"
 #include "DataFileException.h"
 #include "ElapsedTimer.h"
 #include "EventManager.h"
@@ -52,6 +54,7 @@ CiftiMappableConnectivityMatrixDataFile::CiftiMappableConnectivityMatrixDataFile
 : CiftiMappableDataFile(dataFileType)
 {
     m_connectivityDataLoaded = new ConnectivityDataLoaded();
+    m_rowCache = new ConnectivityMatrixRowCache();
     
     /*
      * This method initializes some members
@@ -74,6 +77,7 @@ CiftiMappableConnectivityMatrixDataFile::~CiftiMappableConnectivityMatrixDataFil
     clearPrivate();
     
     delete m_connectivityDataLoaded;
+    delete m_rowCache;
     delete m_sceneAssistant;
 }
 
@@ -83,6 +87,10 @@ CiftiMappableConnectivityMatrixDataFile::~CiftiMappableConnectivityMatrixDataFil
 void
 CiftiMappableConnectivityMatrixDataFile::clear()
 {
+    /*
+     * Prefetching must stop before the CIFTI file is deleted
+     */
+    m_rowCache->clear();
     CiftiMappableDataFile::clear();
     clearPrivate();
 }
@@ -99,6 +107,7 @@ CiftiMappableConnectivityMatrixDataFile::clearPrivate()
     m_rowLoadedText = "";
     m_dataLoadingEnabled = true;
     m_connectivityDataLoaded->reset();
+    m_rowCache->clear();
     m_chartLoadingDimension = ChartMatrixLoadingDimensionEnum::CHART_MATRIX_LOADING_BY_ROW;
     if (getDataFileType() == DataFileTypeEnum::CONNECTIVITY_DENSE_DYNAMIC) {
         m_chartLoadingDimension = ChartMatrixLoadingDimensionEnum::CHART_MATRIX_LOADING_BY_COLUMN;
@@ -155,6 +164,68 @@ CiftiMappableConnectivityMatrixDataFile::isEmpty() const
     return false;
 }
 
+/**
+ * Add information about the file to the data file information.
+ *
+ * @param dataFileInformation
+ *    Consolidates information about a data file.
+ */
+void
+CiftiMappableConnectivityMatrixDataFile::addToDataFileContentInformation(DataFileContentInformation& dataFileInformation)
+{
+    CiftiMappableDataFile::addToDataFileContentInformation(dataFileInformation);
+
+    m_rowCache->addToDataFileContentInformation(m_ciftiFile,
+                                                dataFileInformation);
+}
+
+/**
+ * Start reading, in the background, the rows for the given surface
+ * nodes so that they are available if the user loads data for
+ * any of the nodes (such as nodes neighboring an identified node).
+ * Nothing is done if the file is in memory or data is loaded by column.
+ *
+ * @param surfaceNumberOfNodes
+ *    Number of nodes in the surface.
+ * @param structure
+ *    Structure of the surface.
+ * @param nodeIndices
+ *    Indices of the nodes, most likely to be loaded first.
+ */
+void
+CiftiMappableConnectivityMatrixDataFile::prefetchRowsForSurfaceNodes(const int32_t surfaceNumberOfNodes,
+                                                                     const StructureEnum::Enum structure,
+                                                                     const std::vector<int32_t>& nodeIndices)
+{
+    if (m_ciftiFile == NULL) {
+        return;
+    }
+    if ( ! m_dataLoadingEnabled) {
+        return;
+    }
+
+    /*
+     * Dense dynamic computes its rows and does not read them from the file
+     */
+    if (getDataFileType() == DataFileTypeEnum::CONNECTIVITY_DENSE_DYNAMIC) {
+        return;
+    }
+
+    std::vector<int64_t> rowIndices;
+    std::vector<int64_t> columnIndices;
+    getRowColumnIndicesForNodesWhenLoading(structure,
+                                           surfaceNumberOfNodes,
+                                           nodeIndices,
+                                           rowIndices,
+                                           columnIndices);
+    if (rowIndices.empty()) {
+        return;
+    }
+
+    m_rowCache->prefetchRows(m_ciftiFile,
+                             rowIndices);
+}
+
 /**
  * @return Is loading of data enabled.  Note that if
  * disabled, any previously loaded data is NOT removed
@@ -590,8 +661,9 @@ CiftiMappableConnectivityMatrixDataFile::getDataForColumn(float* dataOut, const
 void
 CiftiMappableConnectivityMatrixDataFile::getDataForRow(float* dataOut, const int64_t& index) const
 {
-    m_ciftiFile->getRow(dataOut,
-                        index);
+    m_rowCache->getRow(m_ciftiFile,
+                       dataOut,
+                       index);
 }
 
 /**
@@ -624,8 +696,9 @@ CiftiMappableConnectivityMatrixDataFile::getProcessedDataForColumn(float* dataOu
 void
 CiftiMappableConnectivityMatrixDataFile::getProcessedDataForRow(float* dataOut, const int64_t& index) const
 {
-    m_ciftiFile->getRow(dataOut,
-                        index);
+    m_rowCache->getRow(m_ciftiFile,
+                       dataOut,
+                       index);
 }
 
 /**
@@ -31,6 +31,7 @@
 namespace caret {
 
     class ConnectivityDataLoaded;
+    class ConnectivityMatrixRowCache;
     class SceneClassAssistant;
     
     class CiftiMappableConnectivityMatrixDataFile :
@@ -76,6 +77,12 @@ namespace caret {
         
         virtual bool isEmpty() const;
 
+        virtual void addToDataFileContentInformation(DataFileContentInformation& dataFileInformation);
+
+        void prefetchRowsForSurfaceNodes(const int32_t surfaceNumberOfNodes,
+                                         const StructureEnum::Enum structure,
+                                         const std::vector<int32_t>& nodeIndices);
+
 		virtual AString getMapName(const int32_t mapIndex) const;
 
         AString getRowName(const int32_t rowIndex) const;
@@ -183,6 +190,9 @@ namespace caret {
         
         ConnectivityDataLoaded* m_connectivityDataLoaded;
         
+        /** Rows read from the file, used when the file is not in memory */
+        ConnectivityMatrixRowCache* m_rowCache;
+        
         /*
          * This is really a member of parcel file since it the parcel
          * file is the only file that can load by row or column.
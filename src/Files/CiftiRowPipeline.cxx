@@ -0,0 +1,206 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiRowPipeline.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "CiftiFile.h"
+#include "MultiDimIterator.h"
+
+#include <algorithm>
+#include <exception>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t DEFAULT_MEM_LIMIT = 256 * 1024 * 1024;//total for both input and both output chunk buffers
+    const int64_t MIN_CHUNKS = 8;//the first read and last write aren't overlapped with anything, so keep them small when there are many items
+    const int64_t ITEMS_PER_THREAD = 4;//but give dynamic scheduling something to balance
+
+    class RowAdapter : public CiftiRowPipeline::Stage
+    {
+        CiftiRowPipeline::RowStage* m_stage;
+        const CiftiFile* m_ciftiIn;
+        CiftiFile* m_ciftiOut;
+        vector<vector<int64_t> > m_indices;
+    public:
+        RowAdapter(CiftiRowPipeline::RowStage* stage, const CiftiFile* ciftiIn, CiftiFile* ciftiOut)
+        {
+            m_stage = stage;
+            m_ciftiIn = ciftiIn;
+            m_ciftiOut = ciftiOut;
+            for (MultiDimIterator<int64_t> iter = ciftiIn->getIteratorOverRows(); !iter.atEnd(); ++iter)
+            {
+                m_indices.push_back(*iter);
+            }
+        }
+        int64_t getNumRows() const { return (int64_t)m_indices.size(); }
+        void readItem(const int64_t& item, float* inputOut)
+        {
+            m_ciftiIn->getRow(inputOut, m_indices[item]);
+        }
+        void computeItem(const int64_t& item, const float* input, float* output, const int& thread)
+        {
+            m_stage->computeRow(m_indices[item], input, output, thread);
+        }
+        void writeItem(const int64_t& item, const float* output)
+        {
+            m_ciftiOut->setRow(output, m_indices[item]);
+        }
+    };
+}
+
+CiftiRowPipeline::Stage::~Stage()
+{
+}
+
+CiftiRowPipeline::RowStage::~RowStage()
+{
+}
+
+int CiftiRowPipeline::getNumThreads()
+{
+#ifdef CARET_OMP
+    return max(1, omp_get_max_threads());
+#else
+    return 1;
+#endif
+}
+
+void CiftiRowPipeline::run(Stage* stage, const int64_t& numItems, const int64_t& inputLength, const int64_t& outputLength, const int64_t& memLimitBytes)
+{
+    CaretAssert(stage != NULL);
+    CaretAssert(inputLength >= 0 && outputLength >= 0);
+    if (numItems < 1) return;
+    int64_t memLimit = memLimitBytes;
+    if (memLimit < 0) memLimit = DEFAULT_MEM_LIMIT;
+    int64_t itemBytes = 2 * (inputLength + outputLength) * sizeof(float);//double buffered
+    int64_t chunkItems = numItems;
+    if (itemBytes > 0)
+    {
+        chunkItems = max((int64_t)1, memLimit / itemBytes);
+    }
+    chunkItems = min(chunkItems, max(ITEMS_PER_THREAD * getNumThreads(), (numItems + MIN_CHUNKS - 1) / MIN_CHUNKS));
+    chunkItems = min(chunkItems, numItems);
+    int64_t numChunks = (numItems + chunkItems - 1) / chunkItems;
+    vector<float> inBuffers[2], outBuffers[2];
+    int numBuffers = (numChunks > 1 ? 2 : 1);//don't double the memory when there is nothing to overlap
+    for (int b = 0; b < numBuffers; ++b)
+    {
+        inBuffers[b].resize(chunkItems * inputLength);
+        outBuffers[b].resize(chunkItems * outputLength);
+    }
+    for (int64_t i = 0; i < chunkItems; ++i)
+    {
+        stage->readItem(i, inBuffers[0].data() + i * inputLength);
+    }
+    bool failed = false;
+    AString failMessage;//exceptions can't leave a parallel region, so save the first message and rethrow after
+    for (int64_t chunk = 0; chunk < numChunks && !failed; ++chunk)
+    {
+        int64_t chunkStart = chunk * chunkItems, chunkEnd = min(numItems, chunkStart + chunkItems);
+        const float* curIn = inBuffers[chunk % 2].data();
+        float* curOut = outBuffers[chunk % 2].data();
+#pragma omp CARET_PAR
+        {
+#pragma omp CARET_SINGLE nowait
+            {
+                try
+                {
+                    if (chunk > 0)
+                    {
+                        int64_t prevStart = chunkStart - chunkItems;
+                        const float* prevOut = outBuffers[(chunk - 1) % 2].data();
+                        for (int64_t i = prevStart; i < chunkStart; ++i)
+                        {
+                            stage->writeItem(i, prevOut + (i - prevStart) * outputLength);
+                        }
+                    }
+                    if (chunk + 1 < numChunks)
+                    {
+                        int64_t nextEnd = min(numItems, chunkEnd + chunkItems);
+                        float* nextIn = inBuffers[(chunk + 1) % 2].data();
+                        for (int64_t i = chunkEnd; i < nextEnd; ++i)
+                        {
+                            stage->readItem(i, nextIn + (i - chunkEnd) * inputLength);
+                        }
+                    }
+                } catch (CaretException& e) {
+#pragma omp critical
+                    {
+                        if (!failed) failMessage = e.whatString();
+                        failed = true;
+                    }
+                } catch (exception& e) {
+#pragma omp critical
+                    {
+                        if (!failed) failMessage = e.what();
+                        failed = true;
+                    }
+                }
+            }//the I/O thread joins the computing when it finishes
+            int thread = 0;
+#ifdef CARET_OMP
+            thread = omp_get_thread_num();
+#endif
+#pragma omp CARET_FOR schedule(dynamic) nowait
+            for (int64_t i = chunkStart; i < chunkEnd; ++i)
+            {
+                try
+                {
+                    stage->computeItem(i, curIn + (i - chunkStart) * inputLength, curOut + (i - chunkStart) * outputLength, thread);
+                } catch (CaretException& e) {
+#pragma omp critical
+                    {
+                        if (!failed) failMessage = e.whatString();
+                        failed = true;
+                    }
+                } catch (exception& e) {
+#pragma omp critical
+                    {
+                        if (!failed) failMessage = e.what();
+                        failed = true;
+                    }
+                }
+            }
+        }
+    }
+    if (failed) throw CaretException(failMessage);
+    int64_t lastStart = (numChunks - 1) * chunkItems;
+    const float* lastOut = outBuffers[(numChunks - 1) % 2].data();
+    for (int64_t i = lastStart; i < numItems; ++i)
+    {
+        stage->writeItem(i, lastOut + (i - lastStart) * outputLength);
+    }
+}
+
+void CiftiRowPipeline::runOverRows(RowStage* stage, const CiftiFile* ciftiIn, CiftiFile* ciftiOut, const int64_t& memLimitBytes)
+{
+    CaretAssert(stage != NULL && ciftiIn != NULL && ciftiOut != NULL);
+    const vector<int64_t>& inDims = ciftiIn->getDimensions(), &outDims = ciftiOut->getDimensions();
+    CaretAssert(inDims.size() == outDims.size());
+    CaretAssert(equal(inDims.begin() + 1, inDims.end(), outDims.begin() + 1));
+    RowAdapter myAdapter(stage, ciftiIn, ciftiOut);
+    run(&myAdapter, myAdapter.getNumRows(), inDims[0], outDims[0], memLimitBytes);
+}
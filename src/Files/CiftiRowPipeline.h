@@ -0,0 +1,66 @@
+#ifndef __CIFTI_ROW_PIPELINE_H__
+#define __CIFTI_ROW_PIPELINE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+
+    class CiftiFile;
+
+    ///streams items (usually cifti rows) through read -> compute -> write, in chunks
+    ///one thread reads the next chunk and writes the previous one while the other threads compute the current chunk
+    class CiftiRowPipeline
+    {
+    public:
+        ///readItem and writeItem are called in item order, from one thread at a time, and never at the same time as each other
+        ///computeItem is called from all threads, in any order, thread is in [0, getNumThreads()) so it can select per-thread scratch
+        class Stage
+        {
+        public:
+            virtual void readItem(const int64_t& item, float* inputOut) = 0;
+            virtual void computeItem(const int64_t& item, const float* input, float* output, const int& thread) = 0;
+            virtual void writeItem(const int64_t& item, const float* output) = 0;
+            virtual ~Stage();
+        };
+
+        ///for the common case of each input row making the output row with the same index, the pipeline does the getRow/setRow
+        class RowStage
+        {
+        public:
+            virtual void computeRow(const std::vector<int64_t>& index, const float* inRow, float* outRow, const int& thread) = 0;
+            virtual ~RowStage();
+        };
+
+        static int getNumThreads();
+
+        ///memLimitBytes is for the chunk buffers, the actual number of items per chunk is also limited so that reading the first chunk doesn't take too long, -1 for default
+        static void run(Stage* stage, const int64_t& numItems, const int64_t& inputLength, const int64_t& outputLength, const int64_t& memLimitBytes = -1);
+
+        ///ciftiOut must already have its XML set, and have the same dimensions as ciftiIn except the row length
+        static void runOverRows(RowStage* stage, const CiftiFile* ciftiIn, CiftiFile* ciftiOut, const int64_t& memLimitBytes = -1);
+    };
+
+}
+
+#endif //__CIFTI_ROW_PIPELINE_H__
@@ -0,0 +1,261 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ClusterLabelingHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "TopologyHelper.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int BLOCKS_PER_THREAD = 4;
+    const int64_t MIN_BLOCK_ELEMENTS = 16384;//don't bother threading small maps
+
+    typedef vector<pair<int64_t, int64_t> > EdgeList;
+
+    //every link points to a lower index, so the root of a tree is its lowest element
+    int64_t findRoot(int64_t* parent, int64_t elem)
+    {
+        while (parent[elem] != elem)
+        {
+            parent[elem] = parent[parent[elem]];//path halving
+            elem = parent[elem];
+        }
+        return elem;
+    }
+
+    void unite(int64_t* parent, const int64_t& first, const int64_t& second)
+    {
+        int64_t root1 = findRoot(parent, first), root2 = findRoot(parent, second);
+        if (root1 < root2)
+        {
+            parent[root2] = root1;
+        } else if (root2 < root1) {
+            parent[root1] = root2;
+        }
+    }
+
+    int getNumBlocks(const int64_t& numElements)
+    {
+        int numThreads = 1;
+#ifdef CARET_OMP
+        if (!omp_in_parallel()) numThreads = max(1, omp_get_max_threads());
+#endif
+        return (int)max((int64_t)1, min((int64_t)(numThreads * BLOCKS_PER_THREAD), numElements / MIN_BLOCK_ELEMENTS));
+    }
+
+    //links between blocks were only recorded, merge them, then turn the forest into cluster numbers in a single increasing pass
+    int64_t finishLabels(int64_t* parent, const int64_t& numElements, const vector<EdgeList>& crossEdges, vector<int64_t>& countsOut)
+    {
+        for (size_t b = 0; b < crossEdges.size(); ++b)
+        {
+            for (size_t e = 0; e < crossEdges[b].size(); ++e)
+            {
+                unite(parent, crossEdges[b][e].first, crossEdges[b][e].second);
+            }
+        }
+        countsOut.clear();
+        for (int64_t i = 0; i < numElements; ++i)
+        {
+            int64_t myParent = parent[i];
+            if (myParent < 0) continue;
+            if (myParent == i)
+            {
+                parent[i] = (int64_t)countsOut.size();
+                countsOut.push_back(1);
+            } else {//lower elements already hold their cluster number
+                parent[i] = parent[myParent];
+                ++countsOut[parent[i]];
+            }
+        }
+        return (int64_t)countsOut.size();
+    }
+}
+
+int64_t ClusterLabelingHelper::labelVolume(const char* marked, const int64_t dims[3], const int& connectivity, int64_t* labelsOut, vector<int64_t>& sizesOut)
+{
+    int maxNonzero = 0;
+    switch (connectivity)
+    {
+        case 6:
+            maxNonzero = 1;
+            break;
+        case 18:
+            maxNonzero = 2;
+            break;
+        case 26:
+            maxNonzero = 3;
+            break;
+        default:
+            throw CaretException("voxel connectivity must be 6, 18, or 26");
+    }
+    vector<int> lowerOffsets;//only look at neighbors that come earlier in index order, every link is seen once from its higher end
+    for (int dk = -1; dk <= 0; ++dk)
+    {
+        for (int dj = -1; dj <= 1; ++dj)
+        {
+            for (int di = -1; di <= 1; ++di)
+            {
+                if (dk == 0 && (dj > 0 || (dj == 0 && di >= 0))) continue;
+                if ((di != 0) + (dj != 0) + (dk != 0) > maxNonzero) continue;
+                lowerOffsets.push_back(di);
+                lowerOffsets.push_back(dj);
+                lowerOffsets.push_back(dk);
+            }
+        }
+    }
+    const int numOffsets = (int)lowerOffsets.size() / 3;
+    const int64_t numRows = dims[1] * dims[2], frameSize = numRows * dims[0];
+    vector<int64_t> parentScratch;
+    int64_t* parent = labelsOut;
+    if (parent == NULL)
+    {
+        parentScratch.resize(frameSize);
+        parent = parentScratch.data();
+    }
+    int numBlocks = (int)min((int64_t)getNumBlocks(frameSize), max((int64_t)1, numRows));
+    vector<EdgeList> crossEdges(numBlocks);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        int64_t rowStart = numRows * b / numBlocks, rowEnd = numRows * (b + 1) / numBlocks;
+        int64_t blockStart = rowStart * dims[0];
+        EdgeList& myEdges = crossEdges[b];
+        for (int64_t row = rowStart; row < rowEnd; ++row)
+        {
+            int64_t j = row % dims[1], k = row / dims[1];
+            int64_t rowBase = row * dims[0];
+            for (int64_t i = 0; i < dims[0]; ++i)
+            {
+                int64_t index = rowBase + i;
+                if (!marked[index])
+                {
+                    parent[index] = -1;
+                    continue;
+                }
+                parent[index] = index;
+                for (int n = 0; n < numOffsets; ++n)
+                {
+                    int64_t ni = i + lowerOffsets[n * 3], nj = j + lowerOffsets[n * 3 + 1], nk = k + lowerOffsets[n * 3 + 2];
+                    if (ni < 0 || ni >= dims[0] || nj < 0 || nj >= dims[1] || nk < 0) continue;
+                    int64_t neighIndex = ni + dims[0] * (nj + dims[1] * nk);
+                    if (!marked[neighIndex]) continue;
+                    if (neighIndex >= blockStart)
+                    {
+                        unite(parent, neighIndex, index);
+                    } else {
+                        myEdges.push_back(make_pair(neighIndex, index));
+                    }
+                }
+            }
+        }
+    }
+    return finishLabels(parent, frameSize, crossEdges, sizesOut);
+}
+
+int64_t ClusterLabelingHelper::labelSurface(const char* marked, const TopologyHelper* myTopoHelp, const float* nodeAreas, int64_t* labelsOut, vector<double>& sizesOut)
+{
+    CaretAssert(myTopoHelp != NULL);
+    const int64_t numNodes = myTopoHelp->getNumberOfNodes();
+    vector<int64_t> parentScratch;
+    int64_t* parent = labelsOut;
+    if (parent == NULL)
+    {
+        parentScratch.resize(numNodes);
+        parent = parentScratch.data();
+    }
+    int numBlocks = getNumBlocks(numNodes);
+    vector<EdgeList> crossEdges(numBlocks);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        int64_t blockStart = numNodes * b / numBlocks, blockEnd = numNodes * (b + 1) / numBlocks;
+        EdgeList& myEdges = crossEdges[b];
+        for (int64_t node = blockStart; node < blockEnd; ++node)
+        {
+            if (!marked[node])
+            {
+                parent[node] = -1;
+                continue;
+            }
+            parent[node] = node;
+            int32_t numNeigh = 0;
+            const int32_t* neighbors = myTopoHelp->getNodeNeighbors((int32_t)node, numNeigh);
+            for (int32_t n = 0; n < numNeigh; ++n)
+            {
+                int64_t neighbor = neighbors[n];
+                if (neighbor >= node || !marked[neighbor]) continue;//neighbor lists are symmetric, so take each link from its higher end
+                if (neighbor >= blockStart)
+                {
+                    unite(parent, neighbor, node);
+                } else {
+                    myEdges.push_back(make_pair(neighbor, node));
+                }
+            }
+        }
+    }
+    vector<int64_t> counts;
+    int64_t numClusters = finishLabels(parent, numNodes, crossEdges, counts);
+    sizesOut.resize(numClusters);
+    if (nodeAreas == NULL)
+    {
+        for (int64_t c = 0; c < numClusters; ++c)
+        {
+            sizesOut[c] = counts[c];
+        }
+    } else {
+        for (int64_t c = 0; c < numClusters; ++c)
+        {
+            sizesOut[c] = 0.0;
+        }
+        for (int64_t node = 0; node < numNodes; ++node)
+        {
+            if (parent[node] >= 0) sizesOut[parent[node]] += nodeAreas[node];
+        }
+    }
+    return numClusters;
+}
+
+void ClusterLabelingHelper::getMembers(const int64_t* labels, const int64_t& numElements, const int64_t& numClusters, vector<int64_t>& startsOut, vector<int64_t>& membersOut)
+{
+    startsOut.assign(numClusters + 1, 0);
+    for (int64_t i = 0; i < numElements; ++i)
+    {
+        if (labels[i] >= 0) ++startsOut[labels[i] + 1];
+    }
+    for (int64_t c = 0; c < numClusters; ++c)
+    {
+        startsOut[c + 1] += startsOut[c];
+    }
+    membersOut.resize(startsOut[numClusters]);
+    vector<int64_t> position(startsOut.begin(), startsOut.end() - 1);
+    for (int64_t i = 0; i < numElements; ++i)
+    {
+        if (labels[i] >= 0) membersOut[position[labels[i]]++] = i;
+    }
+}
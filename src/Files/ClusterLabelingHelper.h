@@ -0,0 +1,50 @@
+#ifndef __CLUSTER_LABELING_HELPER_H__
+#define __CLUSTER_LABELING_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+
+    class TopologyHelper;
+
+    ///connected component labeling with union-find, threads each label a contiguous block of elements, then the links between blocks are merged
+    ///clusters are numbered from 0 in order of their lowest element index (the order a flood fill scanning by index finds them), unmarked elements get -1
+    ///when called from inside a parallel region, it runs single threaded, so many maps can be labeled at once
+    class ClusterLabelingHelper
+    {
+    public:
+        ///connectivity is 6 (faces), 18 (faces and edges) or 26 (faces, edges and corners), voxel index is i + dims[0] * (j + dims[1] * k)
+        ///labelsOut may be NULL when only the sizes are needed, returns the number of clusters
+        static int64_t labelVolume(const char* marked, const int64_t dims[3], const int& connectivity, int64_t* labelsOut, std::vector<int64_t>& sizesOut);
+
+        ///sizes are the sum of nodeAreas over each cluster, or the vertex counts if nodeAreas is NULL
+        static int64_t labelSurface(const char* marked, const TopologyHelper* myTopoHelp, const float* nodeAreas, int64_t* labelsOut, std::vector<double>& sizesOut);
+
+        ///groups element indices by cluster, members of cluster c are membersOut[startsOut[c]] to membersOut[startsOut[c + 1] - 1], in increasing index order
+        static void getMembers(const int64_t* labels, const int64_t& numElements, const int64_t& numClusters, std::vector<int64_t>& startsOut, std::vector<int64_t>& membersOut);
+    };
+
+}
+
+#endif //__CLUSTER_LABELING_HELPER_H__
@@ -0,0 +1,504 @@
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#define __CONNECTIVITY_MATRIX_ROW_CACHE_DECLARE__
+#include "ConnectivityMatrixRowCache.h"
+#undef __CONNECTIVITY_MATRIX_ROW_CACHE_DECLARE__
+
+#include <algorithm>
+#include <exception>
+
+#include <QThread>
+
+#include "CaretAssert.h"
+#include "CiftiFile.h"
+#include "DataFileContentInformation.h"
+
+using namespace caret;
+
+namespace caret {
+    /**
+     * Thread that reads queued rows into a row cache.
+     */
+    class ConnectivityMatrixRowPrefetchThread : public QThread
+    {
+    public:
+        ConnectivityMatrixRowPrefetchThread(ConnectivityMatrixRowCache* rowCache)
+        : QThread(),
+        m_rowCache(rowCache) { }
+
+        void run() {
+            m_rowCache->prefetchQueuedRows();
+        }
+
+    private:
+        ConnectivityMatrixRowCache* m_rowCache;
+    };
+}
+
+/**
+ * \class caret::ConnectivityMatrixRowCache
+ * \brief Cache of rows read from a connectivity matrix file.
+ * \ingroup Files
+ *
+ * Rows of a connectivity matrix file that is read from disk are
+ * kept, up to a fixed number of bytes, so that reloading a row (such
+ * as when the user identifies the same or a nearby vertex) does not
+ * read the file.  When the cache is full, the least recently used
+ * row is removed.
+ *
+ * Rows that are likely to be loaded next may be read by a background
+ * thread with prefetchRows().
+ */
+
+/**
+ * Constructor.
+ *
+ * @param maximumCachedBytes
+ *     Least recently used rows are removed to keep the cached rows
+ *     within this number of bytes.
+ */
+ConnectivityMatrixRowCache::ConnectivityMatrixRowCache(const int64_t maximumCachedBytes)
+: CaretObject(),
+m_maximumCachedBytes(maximumCachedBytes)
+{
+    m_cachedBytes = 0;
+    m_numberOfHits = 0;
+    m_numberOfMisses = 0;
+    m_numberOfPrefetchedRows = 0;
+    m_prefetchCancelledFlag = false;
+    m_ciftiFile = NULL;
+    m_prefetchThread = new ConnectivityMatrixRowPrefetchThread(this);
+}
+
+/**
+ * Destructor.
+ */
+ConnectivityMatrixRowCache::~ConnectivityMatrixRowCache()
+{
+    stopPrefetching();
+    delete m_prefetchThread;
+}
+
+/**
+ * Get a row from the cache or, if it is not in the cache, from
+ * the file and then add the row to the cache.
+ *
+ * @param ciftiFile
+ *     File containing the row.
+ * @param dataOut
+ *     Output with data, must contain the number of columns in the file.
+ * @param rowIndex
+ *     Index of the row.
+ */
+void
+ConnectivityMatrixRowCache::getRow(const CiftiFile* ciftiFile,
+                                   float* dataOut,
+                                   const int64_t rowIndex)
+{
+    CaretAssert(ciftiFile);
+
+    if ( ! isCachingEnabled(ciftiFile)) {
+        ciftiFile->getRow(dataOut,
+                          rowIndex);
+        return;
+    }
+
+    setCiftiFile(ciftiFile);
+
+    if (copyRowFromCache(rowIndex,
+                         dataOut)) {
+        return;
+    }
+
+    ciftiFile->getRow(dataOut,
+                      rowIndex);
+    addRowToCache(rowIndex,
+                  dataOut,
+                  ciftiFile->getNumberOfColumns(),
+                  false);
+}
+
+/**
+ * Start reading the given rows, that are not already in the cache,
+ * in a background thread.  Any prefetching in progress is stopped.
+ *
+ * @param ciftiFile
+ *     File containing the rows.
+ * @param rowIndices
+ *     Indices of the rows, most important first.
+ */
+void
+ConnectivityMatrixRowCache::prefetchRows(const CiftiFile* ciftiFile,
+                                         const std::vector<int64_t>& rowIndices)
+{
+    CaretAssert(ciftiFile);
+
+    if ( ! isCachingEnabled(ciftiFile)) {
+        return;
+    }
+
+    setCiftiFile(ciftiFile);
+    stopPrefetching();
+
+    /*
+     * Prefetch no more than half of the cache so that prefetched
+     * rows do not remove one another.
+     */
+    const int64_t rowBytes = ciftiFile->getNumberOfColumns() * sizeof(float);
+    const int64_t maximumNumberOfRows = ((rowBytes > 0)
+                                         ? (m_maximumCachedBytes / (2 * rowBytes))
+                                         : 0);
+
+    bool startFlag = false;
+    {
+        CaretMutexLocker locker(&m_mutex);
+
+        m_prefetchRowIndices.clear();
+        for (std::vector<int64_t>::const_iterator iter = rowIndices.begin();
+             iter != rowIndices.end();
+             iter++) {
+            if (static_cast<int64_t>(m_prefetchRowIndices.size()) >= maximumNumberOfRows) {
+                break;
+            }
+            const int64_t rowIndex = *iter;
+            if ((rowIndex >= 0)
+                && (m_cachedRows.find(rowIndex) == m_cachedRows.end())
+                && (std::find(m_prefetchRowIndices.begin(),
+                              m_prefetchRowIndices.end(),
+                              rowIndex) == m_prefetchRowIndices.end())) {
+                m_prefetchRowIndices.push_back(rowIndex);
+            }
+        }
+
+        m_prefetchCancelledFlag = false;
+        startFlag = ( ! m_prefetchRowIndices.empty());
+    }
+
+    if (startFlag) {
+        m_prefetchThread->start();
+    }
+}
+
+/**
+ * Wait for the background thread to finish reading the rows
+ * requested by prefetchRows().
+ */
+void
+ConnectivityMatrixRowCache::waitForPrefetching()
+{
+    m_prefetchThread->wait();
+}
+
+/**
+ * Stop any prefetching, remove all rows, and reset the counters.
+ */
+void
+ConnectivityMatrixRowCache::clear()
+{
+    stopPrefetching();
+
+    CaretMutexLocker locker(&m_mutex);
+    removeAllRows();
+    m_numberOfHits = 0;
+    m_numberOfMisses = 0;
+    m_numberOfPrefetchedRows = 0;
+    m_ciftiFile = NULL;
+}
+
+/**
+ * Add information about the cache to the file's content information.
+ *
+ * @param ciftiFile
+ *     File whose rows are cached.
+ * @param dataFileInformation
+ *     Item to which information is added.
+ */
+void
+ConnectivityMatrixRowCache::addToDataFileContentInformation(const CiftiFile* ciftiFile,
+                                                            DataFileContentInformation& dataFileInformation)
+{
+    if ( ! isCachingEnabled(ciftiFile)) {
+        return;
+    }
+
+    CaretMutexLocker locker(&m_mutex);
+
+    dataFileInformation.addNameAndValue("Cached Rows",
+                                        static_cast<int64_t>(m_cachedRows.size()));
+    dataFileInformation.addNameAndValue("Cached Rows Size (MB)",
+                                        static_cast<double>(m_cachedBytes) / (1024.0 * 1024.0),
+                                        1);
+    dataFileInformation.addNameAndValue("Row Cache Hits",
+                                        m_numberOfHits);
+    dataFileInformation.addNameAndValue("Row Cache Misses",
+                                        m_numberOfMisses);
+    dataFileInformation.addNameAndValue("Rows Prefetched",
+                                        m_numberOfPrefetchedRows);
+}
+
+/**
+ * @return Number of rows in the cache.
+ */
+int64_t
+ConnectivityMatrixRowCache::getNumberOfCachedRows() const
+{
+    CaretMutexLocker locker(&m_mutex);
+    return static_cast<int64_t>(m_cachedRows.size());
+}
+
+/**
+ * @return Number of rows loaded from the cache.
+ */
+int64_t
+ConnectivityMatrixRowCache::getNumberOfHits() const
+{
+    CaretMutexLocker locker(&m_mutex);
+    return m_numberOfHits;
+}
+
+/**
+ * @return Number of rows loaded that were not in the cache.
+ */
+int64_t
+ConnectivityMatrixRowCache::getNumberOfMisses() const
+{
+    CaretMutexLocker locker(&m_mutex);
+    return m_numberOfMisses;
+}
+
+/**
+ * @return Number of rows added to the cache by the prefetch thread.
+ */
+int64_t
+ConnectivityMatrixRowCache::getNumberOfPrefetchedRows() const
+{
+    CaretMutexLocker locker(&m_mutex);
+    return m_numberOfPrefetchedRows;
+}
+
+/**
+ * @return True if rows of the given file are cached.  Rows of files
+ * that are in memory are not cached since reading them is fast.
+ *
+ * @param ciftiFile
+ *     File containing the rows.
+ */
+bool
+ConnectivityMatrixRowCache::isCachingEnabled(const CiftiFile* ciftiFile) const
+{
+    if (ciftiFile == NULL) {
+        return false;
+    }
+
+    return ( ! ciftiFile->isInMemory());
+}
+
+/**
+ * Set the file whose rows are cached.  If it is not the file
+ * whose rows are in the cache, the cache is cleared.
+ *
+ * @param ciftiFile
+ *     File containing the rows.
+ */
+void
+ConnectivityMatrixRowCache::setCiftiFile(const CiftiFile* ciftiFile)
+{
+    if (ciftiFile != m_ciftiFile) {
+        clear();
+        m_ciftiFile = ciftiFile;
+    }
+}
+
+/**
+ * Copy a row from the cache and update the hit and miss counters.
+ *
+ * @param rowIndex
+ *     Index of the row.
+ * @param dataOut
+ *     Output with data.
+ * @return
+ *     True if the row was in the cache, else false.
+ */
+bool
+ConnectivityMatrixRowCache::copyRowFromCache(const int64_t rowIndex,
+                                             float* dataOut)
+{
+    CaretMutexLocker locker(&m_mutex);
+
+    std::map<int64_t, CachedRow>::iterator rowIter = m_cachedRows.find(rowIndex);
+    if (rowIter == m_cachedRows.end()) {
+        m_numberOfMisses++;
+        return false;
+    }
+
+    CachedRow& cachedRow = rowIter->second;
+    std::copy(cachedRow.m_data.begin(),
+              cachedRow.m_data.end(),
+              dataOut);
+    m_rowUsage.splice(m_rowUsage.begin(),
+                      m_rowUsage,
+                      cachedRow.m_usagePosition);
+    m_numberOfHits++;
+
+    return true;
+}
+
+/**
+ * Add a row to the cache, removing least recently used rows
+ * as needed to stay within the maximum size of the cache.
+ *
+ * @param rowIndex
+ *     Index of the row.
+ * @param data
+ *     Data in the row.
+ * @param numberOfColumns
+ *     Number of elements in the row.
+ * @param prefetchFlag
+ *     True if the row was read by the prefetch thread.
+ */
+void
+ConnectivityMatrixRowCache::addRowToCache(const int64_t rowIndex,
+                                          const float* data,
+                                          const int64_t numberOfColumns,
+                                          const bool prefetchFlag)
+{
+    const int64_t rowBytes = numberOfColumns * sizeof(float);
+    if (rowBytes > m_maximumCachedBytes) {
+        return;
+    }
+
+    CaretMutexLocker locker(&m_mutex);
+
+    if (m_cachedRows.find(rowIndex) != m_cachedRows.end()) {
+        return;
+    }
+
+    while (( ! m_rowUsage.empty())
+           && ((m_cachedBytes + rowBytes) > m_maximumCachedBytes)) {
+        std::map<int64_t, CachedRow>::iterator oldestIter = m_cachedRows.find(m_rowUsage.back());
+        CaretAssert(oldestIter != m_cachedRows.end());
+        m_cachedBytes -= static_cast<int64_t>(oldestIter->second.m_data.size() * sizeof(float));
+        m_cachedRows.erase(oldestIter);
+        m_rowUsage.pop_back();
+    }
+
+    m_rowUsage.push_front(rowIndex);
+    CachedRow& cachedRow = m_cachedRows[rowIndex];
+    cachedRow.m_data.assign(data,
+                            data + numberOfColumns);
+    cachedRow.m_usagePosition = m_rowUsage.begin();
+    m_cachedBytes += rowBytes;
+
+    if (prefetchFlag) {
+        m_numberOfPrefetchedRows++;
+    }
+}
+
+/**
+ * Remove all rows from the cache.  Caller must lock the mutex.
+ */
+void
+ConnectivityMatrixRowCache::removeAllRows()
+{
+    m_cachedRows.clear();
+    m_rowUsage.clear();
+    m_prefetchRowIndices.clear();
+    m_cachedBytes = 0;
+}
+
+/**
+ * Stop the prefetch thread, if it is running, and wait for it to finish.
+ */
+void
+ConnectivityMatrixRowCache::stopPrefetching()
+{
+    {
+        CaretMutexLocker locker(&m_mutex);
+        m_prefetchCancelledFlag = true;
+    }
+
+    m_prefetchThread->wait();
+}
+
+/**
+ * Read the queued rows into the cache.  Called by the prefetch thread.
+ */
+void
+ConnectivityMatrixRowCache::prefetchQueuedRows()
+{
+    CaretAssert(m_ciftiFile);
+
+    std::vector<int64_t> rowIndices;
+    {
+        CaretMutexLocker locker(&m_mutex);
+        rowIndices = m_prefetchRowIndices;
+    }
+
+    const int64_t numberOfColumns = m_ciftiFile->getNumberOfColumns();
+    if (numberOfColumns <= 0) {
+        return;
+    }
+    std::vector<float> rowData(numberOfColumns);
+
+    try {
+        for (std::vector<int64_t>::const_iterator iter = rowIndices.begin();
+             iter != rowIndices.end();
+             iter++) {
+            const int64_t rowIndex = *iter;
+            {
+                CaretMutexLocker locker(&m_mutex);
+                if (m_prefetchCancelledFlag) {
+                    return;
+                }
+                if (m_cachedRows.find(rowIndex) != m_cachedRows.end()) {
+                    continue;
+                }
+            }
+
+            m_ciftiFile->getRow(&rowData[0],
+                                rowIndex);
+            addRowToCache(rowIndex,
+                          &rowData[0],
+                          numberOfColumns,
+                          true);
+        }
+    }
+    catch (const std::exception&) {
+        /*
+         * Stop prefetching.  The error is reported if
+         * the row is loaded by the user.  Catches CaretException
+         * and anything else (such as std::bad_alloc) so that an
+         * exception never escapes the thread.
+         */
+    }
+}
+
+/**
+ * Get a description of this object's content.
+ * @return String describing this object's content.
+ */
+AString
+ConnectivityMatrixRowCache::toString() const
+{
+    return "ConnectivityMatrixRowCache";
+}
+
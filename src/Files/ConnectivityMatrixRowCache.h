@@ -0,0 +1,143 @@
+#ifndef __CONNECTIVITY_MATRIX_ROW_CACHE_H__
+#define __CONNECTIVITY_MATRIX_ROW_CACHE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include <list>
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include "CaretMutex.h"
+#include "CaretObject.h"
+
+namespace caret {
+
+    class CiftiFile;
+    class ConnectivityMatrixRowPrefetchThread;
+    class DataFileContentInformation;
+
+    class ConnectivityMatrixRowCache : public CaretObject {
+
+    public:
+        ConnectivityMatrixRowCache(const int64_t maximumCachedBytes = s_defaultMaximumCachedBytes);
+
+        virtual ~ConnectivityMatrixRowCache();
+
+        void getRow(const CiftiFile* ciftiFile,
+                    float* dataOut,
+                    const int64_t rowIndex);
+
+        void prefetchRows(const CiftiFile* ciftiFile,
+                          const std::vector<int64_t>& rowIndices);
+
+        void waitForPrefetching();
+
+        void clear();
+
+        void addToDataFileContentInformation(const CiftiFile* ciftiFile,
+                                             DataFileContentInformation& dataFileInformation);
+
+        int64_t getNumberOfCachedRows() const;
+
+        int64_t getNumberOfHits() const;
+
+        int64_t getNumberOfMisses() const;
+
+        int64_t getNumberOfPrefetchedRows() const;
+
+        // ADD_NEW_METHODS_HERE
+
+        virtual AString toString() const;
+
+    private:
+        /**
+         * Data for one row and its position in the least recently used list.
+         */
+        struct CachedRow {
+            std::vector<float> m_data;
+
+            std::list<int64_t>::iterator m_usagePosition;
+        };
+
+        ConnectivityMatrixRowCache(const ConnectivityMatrixRowCache&);
+
+        ConnectivityMatrixRowCache& operator=(const ConnectivityMatrixRowCache&);
+
+        bool isCachingEnabled(const CiftiFile* ciftiFile) const;
+
+        void setCiftiFile(const CiftiFile* ciftiFile);
+
+        bool copyRowFromCache(const int64_t rowIndex,
+                              float* dataOut);
+
+        void addRowToCache(const int64_t rowIndex,
+                           const float* data,
+                           const int64_t numberOfColumns,
+                           const bool prefetchFlag);
+
+        void removeAllRows();
+
+        void stopPrefetching();
+
+        void prefetchQueuedRows();
+
+        /** Protects everything below that is used by the prefetch thread */
+        mutable CaretMutex m_mutex;
+
+        std::map<int64_t, CachedRow> m_cachedRows;
+
+        /** Row indices, most recently used at front */
+        std::list<int64_t> m_rowUsage;
+
+        int64_t m_cachedBytes;
+
+        int64_t m_numberOfHits;
+
+        int64_t m_numberOfMisses;
+
+        int64_t m_numberOfPrefetchedRows;
+
+        std::vector<int64_t> m_prefetchRowIndices;
+
+        bool m_prefetchCancelledFlag;
+
+        /** File whose rows are cached, only changed when prefetching is stopped */
+        const CiftiFile* m_ciftiFile;
+
+        ConnectivityMatrixRowPrefetchThread* m_prefetchThread;
+
+        /** Least recently used rows are removed to stay within this size */
+        const int64_t m_maximumCachedBytes;
+
+        static const int64_t s_defaultMaximumCachedBytes;
+
+        // ADD_NEW_MEMBERS_HERE
+
+        friend class ConnectivityMatrixRowPrefetchThread;
+    };
+
+#ifdef __CONNECTIVITY_MATRIX_ROW_CACHE_DECLARE__
+    const int64_t ConnectivityMatrixRowCache::s_defaultMaximumCachedBytes = 256 * 1024 * 1024;
+#endif // __CONNECTIVITY_MATRIX_ROW_CACHE_DECLARE__
+
+} // namespace
+#endif  //__CONNECTIVITY_MATRIX_ROW_CACHE_H__
@@ -21,13 +21,17 @@
 #include "GeodesicHelper.h"
 
 #include "CaretAssert.h"
+#include "CaretException.h"
 #include "CaretHeap.h"
 #include "CaretMutex.h"
+#include "CaretOMP.h"
 #include "FastStatistics.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 
+#include <algorithm>
 #include <cmath>
+#include <exception>
 #include <iostream>
 #include <stdint.h>
 
@@ -40,8 +44,14 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
     TopologyHelper topoHelpIn(topoBase);//leave this building one privately, to not introduce even worse dependencies regarding SurfaceFile
     m_corrAreaSmallestFactor = 1.0f;
     numNodes = surfaceIn->getNumberOfNodes();
-    nodeNeighbors.resize(numNodes);
-    distances.resize(numNodes);
+    neighOffsets.resize(numNodes + 1);
+    neighOffsets[0] = 0;
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        neighOffsets[i + 1] = neighOffsets[i] + topoHelpIn.getNodeNumberOfNeighbors(i);
+    }
+    nodeNeighbors.resize(neighOffsets[numNodes]);
+    distances.resize(neighOffsets[numNodes]);
     nodeCoords.resize(numNodes);
     vector<float> sqrtCorrAreas;//each edge has 2 vertices that influence it - assume that each influences a piece of the edge with a ratio depending on the square roots of the vertex areas
     vector<float> sqrtVertAreas;//we also assume isometric expansion at each vertex
@@ -62,17 +72,18 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
     bool firstCorrArea = true;//if all corrected vertex areas are significantly larger than 1, we can make A* faster by multiplying all euclidean distances by it, so find the actual smallest
     for (int32_t i = 0; i < numNodes; ++i)
     {//get neighbors
-        vector<int32_t>& neighbors = nodeNeighbors[i];
-        neighbors = topoHelpIn.getNodeNeighbors(i);
+        int32_t numNeigh = 0;
+        const int32_t* topoNeighbors = topoHelpIn.getNodeNeighbors(i, numNeigh);
+        int32_t* neighbors = nodeNeighbors.data() + neighOffsets[i];
+        float* neighDists = distances.data() + neighOffsets[i];
         nodeCoords[i] = surfaceIn->getCoordinate(i);
         const Vector3D baseCoord = nodeCoords[i];
-        int numNeigh = (int)neighbors.size();
-        distances[i].resize(numNeigh);
         for (int32_t j = 0; j < numNeigh; ++j)
         {
+            neighbors[j] = topoNeighbors[j];
             Vector3D neighCoord = surfaceIn->getCoordinate(neighbors[j]);
             tempvec = baseCoord - neighCoord;
-            distances[i][j] = tempvec.length();//precompute for speed in other calls
+            neighDists[j] = tempvec.length();//precompute for speed in other calls
             if (correctedAreas != NULL)
             {
                 float correctionFactor = (sqrtCorrAreas[i] + sqrtCorrAreas[neighbors[j]]) / (sqrtVertAreas[i] + sqrtVertAreas[neighbors[j]]);
@@ -81,21 +92,19 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
                     m_corrAreaSmallestFactor = correctionFactor;//if this is zero anywhere, it just means that the euclidean part of the heuristic must be ignored (worst case, it does dijkstra)
                     firstCorrArea = false;
                 }
-                distances[i][j] *= correctionFactor;
+                neighDists[j] *= correctionFactor;
             }
             if (i < neighbors[j])
             {
-                nodeSpacingAccum += distances[i][j];
+                nodeSpacingAccum += neighDists[j];
                 ++numEdges;
             }
         }//so few floating point operations, this should turn out symmetric
     }
     m_avgNodeSpacing = nodeSpacingAccum / numEdges;
-    std::vector<int32_t> tempneigh2;
-    std::vector<float> tempdist2;
-    nodeNeighbors2.resize(numNodes);
-    distances2.resize(numNodes);
-    neighbors2PathInfo.resize(numNodes);
+    vector<int32_t> crawlBase, crawlFar;//each usable edge gives a crawl neighbor at both ends, collect them first so the flat arrays can be filled in order
+    vector<float> crawlDist;
+    vector<CrawlInfo> crawlInfo;
     const vector<TopologyEdgeInfo>& myEdgeInfo = topoHelpIn.getEdgeInfo();
     CaretAssert(numEdges == (int32_t)myEdgeInfo.size());//SurfaceFile checks for triangles with duplicated nodes
     for (int i = 0; i < numEdges; ++i)
@@ -116,13 +125,6 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
         CrawlInfo tempInfo;
         tempInfo.edgeNodes[0] = neigh1Node;
         tempInfo.edgeNodes[1] = neigh2Node;
-        const int32_t num_reserve = 8;//uses 8 in case it is used on a mesh with haphazard topology
-        nodeNeighbors2[baseNode].reserve(num_reserve);//reserve should be fast if capacity is already num_reserve, and better than reallocating at 2 and 4, if vector allocation is naive doubling
-        nodeNeighbors2[farNode].reserve(num_reserve);//in the extremely rare case of a node with more than num_reserve neighbors, a second allocation plus copy isn't much of a cost
-        distances2[baseNode].reserve(num_reserve);
-        distances2[farNode].reserve(num_reserve);
-        neighbors2PathInfo[baseNode].reserve(num_reserve);
-        neighbors2PathInfo[farNode].reserve(num_reserve);
         Vector3D abhat = (neigh2Coord - neigh1Coord).normal(&abmag);//a is neigh1, b is neigh2, b - a = (vector)ab
         Vector3D ac = farCoord - neigh1Coord;//c is farnode, c - a = (vector)ac
         Vector3D ad = abhat * abhat.dot(ac);//d is the point on the shared edge that farnode (c) is closest to
@@ -152,16 +154,37 @@ GeodesicHelperBase::GeodesicHelperBase(const SurfaceFile* surfaceIn, const float
             tempInfo.pieceDists[1] *= correctionFactor;
         }//for now, assume it only depends on the expansion of the endpoints, and affects each part equally
         tempInfo.pieceDists[0] = tempf - tempInfo.pieceDists[1];
-        nodeNeighbors2[farNode].push_back(baseNode);//record it at both ends, because we are looping through edges
-        distances2[farNode].push_back(tempf);
-        neighbors2PathInfo[farNode].push_back(tempInfo);
-        
-        float tempf2 = tempInfo.pieceDists[0];//swap the piece distances around for the baseNode info
-        tempInfo.pieceDists[0] = tempInfo.pieceDists[1];
-        tempInfo.pieceDists[1] = tempf2;
-        nodeNeighbors2[baseNode].push_back(farNode);
-        distances2[baseNode].push_back(tempf);
-        neighbors2PathInfo[baseNode].push_back(tempInfo);
+        crawlBase.push_back(baseNode);//pieceDists are in the order for farNode's info
+        crawlFar.push_back(farNode);
+        crawlDist.push_back(tempf);
+        crawlInfo.push_back(tempInfo);
+    }
+    neigh2Offsets.resize(numNodes + 1, 0);
+    int32_t numCrawl = (int32_t)crawlBase.size();
+    for (int32_t i = 0; i < numCrawl; ++i)
+    {
+        ++neigh2Offsets[crawlBase[i] + 1];
+        ++neigh2Offsets[crawlFar[i] + 1];
+    }
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        neigh2Offsets[i + 1] += neigh2Offsets[i];
+    }
+    nodeNeighbors2.resize(neigh2Offsets[numNodes]);
+    distances2.resize(neigh2Offsets[numNodes]);
+    neighbors2PathInfo.resize(neigh2Offsets[numNodes]);
+    vector<int64_t> fillPos(neigh2Offsets.begin(), neigh2Offsets.end() - 1);
+    for (int32_t i = 0; i < numCrawl; ++i)
+    {
+        int64_t pos = fillPos[crawlFar[i]]++;//record it at both ends, because we looped through edges
+        nodeNeighbors2[pos] = crawlBase[i];
+        distances2[pos] = crawlDist[i];
+        neighbors2PathInfo[pos] = crawlInfo[i];
+        pos = fillPos[crawlBase[i]]++;
+        nodeNeighbors2[pos] = crawlFar[i];
+        distances2[pos] = crawlDist[i];
+        neighbors2PathInfo[pos] = crawlInfo[i];
+        swap(neighbors2PathInfo[pos].pieceDists[0], neighbors2PathInfo[pos].pieceDists[1]);//swap the piece distances around for the baseNode info
     }
 }
 
@@ -172,6 +195,8 @@ GeodesicHelper::GeodesicHelper(const CaretPointer<const GeodesicHelperBase>& bas
     numNodes = m_myBase->numNodes;
     m_avgNodeSpacing = m_myBase->m_avgNodeSpacing;
     m_corrAreaSmallestFactor = m_myBase->m_corrAreaSmallestFactor;
+    neighOffsets = m_myBase->neighOffsets.data();
+    neigh2Offsets = m_myBase->neigh2Offsets.data();
     distances = m_myBase->distances.data();
     distances2 = m_myBase->distances2.data();
     nodeNeighbors = m_myBase->nodeNeighbors.data();
@@ -215,10 +240,63 @@ void GeodesicHelper::getNodesToGeoDist(const int32_t node, const float maxdist,
     }
 }
 
+GeodesicBatchReceiver::~GeodesicBatchReceiver()
+{
+}
+
+void GeodesicHelper::getNodesToGeoDistBatch(const vector<int32_t>& roots, const float maxdist, GeodesicBatchReceiver* receiver, const bool smoothflag)
+{
+    CaretAssert(receiver != NULL);
+    int64_t numRoots = (int64_t)roots.size();
+    for (int64_t i = 0; i < numRoots; ++i)
+    {
+        if (roots[i] < 0 || roots[i] >= numNodes) throw CaretException("invalid vertex number in geodesic batch: " + AString::number(roots[i]));
+    }
+    if (maxdist < 0.0f)
+    {//like getNodesToGeoDist, a negative cutoff finds nothing
+        for (int64_t i = 0; i < numRoots; ++i)
+        {
+            receiver->receive(i, vector<int32_t>(), vector<float>());
+        }
+        return;
+    }
+    bool failed = false;
+    AString failMessage;//exceptions can't leave a parallel region
+#pragma omp CARET_PAR
+    {
+        GeodesicHelper threadHelper(m_myBase);//per-thread scratch space, leaving this object's scratch alone
+        vector<int32_t> nodes;
+        vector<float> dists;
+#pragma omp CARET_FOR schedule(dynamic)
+        for (int64_t i = 0; i < numRoots; ++i)
+        {
+            try
+            {
+                threadHelper.getNodesToGeoDist(roots[i], maxdist, nodes, dists, smoothflag);
+                receiver->receive(i, nodes, dists);
+            } catch (CaretException& e) {
+#pragma omp critical
+                {
+                    if (!failed) failMessage = e.whatString();
+                    failed = true;
+                }
+            } catch (exception& e) {
+#pragma omp critical
+                {
+                    if (!failed) failMessage = e.what();
+                    failed = true;
+                }
+            }
+        }
+    }
+    if (failed) throw CaretException(failMessage);
+}
+
 void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vector<int32_t>& nodes, std::vector<float>& dists, bool smooth)
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     marked[root] |= 4;
@@ -233,14 +311,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
         nodes.push_back(whichnode);
         dists.push_back(output[whichnode]);
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4)
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                 if (tempf <= maxdist)
                 {//keep it off the heap if it is too far
                     if (!(marked[whichneigh] & 4))
@@ -260,14 +339,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const float maxdist, std::vect
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (tempf <= maxdist)
                     {//keep it off the heap if it is too far
                         if (!(marked[whichneigh] & 4))
@@ -297,6 +377,7 @@ void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
 {//straightforward dijkstra, no cutoffs, full surface
     int32_t i, j, whichnode, whichneigh, numNeigh;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     parent[root] = -1;//idiom for end of path
@@ -306,14 +387,15 @@ void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
     {
         whichnode = m_active.pop();
         marked[whichnode] |= 1;
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];
+                tempf = output[whichnode] + neighDists[j];
                 if (!(marked[whichneigh] & 4))
                 {
                     marked[whichneigh] |= 4;
@@ -329,14 +411,15 @@ void GeodesicHelper::dijkstra(const int32_t root, bool smooth)
         }
         if (smooth)
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (!(marked[whichneigh] & 4))
                     {
                         marked[whichneigh] |= 4;
@@ -451,6 +534,7 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
 {//propagates info about shortest paths not containing root to other roots, hopefully making the problem tractable
     int32_t root, i, j, whichnode, whichneigh, numNeigh, remain, midpoint, midrevparent, endparent, prevdots = 0, dots;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf, tempf2;
     for (i = 0; i < numNodes; ++i)
     {
@@ -496,8 +580,9 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
             {
                 if (!(marked[whichnode] & 2)) --remain;
                 marked[whichnode] |= 1;
-                neighbors = nodeNeighbors[whichnode].data();
-                numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+                neighbors = nodeNeighbors + neighOffsets[whichnode];
+                neighDists = distances + neighOffsets[whichnode];
+                numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
                 for (j = 0; j < numNeigh; ++j)
                 {
                     whichneigh = neighbors[j];
@@ -511,7 +596,7 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
                     } else {
                         if (!(marked[whichneigh] & 1))
                         {//skip floating point math if marked
-                            tempf = out[root][whichnode] + distances[whichnode][j];
+                            tempf = out[root][whichnode] + neighDists[j];
                             if (!(marked[whichneigh] & 4))
                             {
                                 out[root][whichneigh] = tempf;
@@ -528,8 +613,9 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
                 }
                 if (smooth)
                 {
-                    neighbors = nodeNeighbors2[whichnode].data();
-                    numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+                    neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+                    neighDists = distances2 + neigh2Offsets[whichnode];
+                    numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
                     for (j = 0; j < numNeigh; ++j)
                     {
                         whichneigh = neighbors[j];
@@ -543,7 +629,7 @@ void GeodesicHelper::alltoall(float** out, int32_t** parents, bool smooth)
                         } else {
                             if (!(marked[whichneigh] & 1))
                             {//skip floating point math if marked
-                                tempf = out[root][whichnode] + distances2[whichnode][j];
+                                tempf = out[root][whichnode] + neighDists[j];
                                 if (!(marked[whichneigh] & 4))
                                 {
                                     out[root][whichneigh] = tempf;
@@ -669,6 +755,7 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, remain = 0;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     j = interested.size();
     for (i = 0; i < j; ++i)
@@ -698,14 +785,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
             --remain;
         }
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4), so already in changed list
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                 if (!(marked[whichneigh] & 4))
                 {
                     if (!marked[whichneigh])
@@ -725,14 +813,15 @@ void GeodesicHelper::dijkstra(const int32_t root, const std::vector<int32_t>& in
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (!(marked[whichneigh] & 4))
                     {
                         if (!marked[whichneigh])
@@ -762,6 +851,7 @@ int32_t GeodesicHelper::dijkstra(const vector<int32_t>& startList, const vector<
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, ret = -1;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     m_active.clear();
     j = (int32_t)startList.size();
@@ -794,14 +884,15 @@ int32_t GeodesicHelper::dijkstra(const vector<int32_t>& startList, const vector<
             break;
         }
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4), so already in changed list
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];
+                tempf = output[whichnode] + neighDists[j];
                 if (tempf <= maxDist)
                 {
                     if (!(marked[whichneigh] & 4))
@@ -824,14 +915,15 @@ int32_t GeodesicHelper::dijkstra(const vector<int32_t>& startList, const vector<
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (tempf <= maxDist)
                     {
                         if (!(marked[whichneigh] & 4))
@@ -865,6 +957,7 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const floa
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, ret = -1;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -882,14 +975,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const floa
             break;
         }
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4), so already in changed list
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                 if (tempf <= maxdist)
                 {
                     if (!(marked[whichneigh] & 4))
@@ -912,14 +1006,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, const floa
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];//isn't precomputation wonderful
+                    tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                     if (tempf <= maxdist)
                     {
                         if (!(marked[whichneigh] & 4))
@@ -953,6 +1048,7 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, bool smoot
 {
     int32_t i, j, whichnode, whichneigh, numNeigh, numChanged = 0, ret = -1;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -969,14 +1065,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, bool smoot
             break;
         }
         marked[whichnode] |= 1;//anything pulled from heap will already be marked as having a valid value (flag 4), so already in changed list
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];//isn't precomputation wonderful
+                tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                 if (!(marked[whichneigh] & 4))
                 {
                     parent[whichneigh] = whichnode;
@@ -996,14 +1093,15 @@ int32_t GeodesicHelper::closest(const int32_t& root, const char* roi, bool smoot
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];//isn't precomputation wonderful
+                    tempf = output[whichnode] + neighDists[j];//isn't precomputation wonderful
                     if (!(marked[whichneigh] & 4))
                     {
                         parent[whichneigh] = whichnode;
@@ -1034,6 +1132,7 @@ void GeodesicHelper::aStar(const int32_t root, const int32_t endpoint, bool smoo
 {
     int32_t whichnode, whichneigh, numNeigh, numChanged = 0;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -1048,14 +1147,15 @@ void GeodesicHelper::aStar(const int32_t root, const int32_t endpoint, bool smoo
         whichnode = m_active.pop();//we use a modifiable heap, so we don't need to check for duplicates
         marked[whichnode] |= 1;//frozen - will already be in changed list, due to being in heap
         if (whichnode == endpoint) break;
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (int32_t j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j];
+                tempf = output[whichnode] + neighDists[j];
                 if (!(marked[whichneigh] & 4))
                 {
                     heurVal[whichneigh] = m_corrAreaSmallestFactor * (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -1073,14 +1173,15 @@ void GeodesicHelper::aStar(const int32_t root, const int32_t endpoint, bool smoo
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
             for (int32_t j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if (!(marked[whichneigh] & 1))
                 {//skip floating point math if frozen
-                    tempf = output[whichnode] + distances2[whichnode][j];
+                    tempf = output[whichnode] + neighDists[j];
                     if (!(marked[whichneigh] & 4))
                     {
                         heurVal[whichneigh] = m_corrAreaSmallestFactor * (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -1136,6 +1237,7 @@ void GeodesicHelper::aStarLine(const int32_t& root, const int32_t& endpoint, con
     int32_t whichnode, whichneigh, numNeigh, numChanged = 0;
     float penaltyScale = 0.5f / m_avgNodeSpacing;//to prevent change in scale from changing the optimal path - 0.5f is ostensibly for averaging between endpoints, but is largely arbitrary
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -1150,14 +1252,15 @@ void GeodesicHelper::aStarLine(const int32_t& root, const int32_t& endpoint, con
         whichnode = m_active.pop();//we use a modifiable heap, so we don't need to check for duplicates
         marked[whichnode] |= 1;//frozen - will already be in changed list, due to being in heap
         if (whichnode == endpoint) break;
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (int32_t j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if (!(marked[whichneigh] & 1))
             {//skip floating point math if frozen
-                tempf = output[whichnode] + distances[whichnode][j] + penaltyScale * distances[whichnode][j] * (linePenalty(nodeCoords[whichnode], linep1, linep2, segment) + linePenalty(nodeCoords[whichneigh], linep1, linep2, segment));
+                tempf = output[whichnode] + neighDists[j] + penaltyScale * neighDists[j] * (linePenalty(nodeCoords[whichnode], linep1, linep2, segment) + linePenalty(nodeCoords[whichneigh], linep1, linep2, segment));
                 if (!(marked[whichneigh] & 4))
                 {
                     remainEucl = (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -1185,6 +1288,7 @@ void GeodesicHelper::aStarData(const int32_t& root, const int32_t& endpoint, con
 {//NOTE: for consistent behavior, data must not contain negatives (or anything non-numeric)
     int32_t whichnode, whichneigh, numNeigh, numChanged = 0;
     const int32_t* neighbors;
+    const float* neighDists;
     float tempf;
     output[root] = 0.0f;
     changed[numChanged++] = root;
@@ -1198,14 +1302,15 @@ void GeodesicHelper::aStarData(const int32_t& root, const int32_t& endpoint, con
         whichnode = m_active.pop();//we use a modifiable heap, so we don't need to check for duplicates
         marked[whichnode] |= 1;//frozen - will already be in changed list, due to being in heap
         if (whichnode == endpoint) break;
-        neighbors = nodeNeighbors[whichnode].data();
-        numNeigh = (int32_t)nodeNeighbors[whichnode].size();
+        neighbors = nodeNeighbors + neighOffsets[whichnode];
+        neighDists = distances + neighOffsets[whichnode];
+        numNeigh = (int32_t)(neighOffsets[whichnode + 1] - neighOffsets[whichnode]);
         for (int32_t j = 0; j < numNeigh; ++j)
         {
             whichneigh = neighbors[j];
             if ((roiData == NULL || roiData[whichneigh] > 0.0f) && !(marked[whichneigh] & 1))
             {//skip floating point math if frozen or outside roi
-                tempf = output[whichnode] + distances[whichnode][j] * (1.0f + followStrength * (data[whichnode] + data[whichneigh]));//integrate 1 + strength * value to get distance plus path-integrated data
+                tempf = output[whichnode] + neighDists[j] * (1.0f + followStrength * (data[whichnode] + data[whichneigh]));//integrate 1 + strength * value to get distance plus path-integrated data
                 if (!(marked[whichneigh] & 4))
                 {
                     heurVal[whichneigh] = m_corrAreaSmallestFactor * (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
@@ -1223,16 +1328,17 @@ void GeodesicHelper::aStarData(const int32_t& root, const int32_t& endpoint, con
         }
         if (smooth)//repeat with numNeighbors2, nodeNeighbors2, distance2
         {
-            neighbors = nodeNeighbors2[whichnode].data();
-            numNeigh = (int32_t)nodeNeighbors2[whichnode].size();
-            const GeodesicHelperBase::CrawlInfo* pathInfo = neighbors2PathInfo[whichnode].data();
+            neighbors = nodeNeighbors2 + neigh2Offsets[whichnode];
+            neighDists = distances2 + neigh2Offsets[whichnode];
+            numNeigh = (int32_t)(neigh2Offsets[whichnode + 1] - neigh2Offsets[whichnode]);
+            const GeodesicHelperBase::CrawlInfo* pathInfo = neighbors2PathInfo + neigh2Offsets[whichnode];
             for (int32_t j = 0; j < numNeigh; ++j)
             {
                 whichneigh = neighbors[j];
                 if ((roiData == NULL || roiData[whichneigh] > 0.0f) && !(marked[whichneigh] & 1))
                 {//skip floating point math if frozen or outside roi
-                    tempf = output[whichnode] + distances2[whichnode][j] + followStrength * (data[whichnode] * pathInfo[j].pieceDists[0] + data[whichneigh] * pathInfo[j].pieceDists[1]
-                                + distances2[whichnode][j] * (data[pathInfo[j].edgeNodes[0]] * pathInfo[j].edgeWeight + data[pathInfo[j].edgeNodes[1]] * (1.0f - pathInfo[j].edgeWeight)));
+                    tempf = output[whichnode] + neighDists[j] + followStrength * (data[whichnode] * pathInfo[j].pieceDists[0] + data[whichneigh] * pathInfo[j].pieceDists[1]
+                                + neighDists[j] * (data[pathInfo[j].edgeNodes[0]] * pathInfo[j].edgeWeight + data[pathInfo[j].edgeNodes[1]] * (1.0f - pathInfo[j].edgeWeight)));
                     if (!(marked[whichneigh] & 4))
                     {
                         heurVal[whichneigh] = m_corrAreaSmallestFactor * (nodeCoords[whichneigh] - nodeCoords[endpoint]).length();
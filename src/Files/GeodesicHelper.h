@@ -51,9 +51,11 @@ namespace caret {
         GeodesicHelperBase();//can't construct without arguments
         GeodesicHelperBase& operator=(const GeodesicHelperBase& right);//can't assign
         GeodesicHelperBase(const GeodesicHelperBase& right);//can't use copy constructor
-        std::vector<std::vector<float> > distances, distances2;
-        std::vector<std::vector<int32_t> > nodeNeighbors, nodeNeighbors2;
-        std::vector<std::vector<CrawlInfo> > neighbors2PathInfo;
+        //flat (CSR) adjacency: the neighbors of node i are entries [neighOffsets[i], neighOffsets[i + 1]) of nodeNeighbors and distances, likewise for the 2-triangle neighbors
+        std::vector<int64_t> neighOffsets, neigh2Offsets;
+        std::vector<float> distances, distances2;
+        std::vector<int32_t> nodeNeighbors, nodeNeighbors2;
+        std::vector<CrawlInfo> neighbors2PathInfo;
         std::vector<Vector3D> nodeCoords;//for line-following and A*
         int32_t numNodes;
         float m_avgNodeSpacing;//to use for balancing line following penalty
@@ -63,14 +65,23 @@ namespace caret {
         friend class GeodesicHelper;//let it grab the private variables it needs
     };
 
+    ///receives the results of the batched geodesic methods, called from several threads at once, but once per root
+    class GeodesicBatchReceiver
+    {
+    public:
+        virtual void receive(const int64_t& rootIndex, const std::vector<int32_t>& nodes, const std::vector<float>& dists) = 0;
+        virtual ~GeodesicBatchReceiver();
+    };
+
     class GeodesicHelper
     {
         CaretPointer<const GeodesicHelperBase> m_myBase;//mostly just for automatic memory management
         CaretMutex inUse;//could add a function and a locker pointer to be able to lock to thread once, then call repeatedly without locking, if mutex overhead is actually a factor
         CaretMinHeap<int32_t, float> m_active;//save and reuse the allocated space
-        const std::vector<float>* distances, *distances2;
-        const std::vector<int32_t>* nodeNeighbors, *nodeNeighbors2;
-        const std::vector<GeodesicHelperBase::CrawlInfo>* neighbors2PathInfo;
+        const int64_t* neighOffsets, *neigh2Offsets;
+        const float* distances, *distances2;
+        const int32_t* nodeNeighbors, *nodeNeighbors2;
+        const GeodesicHelperBase::CrawlInfo* neighbors2PathInfo;
         const Vector3D* nodeCoords;
         float* output;
         int32_t* parent;
@@ -104,6 +115,9 @@ namespace caret {
         /// Get distances from root node, up to a geodesic distance cutoff, and also return their parents (root node has -1 as parent)
         void getNodesToGeoDist(const int32_t node, const float maxdist, std::vector<int32_t>& neighborsOut, std::vector<float>& distsOut, std::vector<int32_t>& parentsOut, const bool smoothflag = true);
 
+        /// Get distances from many root nodes to a geodesic distance cutoff (use numeric_limits<float>::max() for no cutoff), in parallel with a helper per thread, rootIndex given to the receiver is the position in roots
+        void getNodesToGeoDistBatch(const std::vector<int32_t>& roots, const float maxdist, GeodesicBatchReceiver* receiver, const bool smoothflag = true);
+
         /// Get distances from root node to entire surface - allocate the array first
         void getGeoFromNode(const int32_t node, float* valuesOut, const bool smoothflag = true);//MUST be already allocated to number of nodes
 
@@ -27,11 +27,35 @@
 #include "GeodesicHelper.h"
 #include "TopologyHelper.h"
 #include "CaretOMP.h"
+#include "CaretPointer.h"
+#include "WeightCacheFile.h"
+
+#include <algorithm>
 #include <cmath>
 
 using namespace std;
 using namespace caret;
 
+namespace
+{
+    const char CACHE_MAGIC[8] = { 'W', 'B', 'S', 'M', 'O', 'O', 'T', 'H' };
+    const int32_t CACHE_VERSION = 2;
+    const int64_t ACCUM_COLUMN_BLOCK = 64;//columns accumulated together in smoothNodeMajor
+    const int32_t METRIC_COLUMN_BLOCK = 32;//columns transposed together in smoothMetric
+}
+
+AString MetricSmoothingObject::s_weightCacheDirectory;
+
+void MetricSmoothingObject::setWeightCacheDirectory(const AString& directory)
+{
+    s_weightCacheDirectory = directory;
+}
+
+AString MetricSmoothingObject::getWeightCacheDirectory()
+{
+    return s_weightCacheDirectory;
+}
+
 MetricSmoothingObject::MetricSmoothingObject(const SurfaceFile* mySurf, const float& kernel, const MetricFile* myRoi, Method myMethod, const float* nodeAreas)
 {
     CaretAssert(mySurf != NULL);
@@ -46,7 +70,7 @@ void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int&
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(columnOut != NULL);
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricIn->getNumberOfNodes() != getNumberOfNodes())
     {
         throw CaretException("metric does not match surface number of nodes");
     }
@@ -54,14 +78,14 @@ void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int&
     {
         throw CaretException("invalid column number");
     }
-    if (columnOut->getNumberOfNodes() != (int32_t)m_weightLists.size() || columnOut->getNumberOfColumns() != 1)
+    if (columnOut->getNumberOfNodes() != getNumberOfNodes() || columnOut->getNumberOfColumns() != 1)
     {
-        columnOut->setNumberOfNodesAndColumns(m_weightLists.size(), 1);
+        columnOut->setNumberOfNodesAndColumns(getNumberOfNodes(), 1);
     }
     vector<float> scratch(metricIn->getNumberOfNodes());
     if (roi != NULL)
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
+        if (roi->getNumberOfNodes() != getNumberOfNodes())
         {
             throw CaretException("roi does not match surface number of nodes");
         }
@@ -75,15 +99,15 @@ void MetricSmoothingObject::smoothColumn(const MetricFile* metricIn, const int&
 {
     CaretAssert(metricIn != NULL);
     CaretAssert(metricOut != NULL);
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricIn->getNumberOfNodes() != getNumberOfNodes())
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    if (metricOut->getNumberOfNodes() != getNumberOfNodes())
     {
         throw CaretException("output metric does not match surface number of nodes");
     }
-    if (roi != NULL && (roi->getNumberOfNodes() != (int32_t)m_weightLists.size()))
+    if (roi != NULL && (roi->getNumberOfNodes() != getNumberOfNodes()))
     {
         throw CaretException("roi does not match surface number of nodes");
     }
@@ -113,29 +137,127 @@ void MetricSmoothingObject::smoothMetric(const MetricFile* metricIn, MetricFile*
     CaretAssert(metricIn != NULL);
     CaretAssert(metricOut != NULL);
     int32_t numCols = metricIn->getNumberOfColumns();
-    if (metricIn->getNumberOfNodes() != (int32_t)m_weightLists.size())
+    int32_t numNodes = getNumberOfNodes();
+    if (metricIn->getNumberOfNodes() != numNodes)
     {
         throw CaretException("metric does not match surface number of nodes");
     }
-    if (metricOut->getNumberOfNodes() != (int32_t)m_weightLists.size() || metricOut->getNumberOfColumns() != numCols)
+    if (metricOut->getNumberOfNodes() != numNodes || metricOut->getNumberOfColumns() != numCols)
     {
-        metricOut->setNumberOfNodesAndColumns(m_weightLists.size(), numCols);
+        metricOut->setNumberOfNodesAndColumns(numNodes, numCols);
     }
-    vector<float> scratch(metricIn->getNumberOfNodes());
+    const float* roiData = NULL;
     if (roi != NULL)
     {
-        if (roi->getNumberOfNodes() != (int32_t)m_weightLists.size())
+        if (roi->getNumberOfNodes() != numNodes)
         {
             throw CaretException("roi does not match surface number of nodes");
         }
-        for (int32_t i = 0; i < numCols; ++i)
+        roiData = roi->getValuePointerForColumn(0);
+    }
+    int32_t blockCols = min(numCols, METRIC_COLUMN_BLOCK);
+    vector<float> blockIn((int64_t)numNodes * blockCols), blockOut((int64_t)numNodes * blockCols), scratch(numNodes);
+    vector<const float*> inColumns(blockCols);
+    for (int32_t blockStart = 0; blockStart < numCols; blockStart += blockCols)
+    {//transpose a block of columns to node-major, so the weights are traversed once per block instead of once per column
+        int32_t thisBlock = min(blockCols, numCols - blockStart);
+        for (int32_t c = 0; c < thisBlock; ++c)
         {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, roi, 0, fixZeros);
+            inColumns[c] = metricIn->getValuePointerForColumn(blockStart + c);
         }
-    } else {
-        for (int32_t i = 0; i < numCols; ++i)
+#pragma omp CARET_PARFOR
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            for (int32_t c = 0; c < thisBlock; ++c)
+            {
+                blockIn[(int64_t)i * thisBlock + c] = inColumns[c][i];
+            }
+        }
+        smoothNodeMajor(blockIn.data(), blockOut.data(), thisBlock, roiData, fixZeros);
+        for (int32_t c = 0; c < thisBlock; ++c)
         {
-            smoothColumnInternal(scratch.data(), metricIn, i, metricOut, i, fixZeros);
+            for (int32_t i = 0; i < numNodes; ++i)
+            {
+                scratch[i] = blockOut[(int64_t)i * thisBlock + c];
+            }
+            metricOut->setValuesForColumn(blockStart + c, scratch.data());
+        }
+    }
+}
+
+void MetricSmoothingObject::smoothNodeMajor(const float* dataIn, float* dataOut, const int64_t& numColumns, const float* roiData, const bool& fixZeros) const
+{
+    CaretAssert(dataIn != NULL);
+    CaretAssert(dataOut != NULL);
+    CaretAssert(dataIn != dataOut);
+    if (numColumns < 1) return;
+    int32_t numNodes = getNumberOfNodes();
+#pragma omp CARET_PAR
+    {
+        vector<float> sumScratch(ACCUM_COLUMN_BLOCK), weightSumScratch(ACCUM_COLUMN_BLOCK);
+        float* sums = sumScratch.data();
+        float* weightSums = weightSumScratch.data();
+#pragma omp CARET_FOR schedule(dynamic, 64)
+        for (int32_t i = 0; i < numNodes; ++i)
+        {
+            float* outRow = dataOut + (int64_t)i * numColumns;
+            if ((roiData != NULL && !(roiData[i] > 0.0f)) || m_weightSums[i] == 0.0f)
+            {
+                fill(outRow, outRow + numColumns, 0.0f);
+                continue;
+            }
+            int64_t weightStart = m_weightStarts[i], weightEnd = m_weightStarts[i + 1];
+            for (int64_t blockStart = 0; blockStart < numColumns; blockStart += ACCUM_COLUMN_BLOCK)
+            {//accumulate a block of columns at a time, so the inner loops are contiguous and vectorizable, and the accumulators stay in L1
+                int64_t blockSize = min(ACCUM_COLUMN_BLOCK, numColumns - blockStart);
+                float* outBlock = outRow + blockStart;
+                fill(sums, sums + blockSize, 0.0f);
+                if (fixZeros)
+                {//zeros are excluded per column, so each column needs its own weight sum
+                    fill(weightSums, weightSums + blockSize, 0.0f);
+                    for (int64_t j = weightStart; j < weightEnd; ++j)
+                    {
+                        int32_t neighbor = m_weightNodes[j];
+                        if (roiData != NULL && !(roiData[neighbor] > 0.0f)) continue;
+                        float weight = m_weightValues[j];
+                        const float* inBlock = dataIn + (int64_t)neighbor * numColumns + blockStart;
+                        for (int64_t c = 0; c < blockSize; ++c)
+                        {
+                            float useWeight = (inBlock[c] != 0.0f ? weight : 0.0f);
+                            sums[c] += useWeight * inBlock[c];
+                            weightSums[c] += useWeight;
+                        }
+                    }
+                    for (int64_t c = 0; c < blockSize; ++c)
+                    {
+                        outBlock[c] = (weightSums[c] != 0.0f ? sums[c] / weightSums[c] : 0.0f);
+                    }
+                } else {
+                    float weightSum = 0.0f;
+                    for (int64_t j = weightStart; j < weightEnd; ++j)
+                    {
+                        int32_t neighbor = m_weightNodes[j];
+                        if (roiData != NULL && !(roiData[neighbor] > 0.0f)) continue;
+                        float weight = m_weightValues[j];
+                        const float* inBlock = dataIn + (int64_t)neighbor * numColumns + blockStart;
+                        for (int64_t c = 0; c < blockSize; ++c)
+                        {
+                            sums[c] += weight * inBlock[c];
+                        }
+                        weightSum += weight;
+                    }
+                    if (roiData == NULL) weightSum = m_weightSums[i];//same as what was accumulated, but matches smoothColumn exactly
+                    if (weightSum != 0.0f)
+                    {
+                        for (int64_t c = 0; c < blockSize; ++c)
+                        {
+                            outBlock[c] = sums[c] / weightSum;
+                        }
+                    } else {
+                        fill(outBlock, outBlock + blockSize, 0.0f);
+                    }
+                }
+            }
         }
     }
 }
@@ -154,17 +276,16 @@ void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFil
 #pragma omp CARET_PARFOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (myWeightRef.m_weightSum != 0.0f)//skip nodes with no neighbors quickly
+            if (m_weightSums[i] != 0.0f)//skip nodes with no neighbors quickly
             {
                 float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                int64_t weightEnd = m_weightStarts[i + 1];
+                for (int64_t j = m_weightStarts[i]; j < weightEnd; ++j)
                 {
-                    float value = myColumn[myWeightRef.m_nodes[j]];
+                    float value = myColumn[m_weightNodes[j]];
                     if (value != 0.0f)
                     {
-                        float weight = myWeightRef.m_weights[j];
+                        float weight = m_weightValues[j];
                         sum += weight * value;
                         weightsum += weight;
                     }
@@ -183,16 +304,15 @@ void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFil
 #pragma omp CARET_PARFOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (myWeightRef.m_weightSum != 0.0f)
+            if (m_weightSums[i] != 0.0f)
             {
                 float sum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                int64_t weightEnd = m_weightStarts[i + 1];
+                for (int64_t j = m_weightStarts[i]; j < weightEnd; ++j)
                 {
-                    sum += myWeightRef.m_weights[j] * myColumn[myWeightRef.m_nodes[j]];
+                    sum += m_weightValues[j] * myColumn[m_weightNodes[j]];
                 }
-                scratch[i] = sum / myWeightRef.m_weightSum;
+                scratch[i] = sum / m_weightSums[i];
             } else {
                 scratch[i] = 0.0f;
             }
@@ -218,18 +338,17 @@ void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFil
 #pragma omp CARET_PARFOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (roiColumn[i] > 0.0f && myWeightRef.m_weightSum != 0.0f)//skip nodes with no neighbors quickly
+            if (roiColumn[i] > 0.0f && m_weightSums[i] != 0.0f)//skip nodes with no neighbors quickly
             {
                 float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                int64_t weightEnd = m_weightStarts[i + 1];
+                for (int64_t j = m_weightStarts[i]; j < weightEnd; ++j)
                 {
-                    int32_t neighbor = myWeightRef.m_nodes[j];
+                    int32_t neighbor = m_weightNodes[j];
                     float value = myColumn[neighbor];
                     if (roiColumn[neighbor] > 0.0f && value != 0.0f)
                     {
-                        float weight = myWeightRef.m_weights[j];
+                        float weight = m_weightValues[j];
                         sum += weight * value;
                         weightsum += weight;
                     }
@@ -248,17 +367,16 @@ void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFil
 #pragma omp CARET_PARFOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            const WeightList& myWeightRef = m_weightLists[i];
-            if (roiColumn[i] > 0.0f && myWeightRef.m_weightSum != 0.0f)
+            if (roiColumn[i] > 0.0f && m_weightSums[i] != 0.0f)
             {
                 float sum = 0.0f, weightsum = 0.0f;
-                int32_t numWeights = myWeightRef.m_nodes.size();
-                for (int32_t j = 0; j < numWeights; ++j)
+                int64_t weightEnd = m_weightStarts[i + 1];
+                for (int64_t j = m_weightStarts[i]; j < weightEnd; ++j)
                 {
-                    int32_t neighbor = myWeightRef.m_nodes[j];
+                    int32_t neighbor = m_weightNodes[j];
                     if (roiColumn[neighbor] > 0.0f)
                     {
-                        float weight = myWeightRef.m_weights[j];
+                        float weight = m_weightValues[j];
                         sum += weight * myColumn[neighbor];
                         weightsum += weight;
                     }
@@ -277,12 +395,12 @@ void MetricSmoothingObject::smoothColumnInternal(float* scratch, const MetricFil
     metricOut->setValuesForColumn(whichOutColumn, scratch);
 }
 
-void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel)
+void MetricSmoothingObject::precomputeWeightsGeoGauss(vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
     float gaussianDenom = -0.5f / myKernel / myKernel;
-    m_weightLists.resize(numNodes);
+    weightsOut.resize(numNodes);
 #pragma omp CARET_PAR
     {
         CaretPointer<TopologyHelper> myTopoHelp = mySurf->getTopologyHelper();//don't really need one per thread here, but good practice in case we want getNeighborsToDepth
@@ -291,32 +409,32 @@ void MetricSmoothingObject::precomputeWeightsGeoGauss(const SurfaceFile* mySurf,
 #pragma omp CARET_FOR schedule(dynamic)
         for (int32_t i = 0; i < numNodes; ++i)
         {
-            myGeoHelp->getNodesToGeoDist(i, myGeoDist, m_weightLists[i].m_nodes, distances, true);
+            myGeoHelp->getNodesToGeoDist(i, myGeoDist, weightsOut[i].m_nodes, distances, true);
             if (distances.size() < 7)
             {
-                m_weightLists[i].m_nodes = myTopoHelp->getNodeNeighbors(i);
-                m_weightLists[i].m_nodes.push_back(i);
-                myGeoHelp->getGeoToTheseNodes(i, m_weightLists[i].m_nodes, distances, true);
+                weightsOut[i].m_nodes = myTopoHelp->getNodeNeighbors(i);
+                weightsOut[i].m_nodes.push_back(i);
+                myGeoHelp->getGeoToTheseNodes(i, weightsOut[i].m_nodes, distances, true);
             }
             int32_t numNeigh = (int32_t)distances.size();
-            m_weightLists[i].m_weights.resize(numNeigh);
-            m_weightLists[i].m_weightSum = 0.0f;
+            weightsOut[i].m_weights.resize(numNeigh);
+            weightsOut[i].m_weightSum = 0.0f;
             for (int32_t j = 0; j < numNeigh; ++j)
             {
                 float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                m_weightLists[i].m_weights[j] = weight;
-                m_weightLists[i].m_weightSum += weight;
+                weightsOut[i].m_weights[j] = weight;
+                weightsOut[i].m_weightSum += weight;
             }
         }
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
+void MetricSmoothingObject::precomputeWeightsROIGeoGauss(vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
     float gaussianDenom = -0.5f / myKernel / myKernel;
-    m_weightLists.resize(numNodes);
+    weightsOut.resize(numNodes);
     const float* myRoiColumn = theRoi->getValuePointerForColumn(0);
 #pragma omp CARET_PAR
     {
@@ -337,17 +455,17 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySu
                     myGeoHelp->getGeoToTheseNodes(i, nodes, distances, true);
                 }
                 int32_t numNeigh = (int32_t)distances.size();
-                m_weightLists[i].m_weights.reserve(numNeigh);
-                m_weightLists[i].m_nodes.reserve(numNeigh);
-                m_weightLists[i].m_weightSum = 0.0f;
+                weightsOut[i].m_weights.reserve(numNeigh);
+                weightsOut[i].m_nodes.reserve(numNeigh);
+                weightsOut[i].m_weightSum = 0.0f;
                 for (int32_t j = 0; j < numNeigh; ++j)
                 {
                     if (myRoiColumn[nodes[j]] > 0.0f)
                     {
                         float weight = exp(distances[j] * distances[j] * gaussianDenom);//exp(- dist ^ 2 / (2 * sigma ^ 2))
-                        m_weightLists[i].m_weights.push_back(weight);
-                        m_weightLists[i].m_nodes.push_back(nodes[j]);
-                        m_weightLists[i].m_weightSum += weight;
+                        weightsOut[i].m_weights.push_back(weight);
+                        weightsOut[i].m_nodes.push_back(nodes[j]);
+                        weightsOut[i].m_weightSum += weight;
                     }
                 }
             }
@@ -355,7 +473,7 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGauss(const SurfaceFile* mySu
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const float* nodeAreas)
+void MetricSmoothingObject::precomputeWeightsGeoGaussArea(vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel, const float* nodeAreas)
 {//this method is normalized in two ways to provide evenly diffusing smoothing with equivalent sum of areas * values as input
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
@@ -396,13 +514,13 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* myS
             tempList[i].m_weightSum = nodeAreas[i];
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
+    weightsOut.resize(numNodes);//now convert it to gathering kernels
     for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
     {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
+        weightsOut[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
         size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
-        m_weightLists[i].m_weights.reserve(neighborCount);
+        weightsOut[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
+        weightsOut[i].m_weights.reserve(neighborCount);
     }
     for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
     {
@@ -411,14 +529,14 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussArea(const SurfaceFile* myS
         {
             int32_t node = tempList[i].m_nodes[j];
             float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
+            weightsOut[node].m_nodes.push_back(i);
+            weightsOut[node].m_weights.push_back(weight);
+            weightsOut[node].m_weightSum += weight;
         }
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, const float* nodeAreas)
+void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, const float* nodeAreas)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
@@ -468,13 +586,13 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile*
             }
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
+    weightsOut.resize(numNodes);//now convert it to gathering kernels
     for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
     {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
+        weightsOut[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
         size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
-        m_weightLists[i].m_weights.reserve(neighborCount);
+        weightsOut[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
+        weightsOut[i].m_weights.reserve(neighborCount);
     }
     for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
     {
@@ -483,14 +601,14 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussArea(const SurfaceFile*
         {
             int32_t node = tempList[i].m_nodes[j];
             float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
+            weightsOut[node].m_nodes.push_back(i);
+            weightsOut[node].m_weights.push_back(weight);
+            weightsOut[node].m_weightSum += weight;
         }
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* mySurf, float myKernel)
+void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel)
 {//this method is normalized in two ways to provide evenly diffusing smoothing with equivalent sum of values as input - this special purpose smoothing is for things that should not be integrated across the surface
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
@@ -530,13 +648,13 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* my
             tempList[i].m_weightSum = 1.0f;
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
+    weightsOut.resize(numNodes);//now convert it to gathering kernels
     for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
     {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
+        weightsOut[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
         size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
-        m_weightLists[i].m_weights.reserve(neighborCount);
+        weightsOut[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes (geodesic distance should be symmetric except for rounding errors, so it should usually be exact)
+        weightsOut[i].m_weights.reserve(neighborCount);
     }
     for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
     {
@@ -545,14 +663,14 @@ void MetricSmoothingObject::precomputeWeightsGeoGaussEqual(const SurfaceFile* my
         {
             int32_t node = tempList[i].m_nodes[j];
             float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
+            weightsOut[node].m_nodes.push_back(i);
+            weightsOut[node].m_weights.push_back(weight);
+            weightsOut[node].m_weightSum += weight;
         }
     }
 }
 
-void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
+void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi)
 {
     int32_t numNodes = mySurf->getNumberOfNodes();
     float myGeoDist = myKernel * 3.0f;
@@ -601,13 +719,13 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile*
             }
         }
     }
-    m_weightLists.resize(numNodes);//now convert it to gathering kernels
+    weightsOut.resize(numNodes);//now convert it to gathering kernels
     for (int32_t i = 0; i < numNodes; ++i)//sadly, this is VERY hard to parallelize in a manner that is efficient, since it needs random access modification
     {
-        m_weightLists[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
+        weightsOut[i].m_weightSum = 0.0f;//memory initialization may not go much faster in parallel
         size_t neighborCount = tempList[i].m_nodes.size();
-        m_weightLists[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
-        m_weightLists[i].m_weights.reserve(neighborCount);
+        weightsOut[i].m_nodes.reserve(neighborCount);//also preallocate the expected number of nodes, again, should be exact except for rounding errors in geodesic distance
+        weightsOut[i].m_weights.reserve(neighborCount);
     }
     for (int32_t i = 0; i < numNodes; ++i)//and this needs to push onto random vectors in the weight list
     {
@@ -616,9 +734,9 @@ void MetricSmoothingObject::precomputeWeightsROIGeoGaussEqual(const SurfaceFile*
         {
             int32_t node = tempList[i].m_nodes[j];
             float weight = tempList[i].m_weights[j];
-            m_weightLists[node].m_nodes.push_back(i);
-            m_weightLists[node].m_weights.push_back(weight);
-            m_weightLists[node].m_weightSum += weight;
+            weightsOut[node].m_nodes.push_back(i);
+            weightsOut[node].m_weights.push_back(weight);
+            weightsOut[node].m_weightSum += weight;
         }
     }
 }
@@ -639,18 +757,26 @@ void MetricSmoothingObject::precomputeWeights(const SurfaceFile* mySurf, float m
         default:
             break;
     }
+    CaretPointer<WeightCacheFile> myCache;
+    if (!s_weightCacheDirectory.isEmpty())
+    {
+        myCache.grabNew(new WeightCacheFile(s_weightCacheDirectory, ".wbsmooth", CACHE_MAGIC, CACHE_VERSION, "smoothing"));
+        addCacheKey(*myCache, mySurf, myKernel, theRoi, myMethod, passAreas);
+        if (loadWeightCache(*myCache, mySurf->getNumberOfNodes())) return;
+    }
+    vector<WeightList> weightLists;
     if (theRoi != NULL)
     {
         switch (myMethod)
         {
             case GEO_GAUSS_AREA:
-                precomputeWeightsROIGeoGaussArea(mySurf, myKernel, theRoi, passAreas);
+                precomputeWeightsROIGeoGaussArea(weightLists, mySurf, myKernel, theRoi, passAreas);
                 break;
             case GEO_GAUSS_EQUAL:
-                precomputeWeightsROIGeoGaussEqual(mySurf, myKernel, theRoi);
+                precomputeWeightsROIGeoGaussEqual(weightLists, mySurf, myKernel, theRoi);
                 break;
             case GEO_GAUSS:
-                precomputeWeightsROIGeoGauss(mySurf, myKernel, theRoi);
+                precomputeWeightsROIGeoGauss(weightLists, mySurf, myKernel, theRoi);
                 break;
             default:
                 throw CaretException("unknown smoothing method specified");
@@ -659,16 +785,109 @@ void MetricSmoothingObject::precomputeWeights(const SurfaceFile* mySurf, float m
         switch (myMethod)
         {
             case GEO_GAUSS_AREA:
-                precomputeWeightsGeoGaussArea(mySurf, myKernel, passAreas);
+                precomputeWeightsGeoGaussArea(weightLists, mySurf, myKernel, passAreas);
                 break;
             case GEO_GAUSS_EQUAL:
-                precomputeWeightsGeoGaussEqual(mySurf, myKernel);
+                precomputeWeightsGeoGaussEqual(weightLists, mySurf, myKernel);
                 break;
             case GEO_GAUSS:
-                precomputeWeightsGeoGauss(mySurf, myKernel);
+                precomputeWeightsGeoGauss(weightLists, mySurf, myKernel);
                 break;
             default:
                 throw CaretException("unknown smoothing method specified");
         };
     }
+    setWeights(weightLists);
+    if (myCache != NULL) saveWeightCache(*myCache);
+}
+
+void MetricSmoothingObject::setWeights(const vector<WeightList>& weightLists)
+{
+    int32_t numNodes = (int32_t)weightLists.size();
+    m_weightStarts.resize(numNodes + 1);
+    m_weightSums.resize(numNodes);
+    m_weightStarts[0] = 0;
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        m_weightStarts[i + 1] = m_weightStarts[i] + weightLists[i].m_nodes.size();
+        m_weightSums[i] = weightLists[i].m_weightSum;
+    }
+    m_weightNodes.resize(m_weightStarts[numNodes]);
+    m_weightValues.resize(m_weightStarts[numNodes]);
+#pragma omp CARET_PARFOR schedule(dynamic)
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        CaretAssert(weightLists[i].m_nodes.size() == weightLists[i].m_weights.size());
+        copy(weightLists[i].m_nodes.begin(), weightLists[i].m_nodes.end(), m_weightNodes.begin() + m_weightStarts[i]);
+        copy(weightLists[i].m_weights.begin(), weightLists[i].m_weights.end(), m_weightValues.begin() + m_weightStarts[i]);
+    }
+}
+
+void MetricSmoothingObject::addCacheKey(WeightCacheFile& myCache, const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod, const float* nodeAreas)
+{//everything the weights depend on
+    int32_t numNodes = mySurf->getNumberOfNodes(), numTriangles = mySurf->getNumberOfTriangles();
+    int32_t header[3] = { (int32_t)myMethod, numNodes, numTriangles };
+    myCache.addKeyData(header, sizeof(header));
+    myCache.addKeyData(&myKernel, sizeof(float));
+    myCache.addKeyData(mySurf->getCoordinateData(), numNodes * 3 * sizeof(float));
+    for (int32_t i = 0; i < numTriangles; ++i)
+    {
+        myCache.addKeyData(mySurf->getTriangle(i), 3 * sizeof(int32_t));
+    }
+    if (theRoi != NULL)
+    {
+        myCache.addKeyMask(theRoi->getValuePointerForColumn(0), numNodes);
+    }
+    if (myMethod == GEO_GAUSS_AREA && nodeAreas != NULL)
+    {
+        myCache.addKeyData("areas", 5);
+        myCache.addKeyData(nodeAreas, numNodes * sizeof(float));
+    }
+}
+
+//payload is weight starts (numNodes + 1 int64), weight sums (numNodes float), nodes (numEntries int32), and weights (numEntries float)
+bool MetricSmoothingObject::loadWeightCache(WeightCacheFile& myCache, const int32_t& numNodes)
+{
+    int64_t counts[WeightCacheFile::NUM_COUNTS];
+    if (!myCache.beginRead(counts)) return false;
+    int64_t numEntries = counts[1];
+    if (counts[0] != numNodes || numEntries < 0 ||
+        myCache.getPayloadSize() != (int64_t)((numNodes + 1) * sizeof(int64_t) + numNodes * sizeof(float) + numEntries * (sizeof(int32_t) + sizeof(float))))
+    {
+        return myCache.finishRead(false);
+    }
+    vector<int64_t> weightStarts(numNodes + 1);
+    vector<float> weightSums(numNodes);
+    vector<int32_t> weightNodes(numEntries);
+    vector<float> weightValues(numEntries);
+    bool good = myCache.read(weightStarts.data(), weightStarts.size() * sizeof(int64_t)) &&
+                myCache.read(weightSums.data(), weightSums.size() * sizeof(float)) &&
+                myCache.read(weightNodes.data(), weightNodes.size() * sizeof(int32_t)) &&
+                myCache.read(weightValues.data(), weightValues.size() * sizeof(float));
+    if (good && (weightStarts[0] != 0 || weightStarts[numNodes] != numEntries)) good = false;
+    for (int32_t i = 0; good && i < numNodes; ++i)
+    {
+        if (weightStarts[i + 1] < weightStarts[i]) good = false;
+    }
+    for (int64_t j = 0; good && j < numEntries; ++j)
+    {
+        if (weightNodes[j] < 0 || weightNodes[j] >= numNodes) good = false;
+    }
+    if (!myCache.finishRead(good)) return false;
+    m_weightStarts.swap(weightStarts);
+    m_weightSums.swap(weightSums);
+    m_weightNodes.swap(weightNodes);
+    m_weightValues.swap(weightValues);
+    return true;
+}
+
+void MetricSmoothingObject::saveWeightCache(WeightCacheFile& myCache) const
+{
+    int64_t counts[WeightCacheFile::NUM_COUNTS] = { getNumberOfNodes(), (int64_t)m_weightNodes.size(), 0 };
+    if (!myCache.beginWrite(counts)) return;
+    myCache.write(m_weightStarts.data(), m_weightStarts.size() * sizeof(int64_t));
+    myCache.write(m_weightSums.data(), m_weightSums.size() * sizeof(float));
+    myCache.write(m_weightNodes.data(), m_weightNodes.size() * sizeof(int32_t));
+    myCache.write(m_weightValues.data(), m_weightValues.size() * sizeof(float));
+    myCache.finishWrite();
 }
@@ -27,9 +27,14 @@
 //NOTE: this object contains no mutable members, multiple threads can call the same function on the same instance and expect consistent behavior, while running concurrently,
 //      as long as they don't call it with output arguments that overlap (same instance, same row, or one row plus full metric, etc)
 //
+//NOTE: when a weight cache directory is set, the constructor loads previously computed weights for the same surface, kernel, ROI, method and areas from it instead of
+//      recomputing them, and saves newly computed weights to it.
+//
 //NOTE: for a static ROI, it is (sometimes much) more efficient to use it in the constructor, and provide no ROI (NULL) to the functions, using both an ROI in constructor and in method
 //      will result in the effective ROI being the logical AND of the two (intersection).
 
+#include "AString.h"
+
 #include "stdint.h"
 #include "stddef.h"
 #include <vector>
@@ -38,6 +43,7 @@ namespace caret {
     
     class SurfaceFile;
     class MetricFile;
+    class WeightCacheFile;
     
     class MetricSmoothingObject
     {
@@ -52,6 +58,13 @@ namespace caret {
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* columnOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
         void smoothColumn(const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi = NULL, const int& whichRoiColumn = 0, const bool& fixZeros = false) const;
         void smoothMetric(const MetricFile* metricIn, MetricFile* metricOut, const MetricFile* roi = NULL, const bool& fixZeros = false) const;
+        ///smooths many columns in one pass over the weights, node-major: the value of column c for node i is at [i * numColumns + c], for dataIn and dataOut
+        ///roiData is one value per node, like column 0 of the roi arguments above
+        void smoothNodeMajor(const float* dataIn, float* dataOut, const int64_t& numColumns, const float* roiData = NULL, const bool& fixZeros = false) const;
+        
+        ///empty disables the cache, which is the default
+        static void setWeightCacheDirectory(const AString& directory);
+        static AString getWeightCacheDirectory();
     private:
         struct WeightList
         {
@@ -59,16 +72,24 @@ namespace caret {
             std::vector<float> m_weights;
             float m_weightSum;
         };
-        std::vector<WeightList> m_weightLists;
+        std::vector<int64_t> m_weightStarts;//gathering weights for node i are entries m_weightStarts[i] to m_weightStarts[i + 1] - 1
+        std::vector<int32_t> m_weightNodes;
+        std::vector<float> m_weightValues, m_weightSums;
+        static AString s_weightCacheDirectory;
+        int32_t getNumberOfNodes() const { return (int32_t)m_weightSums.size(); }
+        void setWeights(const std::vector<WeightList>& weightLists);
+        static void addCacheKey(WeightCacheFile& myCache, const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod, const float* nodeAreas);
+        bool loadWeightCache(WeightCacheFile& myCache, const int32_t& numNodes);
+        void saveWeightCache(WeightCacheFile& myCache) const;
         void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const bool& fixZeros) const;
         void smoothColumnInternal(float* scratch, const MetricFile* metricIn, const int& whichColumn, MetricFile* metricOut, const int& whichOutColumn, const MetricFile* roi, const int& whichRoiColumn, const bool& fixZeros) const;
         void precomputeWeights(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, Method myMethod, const float* nodeAreas);
-        void precomputeWeightsGeoGauss(const SurfaceFile* mySurf, float myKernel);
-        void precomputeWeightsROIGeoGauss(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
-        void precomputeWeightsGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const float* nodeAreas);
-        void precomputeWeightsROIGeoGaussArea(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, const float* nodeAreas);
-        void precomputeWeightsGeoGaussEqual(const SurfaceFile* mySurf, float myKernel);
-        void precomputeWeightsROIGeoGaussEqual(const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
+        void precomputeWeightsGeoGauss(std::vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel);
+        void precomputeWeightsROIGeoGauss(std::vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
+        void precomputeWeightsGeoGaussArea(std::vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel, const float* nodeAreas);
+        void precomputeWeightsROIGeoGaussArea(std::vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi, const float* nodeAreas);
+        void precomputeWeightsGeoGaussEqual(std::vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel);
+        void precomputeWeightsROIGeoGaussEqual(std::vector<WeightList>& weightsOut, const SurfaceFile* mySurf, float myKernel, const MetricFile* theRoi);
         MetricSmoothingObject();
     };
     
@@ -47,14 +47,20 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 
 #include "RibbonMappingHelper.h"
 
+#include "ByteSwapping.h"
+#include "CaretAssert.h"
 #include "CaretException.h"
+#include "CaretOMP.h"
 #include "FloatMatrix.h"
 #include "MathFunctions.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 #include "VolumeSpace.h"
 
+#include <QFile>
+
 #include <cmath>
+#include <cstring>
 
 using namespace caret;
 using namespace std;
@@ -330,3 +336,188 @@ void RibbonMappingHelper::computeWeightsRibbon(vector<vector<VoxelWeight> >& myW
         }
     }
 }
+
+namespace
+{
+    const char WEIGHTS_MAGIC[8] = { 'W', 'B', 'V', 'X', 'W', 'G', 'H', 'T' };
+    const int32_t WEIGHTS_VERSION = 1;
+    
+    //followed by starts (numNodes + 1 int64), voxels (numEntries int64), and weights (numEntries float), all in the byte order of the machine that wrote it
+    struct WeightsHeader
+    {
+        char m_magic[8];
+        int32_t m_version;//also detects byte order mismatch
+        int32_t m_normalized;
+        int64_t m_dims[3];
+        float m_sform[12];
+        int64_t m_numNodes, m_numEntries;
+    };
+}
+
+VertexVoxelWeights::VertexVoxelWeights()
+{
+    m_normalized = false;
+    m_starts.resize(1, 0);
+}
+
+void VertexVoxelWeights::setWeights(const vector<vector<VoxelWeight> >& myWeights, const VolumeSpace& myVolSpace, const bool& normalized)
+{
+    m_volSpace = myVolSpace;
+    m_normalized = normalized;
+    const int64_t* dims = myVolSpace.getDims();
+    int64_t numNodes = (int64_t)myWeights.size();
+    m_starts.resize(numNodes + 1);
+    m_starts[0] = 0;
+    for (int64_t i = 0; i < numNodes; ++i)
+    {
+        m_starts[i + 1] = m_starts[i] + (int64_t)myWeights[i].size();
+    }
+    m_voxels.resize(m_starts[numNodes]);
+    m_weights.resize(m_starts[numNodes]);
+    for (int64_t i = 0; i < numNodes; ++i)
+    {
+        const vector<VoxelWeight>& nodeWeights = myWeights[i];
+        int64_t base = m_starts[i];
+        for (int64_t j = 0; j < (int64_t)nodeWeights.size(); ++j)
+        {
+            const int64_t* ijk = nodeWeights[j].ijk;
+            CaretAssert(myVolSpace.indexValid(ijk));
+            m_voxels[base + j] = ijk[0] + dims[0] * (ijk[1] + dims[1] * ijk[2]);
+            m_weights[base + j] = nodeWeights[j].weight;
+        }
+    }
+}
+
+void VertexVoxelWeights::swap(VertexVoxelWeights& other)
+{
+    std::swap(m_volSpace, other.m_volSpace);
+    std::swap(m_normalized, other.m_normalized);
+    m_starts.swap(other.m_starts);
+    m_voxels.swap(other.m_voxels);
+    m_weights.swap(other.m_weights);
+}
+
+void VertexVoxelWeights::apply(const float* frame, float* dataOut) const
+{//keep the arithmetic identical to mapping with freshly computed weights
+    int64_t numNodes = getNumberOfNodes();
+    const int64_t* voxels = m_voxels.data();
+    const float* weights = m_weights.data();
+    if (m_normalized)
+    {
+#pragma omp CARET_PARFOR schedule(dynamic, 256)
+        for (int64_t node = 0; node < numNodes; ++node)
+        {
+            double accum = 0.0;
+            for (int64_t j = m_starts[node]; j < m_starts[node + 1]; ++j)
+            {
+                accum += weights[j] * frame[voxels[j]];
+            }
+            dataOut[node] = accum;
+        }
+    } else {
+#pragma omp CARET_PARFOR schedule(dynamic, 256)
+        for (int64_t node = 0; node < numNodes; ++node)
+        {
+            float accum = 0.0f, totalWeight = 0.0f;
+            for (int64_t j = m_starts[node]; j < m_starts[node + 1]; ++j)
+            {
+                totalWeight += weights[j];
+                accum += weights[j] * frame[voxels[j]];
+            }
+            if (totalWeight != 0.0f)
+            {
+                dataOut[node] = accum / totalWeight;
+            } else {
+                dataOut[node] = 0.0f;
+            }
+        }
+    }
+}
+
+void VertexVoxelWeights::writeFile(const AString& fileName) const
+{
+    QFile outFile(fileName);
+    if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        throw CaretException("failed to open weights file '" + fileName + "' for writing");
+    }
+    WeightsHeader myHeader;
+    memset(&myHeader, 0, sizeof(WeightsHeader));
+    memcpy(myHeader.m_magic, WEIGHTS_MAGIC, sizeof(WEIGHTS_MAGIC));
+    myHeader.m_version = WEIGHTS_VERSION;
+    myHeader.m_normalized = (m_normalized ? 1 : 0);
+    const int64_t* dims = m_volSpace.getDims();
+    const vector<vector<float> >& sform = m_volSpace.getSform();
+    for (int i = 0; i < 3; ++i)
+    {
+        myHeader.m_dims[i] = dims[i];
+        for (int j = 0; j < 4; ++j)
+        {
+            myHeader.m_sform[i * 4 + j] = sform[i][j];
+        }
+    }
+    myHeader.m_numNodes = getNumberOfNodes();
+    myHeader.m_numEntries = (int64_t)m_voxels.size();
+    bool good = outFile.write((const char*)&myHeader, sizeof(WeightsHeader)) == (qint64)sizeof(WeightsHeader) &&
+                outFile.write((const char*)m_starts.data(), m_starts.size() * sizeof(int64_t)) == (qint64)(m_starts.size() * sizeof(int64_t)) &&
+                outFile.write((const char*)m_voxels.data(), m_voxels.size() * sizeof(int64_t)) == (qint64)(m_voxels.size() * sizeof(int64_t)) &&
+                outFile.write((const char*)m_weights.data(), m_weights.size() * sizeof(float)) == (qint64)(m_weights.size() * sizeof(float));
+    outFile.close();
+    if (!good || outFile.error() != QFile::NoError)
+    {
+        throw CaretException("failed to write weights file '" + fileName + "'");
+    }
+}
+
+void VertexVoxelWeights::readFile(const AString& fileName)
+{
+    QFile inFile(fileName);
+    if (!inFile.open(QIODevice::ReadOnly))
+    {
+        throw CaretException("failed to open weights file '" + fileName + "'");
+    }
+    WeightsHeader myHeader;
+    if (inFile.read((char*)&myHeader, sizeof(WeightsHeader)) != (qint64)sizeof(WeightsHeader) || memcmp(myHeader.m_magic, WEIGHTS_MAGIC, sizeof(WEIGHTS_MAGIC)) != 0)
+    {
+        throw CaretException("file '" + fileName + "' is not a volume to surface mapping weights file");
+    }
+    if (myHeader.m_version != WEIGHTS_VERSION)
+    {
+        int32_t swapped = myHeader.m_version;
+        ByteSwapping::swap(swapped);
+        if (swapped == WEIGHTS_VERSION)
+        {
+            throw CaretException("weights file '" + fileName + "' was written on a machine with different byte order, it must be regenerated");
+        }
+        throw CaretException("weights file '" + fileName + "' has unsupported version " + AString::number(myHeader.m_version));
+    }
+    if (myHeader.m_numNodes < 0 || myHeader.m_numEntries < 0 || myHeader.m_dims[0] < 1 || myHeader.m_dims[1] < 1 || myHeader.m_dims[2] < 1 ||
+        inFile.size() != (qint64)(sizeof(WeightsHeader) + (myHeader.m_numNodes + 1) * sizeof(int64_t) + myHeader.m_numEntries * (sizeof(int64_t) + sizeof(float))))
+    {
+        throw CaretException("weights file '" + fileName + "' is truncated or corrupt");
+    }
+    vector<int64_t> starts(myHeader.m_numNodes + 1), voxels(myHeader.m_numEntries);
+    vector<float> weights(myHeader.m_numEntries);
+    bool good = inFile.read((char*)starts.data(), starts.size() * sizeof(int64_t)) == (qint64)(starts.size() * sizeof(int64_t)) &&
+                inFile.read((char*)voxels.data(), voxels.size() * sizeof(int64_t)) == (qint64)(voxels.size() * sizeof(int64_t)) &&
+                inFile.read((char*)weights.data(), weights.size() * sizeof(float)) == (qint64)(weights.size() * sizeof(float));
+    if (good && (starts[0] != 0 || starts[myHeader.m_numNodes] != myHeader.m_numEntries)) good = false;
+    for (int64_t i = 0; good && i < myHeader.m_numNodes; ++i)
+    {
+        if (starts[i + 1] < starts[i]) good = false;
+    }
+    int64_t frameSize = myHeader.m_dims[0] * myHeader.m_dims[1] * myHeader.m_dims[2];
+    for (int64_t j = 0; good && j < myHeader.m_numEntries; ++j)
+    {
+        if (voxels[j] < 0 || voxels[j] >= frameSize) good = false;
+    }
+    if (!good)
+    {
+        throw CaretException("weights file '" + fileName + "' is truncated or corrupt");
+    }
+    m_volSpace.setSpace(myHeader.m_dims, myHeader.m_sform);
+    m_normalized = (myHeader.m_normalized != 0);
+    m_starts.swap(starts);
+    m_voxels.swap(voxels);
+    m_weights.swap(weights);
+}
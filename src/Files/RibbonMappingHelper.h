@@ -21,6 +21,9 @@
  */
 /*LICENSE_END*/
 
+#include "AString.h"
+#include "VolumeSpace.h"
+
 #include "stdint.h"
 #include <cstddef>
 #include <vector>
@@ -29,7 +32,6 @@ namespace caret
 {
     
     class SurfaceFile;
-    class VolumeSpace;
     
     struct VoxelWeight
     {//for precomputation in ribbon/myelin style volume to surface mapping
@@ -45,6 +47,30 @@ namespace caret
         }
     };
     
+    ///per-vertex voxel weights flattened into one array with linear voxel indices, so they can be applied to a frame as a sparse gather, and saved for reuse
+    class VertexVoxelWeights
+    {
+        VolumeSpace m_volSpace;
+        bool m_normalized;//myelin style weights sum to 1 per vertex, ribbon weights are divided by their sum when applied
+        std::vector<int64_t> m_starts;//numNodes + 1, weights for vertex i are [m_starts[i], m_starts[i + 1])
+        std::vector<int64_t> m_voxels;//index into a frame
+        std::vector<float> m_weights;
+    public:
+        VertexVoxelWeights();
+        void setWeights(const std::vector<std::vector<VoxelWeight> >& myWeights, const VolumeSpace& myVolSpace, const bool& normalized);
+        int64_t getNumberOfNodes() const { return (int64_t)m_starts.size() - 1; }
+        const VolumeSpace& getVolumeSpace() const { return m_volSpace; }
+        bool isNormalized() const { return m_normalized; }
+        void swap(VertexVoxelWeights& other);
+        
+        ///frame must be in the volume space the weights were computed in, dataOut must have getNumberOfNodes() elements
+        void apply(const float* frame, float* dataOut) const;
+        
+        ///throws CaretException on failure
+        void writeFile(const AString& fileName) const;
+        void readFile(const AString& fileName);
+    };
+    
     class RibbonMappingHelper
     {
     public:
@@ -50,6 +50,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SO
 #include "SignedDistanceHelper.h"
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
+#include <algorithm>
 #include <cmath>
 
 using namespace std;
@@ -241,6 +242,126 @@ void SignedDistanceHelper::barycentricWeights(const float coord[3], BarycentricI
     }
 }
 
+bool SignedDistanceHelper::rayEntersOct(const Oct<SignedDistanceHelperBase::TriVector>* thisOct, const float start[3], const float direction[3], float& paramOut)
+{//parameter along the ray at which it enters the box, 0 if it starts inside
+    float curlow = 0.0f, curhigh = 0.0f;
+    bool first = true;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (direction[i] != 0.0f)
+        {
+            float templow = (thisOct->m_bounds[i][0] - start[i]) / direction[i];
+            float temphigh = (thisOct->m_bounds[i][2] - start[i]) / direction[i];
+            if (templow > temphigh) std::swap(templow, temphigh);
+            if (first)
+            {
+                first = false;
+                curlow = templow;
+                curhigh = temphigh;
+            } else {
+                if (templow > curlow) curlow = templow;
+                if (temphigh < curhigh) curhigh = temphigh;
+            }
+            if (curhigh < curlow || curhigh < 0.0f) return false;
+        } else {
+            if (start[i] < thisOct->m_bounds[i][0] || start[i] > thisOct->m_bounds[i][2]) return false;
+        }
+    }
+    if (first) return false;//zero length direction
+    paramOut = (curlow > 0.0f ? curlow : 0.0f);
+    return true;
+}
+
+bool SignedDistanceHelper::rayIntersection(const float start[3], const float direction[3], int32_t& triangleOut, float& paramOut, RaySide side)
+{
+    CaretMutexLocker locked(&m_mutex);
+    triangleOut = -1;
+    paramOut = -1.0f;
+    float tempf = -1.0f;
+    if (!rayEntersOct(m_base->m_indexRoot, start, direction, tempf)) return false;
+    CaretSimpleMinHeap<Oct<SignedDistanceHelperBase::TriVector>*, float> myHeap;
+    myHeap.push(m_base->m_indexRoot, tempf);
+    bool found = false;
+    int numChanged = 0;
+    while (!myHeap.isEmpty())
+    {
+        Oct<SignedDistanceHelperBase::TriVector>* curOct = myHeap.pop(&tempf);
+        if (found && tempf > paramOut) break;//octs come out in order of where the ray enters them, nothing further along can be closer
+        if (curOct->m_leaf)
+        {
+            vector<int32_t>& myVecRef = *(curOct->m_data.m_triList);
+            int numTris = (int)myVecRef.size();
+            for (int i = 0; i < numTris; ++i)
+            {
+                if (m_triMarked[myVecRef[i]] != 1)
+                {
+                    m_triMarked[myVecRef[i]] = 1;
+                    m_triMarkChanged[numChanged++] = myVecRef[i];
+                    if (rayHitsTri(start, direction, myVecRef[i], side, tempf) && (!found || tempf < paramOut))
+                    {
+                        triangleOut = myVecRef[i];
+                        paramOut = tempf;
+                        found = true;
+                    }
+                }
+            }
+        } else {
+            for (int ci = 0; ci < 2; ++ci)
+            {
+                for (int cj = 0; cj < 2; ++cj)
+                {
+                    for (int ck = 0; ck < 2; ++ck)
+                    {
+                        if (rayEntersOct(curOct->m_children[ci][cj][ck], start, direction, tempf) && (!found || tempf <= paramOut))
+                        {
+                            myHeap.push(curOct->m_children[ci][cj][ck], tempf);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    while (numChanged)
+    {
+        m_triMarked[m_triMarkChanged[--numChanged]] = 0;//clean up
+    }
+    return found;
+}
+
+bool SignedDistanceHelper::rayHitsTri(const float start[3], const float direction[3], int32_t triangle, RaySide side, float& paramOut)
+{//Moller-Trumbore, in double so that nearly edge-on triangles don't produce garbage
+    const int32_t* triNodes = m_base->getTriangle(triangle);
+    const float* vert1 = m_base->getCoordinate(triNodes[0]);
+    const float* vert2 = m_base->getCoordinate(triNodes[1]);
+    const float* vert3 = m_base->getCoordinate(triNodes[2]);
+    double edge1[3], edge2[3], pvec[3], tvec[3], qvec[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        edge1[i] = (double)vert2[i] - vert1[i];
+        edge2[i] = (double)vert3[i] - vert1[i];
+        tvec[i] = (double)start[i] - vert1[i];
+    }
+    pvec[0] = direction[1] * edge2[2] - direction[2] * edge2[1];
+    pvec[1] = direction[2] * edge2[0] - direction[0] * edge2[2];
+    pvec[2] = direction[0] * edge2[1] - direction[1] * edge2[0];
+    double det = edge1[0] * pvec[0] + edge1[1] * pvec[1] + edge1[2] * pvec[2];
+    if (det == 0.0) return false;//ray is parallel to the triangle
+    if (side == COUNTERCLOCKWISE_SIDE && det < 0.0) return false;//det is positive when the vertices appear counterclockwise from the start of the ray
+    if (side == CLOCKWISE_SIDE && det > 0.0) return false;
+    double invDet = 1.0 / det;
+    double u = (tvec[0] * pvec[0] + tvec[1] * pvec[1] + tvec[2] * pvec[2]) * invDet;
+    if (u < 0.0 || u > 1.0) return false;
+    qvec[0] = tvec[1] * edge1[2] - tvec[2] * edge1[1];
+    qvec[1] = tvec[2] * edge1[0] - tvec[0] * edge1[2];
+    qvec[2] = tvec[0] * edge1[1] - tvec[1] * edge1[0];
+    double v = (direction[0] * qvec[0] + direction[1] * qvec[1] + direction[2] * qvec[2]) * invDet;
+    if (v < 0.0 || u + v > 1.0) return false;
+    double t = (edge2[0] * qvec[0] + edge2[1] * qvec[1] + edge2[2] * qvec[2]) * invDet;
+    if (t < 0.0) return false;
+    paramOut = (float)t;
+    return true;
+}
+
 int SignedDistanceHelper::computeSign(const float coord[3], SignedDistanceHelper::ClosestPointInfo myInfo, WindingLogic myWinding)
 {
     Vector3D point = coord;
@@ -91,6 +91,13 @@ namespace caret {
             NONZERO,
             NORMALS
         };
+        ///which side of a triangle a ray may hit, by whether the triangle's vertices appear counterclockwise or clockwise from the ray's start
+        enum RaySide
+        {
+            EITHER_SIDE,
+            COUNTERCLOCKWISE_SIDE,
+            CLOCKWISE_SIDE
+        };
     private:
         CaretMutex m_mutex;
         CaretPointer<SignedDistanceHelperBase> m_base;
@@ -106,6 +113,8 @@ namespace caret {
         float unsignedDistToTri(const float coord[3], int32_t triangle, ClosestPointInfo& myInfo);
         int computeSign(const float coord[3], ClosestPointInfo myInfo, WindingLogic myWinding);
         bool pointInTri(Vector3D verts[3], Vector3D inPlane, int majAxis, int midAxis);
+        bool rayHitsTri(const float start[3], const float direction[3], int32_t triangle, RaySide side, float& paramOut);
+        static bool rayEntersOct(const Oct<SignedDistanceHelperBase::TriVector>* thisOct, const float start[3], const float direction[3], float& paramOut);
     public:
         SignedDistanceHelper(CaretPointer<SignedDistanceHelperBase> myBase);
         
@@ -115,6 +124,10 @@ namespace caret {
         ///find the closest point ON the surface, and return information about it
         ///will never have negative barycentric weights, or a point outside the triangle
         void barycentricWeights(const float coordIn[3], BarycentricInfo& baryInfoOut);
+        
+        ///find the first triangle hit by a ray on the given side, returns false if the ray misses the surface
+        ///the hit point is start + paramOut * direction
+        bool rayIntersection(const float start[3], const float direction[3], int32_t& triangleOut, float& paramOut, RaySide side = EITHER_SIDE);
     };
 
 }
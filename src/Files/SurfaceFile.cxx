@@ -39,6 +39,7 @@
 #include "GiftiMetaDataXmlElements.h"
 #include "MathFunctions.h"
 #include "Matrix4x4.h"
+#include "ModificationStamp.h"
 #include "Vector3D.h"
 
 #include "CaretPointLocator.h"
@@ -525,6 +526,8 @@ SurfaceFile::initializeMembersSurfaceFile()
     m_geoHelperIndex = 0;
     m_topoHelperIndex = 0;
     m_normalsComputed = false;
+    m_geometryStamp = ModificationStamp::newStamp();
+    m_nodeColoringStamp = ModificationStamp::newStamp();
 }
 
 /**
@@ -565,6 +568,7 @@ void
 SurfaceFile::invalidateNormals()
 {
     m_normalsComputed = false;
+    m_geometryStamp = ModificationStamp::newStamp();
 }
 /**
  * Compute surface normals.
@@ -577,6 +581,7 @@ SurfaceFile::computeNormals()
         return;
     }
     m_normalsComputed = true;
+    m_geometryStamp = ModificationStamp::newStamp();
     int32_t numCoords = this->getNumberOfNodes();
     if (numCoords > 0) {
         this->normalVectors.resize(numCoords * 3);
@@ -858,6 +863,7 @@ CaretPointer<SignedDistanceHelper> SurfaceFile::getSignedDistanceHelper() const
 
 void SurfaceFile::invalidateHelpers()
 {
+    m_geometryStamp = ModificationStamp::newStamp();
     if (m_geoBase != NULL)
     {
         CaretMutexLocker myLock(&m_geoHelperMutex);//make this function threadsafe
@@ -988,7 +994,9 @@ SurfaceFile::applyMatrix(const Matrix4x4& matrix)
             matrix.multiplyPoint3(&coordinatePointer[i*3]);
         }
     }
-    
+
+    invalidateHelpers();//also gives a new geometry stamp, so cached vertex buffers get reloaded
+    invalidateNormals();//otherwise computeNormals keeps the old normals
     computeNormals();
     
     setModified();
@@ -1343,6 +1351,7 @@ SurfaceFile::getNodesSpacingStatistics(FastStatistics& statsOut) const
 void
 SurfaceFile::invalidateNodeColoringForBrowserTabs()
 {
+    m_nodeColoringStamp = ModificationStamp::newStamp();
     /*
      * Free memory since could have many tabs and many surfaces equals lots of memory
      */
@@ -1474,6 +1483,7 @@ SurfaceFile::setSurfaceNodeColoringRgbaForBrowserTab(const int32_t browserTabInd
     
     this->allocateSurfaceNodeColoringForBrowserTab(browserTabIndex, 
                                             false);
+    m_nodeColoringStamp = ModificationStamp::newStamp();
     const int numberOfComponentsRGBA = this->getNumberOfNodes() * 4;
     std::vector<float>& rgba = this->surfaceNodeColoringForBrowserTabs[browserTabIndex];
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
@@ -1521,6 +1531,7 @@ SurfaceFile::setSurfaceMontageNodeColoringRgbaForBrowserTab(const int32_t browse
     
     this->allocateSurfaceMontageNodeColoringForBrowserTab(browserTabIndex, 
                                                    false);
+    m_nodeColoringStamp = ModificationStamp::newStamp();
     const int numberOfComponentsRGBA = this->getNumberOfNodes() * 4;
     std::vector<float>& rgba = this->surfaceMontageNodeColoringForBrowserTabs[browserTabIndex];
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
@@ -1568,6 +1579,7 @@ SurfaceFile::setWholeBrainNodeColoringRgbaForBrowserTab(const int32_t browserTab
     
     this->allocateWholeBrainNodeColoringForBrowserTab(browserTabIndex, 
                                                    false);
+    m_nodeColoringStamp = ModificationStamp::newStamp();
     const int numberOfComponentsRGBA = this->getNumberOfNodes() * 4;
     std::vector<float>& rgba = this->wholeBrainNodeColoringForBrowserTabs[browserTabIndex];
     for (int32_t i = 0; i < numberOfComponentsRGBA; i++) {
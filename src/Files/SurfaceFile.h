@@ -93,6 +93,12 @@ namespace caret {
         
         const float* getNormalData() const;
         
+        ///changes whenever coordinates, triangles or normals change, and is unique across all surfaces, for caching things derived from geometry
+        int64_t getGeometryModificationStamp() const { return m_geometryStamp; }
+        
+        ///changes whenever the node coloring for any browser tab is set or invalidated
+        int64_t getNodeColoringModificationStamp() const { return m_nodeColoringStamp; }
+        
         int getNumberOfTriangles() const;
         
         const int32_t* getTriangle(const int32_t index) const;
@@ -260,6 +266,8 @@ namespace caret {
         
         bool m_normalsComputed;
         
+        int64_t m_geometryStamp, m_nodeColoringStamp;
+        
         bool m_skipSanityCheck;
 
         ///topology base for surface
@@ -33,6 +33,7 @@
 #include "SurfaceFile.h"
 #include "TopologyHelper.h"
 #include "Vector3D.h"
+#include "WeightCacheFile.h"
 
 #include <set>
 #include <map>
@@ -40,10 +41,35 @@
 using namespace std;
 using namespace caret;
 
+namespace
+{
+    const char CACHE_MAGIC[8] = { 'W', 'B', 'R', 'E', 'S', 'M', 'P', 'L' };
+    const int32_t CACHE_VERSION = 2;
+}
+
+AString SurfaceResamplingHelper::s_weightCacheDirectory;
+
+void SurfaceResamplingHelper::setWeightCacheDirectory(const AString& directory)
+{
+    s_weightCacheDirectory = directory;
+}
+
+AString SurfaceResamplingHelper::getWeightCacheDirectory()
+{
+    return s_weightCacheDirectory;
+}
+
 SurfaceResamplingHelper::SurfaceResamplingHelper(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
                                                  const float* currentAreas, const float* newAreas, const float* currentRoi)
 {
     if (!checkSphere(currentSphere) || !checkSphere(newSphere)) throw CaretException("input surfaces to SurfaceResamplingHelper must be spheres");
+    CaretPointer<WeightCacheFile> myCache;
+    if (!s_weightCacheDirectory.isEmpty() && (myMethod != SurfaceResamplingMethodEnum::ADAP_BARY_AREA || (currentAreas != NULL && newAreas != NULL)))
+    {
+        myCache.grabNew(new WeightCacheFile(s_weightCacheDirectory, ".wbresample", CACHE_MAGIC, CACHE_VERSION, "resampling"));
+        addCacheKey(*myCache, myMethod, currentSphere, newSphere, currentAreas, newAreas, currentRoi);
+        if (loadWeightCache(*myCache, currentSphere->getNumberOfNodes(), newSphere->getNumberOfNodes())) return;
+    }
     SurfaceFile currentSphereMod, newSphereMod;
     changeRadius(100.0f, currentSphere, &currentSphereMod);
     changeRadius(100.0f, newSphere, &newSphereMod);
@@ -58,6 +84,7 @@ SurfaceResamplingHelper::SurfaceResamplingHelper(const SurfaceResamplingMethodEn
             computeWeightsBarycentric(&currentSphereMod, &newSphereMod, currentRoi);
             break;
     }
+    if (myCache != NULL) saveWeightCache(*myCache, currentSphere->getNumberOfNodes());
 }
 
 void SurfaceResamplingHelper::resampleNormal(const float* input, float* output, const float& invalidVal) const
@@ -613,3 +640,82 @@ void SurfaceResamplingHelper::makeBarycentricWeights(const SurfaceFile* from, co
         }
     }
 }
+
+void SurfaceResamplingHelper::addCacheKey(WeightCacheFile& myCache, const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
+                                          const float* currentAreas, const float* newAreas, const float* currentRoi)
+{//everything the weights depend on
+    int32_t numCurNodes = currentSphere->getNumberOfNodes(), numNewNodes = newSphere->getNumberOfNodes();
+    int32_t header[3] = { (int32_t)myMethod, numCurNodes, numNewNodes };
+    myCache.addKeyData(header, sizeof(header));
+    const SurfaceFile* spheres[2] = { currentSphere, newSphere };
+    for (int s = 0; s < 2; ++s)
+    {
+        int32_t numNodes = spheres[s]->getNumberOfNodes(), numTriangles = spheres[s]->getNumberOfTriangles();
+        myCache.addKeyData(&numTriangles, sizeof(int32_t));
+        myCache.addKeyData(spheres[s]->getCoordinateData(), numNodes * 3 * sizeof(float));
+        for (int32_t i = 0; i < numTriangles; ++i)
+        {
+            myCache.addKeyData(spheres[s]->getTriangle(i), 3 * sizeof(int32_t));
+        }
+    }
+    if (currentRoi != NULL)
+    {
+        myCache.addKeyMask(currentRoi, numCurNodes);
+    }
+    if (myMethod == SurfaceResamplingMethodEnum::ADAP_BARY_AREA)
+    {
+        CaretAssert(currentAreas != NULL && newAreas != NULL);
+        myCache.addKeyData("areas", 5);
+        myCache.addKeyData(currentAreas, numCurNodes * sizeof(float));
+        myCache.addKeyData(newAreas, numNewNodes * sizeof(float));
+    }
+}
+
+//payload is weight starts (numNewNodes + 1 int64), then numEntries of (node int32, weight float)
+bool SurfaceResamplingHelper::loadWeightCache(WeightCacheFile& myCache, const int& numCurNodes, const int& numNewNodes)
+{
+    int64_t counts[WeightCacheFile::NUM_COUNTS];
+    if (!myCache.beginRead(counts)) return false;
+    int64_t numEntries = counts[2];
+    if (counts[0] != numCurNodes || counts[1] != numNewNodes || numEntries < 0 ||
+        myCache.getPayloadSize() != (int64_t)((numNewNodes + 1) * sizeof(int64_t) + numEntries * sizeof(WeightElem)))
+    {
+        return myCache.finishRead(false);
+    }
+    vector<int64_t> weightStarts(numNewNodes + 1);
+    CaretArray<WeightElem> storage(numEntries);
+    bool good = myCache.read(weightStarts.data(), weightStarts.size() * sizeof(int64_t)) &&
+                myCache.read(storage.getArray(), numEntries * sizeof(WeightElem));
+    if (good && (weightStarts[0] != 0 || weightStarts[numNewNodes] != numEntries)) good = false;
+    for (int i = 0; good && i < numNewNodes; ++i)
+    {
+        if (weightStarts[i + 1] < weightStarts[i]) good = false;
+    }
+    for (int64_t j = 0; good && j < numEntries; ++j)
+    {
+        if (storage[j].node < 0 || storage[j].node >= numCurNodes) good = false;
+    }
+    if (!myCache.finishRead(good)) return false;
+    m_storagechunk = storage;
+    m_weights = CaretArray<WeightElem*>(numNewNodes + 1);
+    for (int i = 0; i <= numNewNodes; ++i)
+    {
+        m_weights[i] = m_storagechunk + weightStarts[i];
+    }
+    return true;
+}
+
+void SurfaceResamplingHelper::saveWeightCache(WeightCacheFile& myCache, const int& numCurNodes) const
+{
+    int numNewNodes = (int)m_weights.size() - 1;
+    vector<int64_t> weightStarts(numNewNodes + 1);
+    for (int i = 0; i <= numNewNodes; ++i)
+    {
+        weightStarts[i] = m_weights[i] - m_storagechunk.getArray();
+    }
+    int64_t counts[WeightCacheFile::NUM_COUNTS] = { numCurNodes, numNewNodes, weightStarts[numNewNodes] };
+    if (!myCache.beginWrite(counts)) return;
+    myCache.write(weightStarts.data(), weightStarts.size() * sizeof(int64_t));
+    myCache.write(m_storagechunk.getArray(), weightStarts[numNewNodes] * sizeof(WeightElem));
+    myCache.finishWrite();
+}
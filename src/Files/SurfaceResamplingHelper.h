@@ -21,6 +21,7 @@
  */
 /*LICENSE_END*/
 
+#include "AString.h"
 #include "CaretPointer.h"
 #include "SurfaceResamplingMethodEnum.h"
 
@@ -30,6 +31,7 @@
 namespace caret {
 
     class SurfaceFile;
+    class WeightCacheFile;
     
     class SurfaceResamplingHelper
     {
@@ -42,12 +44,17 @@ namespace caret {
         };
         CaretArray<WeightElem> m_storagechunk;
         CaretArray<WeightElem*> m_weights;
+        static AString s_weightCacheDirectory;
         static bool checkSphere(const SurfaceFile* surface);
         static void changeRadius(const float& radius, const SurfaceFile* input, SurfaceFile* output);
         void computeWeightsAdapBaryArea(const SurfaceFile* currentSphere, const SurfaceFile* newSphere, const float* currentAreas, const float* newAreas, const float* currentRoi);
         void computeWeightsBarycentric(const SurfaceFile* currentSphere, const SurfaceFile* newSphere, const float* currentRoi);
         static void makeBarycentricWeights(const SurfaceFile* from, const SurfaceFile* to, std::vector<std::map<int, float> >& weights, const float* currentRoi);
         void compactWeights(const std::vector<std::map<int, float> >& weights);
+        static void addCacheKey(WeightCacheFile& myCache, const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
+                                const float* currentAreas, const float* newAreas, const float* currentRoi);
+        bool loadWeightCache(WeightCacheFile& myCache, const int& numCurNodes, const int& numNewNodes);
+        void saveWeightCache(WeightCacheFile& myCache, const int& numCurNodes) const;
     public:
         SurfaceResamplingHelper() { }
         SurfaceResamplingHelper(const SurfaceResamplingMethodEnum::Enum& myMethod, const SurfaceFile* currentSphere, const SurfaceFile* newSphere,
@@ -65,6 +72,10 @@ namespace caret {
         ///get the ROI of nodes that have data within the input ROI
         void getResampleValidROI(float* output) const;
         
+        ///directory to save computed weights in and reuse them from, empty (the default) disables the cache
+        static void setWeightCacheDirectory(const AString& directory);
+        static AString getWeightCacheDirectory();
+        
         ///resample a cut surface - not something you will apply multiple times, so static method
         static void resampleCutSurface(const SurfaceFile* cutSurfaceIn, const SurfaceFile* curSphere, const SurfaceFile* newSphere, SurfaceFile* surfaceOut);
     };
@@ -0,0 +1,292 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "TFCEHelper.h"
+
+#include "CaretAssert.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "TopologyHelper.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t UNVISITED = -1;//parent values below this are roots, encoding their cluster as -(cluster + 2)
+
+    struct Cluster
+    {
+        double accumVal, totalArea;
+        int64_t numMembers;
+        float lastVal;
+        bool first;
+        Cluster()
+        {
+            first = true;
+            accumVal = 0.0;
+            totalArea = 0.0;
+            numMembers = 0;
+        }
+        void addMember(const float& val, const float& area, const float& param_e, const float& param_h)
+        {
+            update(val, param_e, param_h);
+            ++numMembers;
+            totalArea += area;
+        }
+        void update(const float& bottomVal, const float& param_e, const float& param_h)
+        {
+            if (first)
+            {
+                lastVal = bottomVal;
+                first = false;
+            } else {
+                if (bottomVal != lastVal)//skip computing if there is no difference
+                {
+                    CaretAssert(bottomVal < lastVal);
+                    double integrated_h = param_h + 1.0f;//integral(x^h) = (x^(h + 1))/(h + 1) + C
+                    double newSlice = pow(totalArea, (double)param_e) * (pow((double)lastVal, integrated_h) - pow((double)bottomVal, integrated_h)) / integrated_h;
+                    accumVal += newSlice;
+                    lastVal = bottomVal;//computing in double precision, with float for inputs, puts the smallest difference between values far greater than the instability of the computation
+                }
+            }
+        }
+    };
+
+    struct ValueIndex
+    {
+        float value;
+        int64_t index;
+        bool operator<(const ValueIndex& rhs) const
+        {//largest first
+            if (value != rhs.value) return value > rhs.value;
+            return index < rhs.index;
+        }
+    };
+
+    //offset is the integral an element has beyond what its parent gets, compresses the path so later lookups are direct
+    int64_t findRoot(vector<int64_t>& parent, vector<double>& offset, const int64_t& elem)
+    {
+        int64_t root = elem;
+        double total = 0.0;
+        while (parent[root] >= 0)
+        {
+            total += offset[root];
+            root = parent[root];
+        }
+        int64_t cur = elem;
+        while (parent[cur] >= 0)
+        {
+            int64_t next = parent[cur];
+            double curOffset = offset[cur];
+            parent[cur] = root;
+            offset[cur] = total;
+            total -= curOffset;
+            cur = next;
+        }
+        return root;
+    }
+
+    bool inParallel()
+    {
+#ifdef CARET_OMP
+        return omp_in_parallel() != 0;
+#else
+        return false;
+#endif
+    }
+}
+
+TFCEHelper::TFCEHelper(const TopologyHelper* myTopoHelp, const float* areaData)
+{
+    CaretAssert(myTopoHelp != NULL && areaData != NULL);
+    m_dims[0] = 0;
+    m_dims[1] = 0;
+    m_dims[2] = 0;
+    m_voxelVolume = 0.0f;
+    m_numElements = myTopoHelp->getNumberOfNodes();
+    m_elemWeights.assign(areaData, areaData + m_numElements);
+    m_neighborStarts.resize(m_numElements + 1);
+    m_neighborStarts[0] = 0;
+    for (int32_t node = 0; node < (int32_t)m_numElements; ++node)
+    {
+        int32_t numNeigh = 0;
+        const int32_t* neighbors = myTopoHelp->getNodeNeighbors(node, numNeigh);
+        m_neighbors.insert(m_neighbors.end(), neighbors, neighbors + numNeigh);
+        m_neighborStarts[node + 1] = (int32_t)m_neighbors.size();
+    }
+}
+
+TFCEHelper::TFCEHelper(const int64_t dims[3], const float& voxelVolume)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (dims[i] < 1) throw CaretException("TFCE volume dimensions must be positive");
+        m_dims[i] = dims[i];
+    }
+    m_voxelVolume = voxelVolume;
+    m_numElements = dims[0] * dims[1] * dims[2];
+}
+
+void TFCEHelper::compute(const float* data, float* dataOut, const float* roiData, const float& param_e, const float& param_h) const
+{
+    vector<double> accum(m_numElements, 0.0);
+    int numPasses = (inParallel() ? 1 : 2);//when nested, the positive and negative passes run serially
+#pragma omp CARET_PARFOR num_threads(numPasses)
+    for (int pass = 0; pass < 2; ++pass)
+    {//negatives and positives don't overlap, so both passes share the accum array
+        computePass(data, roiData, pass == 1, param_e, param_h, accum.data());
+    }
+    for (int64_t i = 0; i < m_numElements; ++i)
+    {
+        if (roiData == NULL || roiData[i] > 0.0f)
+        {
+            if (data[i] < 0.0f)
+            {
+                dataOut[i] = (float)-accum[i];
+            } else {
+                dataOut[i] = (float)accum[i];
+            }
+        } else {
+            dataOut[i] = 0.0f;
+        }
+    }
+}
+
+void TFCEHelper::computePass(const float* data, const float* roiData, const bool& negate, const float& param_e, const float& param_h, double* accumOut) const
+{
+    vector<ValueIndex> order;
+    for (int64_t i = 0; i < m_numElements; ++i)
+    {
+        if (roiData == NULL || roiData[i] > 0.0f)
+        {
+            float value = (negate ? -data[i] : data[i]);
+            if (value > 0.0f)
+            {
+                ValueIndex temp;
+                temp.value = value;
+                temp.index = i;
+                order.push_back(temp);
+            }
+        }
+    }
+    sort(order.begin(), order.end());
+    vector<int64_t> parent(m_numElements, UNVISITED);
+    vector<double> offset(m_numElements, 0.0);
+    vector<Cluster> clusterList;
+    vector<int64_t> touchingRoots;
+    const bool isVolume = (m_dims[0] > 0);
+    const int64_t numOrdered = (int64_t)order.size();
+    for (int64_t o = 0; o < numOrdered; ++o)
+    {
+        const int64_t elem = order[o].index;
+        const float value = order[o].value;
+        const float area = (isVolume ? m_voxelVolume : m_elemWeights[elem]);
+        touchingRoots.clear();
+        int64_t neighScratch[6];
+        const int32_t* surfNeighbors = NULL;
+        int numNeigh = 0;
+        if (isVolume)
+        {
+            int64_t i = elem % m_dims[0], j = (elem / m_dims[0]) % m_dims[1], k = elem / (m_dims[0] * m_dims[1]);
+            int64_t jstride = m_dims[0], kstride = m_dims[0] * m_dims[1];
+            if (i > 0) neighScratch[numNeigh++] = elem - 1;
+            if (i + 1 < m_dims[0]) neighScratch[numNeigh++] = elem + 1;
+            if (j > 0) neighScratch[numNeigh++] = elem - jstride;
+            if (j + 1 < m_dims[1]) neighScratch[numNeigh++] = elem + jstride;
+            if (k > 0) neighScratch[numNeigh++] = elem - kstride;
+            if (k + 1 < m_dims[2]) neighScratch[numNeigh++] = elem + kstride;
+        } else {
+            surfNeighbors = m_neighbors.data() + m_neighborStarts[elem];
+            numNeigh = m_neighborStarts[elem + 1] - m_neighborStarts[elem];
+        }
+        for (int n = 0; n < numNeigh; ++n)
+        {
+            int64_t neighbor = (isVolume ? neighScratch[n] : surfNeighbors[n]);
+            if (parent[neighbor] == UNVISITED) continue;
+            int64_t root = findRoot(parent, offset, neighbor);
+            if (find(touchingRoots.begin(), touchingRoots.end(), root) == touchingRoots.end())
+            {
+                touchingRoots.push_back(root);
+            }
+        }
+        switch (touchingRoots.size())
+        {
+            case 0://make new cluster
+            {
+                parent[elem] = -((int64_t)clusterList.size() + 2);
+                clusterList.push_back(Cluster());
+                clusterList.back().addMember(value, area, param_e, param_h);
+                break;
+            }
+            case 1://add to cluster
+            {
+                Cluster& thisCluster = clusterList[-parent[touchingRoots[0]] - 2];
+                thisCluster.addMember(value, area, param_e, param_h);
+                parent[elem] = touchingRoots[0];
+                offset[elem] = -thisCluster.accumVal;//the element is on the edge, so it gets what the cluster accumulates from here down
+                break;
+            }
+            default://merge all touching clusters
+            {
+                int64_t mergedRoot = touchingRoots[0];
+                for (size_t r = 1; r < touchingRoots.size(); ++r)
+                {//keep the biggest cluster as the root, to keep paths short
+                    if (clusterList[-parent[touchingRoots[r]] - 2].numMembers > clusterList[-parent[mergedRoot] - 2].numMembers)
+                    {
+                        mergedRoot = touchingRoots[r];
+                    }
+                }
+                Cluster& mergedCluster = clusterList[-parent[mergedRoot] - 2];
+                mergedCluster.update(value, param_e, param_h);//recalculate to align cluster bottoms
+                for (size_t r = 0; r < touchingRoots.size(); ++r)
+                {
+                    int64_t thisRoot = touchingRoots[r];
+                    if (thisRoot == mergedRoot) continue;
+                    Cluster& thisCluster = clusterList[-parent[thisRoot] - 2];
+                    thisCluster.update(value, param_e, param_h);
+                    mergedCluster.totalArea += thisCluster.totalArea;
+                    mergedCluster.numMembers += thisCluster.numMembers;
+                    parent[thisRoot] = mergedRoot;
+                    offset[thisRoot] = thisCluster.accumVal - mergedCluster.accumVal;//one correction on the old root covers all of its members
+                }
+                mergedCluster.addMember(value, area, param_e, param_h);//will not trigger recomputation, we already recomputed at this value
+                parent[elem] = mergedRoot;
+                offset[elem] = -mergedCluster.accumVal;
+                break;
+            }
+        }
+    }
+    for (size_t c = 0; c < clusterList.size(); ++c)
+    {
+        clusterList[c].update(0.0f, param_e, param_h);//update to include the to-zero slice, dead clusters don't matter
+    }
+    for (int64_t o = 0; o < numOrdered; ++o)
+    {
+        const int64_t elem = order[o].index;
+        int64_t root = findRoot(parent, offset, elem);
+        double value = clusterList[-parent[root] - 2].accumVal;
+        if (root != elem) value += offset[elem];
+        accumOut[elem] = value;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef __TFCE_HELPER_H__
+#define __TFCE_HELPER_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "stdint.h"
+#include <vector>
+
+namespace caret {
+
+    class TopologyHelper;
+
+    ///threshold-free cluster enhancement, by adding elements in order of decreasing value to a union-find forest
+    ///each element stores its integral relative to its parent, so merging clusters is constant time instead of touching every member
+    ///construct once per surface or volume space, then compute as many maps (or permutations) as needed, compute functions are const and thread safe
+    class TFCEHelper
+    {
+        int64_t m_dims[3];//volume mode when m_dims[0] > 0
+        std::vector<int32_t> m_neighborStarts, m_neighbors;//surface mode
+        std::vector<float> m_elemWeights;
+        float m_voxelVolume;
+        int64_t m_numElements;
+
+        void computePass(const float* data, const float* roiData, const bool& negate, const float& param_e, const float& param_h, double* accumOut) const;
+    public:
+        ///surface adjacency, areaData is the per-vertex area
+        TFCEHelper(const TopologyHelper* myTopoHelp, const float* areaData);
+
+        ///face neighbors in a volume, every voxel has the same volume
+        TFCEHelper(const int64_t dims[3], const float& voxelVolume);
+
+        int64_t getNumberOfElements() const { return m_numElements; }
+
+        ///output has the sign of the input, and is zero outside the roi, roiData may be NULL
+        ///positive and negative values are computed in parallel unless already inside a parallel region
+        void compute(const float* data, float* dataOut, const float* roiData, const float& param_e, const float& param_h) const;
+    };
+
+}
+
+#endif //__TFCE_HELPER_H__
@@ -84,24 +84,13 @@ namespace caret {
         TopologyHelperBase& operator=(const TopologyHelperBase&);
         void processTileNeighbor(std::vector<TopologyEdgeInfo>& tempEdgeInfo, CaretArray<int32_t>& scratch, const int32_t& root, const int32_t& neighbor, const int32_t& thirdNode, const int32_t& tile, const int32_t& tileEdge, const bool& reversed);
         void sortNeighbors(const SurfaceFile* mySurf, const int32_t& node, CaretArray<int32_t>& nodeScratch, CaretArray<int32_t>& tileScratch);
-        struct NodeInfo
-        {
-            std::vector<int32_t> m_neighbors;
-            std::vector<int32_t> m_edges;//index into the topology edges vector, matched with neighbors
-            std::vector<int32_t> m_tiles;
-            std::vector<int32_t> m_whichVertex;//stores which tile vertex this node is, matched to m_tiles
-            void addTileInfo(int32_t tile, int32_t vertexNum)//don't take edge info yet because it is built after neighbor info
-            {
-                m_tiles.push_back(tile);
-                m_whichVertex.push_back(vertexNum);
-            }
-            void addNeighborInfo(int32_t neighbor, int32_t edge)//after we have tile info, we then generate neighbor info with the help of a mark array
-            {
-                m_neighbors.push_back(neighbor);
-                m_edges.push_back(edge);
-            }
-        };
-        std::vector<NodeInfo> m_nodeInfo;
+        //per-node info is stored flat (CSR): node i owns entries [m_neighOffsets[i], m_neighOffsets[i + 1]) of m_neighbors and m_edges, likewise for tiles
+        std::vector<int64_t> m_neighOffsets, m_tileOffsets;
+        std::vector<int32_t> m_neighbors;
+        std::vector<int32_t> m_edges;//index into the topology edges vector, matched with neighbors
+        std::vector<int32_t> m_tiles;
+        std::vector<int32_t> m_whichVertex;//stores which tile vertex this node is, matched to m_tiles
+        std::vector<std::vector<int32_t> > m_nodeNeighbors, m_nodeEdges, m_nodeTiles;//exact size copies of the flat ranges, for the accessors that return vectors
         std::vector<TopologyEdgeInfo> m_edgeInfo;
         std::vector<TopologyTileInfo> m_tileInfo;
         std::vector<int32_t> m_boundaryCount;
@@ -122,7 +111,14 @@ namespace caret {
         mutable CaretMutex m_usingMarkNodes;
         bool m_neighborsSorted;
         int32_t m_numNodes, m_maxNeigh;
-        const std::vector<TopologyHelperBase::NodeInfo>& m_nodeInfo;//references for convenience instead of using the m_base pointer
+        const std::vector<int64_t>& m_neighOffsets;//references for convenience instead of using the m_base pointer
+        const std::vector<int64_t>& m_tileOffsets;
+        const std::vector<int32_t>& m_neighbors;
+        const std::vector<int32_t>& m_edges;
+        const std::vector<int32_t>& m_tiles;
+        const std::vector<std::vector<int32_t> >& m_nodeNeighbors;
+        const std::vector<std::vector<int32_t> >& m_nodeEdges;
+        const std::vector<std::vector<int32_t> >& m_nodeTiles;
         const std::vector<TopologyEdgeInfo>& m_edgeInfo;
         const std::vector<TopologyTileInfo>& m_tileInfo;
         const std::vector<int32_t>& m_boundaryCount;
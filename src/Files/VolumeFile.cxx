@@ -1570,6 +1570,32 @@ VolumeFile::getVoxelColorInMap(const PaletteFile* /*paletteFile*/,
                                          rgbaOut);
 }
 
+/**
+ * Get the voxel coloring for an entire map, with the I index varying
+ * fastest.  Label display selections are NOT applied.
+ *
+ * @param mapIndex
+ *    Index of the map.
+ * @param coloringStampOut
+ *    Output with a stamp that changes whenever the map's coloring changes.
+ * @return
+ *    Pointer to the RGBA coloring, or NULL if coloring is not enabled
+ *    or the map's coloring is not valid.
+ */
+const uint8_t*
+VolumeFile::getVoxelColorsForMap(const int32_t mapIndex,
+                                 int64_t& coloringStampOut) const
+{
+    coloringStampOut = -1;
+    if (s_voxelColoringEnabled == false) {
+        return NULL;
+    }
+    CaretAssert(m_voxelColorizer);
+    
+    return m_voxelColorizer->getVoxelColorsForMap(mapIndex,
+                                                  coloringStampOut);
+}
+
 /**
  * Clear the voxel coloring for the given map.
  * Does nothing if coloring is not enabled.
@@ -317,6 +317,9 @@ namespace caret {
                                 const int32_t tabIndex,
                                 uint8_t rgbaOut[4]) const;
         
+        const uint8_t* getVoxelColorsForMap(const int32_t mapIndex,
+                                            int64_t& coloringStampOut) const;
+        
         void clearVoxelColoringForMap(const int64_t mapIndex);
         
         virtual bool getDataRangeFromAllMaps(float& dataRangeMinimumOut,
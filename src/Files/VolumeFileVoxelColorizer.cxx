@@ -28,6 +28,7 @@
 #include "ElapsedTimer.h"
 #include "GiftiLabel.h"
 #include "GroupAndNameHierarchyItem.h"
+#include "ModificationStamp.h"
 #include "NodeAndVoxelColoring.h"
 #include "VolumeFile.h"
 
@@ -68,6 +69,7 @@ VolumeFileVoxelColorizer::VolumeFileVoxelColorizer(VolumeFile* volumeFile)
     for (int64_t i = 0; i < m_mapCount; i++) {
         m_mapRGBA.push_back(new uint8_t[m_mapRGBACount]);
         m_mapColoringValid.push_back(false);
+        m_mapColoringStamp.push_back(ModificationStamp::newStamp());
     }
 }
 
@@ -212,6 +214,8 @@ VolumeFileVoxelColorizer::assignVoxelColorsForMap(const int32_t mapIndex,
             break;
     }
     
+    m_mapColoringStamp[mapIndex] = ModificationStamp::newStamp();
+    
     CaretLogFine("Time to color map named \""
                    + m_volumeFile->getMapName(mapIndex)
                    + " in volume file "
@@ -230,6 +234,39 @@ VolumeFileVoxelColorizer::invalidateColoring()
     std::fill(m_mapColoringValid.begin(),
               m_mapColoringValid.end(),
               false);
+    for (std::vector<int64_t>::iterator iter = m_mapColoringStamp.begin();
+         iter != m_mapColoringStamp.end();
+         iter++) {
+        *iter = ModificationStamp::newStamp();
+    }
+}
+
+/**
+ * Get the voxel coloring for an entire map, with the I index
+ * varying fastest, as needed for loading a 3D texture.  Label
+ * display selections are NOT applied.
+ *
+ * @param mapIndex
+ *     Index of map.
+ * @param coloringStampOut
+ *     Output with a stamp that changes whenever the map's coloring
+ *     changes, so that copies of the coloring are only updated
+ *     when needed.
+ * @return
+ *     Pointer to the RGBA coloring or NULL if the map's coloring
+ *     is not valid.
+ */
+const uint8_t*
+VolumeFileVoxelColorizer::getVoxelColorsForMap(const int32_t mapIndex,
+                                               int64_t& coloringStampOut) const
+{
+    CaretAssertVectorIndex(m_mapRGBA, mapIndex);
+    
+    coloringStampOut = m_mapColoringStamp[mapIndex];
+    if ( ! m_mapColoringValid[mapIndex]) {
+        return NULL;
+    }
+    return m_mapRGBA[mapIndex];
 }
 
 /**
@@ -601,5 +638,6 @@ VolumeFileVoxelColorizer::clearVoxelColoringForMap(const int64_t mapIndex)
     
     CaretAssertVectorIndex(m_mapColoringValid, mapIndex);
     m_mapColoringValid[mapIndex] = false;
+    m_mapColoringStamp[mapIndex] = ModificationStamp::newStamp();
 }
 
@@ -68,6 +68,9 @@ namespace caret {
                                 const int32_t tabIndex,
                                 uint8_t rgbaOut[4]) const;
         
+        const uint8_t* getVoxelColorsForMap(const int32_t mapIndex,
+                                            int64_t& coloringStampOut) const;
+        
         void clearVoxelColoringForMap(const int64_t mapIndex);
         
         void invalidateColoring();
@@ -101,6 +104,9 @@ namespace caret {
         
         std::vector<bool> m_mapColoringValid;
         std::vector<uint8_t*> m_mapRGBA;
+        
+        /** Changes whenever a map's coloring changes, unique across all volumes */
+        std::vector<int64_t> m_mapColoringStamp;
     };
     
 #ifdef __VOLUME_FILE_VOXEL_COLORIZER_DECLARE__
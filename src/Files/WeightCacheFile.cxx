@@ -0,0 +1,202 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "WeightCacheFile.h"
+
+#include "ByteOrderEnum.h"
+#include "CaretAssert.h"
+#include "CaretLogger.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //followed by the caller's payload, all in native byte order
+    struct CacheHeader
+    {
+        char m_magic[8];
+        int32_t m_version;
+        char m_key[40];//hex sha1, also the file name
+        int32_t m_padding;
+        int64_t m_counts[WeightCacheFile::NUM_COUNTS];
+    };
+}
+
+WeightCacheFile::WeightCacheFile(const AString& directory, const AString& extension, const char magic[8], const int32_t& version, const AString& description) :
+    m_hash(QCryptographicHash::Sha1)
+{
+    m_directory = directory;
+    m_extension = extension;
+    m_description = description;
+    memcpy(m_magic, magic, sizeof(m_magic));
+    m_version = version;
+    m_writeGood = false;
+    int32_t bigEndian = (ByteOrderEnum::isSystemBigEndian() ? 1 : 0);//the data is hashed in native byte order
+    m_hash.addData(m_magic, sizeof(m_magic));
+    m_hash.addData((const char*)&m_version, sizeof(int32_t));
+    m_hash.addData((const char*)&bigEndian, sizeof(int32_t));
+}
+
+WeightCacheFile::~WeightCacheFile()
+{
+}
+
+void WeightCacheFile::addKeyData(const void* data, const int64_t& bytes)
+{
+    CaretAssert(m_key.isEmpty());//the key is final once the file name is used
+    const int64_t CHUNK = 1<<30;//addData takes an int length
+    for (int64_t done = 0; done < bytes; done += CHUNK)
+    {
+        m_hash.addData((const char*)data + done, (int)min(CHUNK, bytes - done));
+    }
+}
+
+void WeightCacheFile::addKeyMask(const float* values, const int64_t& count)
+{
+    vector<char> mask(count);
+    for (int64_t i = 0; i < count; ++i)
+    {
+        mask[i] = (values[i] > 0.0f ? 1 : 0);
+    }
+    addKeyData("mask", 4);
+    addKeyData(mask.data(), count);
+}
+
+void WeightCacheFile::finishKey()
+{
+    if (!m_key.isEmpty()) return;
+    m_key = AString(m_hash.result().toHex());
+    m_fileName = m_directory + "/" + m_key + m_extension;
+}
+
+const AString& WeightCacheFile::getFileName()
+{
+    finishKey();
+    return m_fileName;
+}
+
+bool WeightCacheFile::beginRead(int64_t countsOut[NUM_COUNTS])
+{
+    finishKey();
+    m_readFile.close();
+    m_readFile.setFileName(m_fileName);
+    if (!m_readFile.open(QIODevice::ReadOnly)) return false;
+    CacheHeader myHeader;
+    if (m_readFile.read((char*)&myHeader, sizeof(CacheHeader)) != (qint64)sizeof(CacheHeader) || memcmp(myHeader.m_magic, m_magic, sizeof(m_magic)) != 0 ||
+        myHeader.m_version != m_version || AString::fromLatin1(myHeader.m_key, sizeof(myHeader.m_key)) != m_key)
+    {
+        CaretLogFine("ignoring stale or unrecognized " + m_description + " weight cache file '" + m_fileName + "'");
+        m_readFile.close();
+        return false;
+    }
+    for (int i = 0; i < NUM_COUNTS; ++i)
+    {
+        countsOut[i] = myHeader.m_counts[i];
+    }
+    return true;
+}
+
+int64_t WeightCacheFile::getPayloadSize() const
+{
+    return m_readFile.size() - (int64_t)sizeof(CacheHeader);
+}
+
+bool WeightCacheFile::read(void* dataOut, const int64_t& bytes)
+{
+    return m_readFile.read((char*)dataOut, bytes) == (qint64)bytes;
+}
+
+bool WeightCacheFile::finishRead(const bool& valid)
+{
+    bool ret = valid && m_readFile.atEnd();
+    m_readFile.close();
+    if (ret)
+    {
+        CaretLogFine("loaded " + m_description + " weights from cache file '" + m_fileName + "'");
+    } else {
+        CaretLogFine("ignoring stale or corrupt " + m_description + " weight cache file '" + m_fileName + "'");
+    }
+    return ret;
+}
+
+bool WeightCacheFile::beginWrite(const int64_t counts[NUM_COUNTS])
+{
+    finishKey();
+    QFileInfo cacheInfo(m_fileName);
+    if (!QDir().mkpath(cacheInfo.absolutePath()))
+    {
+        CaretLogFine("unable to create " + m_description + " weight cache directory '" + cacheInfo.absolutePath() + "'");
+        return false;
+    }
+    m_writeFile.grabNew(new QTemporaryFile(cacheInfo.absolutePath() + "/" + cacheInfo.fileName() + ".XXXXXX"));
+    if (!m_writeFile->open())
+    {
+        CaretLogFine("unable to write " + m_description + " weight cache file '" + m_fileName + "'");
+        m_writeFile.grabNew(NULL);
+        return false;
+    }
+    CacheHeader myHeader;
+    memset(&myHeader, 0, sizeof(CacheHeader));
+    memcpy(myHeader.m_magic, m_magic, sizeof(m_magic));
+    myHeader.m_version = m_version;
+    QByteArray keyBytes = m_key.toLatin1();
+    CaretAssert(keyBytes.size() == sizeof(myHeader.m_key));
+    memcpy(myHeader.m_key, keyBytes.constData(), sizeof(myHeader.m_key));
+    for (int i = 0; i < NUM_COUNTS; ++i)
+    {
+        myHeader.m_counts[i] = counts[i];
+    }
+    m_writeGood = true;
+    return write(&myHeader, sizeof(CacheHeader));
+}
+
+bool WeightCacheFile::write(const void* data, const int64_t& bytes)
+{
+    if (m_writeFile == NULL) return false;
+    m_writeGood = m_writeGood && m_writeFile->write((const char*)data, bytes) == (qint64)bytes;
+    return m_writeGood;
+}
+
+void WeightCacheFile::finishWrite()
+{
+    if (m_writeFile == NULL) return;
+    m_writeFile->close();
+    if (!m_writeGood)
+    {
+        CaretLogFine("failed writing " + m_description + " weight cache file '" + m_fileName + "'");
+    } else {
+        QFile::remove(m_fileName);//rename doesn't overwrite, and another process may have just written the same weights
+        if (QFile::rename(m_writeFile->fileName(), m_fileName))
+        {
+            m_writeFile->setAutoRemove(false);
+        } else {
+            CaretLogFine("unable to rename " + m_description + " weight cache file to '" + m_fileName + "'");
+        }
+    }
+    m_writeFile.grabNew(NULL);
+}
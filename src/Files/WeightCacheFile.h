@@ -0,0 +1,80 @@
+#ifndef __WEIGHT_CACHE_FILE_H__
+#define __WEIGHT_CACHE_FILE_H__
+
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2016  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "AString.h"
+#include "CaretPointer.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+
+#include <stdint.h>
+
+class QTemporaryFile;
+
+namespace caret {
+    
+    ///file scaffolding for caches of precomputed weights: the file is named by a hash of everything the weights depend on,
+    ///has a common header, and is written to a temporary file and renamed so concurrent commands never see a partial file
+    ///the cache is only an optimization, so failures are logged at fine level and mean recomputing, never exceptions
+    class WeightCacheFile
+    {
+        AString m_directory, m_extension, m_description, m_key, m_fileName;
+        char m_magic[8];
+        int32_t m_version;
+        QCryptographicHash m_hash;
+        QFile m_readFile;
+        CaretPointer<QTemporaryFile> m_writeFile;
+        bool m_writeGood;
+        void finishKey();
+        WeightCacheFile(const WeightCacheFile&);
+        WeightCacheFile& operator=(const WeightCacheFile&);
+    public:
+        ///counts stored in the header, for the caller to describe the payload with
+        static const int NUM_COUNTS = 3;
+        
+        ///description is only used in log messages
+        WeightCacheFile(const AString& directory, const AString& extension, const char magic[8], const int32_t& version, const AString& description);
+        ~WeightCacheFile();
+        
+        ///add data that the weights depend on to the key, in native byte order, before reading or writing
+        void addKeyData(const void* data, const int64_t& bytes);
+        ///add only whether each value is positive to the key, for ROIs
+        void addKeyMask(const float* values, const int64_t& count);
+        const AString& getFileName();
+        
+        ///opens the file and checks the header, returning its counts - the caller must check them, then read the payload and call finishRead
+        bool beginRead(int64_t countsOut[NUM_COUNTS]);
+        int64_t getPayloadSize() const;
+        bool read(void* dataOut, const int64_t& bytes);
+        ///valid is the caller's verdict on the counts and payload, returns whether the payload can be used
+        bool finishRead(const bool& valid);
+        
+        bool beginWrite(const int64_t counts[NUM_COUNTS]);
+        bool write(const void* data, const int64_t& bytes);
+        ///renames the temporary file into place if everything was written
+        void finishWrite();
+    };
+    
+}
+
+#endif //__WEIGHT_CACHE_FILE_H__
@@ -524,11 +524,30 @@ PreferencesDialog::createOpenGLWidget()
                      this, SLOT(openGLDrawingMethodEnumComboBoxItemActivated()));
     m_allWidgets->add(m_openGLDrawingMethodEnumComboBox->getWidget());
     
+    /*
+     * Volume slices drawn with textures
+     */
+    m_openGLVolumeSliceTexturesComboBox = new WuQTrueFalseComboBox("On",
+                                                                   "Off",
+                                                                   this);
+    QObject::connect(m_openGLVolumeSliceTexturesComboBox, SIGNAL(statusChanged(bool)),
+                     this, SLOT(openGLVolumeSliceTexturesComboBoxChanged(bool)));
+    WuQtUtilities::setWordWrappedToolTip(m_openGLVolumeSliceTexturesComboBox->getWidget(),
+                                         "When on, each volume map is loaded into graphics memory "
+                                         "and a slice is drawn as one textured polygon per layer, "
+                                         "which is much faster for high resolution volumes and "
+                                         "montages.  Label volumes and identification are always "
+                                         "drawn voxel by voxel.");
+    m_allWidgets->add(m_openGLVolumeSliceTexturesComboBox);
+    
     
     QGridLayout* gridLayout = new QGridLayout();
     addWidgetToLayout(gridLayout,
                       "Image Capture Method: ",
                       m_openGLImageCaptureMethodEnumComboBox->getWidget());
+    addWidgetToLayout(gridLayout,
+                      "Volume Slice Textures: ",
+                      m_openGLVolumeSliceTexturesComboBox->getWidget());
     QLabel* vertexBuffersLabel = addWidgetToLayout(gridLayout,
                                                          "OpenGL Vertex Buffers: ",
                                                          m_openGLDrawingMethodEnumComboBox->getWidget());
@@ -560,6 +579,8 @@ PreferencesDialog::updateOpenGLWidget(CaretPreferences* prefs)
     
     const OpenGLDrawingMethodEnum::Enum drawingMethod = prefs->getOpenDrawingMethod();
     m_openGLDrawingMethodEnumComboBox->setSelectedItem<OpenGLDrawingMethodEnum,OpenGLDrawingMethodEnum::Enum>(drawingMethod);
+    
+    m_openGLVolumeSliceTexturesComboBox->setStatus(prefs->isVolumeSliceTextureDrawingEnabled());
 }
 
 /**
@@ -901,6 +922,19 @@ PreferencesDialog::openGLDrawingMethodEnumComboBoxItemActivated()
     EventManager::get()->sendEvent(EventGraphicsUpdateAllWindows().getPointer());
 }
 
+/**
+ * Called when volume slice texture drawing is changed.
+ * @param value
+ *   New value.
+ */
+void
+PreferencesDialog::openGLVolumeSliceTexturesComboBoxChanged(bool value)
+{
+    CaretPreferences* prefs = SessionManager::get()->getCaretPreferences();
+    prefs->setVolumeSliceTextureDrawingEnabled(value);
+    EventManager::get()->sendEvent(EventGraphicsUpdateAllWindows().getPointer());
+}
+
 /**
  * Called when the image capture method is changed.
  */
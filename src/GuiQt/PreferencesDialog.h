@@ -64,6 +64,7 @@ namespace caret {
         
         void openGLDrawingMethodEnumComboBoxItemActivated();
         void openGLImageCaptureMethodEnumComboBoxItemActivated();
+        void openGLVolumeSliceTexturesComboBoxChanged(bool value);
         
         void volumeAxesCrosshairsComboBoxToggled(bool value);
         void volumeAxesLabelsComboBoxToggled(bool value);
@@ -139,6 +140,7 @@ namespace caret {
         
         EnumComboBoxTemplate* m_openGLDrawingMethodEnumComboBox;
         EnumComboBoxTemplate* m_openGLImageCaptureMethodEnumComboBox;
+        WuQTrueFalseComboBox* m_openGLVolumeSliceTexturesComboBox;
 
         WuQTrueFalseComboBox* m_dynamicConnectivityComboBox;
         
@@ -59,6 +59,22 @@ void NiftiIO::close()
     m_dims.clear();
 }
 
+const float* NiftiIO::mapFloatData()
+{
+    if (m_header.getDataType() != NIFTI_TYPE_FLOAT32 || m_header.isSwapped()) return NULL;
+    double mult, offset;
+    if (m_header.getDataScaling(mult, offset)) return NULL;
+    if (m_header.getDataOffset() % sizeof(float) != 0) return NULL;//misaligned floats would be slow or fault on some platforms
+    int64_t numElems = 1;
+    for (int i = 0; i < (int)m_dims.size(); ++i)
+    {
+        numElems *= m_dims[i];
+    }
+    if (numElems < 1) return NULL;
+    CaretMutexLocker locked(&m_mutex);//don't let readData move the file position while we map
+    return (const float*)m_file.mapReadOnly(m_header.getDataOffset(), numElems * sizeof(float));
+}
+
 int NiftiIO::getNumComponents() const
 {
     switch (m_header.getDataType())
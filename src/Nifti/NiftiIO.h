@@ -58,12 +58,20 @@ namespace caret
         const NiftiHeader& getHeader() const { return m_header; }
         const std::vector<int64_t>& getDimensions() const { return m_dims; }
         int getNumComponents() const;
+        //for uncompressed, native endian, unscaled float32 files, maps the entire data section read-only and returns it, otherwise returns NULL
+        //the pointer is valid until close() or another open
+        const float* mapFloatData();
         //to read/write 1 frame of a standard volume file, call with fullDims = 3, indexSelect containing indexes for any of dims 4-7 that exist
         //NOTE: you need to provide storage for all components within the range, if getNumComponents() == 3 and fullDims == 0, you need 3 elements allocated
         template<typename T>
         void readData(T* dataOut, const int& fullDims, const std::vector<int64_t>& indexSelect, const bool& tolerateShortRead = false);
         template<typename T>
         void writeData(const T* dataIn, const int& fullDims, const std::vector<int64_t>& indexSelect);
+        //lower level access to a contiguous range of the data, offset and numElems are in components (same as numbers of elements of the output array), from the start of the data
+        template<typename T>
+        void readRange(T* dataOut, const int64_t& offset, const int64_t& numElems, const bool& tolerateShortRead = false);
+        template<typename T>
+        void writeRange(const T* dataIn, const int64_t& offset, const int64_t& numElems);
     };
     
     template<typename T>
@@ -84,11 +92,18 @@ namespace caret
             numSkip += indexSelect[curDim - fullDims] * numDimSkip;
             numDimSkip *= m_dims[curDim];
         }
+        readRange(dataOut, numSkip, numElems, tolerateShortRead);
+    }
+    
+    template<typename T>
+    void NiftiIO::readRange(T* dataOut, const int64_t& offset, const int64_t& numElems, const bool& tolerateShortRead)
+    {
+        CaretAssert(offset >= 0 && numElems >= 0);
         CaretMutexLocker locked(&m_mutex);//protect starting with resizing until we are done converting, because we use an internal variable for scratch space
         //we can't guarantee that the output memory is enough to use as scratch space, as we might be doing a narrowing conversion
         //we are doing FILE ACCESS, so cpu performance isn't really something to worry about
         m_scratch.resize(numElems * numBytesPerElem());
-        m_file.seek(numSkip * numBytesPerElem() + m_header.getDataOffset());
+        m_file.seek(offset * numBytesPerElem() + m_header.getDataOffset());
         int64_t numRead = 0;
         m_file.read(m_scratch.data(), m_scratch.size(), &numRead);
         if ((numRead != (int64_t)m_scratch.size() && !tolerateShortRead) || numRead < 0)//for now, assume read giving -1 is always a problem
@@ -158,10 +173,17 @@ namespace caret
             numSkip += indexSelect[curDim - fullDims] * numDimSkip;
             numDimSkip *= m_dims[curDim];
         }
+        writeRange(dataIn, numSkip, numElems);
+    }
+    
+    template<typename T>
+    void NiftiIO::writeRange(const T* dataIn, const int64_t& offset, const int64_t& numElems)
+    {
+        CaretAssert(offset >= 0 && numElems >= 0);
         CaretMutexLocker locked(&m_mutex);//protect starting with resizing until we are done writing, because we use an internal variable for scratch space
         //we are doing FILE ACCESS, so cpu performance isn't really something to worry about
         m_scratch.resize(numElems * numBytesPerElem());
-        m_file.seek(numSkip * numBytesPerElem() + m_header.getDataOffset());
+        m_file.seek(offset * numBytesPerElem() + m_header.getDataOffset());
         switch (m_header.getDataType())
         {
             case NIFTI_TYPE_UINT8:
@@ -25,14 +25,144 @@
 #include "CaretLogger.h"
 #include "CaretMathExpression.h"
 #include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
 #include "CiftiXML.h"
 #include "MultiDimIterator.h"
 
+#include <algorithm>
 #include <iostream>
 
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    const int64_t BATCH_ELEMENTS = 1 << 16;
+    
+    //each item is a batch of output rows, evaluating many rows at once keeps the per-call overhead of the expression low for short rows
+    class MathBatchStage : public CiftiRowPipeline::Stage
+    {
+        const CaretMathExpression* m_expr;
+        const vector<CiftiFile*>* m_varCiftiFiles;
+        const vector<vector<int64_t> >* m_selectInfo;
+        CiftiFile* m_ciftiOut;
+        vector<vector<int64_t> > m_rowIndices;//output rows, in iteration order
+        vector<vector<float> > m_inputRows;
+        vector<vector<int64_t> > m_loadedRow;//to detect and prevent rereading the same row
+        int64_t m_rowLength, m_batchRows;
+        bool m_nanfix;
+        float m_nanfixval;
+        
+        int64_t getBatchStart(const int64_t& item) const { return item * m_batchRows; }
+        int64_t getBatchEnd(const int64_t& item) const { return min((int64_t)m_rowIndices.size(), (item + 1) * m_batchRows); }
+    public:
+        MathBatchStage(const CaretMathExpression* myExpr, const vector<CiftiFile*>& varCiftiFiles, const vector<vector<int64_t> >& selectInfo, CiftiFile* ciftiOut,
+                       const bool& nanfix, const float& nanfixval)
+        {
+            m_expr = myExpr;
+            m_varCiftiFiles = &varCiftiFiles;
+            m_selectInfo = &selectInfo;
+            m_ciftiOut = ciftiOut;
+            m_nanfix = nanfix;
+            m_nanfixval = nanfixval;
+            const vector<int64_t>& outDims = ciftiOut->getDimensions();
+            m_rowLength = outDims[0];
+            m_batchRows = max((int64_t)1, BATCH_ELEMENTS / m_rowLength);
+            for (MultiDimIterator<int64_t> iter = ciftiOut->getIteratorOverRows(); !iter.atEnd(); ++iter)
+            {
+                m_rowIndices.push_back(*iter);
+            }
+            int numVars = (int)varCiftiFiles.size();
+            m_inputRows.resize(numVars);
+            m_loadedRow.resize(numVars);
+            for (int v = 0; v < numVars; ++v)
+            {
+                m_inputRows[v].resize(varCiftiFiles[v]->getCiftiXML().getDimensionLength(CiftiXML::ALONG_ROW));
+                m_loadedRow[v].resize(varCiftiFiles[v]->getCiftiXML().getNumberOfDimensions() - 1, -1);//we always load a full row, so ignore first dim
+            }
+        }
+        int64_t getNumBatches() const { return ((int64_t)m_rowIndices.size() + m_batchRows - 1) / m_batchRows; }
+        int64_t getInputLength() const { return (int64_t)m_inputRows.size() * m_batchRows * m_rowLength; }
+        int64_t getOutputLength() const { return m_batchRows * m_rowLength; }
+        void readItem(const int64_t& item, float* inputOut)
+        {
+            int numVars = (int)m_inputRows.size();
+            int64_t batchStart = getBatchStart(item), batchEnd = getBatchEnd(item);
+            for (int64_t row = batchStart; row < batchEnd; ++row)
+            {
+                const vector<int64_t>& outIndex = m_rowIndices[row];
+                for (int v = 0; v < numVars; ++v)//first, retrieve whichever rows are needed
+                {
+                    const vector<int64_t>& thisSelect = (*m_selectInfo)[v];
+                    bool needToLoad = false;
+                    for (int dim = 0; dim < (int)m_loadedRow[v].size(); ++dim)
+                    {
+                        int64_t indexNeeded = -1;
+                        if (thisSelect[dim + 1] == -1)
+                        {
+                            CaretAssert(dim < (int)outIndex.size());//"match to output index" can't work past output dimensionality
+                            indexNeeded = outIndex[dim];//NOTE: row indices also don't include the first dim
+                        } else {
+                            indexNeeded = thisSelect[dim + 1];
+                        }
+                        if (indexNeeded != m_loadedRow[v][dim])
+                        {
+                            needToLoad = true;
+                            m_loadedRow[v][dim] = indexNeeded;
+                        }
+                    }
+                    if (needToLoad)
+                    {
+                        (*m_varCiftiFiles)[v]->getRow(m_inputRows[v].data(), m_loadedRow[v]);
+                    }
+                    float* batchRow = inputOut + (v * m_batchRows + row - batchStart) * m_rowLength;
+                    if (thisSelect[0] == -1)//now we check for select along row
+                    {
+                        for (int64_t j = 0; j < m_rowLength; ++j)
+                        {
+                            batchRow[j] = m_inputRows[v][j];
+                        }
+                    } else {
+                        for (int64_t j = 0; j < m_rowLength; ++j)
+                        {
+                            batchRow[j] = m_inputRows[v][thisSelect[0]];
+                        }
+                    }
+                }
+            }
+        }
+        void computeItem(const int64_t& item, const float* input, float* output, const int&)
+        {
+            int numVars = (int)m_inputRows.size();
+            int64_t numElements = (getBatchEnd(item) - getBatchStart(item)) * m_rowLength;
+            vector<const float*> batchPointers(numVars);
+            for (int v = 0; v < numVars; ++v)
+            {
+                batchPointers[v] = input + v * m_batchRows * m_rowLength;
+            }
+            m_expr->evaluate(batchPointers, numElements, output);
+            if (m_nanfix)
+            {
+                for (int64_t j = 0; j < numElements; ++j)
+                {
+                    if (output[j] != output[j])
+                    {
+                        output[j] = m_nanfixval;
+                    }
+                }
+            }
+        }
+        void writeItem(const int64_t& item, const float* output)
+        {
+            int64_t batchStart = getBatchStart(item), batchEnd = getBatchEnd(item);
+            for (int64_t row = batchStart; row < batchEnd; ++row)
+            {
+                m_ciftiOut->setRow(output + (row - batchStart) * m_rowLength, m_rowIndices[row]);
+            }
+        }
+    };
+}
+
 AString OperationCiftiMath::getCommandSwitch()
 {
     return "-cifti-math";
@@ -235,57 +365,6 @@ void OperationCiftiMath::useParameters(OperationParameters* myParams, ProgressOb
     }
     if (outXML.getNumberOfDimensions() < 1) throw OperationException("output must have at least 1 dimension");
     myCiftiOut->setCiftiXML(outXML);
-    vector<float> values(numVars), scratchRow(outDims[0]);
-    vector<vector<float> > inputRows(numVars);
-    vector<vector<int64_t> > loadedRow(numVars);//to detect and prevent rereading the same row
-    for (int v = 0; v < numVars; ++v)
-    {
-        inputRows[v].resize(varCiftiFiles[v]->getCiftiXML().getDimensionLength(CiftiXML::ALONG_ROW));
-        loadedRow[v].resize(varCiftiFiles[v]->getCiftiXML().getNumberOfDimensions() - 1, -1);//we always load a full row, so ignore first dim
-    }
-    for (MultiDimIterator<int64_t> iter(vector<int64_t>(outDims.begin() + 1, outDims.end())); !iter.atEnd(); ++iter)
-    {
-        for (int v = 0; v < numVars; ++v)//first, retrieve whichever rows are needed
-        {
-            bool needToLoad = false;
-            for (int dim = 0; dim < (int)loadedRow[v].size(); ++dim)
-            {
-                int64_t indexNeeded = -1;
-                if (selectInfo[v][dim + 1] == -1)
-                {
-                    CaretAssert(dim + 1 < (int)outDims.size());//"match to output index" can't work past output dimensionality
-                    indexNeeded = (*iter)[dim];//NOTE: iter also doesn't include the first dim
-                } else {
-                    indexNeeded = selectInfo[v][dim + 1];
-                }
-                if (indexNeeded != loadedRow[v][dim])
-                {
-                    needToLoad = true;
-                    loadedRow[v][dim] = indexNeeded;
-                }
-            }
-            if (needToLoad)
-            {
-                varCiftiFiles[v]->getRow(inputRows[v].data(), loadedRow[v]);
-            }
-        }
-        for (int j = 0; j < outDims[0]; ++j)
-        {
-            for (int v = 0; v < numVars; ++v)//now we check for select along row
-            {
-                if (selectInfo[v][0] == -1)
-                {
-                    values[v] = inputRows[v][j];
-                } else {
-                    values[v] = inputRows[v][selectInfo[v][0]];
-                }
-            }
-            scratchRow[j] = (float)myExpr.evaluate(values);
-            if (nanfix && scratchRow[j] != scratchRow[j])
-            {
-                scratchRow[j] = nanfixval;
-            }
-        }
-        myCiftiOut->setRow(scratchRow.data(), *iter);
-    }
+    MathBatchStage myStage(&myExpr, varCiftiFiles, selectInfo, myCiftiOut, nanfix, nanfixval);
+    CiftiRowPipeline::run(&myStage, myStage.getNumBatches(), myStage.getInputLength(), myStage.getOutputLength());
 }
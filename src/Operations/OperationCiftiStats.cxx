@@ -191,17 +191,31 @@ void OperationCiftiStats::useParameters(OperationParameters* myParams, ProgressO
     vector<float> colScratch(colLength);
     if (useColumn == -1)
     {
-        myInput->convertToInMemory();//we will be getting all columns, so read it all in first
-        if (matchColumnMode)
-        {
-            roiCifti->convertToInMemory();//ditto
-        }
+        //we will be getting all columns, gather them in batches so on-disk files get read in large sequential pieces without loading the whole file
+        int64_t batchSize = max((int64_t)1, min((int64_t)numCols, myInput->getColumnMemoryLimit() / (int64_t)(colLength * sizeof(float))));
+        vector<float> inputBatch(batchSize * colLength), roiBatch;
+        if (matchColumnMode) roiBatch.resize(batchSize * colLength);
+        vector<int64_t> batchIndices;
         for (int i = 0; i < numCols; ++i)
         {
-            myInput->getColumn(colScratch.data(), i);
+            int64_t batchPos = i % batchSize;
+            if (batchPos == 0)
+            {
+                batchIndices.clear();
+                for (int64_t j = i; j < min((int64_t)numCols, i + batchSize); ++j)
+                {
+                    batchIndices.push_back(j);
+                }
+                myInput->getColumns(inputBatch.data(), batchIndices);
+                if (matchColumnMode)
+                {
+                    roiCifti->getColumns(roiBatch.data(), batchIndices);
+                }
+            }
+            colScratch.assign(inputBatch.begin() + batchPos * colLength, inputBatch.begin() + (batchPos + 1) * colLength);
             if (matchColumnMode)
             {
-                roiCifti->getColumn(roiData.data(), i);
+                roiData.assign(roiBatch.begin() + batchPos * colLength, roiBatch.begin() + (batchPos + 1) * colLength);
             }
             float result;
             if (reduceOpt->m_present)
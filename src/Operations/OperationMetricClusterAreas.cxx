@@ -0,0 +1,115 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationMetricClusterAreas.h"
+#include "OperationException.h"
+
+#include "AlgorithmMetricFindClusters.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationMetricClusterAreas::getCommandSwitch()
+{
+    return "-metric-cluster-areas";
+}
+
+AString OperationMetricClusterAreas::getShortDescription()
+{
+    return "LIST AREAS OF SURFACE CLUSTERS";
+}
+
+OperationParameters* OperationMetricClusterAreas::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    
+    ret->addSurfaceParameter(1, "surface", "the surface to compute on");
+    
+    ret->addMetricParameter(2, "metric-in", "the input metric");
+    
+    ret->addDoubleParameter(3, "value-threshold", "threshold for data values");
+    
+    ret->createOptionalParameter(4, "-less-than", "find values less than <value-threshold>, rather than greater");
+    
+    OptionalParameter* roiOpt = ret->createOptionalParameter(5, "-roi", "select a region of interest");
+    roiOpt->addMetricParameter(1, "roi-metric", "the roi, as a metric");
+    
+    OptionalParameter* corrAreasOpt = ret->createOptionalParameter(6, "-corrected-areas", "vertex areas to use instead of computing them from the surface");
+    corrAreasOpt->addMetricParameter(1, "area-metric", "the corrected vertex areas, as a metric");
+    
+    ret->createOptionalParameter(7, "-show-map-name", "print map index and name before each output");
+    
+    ret->setHelpText(
+        AString("For each column of the input, prints the area in mm^2 of every cluster found with the same rules as -metric-find-clusters, ") +
+        "largest first, on a single line.  " +
+        "No minimum area is applied and no output metric is made, so this is much faster than -metric-find-clusters for building " +
+        "the distribution of cluster areas, for instance over the columns of a permutation test.  " +
+        "Columns are processed in parallel."
+    );
+    return ret;
+}
+
+void OperationMetricClusterAreas::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    SurfaceFile* mySurf = myParams->getSurface(1);
+    MetricFile* myMetric = myParams->getMetric(2);
+    float threshValue = (float)myParams->getDouble(3);
+    bool lessThan = myParams->getOptionalParameter(4)->m_present;
+    MetricFile* myRoi = NULL;
+    OptionalParameter* roiOpt = myParams->getOptionalParameter(5);
+    if (roiOpt->m_present)
+    {
+        myRoi = roiOpt->getMetric(1);
+    }
+    MetricFile* myAreas = NULL;
+    OptionalParameter* corrAreasOpt = myParams->getOptionalParameter(6);
+    if (corrAreasOpt->m_present)
+    {
+        myAreas = corrAreasOpt->getMetric(1);
+    }
+    bool showMapName = myParams->getOptionalParameter(7)->m_present;
+    vector<vector<double> > areas;
+    AlgorithmMetricFindClusters::getClusterAreas(mySurf, myMetric, threshValue, areas, lessThan, myRoi, myAreas);
+    int numCols = myMetric->getNumberOfColumns();
+    CaretAssert((int)areas.size() == numCols);
+    for (int i = 0; i < numCols; ++i)
+    {
+        sort(areas[i].begin(), areas[i].end(), greater<double>());
+        if (showMapName) cout << AString::number(i + 1) << ": " << myMetric->getMapName(i) << ":";
+        stringstream resultsstr;
+        resultsstr << setprecision(7);
+        for (size_t c = 0; c < areas[i].size(); ++c)
+        {
+            if (c != 0 || showMapName) resultsstr << " ";
+            resultsstr << areas[i][c];
+        }
+        cout << resultsstr.str() << endl;
+    }
+}
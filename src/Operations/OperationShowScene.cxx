@@ -19,8 +19,10 @@
  */
 /*LICENSE_END*/
 
+#include <algorithm>
 #include <cstdio>
 #include <fstream>
+#include <iostream>
 
 #ifdef HAVE_OSMESA
 #include <GL/osmesa.h>
@@ -36,6 +38,7 @@
 #include "CaretAssert.h"
 #include "CaretLogger.h"
 #include "DataFileException.h"
+#include "ElapsedTimer.h"
 #include "EventBrowserTabGet.h"
 #include "EventManager.h"
 #include "FileInformation.h"
@@ -106,6 +109,9 @@ OperationShowScene::getParameters()
     
     ret->createOptionalParameter(7, "-no-scene-colors", "Do not use background and foreground colors in scene");
     
+    OptionalParameter* benchmarkOpt = ret->createOptionalParameter(8, "-benchmark-frames", "after rendering each window, redraw it and report drawing times");
+    benchmarkOpt->addIntegerParameter(1, "count", "number of frames to redraw");
+    
     AString helpText("Render content of browser windows displayed in a scene "
                      "into image file(s).  The image file name should be "
                      "similar to \"capture.png\".  If there is only one image "
@@ -143,6 +149,10 @@ OperationShowScene::getParameters()
                  "      of the graphics region, the width and height specified\n"
                  "      on the command line is used for the size of the \n"
                  "      output image.\n"
+                 "\n"
+                 "The -benchmark-frames option redraws each window the given\n"
+                 "number of times after its image is written, and prints the\n"
+                 "average, minimum, and maximum time to draw the window.\n"
                  );
     
     
@@ -179,6 +189,15 @@ OperationShowScene::useParameters(OperationParameters* myParams,
     
     const bool doNotUseSceneColorsFlag = myParams->getOptionalParameter(7)->m_present;
     
+    int32_t benchmarkFrameCount = 0;
+    OptionalParameter* benchmarkOpt = myParams->getOptionalParameter(8);
+    if (benchmarkOpt->m_present) {
+        benchmarkFrameCount = static_cast<int32_t>(benchmarkOpt->getInteger(1));
+        if (benchmarkFrameCount < 1) {
+            throw OperationException("number of benchmark frames must be positive");
+        }
+    }
+    
     if ( ! useWindowSizeForImageSizeFlag) {
         if ((userImageWidth <= 0)
             || (userImageHeight <= 0)) {
@@ -445,6 +464,14 @@ OperationShowScene::useParameters(OperationParameters* myParams,
                                    imageWidth,
                                    imageHeight);
                         
+                        if (benchmarkFrameCount > 0) {
+                            benchmarkDrawing(brainOpenGL,
+                                             brain,
+                                             viewports,
+                                             windowIndex,
+                                             benchmarkFrameCount);
+                        }
+                        
                         for (std::vector<BrainOpenGLViewportContent*>::iterator vpIter = viewports.begin();
                              vpIter != viewports.end();
                              vpIter++) {
@@ -501,6 +528,14 @@ OperationShowScene::useParameters(OperationParameters* myParams,
                                imageWidth,
                                imageHeight);
                     
+                    if (benchmarkFrameCount > 0) {
+                        benchmarkDrawing(brainOpenGL,
+                                         brain,
+                                         viewportContents,
+                                         windowIndex,
+                                         benchmarkFrameCount);
+                    }
+                    
                 }
             }
             
@@ -513,6 +548,68 @@ OperationShowScene::useParameters(OperationParameters* myParams,
     }
 }
 
+/**
+ * Redraw a window and print drawing times.  The window was drawn
+ * once for its image, so the redraws measure drawing with surfaces
+ * and other content already loaded into graphics memory.
+ *
+ * @param brainOpenGL
+ *    OpenGL drawing for the window.
+ * @param brain
+ *    The brain.
+ * @param viewportContents
+ *    Content of the viewports in the window.
+ * @param windowIndex
+ *    Index of the window.
+ * @param numberOfFrames
+ *    Number of times the window is redrawn.
+ */
+void
+OperationShowScene::benchmarkDrawing(BrainOpenGL* brainOpenGL,
+                                     Brain* brain,
+                                     std::vector<BrainOpenGLViewportContent*>& viewportContents,
+                                     const int32_t windowIndex,
+                                     const int32_t numberOfFrames)
+{
+#ifdef HAVE_OSMESA
+    CaretAssert(brainOpenGL);
+    CaretAssert(numberOfFrames > 0);
+    
+    double totalMilliseconds = 0.0;
+    double minimumMilliseconds = 0.0;
+    double maximumMilliseconds = 0.0;
+    ElapsedTimer timer;
+    for (int32_t iFrame = 0; iFrame < numberOfFrames; iFrame++) {
+        timer.start();
+        brainOpenGL->drawModels(brain,
+                                viewportContents);
+        /*
+         * Drawing commands may be queued, wait for them to complete
+         */
+        glFinish();
+        const double milliseconds = timer.getElapsedTimeMilliseconds();
+        
+        totalMilliseconds += milliseconds;
+        if (iFrame == 0) {
+            minimumMilliseconds = milliseconds;
+            maximumMilliseconds = milliseconds;
+        }
+        else {
+            minimumMilliseconds = std::min(minimumMilliseconds, milliseconds);
+            maximumMilliseconds = std::max(maximumMilliseconds, milliseconds);
+        }
+    }
+    
+    std::cout << "Window " << (windowIndex + 1)
+    << ": " << numberOfFrames << " frames, "
+    << "average " << (totalMilliseconds / numberOfFrames) << " ms, "
+    << "minimum " << minimumMilliseconds << " ms, "
+    << "maximum " << maximumMilliseconds << " ms, "
+    << (1000.0 * numberOfFrames / std::max(totalMilliseconds, 0.001)) << " frames per second"
+    << std::endl;
+#endif // HAVE_OSMESA
+}
+
 /**
  * Estimate the size of the graphics region from scenes that lack
  * an explicit entry for the graphics region size.  Scenes in version
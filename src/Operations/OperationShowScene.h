@@ -26,7 +26,10 @@
 
 namespace caret {
 
+    class Brain;
+    class BrainOpenGL;
     class BrainOpenGLFixedPipeline;
+    class BrainOpenGLViewportContent;
     
     class OperationShowScene : public AbstractOperation {
 
@@ -51,6 +54,12 @@ namespace caret {
                                   const int32_t imageWidth,
                                   const int32_t imageHeight);
         
+        static void benchmarkDrawing(BrainOpenGL* brainOpenGL,
+                                     Brain* brain,
+                                     std::vector<BrainOpenGLViewportContent*>& viewportContents,
+                                     const int32_t windowIndex,
+                                     const int32_t numberOfFrames);
+        
         static void estimateGraphicsSize(const SceneClass* windowSceneClass,
                                          float& estimatedWidthOut,
                                          float& estimatedHeightOut);
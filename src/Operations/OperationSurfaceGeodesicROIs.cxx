@@ -32,6 +32,78 @@
 using namespace caret;
 using namespace std;
 
+namespace
+{
+    //ALLOW: each root's ROI is independent, so just write its column
+    class AllowReceiver : public GeodesicBatchReceiver
+    {
+        MetricFile* m_metricOut;
+        float m_invneg2sigmasqr;
+        bool m_gaussian;
+    public:
+        AllowReceiver(MetricFile* metricOut, const float& sigma)
+        {
+            m_metricOut = metricOut;
+            m_gaussian = (sigma > 0.0f);
+            m_invneg2sigmasqr = -0.5f / (sigma * sigma);
+        }
+        void receive(const int64_t& rootIndex, const vector<int32_t>& roinodes, const vector<float>& dists)
+        {
+            vector<float> weights(roinodes.size(), 1.0f);
+            if (m_gaussian)
+            {
+                double accum = 0.0;
+                for (int j = 0; j < (int)dists.size(); ++j)
+                {
+                    weights[j] = exp(dists[j] * dists[j] * m_invneg2sigmasqr);
+                    accum += weights[j];
+                }
+                for (int j = 0; j < (int)dists.size(); ++j)
+                {
+                    weights[j] /= accum;
+                }
+            }
+#pragma omp critical
+            {
+                for (int j = 0; j < (int)roinodes.size(); ++j)
+                {
+                    m_metricOut->setValue(roinodes[j], rootIndex, weights[j]);
+                }
+            }
+        }
+    };
+
+    //CLOSEST and EXCLUDE: track how many ROIs reach each vertex, and which root is closest
+    class OverlapReceiver : public GeodesicBatchReceiver
+    {
+        vector<int>& m_useCounts;
+        vector<int>& m_closestSeed;
+        vector<float>& m_bestDists;
+    public:
+        OverlapReceiver(vector<int>& useCounts, vector<int>& closestSeed, vector<float>& bestDists) :
+            m_useCounts(useCounts), m_closestSeed(closestSeed), m_bestDists(bestDists)
+        {
+        }
+        void receive(const int64_t& rootIndex, const vector<int32_t>& roinodes, const vector<float>& dists)
+        {
+#pragma omp critical
+            {
+                for (int j = 0; j < (int)roinodes.size(); ++j)
+                {
+                    int32_t node = roinodes[j];
+                    ++m_useCounts[node];
+                    if (m_bestDists[node] < 0.0f || dists[j] < m_bestDists[node] ||
+                        (dists[j] == m_bestDists[node] && rootIndex < m_closestSeed[node]))//roots finish in any order, so break ties the way serial order did
+                    {
+                        m_bestDists[node] = dists[j];
+                        m_closestSeed[node] = rootIndex;//nodelist array index, not node number
+                    }
+                }
+            }
+        }
+    };
+}
+
 AString OperationSurfaceGeodesicROIs::getCommandSwitch()
 {
     return "-surface-geodesic-rois";
@@ -79,6 +151,7 @@ void OperationSurfaceGeodesicROIs::useParameters(OperationParameters* myParams,
     LevelProgress myProgress(myProgObj);
     SurfaceFile* mySurf = myParams->getSurface(1);
     float limit = (float)myParams->getDouble(2);
+    if (limit < 0.0f) throw OperationException("limit must not be negative");
     AString nodeFileName = myParams->getString(3);
     MetricFile* myMetricOut = myParams->getOutputMetric(4);
     OptionalParameter* gaussOpt = myParams->getOptionalParameter(5);
@@ -97,7 +170,7 @@ void OperationSurfaceGeodesicROIs::useParameters(OperationParameters* myParams,
         throw OperationException("error opening list file for reading");
     }
     int nodenum, numNodes = mySurf->getNumberOfNodes();
-    vector<int> nodelist;
+    vector<int32_t> nodelist;
     textFile >> nodenum;
     while (textFile)
     {
@@ -164,55 +237,19 @@ void OperationSurfaceGeodesicROIs::useParameters(OperationParameters* myParams,
     switch (overlapType)
     {
         case 1://ALLOW
-            for (int i = 0; i < (int)nodelist.size(); ++i)
-            {
-                CaretPointer<GeodesicHelper> myhelp = mySurf->getGeodesicHelper();
-                vector<int32_t> roinodes;
-                vector<float> dists;
-                myhelp->getNodesToGeoDist(nodelist[i], limit, roinodes, dists);
-                if (sigma > 0.0f)
-                {
-                    double accum = 0.0;
-                    for (int j = 0; j < (int)dists.size(); ++j)
-                    {
-                        dists[j] = exp(dists[j] * dists[j] * invneg2sigmasqr);//reuse the vector for weights
-                        accum += dists[j];
-                    }
-                    for (int j = 0; j < (int)dists.size(); ++j)
-                    {
-                        dists[j] /= accum;
-                        myMetricOut->setValue(roinodes[j], i, dists[j]);
-                    }
-                } else {
-                    for (int j = 0; j < (int)roinodes.size(); ++j)
-                    {
-                        myMetricOut->setValue(roinodes[j], i, 1.0f);
-                    }
-                }
-            }
+        {
+            AllowReceiver myReceiver(myMetricOut, sigma);
+            mySurf->getGeodesicHelper()->getNodesToGeoDistBatch(nodelist, limit, &myReceiver);
             break;
+        }
         case 2:
         case 3:
         {
             vector<int> useCounts(numNodes, 0);
             vector<int> closestSeed(numNodes, -1);
             vector<float> bestDists(numNodes, -1.0f);
-            for (int i = 0; i < (int)nodelist.size(); ++i)
-            {
-                CaretPointer<GeodesicHelper> myhelp = mySurf->getGeodesicHelper();
-                vector<int32_t> roinodes;
-                vector<float> dists;
-                myhelp->getNodesToGeoDist(nodelist[i], limit, roinodes, dists);
-                for (int j = 0; j < (int)roinodes.size(); ++j)
-                {
-                    ++useCounts[roinodes[j]];
-                    if (bestDists[roinodes[j]] < 0.0f || dists[j] < bestDists[roinodes[j]])
-                    {
-                        bestDists[roinodes[j]] = dists[j];
-                        closestSeed[roinodes[j]] = i;//nodelist array index, not node number
-                    }
-                }
-            }
+            OverlapReceiver myReceiver(useCounts, closestSeed, bestDists);
+            mySurf->getGeodesicHelper()->getNodesToGeoDistBatch(nodelist, limit, &myReceiver);
             if (sigma > 0.0f)
             {
                 vector<double> accums(nodelist.size(), 0.0);
@@ -0,0 +1,120 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "OperationVolumeClusterSizes.h"
+#include "OperationException.h"
+
+#include "AlgorithmVolumeFindClusters.h"
+#include "VolumeFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+AString OperationVolumeClusterSizes::getCommandSwitch()
+{
+    return "-volume-cluster-sizes";
+}
+
+AString OperationVolumeClusterSizes::getShortDescription()
+{
+    return "LIST SIZES OF VOLUME CLUSTERS";
+}
+
+OperationParameters* OperationVolumeClusterSizes::getParameters()
+{
+    OperationParameters* ret = new OperationParameters();
+    
+    ret->addVolumeParameter(1, "volume-in", "the input volume");
+    
+    ret->addDoubleParameter(2, "value-threshold", "threshold for data values");
+    
+    ret->createOptionalParameter(3, "-less-than", "find values less than <value-threshold>, rather than greater");
+    
+    OptionalParameter* roiOpt = ret->createOptionalParameter(4, "-roi", "select a region of interest");
+    roiOpt->addVolumeParameter(1, "roi-volume", "the roi, as a volume file");
+    
+    OptionalParameter* connectOpt = ret->createOptionalParameter(5, "-connectivity", "use a different voxel neighborhood than face neighbors");
+    connectOpt->addIntegerParameter(1, "neighbors", "6 for face neighbors, 18 to include edge neighbors, 26 to include corner neighbors");
+    
+    ret->createOptionalParameter(6, "-show-map-name", "print map index and name before each output");
+    
+    ret->setHelpText(
+        AString("For each subvolume of the input, prints the volume in mm^3 of every cluster found with the same rules as -volume-find-clusters, ") +
+        "largest first, on a single line.  " +
+        "No minimum size is applied and no output volume is made, so this is much faster than -volume-find-clusters for building " +
+        "the distribution of cluster sizes, for instance over the maps of a permutation test.  " +
+        "Subvolumes are processed in parallel."
+    );
+    return ret;
+}
+
+void OperationVolumeClusterSizes::useParameters(OperationParameters* myParams, ProgressObject* myProgObj)
+{
+    LevelProgress myProgress(myProgObj);
+    VolumeFile* input = myParams->getVolume(1);
+    float threshValue = (float)myParams->getDouble(2);
+    bool lessThan = myParams->getOptionalParameter(3)->m_present;
+    if (input->getNumberOfComponents() != 1) throw OperationException("multi-component volumes are not supported in -volume-cluster-sizes");
+    VolumeFile* myRoi = NULL;
+    OptionalParameter* roiOpt = myParams->getOptionalParameter(4);
+    if (roiOpt->m_present)
+    {
+        myRoi = roiOpt->getVolume(1);
+    }
+    OptionalParameter* connectOpt = myParams->getOptionalParameter(5);
+    int connectivity = 6;
+    if (connectOpt->m_present)
+    {
+        connectivity = (int)connectOpt->getInteger(1);
+        if (connectivity != 6 && connectivity != 18 && connectivity != 26)
+        {
+            throw OperationException("connectivity must be 6, 18, or 26");
+        }
+    }
+    bool showMapName = myParams->getOptionalParameter(6)->m_present;
+    Vector3D ivec, jvec, kvec, origin;
+    input->getVolumeSpace().getSpacingVectors(ivec, jvec, kvec, origin);
+    float voxelVolume = abs(ivec.dot(jvec.cross(kvec)));
+    vector<vector<int64_t> > sizes;
+    AlgorithmVolumeFindClusters::getClusterSizes(input, threshValue, sizes, lessThan, myRoi, connectivity);
+    int numMaps = input->getNumberOfMaps();
+    CaretAssert((int)sizes.size() == numMaps);
+    for (int i = 0; i < numMaps; ++i)
+    {
+        sort(sizes[i].begin(), sizes[i].end(), greater<int64_t>());
+        if (showMapName) cout << AString::number(i + 1) << ": " << input->getMapName(i) << ":";
+        stringstream resultsstr;
+        resultsstr << setprecision(7);
+        for (size_t c = 0; c < sizes[i].size(); ++c)
+        {
+            if (c != 0 || showMapName) resultsstr << " ";
+            resultsstr << sizes[i][c] * voxelVolume;
+        }
+        cout << resultsstr.str() << endl;
+    }
+}
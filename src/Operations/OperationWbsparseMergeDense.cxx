@@ -21,8 +21,12 @@
 #include "OperationWbsparseMergeDense.h"
 #include "OperationException.h"
 
+#include "CaretOMP.h"
 #include "CaretSparseFile.h"
 
+#include <algorithm>
+#include <exception>
+
 using namespace caret;
 using namespace std;
 
@@ -158,71 +162,100 @@ void OperationWbsparseMergeDense::useParameters(OperationParameters* myParams, P
     {
         case CiftiXML::ALONG_ROW:
         {
-            for (int64_t i = 0; i < outColSize; ++i)
+            vector<int64_t> modelStart(numOutModels, 0), modelEnd(numOutModels, 0);//we could just do the entire row for each file, but doing it by structure could allow structure selection in the future
+            for (int j = 0; j < numOutModels; ++j)
             {
-                int64_t curOffset = 0;
-                vector<int64_t> outIndices, outValues, inIndices, inValues;
-                int loaded = -1;
-                for (int j = 0; j < numOutModels; ++j)//we could just do the entire row for each file, but doing it by structure could allow structure selection in the future
+                const CiftiBrainModelsMap::ModelInfo& myInfo = outModelInfo[j];
+                const CiftiXML& thisXML = wbsparseList[sourceWbsparse[j]]->getCiftiXML();
+                const CiftiBrainModelsMap& thisDenseMap = thisXML.getBrainModelsMap(myDir);
+                switch (myInfo.m_type)
                 {
-                    const CiftiBrainModelsMap::ModelInfo& myInfo = outModelInfo[j];
-                    const CiftiXML& thisXML = wbsparseList[sourceWbsparse[j]]->getCiftiXML();
-                    const CiftiBrainModelsMap& thisDenseMap = thisXML.getBrainModelsMap(myDir);
-                    int64_t startIndex = -1, endIndex = -1;
-                    switch (myInfo.m_type)
+                    case CiftiBrainModelsMap::SURFACE:
                     {
-                        case CiftiBrainModelsMap::SURFACE:
-                        {
-                            vector<CiftiBrainModelsMap::SurfaceMap> tempMap = thisDenseMap.getSurfaceMap(myInfo.m_structure);
-                            if (tempMap.size() > 0)
-                            {
-                                startIndex = tempMap[0].m_ciftiIndex;//NOTE: CiftiXML guarantees these are ordered by cifti index and contiguous
-                                endIndex = startIndex + tempMap.size();
-                            } else {
-                                startIndex = 0;
-                                endIndex = 0;
-                            }
-                            break;
-                        }
-                        case CiftiBrainModelsMap::VOXELS:
+                        vector<CiftiBrainModelsMap::SurfaceMap> tempMap = thisDenseMap.getSurfaceMap(myInfo.m_structure);
+                        if (tempMap.size() > 0)
                         {
-                            vector<CiftiBrainModelsMap::VolumeMap> tempMap = thisDenseMap.getVolumeStructureMap(myInfo.m_structure);
-                            if (tempMap.size() > 0)
-                            {
-                                startIndex = tempMap[0].m_ciftiIndex;//NOTE: CiftiXML guarantees these are ordered by cifti index and contiguous
-                                endIndex = startIndex + tempMap.size();
-                            } else {
-                                startIndex = 0;
-                                endIndex = 0;
-                            }
-                            break;
+                            modelStart[j] = tempMap[0].m_ciftiIndex;//NOTE: CiftiXML guarantees these are ordered by cifti index and contiguous
+                            modelEnd[j] = modelStart[j] + tempMap.size();
                         }
-                        default:
-                            CaretAssert(false);
-                            break;
+                        break;
                     }
-                    if (endIndex > startIndex)
+                    case CiftiBrainModelsMap::VOXELS:
                     {
-                        if (loaded != sourceWbsparse[j])
+                        vector<CiftiBrainModelsMap::VolumeMap> tempMap = thisDenseMap.getVolumeStructureMap(myInfo.m_structure);
+                        if (tempMap.size() > 0)
                         {
-                            wbsparseList[sourceWbsparse[j]]->getRowSparse(i, inIndices, inValues);
-                            loaded = sourceWbsparse[j];
+                            modelStart[j] = tempMap[0].m_ciftiIndex;//NOTE: CiftiXML guarantees these are ordered by cifti index and contiguous
+                            modelEnd[j] = modelStart[j] + tempMap.size();
                         }
-                        int64_t numSparse = (int64_t)inIndices.size();
-                        for (int64_t k = 0; k < numSparse; ++k)
+                        break;
+                    }
+                    default:
+                        CaretAssert(false);
+                        break;
+                }
+            }
+            const int64_t CHUNK_ROWS = 1024;//build a chunk of output rows in parallel, then write them in order
+            vector<vector<int64_t> > chunkIndices(CHUNK_ROWS), chunkValues(CHUNK_ROWS);
+            for (int64_t chunkStart = 0; chunkStart < outColSize; chunkStart += CHUNK_ROWS)
+            {
+                int64_t chunkEnd = min(outColSize, chunkStart + CHUNK_ROWS);
+                bool failed = false;
+                AString failMessage;//exceptions can't leave a parallel region
+#pragma omp CARET_PAR
+                {
+                    vector<int64_t> inIndices, inValues;
+#pragma omp CARET_FOR schedule(dynamic)
+                    for (int64_t i = chunkStart; i < chunkEnd; ++i)
+                    {
+                        try
                         {
-                            if (inIndices[k] >= startIndex && inIndices[k] < endIndex)
+                            vector<int64_t>& outIndices = chunkIndices[i - chunkStart], &outValues = chunkValues[i - chunkStart];
+                            outIndices.clear();
+                            outValues.clear();
+                            int64_t curOffset = 0;
+                            int loaded = -1;
+                            for (int j = 0; j < numOutModels; ++j)
+                            {
+                                if (modelEnd[j] > modelStart[j])
+                                {
+                                    if (loaded != sourceWbsparse[j])
+                                    {
+                                        wbsparseList[sourceWbsparse[j]]->getRowSparse(i, inIndices, inValues);
+                                        loaded = sourceWbsparse[j];
+                                    }
+                                    int64_t numSparse = (int64_t)inIndices.size();
+                                    for (int64_t k = 0; k < numSparse; ++k)
+                                    {
+                                        if (inIndices[k] >= modelStart[j] && inIndices[k] < modelEnd[j])
+                                        {
+                                            outIndices.push_back(inIndices[k] + curOffset);
+                                            outValues.push_back(inValues[k]);
+                                        }
+                                    }
+                                    curOffset += modelEnd[j] - modelStart[j];
+                                }
+                            }
+                        } catch (CaretException& e) {
+#pragma omp critical
                             {
-                                outIndices.push_back(inIndices[k] + curOffset);
-                                outValues.push_back(inValues[k]);
+                                if (!failed) failMessage = e.whatString();
+                                failed = true;
+                            }
+                        } catch (exception& e) {
+#pragma omp critical
+                            {
+                                if (!failed) failMessage = e.what();
+                                failed = true;
                             }
                         }
-                        curOffset += endIndex - startIndex;
                     }
                 }
-                myWriter.writeRowSparse(i, outIndices, outValues);
-                outIndices.clear();//reset for next row
-                outValues.clear();
+                if (failed) throw OperationException(failMessage);
+                for (int64_t i = chunkStart; i < chunkEnd; ++i)
+                {
+                    myWriter.writeRowSparse(i, chunkIndices[i - chunkStart], chunkValues[i - chunkStart]);
+                }
             }
             break;
         }
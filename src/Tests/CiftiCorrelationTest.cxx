@@ -0,0 +1,143 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiCorrelationTest.h"
+
+#include "AlgorithmCiftiCorrelation.h"
+#include "CiftiFile.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //straightforward double precision implementation to check the blocked kernel against
+    float referenceCorrelation(const vector<float>& row1, const vector<float>& row2, const vector<float>* weights, const bool& fisherZ, const bool& noDemean, const bool& covariance)
+    {
+        int numCols = (int)row1.size();
+        double weightSum = 0.0, mean1 = 0.0, mean2 = 0.0;
+        for (int i = 0; i < numCols; ++i)
+        {
+            double weight = (weights == NULL ? 1.0 : (*weights)[i]);
+            weightSum += weight;
+            mean1 += weight * row1[i];
+            mean2 += weight * row2[i];
+        }
+        mean1 /= weightSum;
+        mean2 /= weightSum;
+        if (noDemean)
+        {
+            mean1 = 0.0;
+            mean2 = 0.0;
+        }
+        double crossSum = 0.0, sqr1 = 0.0, sqr2 = 0.0;
+        for (int i = 0; i < numCols; ++i)
+        {
+            double weight = (weights == NULL ? 1.0 : (*weights)[i]);
+            double val1 = row1[i] - mean1, val2 = row2[i] - mean2;
+            crossSum += weight * val1 * val2;
+            sqr1 += weight * val1 * val1;
+            sqr2 += weight * val2 * val2;
+        }
+        if (covariance) return crossSum / weightSum;
+        double r = crossSum / sqrt(sqr1 * sqr2);
+        if (fisherZ)
+        {
+            if (r > 0.999999) r = 0.999999;
+            if (r < -0.999999) r = -0.999999;
+            return 0.5 * log((1 + r) / (1 - r));
+        }
+        return r;
+    }
+}
+
+CiftiCorrelationTest::CiftiCorrelationTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void CiftiCorrelationTest::execute()
+{
+    const int NUM_ROWS = 157, NUM_COLS = 203;//odd sizes to exercise the kernel edges
+    vector<vector<float> > inData(NUM_ROWS, vector<float>(NUM_COLS));
+    for (int i = 0; i < NUM_ROWS; ++i)
+    {
+        for (int j = 0; j < NUM_COLS; ++j)
+        {
+            inData[i][j] = sin(i * 0.37f + j * 0.11f) * (i % 5 + 1) + rand() / (float)RAND_MAX + i % 7;
+        }
+    }
+    CiftiXML myXML;
+    myXML.setNumberOfDimensions(2);
+    myXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(NUM_COLS));
+    myXML.setMap(CiftiXML::ALONG_COLUMN, CiftiSeriesMap(NUM_ROWS));
+    CiftiFile inFile;
+    inFile.setCiftiXML(myXML);
+    for (int i = 0; i < NUM_ROWS; ++i)
+    {
+        inFile.setRow(inData[i].data(), i);
+    }
+    vector<float> weights(NUM_COLS), binaryWeights(NUM_COLS);
+    for (int j = 0; j < NUM_COLS; ++j)
+    {
+        weights[j] = (j % 5 == 0 ? 0.0f : (j % 3) * 0.5f + 0.25f);
+        binaryWeights[j] = (j % 4 == 0 ? 0.0f : 1.0f);
+    }
+    const int NUM_MODES = 7;
+    const char* modeNames[NUM_MODES] = { "plain", "fisher-z", "no-demean", "covariance", "weights", "binary weights", "weighted covariance" };
+    const bool modeFisherZ[NUM_MODES] = { false, true, false, false, false, false, false };
+    const bool modeNoDemean[NUM_MODES] = { false, false, true, false, false, false, false };
+    const bool modeCovariance[NUM_MODES] = { false, false, false, true, false, false, true };
+    const vector<float>* modeWeights[NUM_MODES] = { NULL, NULL, NULL, NULL, &weights, &binaryWeights, &weights };
+    const float memLimits[] = { -1.0f, 0.0f };//everything at once, one output row at a time reading input as needed
+    vector<float> scratchRow(NUM_ROWS);
+    for (int m = 0; m < NUM_MODES; ++m)
+    {
+        for (int l = 0; l < 2; ++l)
+        {
+            CiftiFile outFile;
+            AlgorithmCiftiCorrelation(NULL, &inFile, &outFile, modeWeights[m], modeFisherZ[m], memLimits[l], modeNoDemean[m], modeCovariance[m]);
+            if (outFile.getNumberOfRows() != NUM_ROWS || outFile.getNumberOfColumns() != NUM_ROWS)
+            {
+                setFailed(AString("output has wrong dimensions in mode ") + modeNames[m]);
+                continue;
+            }
+            bool modeFailed = false;
+            for (int i = 0; i < NUM_ROWS && !modeFailed; ++i)
+            {
+                outFile.getRow(scratchRow.data(), i);
+                for (int j = 0; j < NUM_ROWS; ++j)
+                {
+                    float expected = referenceCorrelation(inData[i], inData[j], modeWeights[m], modeFisherZ[m], modeNoDemean[m], modeCovariance[m]);
+                    if (fabs(scratchRow[j] - expected) > 1e-5f * (1.0f + fabs(expected)))
+                    {
+                        setFailed(AString("mismatch in mode ") + modeNames[m] + " with memory limit " + AString::number(memLimits[l]) + " at row " + AString::number(i) +
+                                  ", column " + AString::number(j) + ": expected " + AString::number(expected) + ", got " + AString::number(scratchRow[j]));
+                        modeFailed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -19,8 +19,17 @@
 /*LICENSE_END*/
 
 #include "CiftiFileTest.h"
+#include "ByteOrderEnum.h"
 #include "CiftiFile.h"
+#include "DataFileException.h"
+
+#include <QDir>
+
+#include <algorithm>
+#include <cstring>
+
 using namespace caret;
+using namespace std;
 CiftiFileTest::CiftiFileTest(const AString &identifier) : TestInterface(identifier)
 {
 }
@@ -193,9 +202,240 @@ void CiftiFileTest::testCiftiReadWriteOnDisk()
             this->setFailed("Input and output Cifti file rows are not the same.");
             return;
         }
+        const float* mappedRow = test.getRowPointer(i);//output is native-endian uncompressed float32, so it must be memory mapped
+        if(mappedRow == NULL)
+        {
+            this->setFailed("Row of native float32 Cifti file was not memory mapped.");
+            return;
+        }
+        if(memcmp((const void *)mappedRow,(void *)testRow,rowSize*sizeof(float)))
+        {
+            this->setFailed("Memory mapped row does not match row read from Cifti file.");
+            return;
+        }
     }
     std::cout << "Reading and writing of Cifti was successful for all frames." << std::endl;
     delete [] row;
     delete [] testRow;
 }
 
+
+namespace
+{
+    const int64_t COLUMNS_TEST_ROWS = 50, COLUMNS_TEST_ROW_LENGTH = 3000;//rows longer than the 1024 element gap that getColumns reads through
+    
+    float columnsTestValue(const int64_t& row, const int64_t& column)
+    {
+        return row * 10000.0f + column;//exact in float for the test sizes
+    }
+    
+    CiftiXML makeColumnsTestXML()
+    {
+        CiftiXML myXML;
+        myXML.setNumberOfDimensions(2);
+        myXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(COLUMNS_TEST_ROW_LENGTH));
+        myXML.setMap(CiftiXML::ALONG_COLUMN, CiftiSeriesMap(COLUMNS_TEST_ROWS));
+        return myXML;
+    }
+    
+    void writeColumnsTestFile(const AString& filename, const CiftiFile::ENDIAN& endian)
+    {
+        CiftiFile myFile;
+        myFile.setWritingFile(filename, CiftiVersion(), endian);
+        myFile.setCiftiXML(makeColumnsTestXML());
+        vector<float> scratchRow(COLUMNS_TEST_ROW_LENGTH);
+        for (int64_t i = 0; i < COLUMNS_TEST_ROWS; ++i)
+        {
+            for (int64_t j = 0; j < COLUMNS_TEST_ROW_LENGTH; ++j)
+            {
+                scratchRow[j] = columnsTestValue(i, j);
+            }
+            myFile.setRow(scratchRow.data(), i);
+        }
+    }
+}
+
+CiftiFileColumnsTest::CiftiFileColumnsTest(const AString &identifier) : TestInterface(identifier)
+{
+}
+
+void CiftiFileColumnsTest::execute()
+{
+    testGetColumns();
+    testSetColumns();
+    testTruncatedFile();
+}
+
+void CiftiFileColumnsTest::checkColumns(const CiftiFile& file, const vector<int64_t>& indices, const AString& description)
+{
+    vector<float> columns(indices.size() * COLUMNS_TEST_ROWS);
+    file.getColumns(columns.data(), indices);
+    for (size_t j = 0; j < indices.size(); ++j)
+    {
+        for (int64_t i = 0; i < COLUMNS_TEST_ROWS; ++i)
+        {
+            if (columns[i + COLUMNS_TEST_ROWS * j] != columnsTestValue(i, indices[j]))
+            {
+                setFailed("getColumns gave wrong value at row " + AString::number(i) + " of requested column " + AString::number(indices[j]) + " (" + description + ")");
+                return;
+            }
+        }
+    }
+    if (indices.size() == 1)
+    {
+        vector<float> column(COLUMNS_TEST_ROWS);
+        file.getColumn(column.data(), indices[0]);
+        if (memcmp(column.data(), columns.data(), COLUMNS_TEST_ROWS * sizeof(float)) != 0)
+        {
+            setFailed("getColumn and getColumns differ for column " + AString::number(indices[0]) + " (" + description + ")");
+        }
+    }
+}
+
+void CiftiFileColumnsTest::testGetColumns()
+{
+    CiftiFile::ENDIAN swappedEndian = CiftiFile::BIG;
+    if (ByteOrderEnum::getSystemEndian() == ByteOrderEnum::ENDIAN_BIG) swappedEndian = CiftiFile::LITTLE;
+    AString nativeName = QDir::tempPath() + "/wb_columns_test_native.dtseries.nii";
+    AString swappedName = QDir::tempPath() + "/wb_columns_test_swapped.dtseries.nii";
+    writeColumnsTestFile(nativeName, CiftiFile::NATIVE);
+    writeColumnsTestFile(swappedName, swappedEndian);
+    vector<vector<int64_t> > indexLists;
+    const int64_t unsortedDuplicates[] = { 2500, 3, 3, 1500, 0, 2999, 1500 };
+    indexLists.push_back(vector<int64_t>(unsortedDuplicates, unsortedDuplicates + 7));
+    const int64_t separateSpans[] = { 2900, 10, 20, 1100 };//10 and 20 merge, the others are more than 1024 columns from any other
+    indexLists.push_back(vector<int64_t>(separateSpans, separateSpans + 4));
+    const int64_t mergedGaps[] = { 2050, 0, 1025 };//gaps of exactly 1024 are read through, which then covers most of the row
+    indexLists.push_back(vector<int64_t>(mergedGaps, mergedGaps + 3));
+    indexLists.push_back(vector<int64_t>(1, 7));
+    vector<int64_t> allReversed(COLUMNS_TEST_ROW_LENGTH);
+    for (int64_t j = 0; j < COLUMNS_TEST_ROW_LENGTH; ++j)
+    {
+        allReversed[j] = COLUMNS_TEST_ROW_LENGTH - 1 - j;
+    }
+    indexLists.push_back(allReversed);
+    {//scope so the files get closed before removing them
+        CiftiFile nativeFile(nativeName), swappedFile(swappedName), memoryFile(nativeName);
+        memoryFile.convertToInMemory();
+        if (swappedFile.getRowPointer(0) != NULL)
+        {
+            setFailed("byteswapped file was memory mapped, so the on-disk getColumns path is not tested");
+        }
+        const int64_t memLimits[] = { ((int64_t)1) << 28, 1, 7 * COLUMNS_TEST_ROW_LENGTH * sizeof(float) };//all rows in one read, one row per read, blocks that don't divide the rows evenly
+        for (size_t l = 0; l < indexLists.size(); ++l)
+        {
+            for (int m = 0; m < 3; ++m)
+            {
+                AString description = "index list " + AString::number(l) + ", memory limit " + AString::number(memLimits[m]);
+                nativeFile.setColumnMemoryLimit(memLimits[m]);
+                swappedFile.setColumnMemoryLimit(memLimits[m]);
+                memoryFile.setColumnMemoryLimit(memLimits[m]);
+                checkColumns(nativeFile, indexLists[l], "mapped, " + description);
+                checkColumns(swappedFile, indexLists[l], "on disk, " + description);
+                checkColumns(memoryFile, indexLists[l], "in memory, " + description);
+                if (failed()) break;
+            }
+        }
+    }
+    QFile::remove(nativeName);
+    QFile::remove(swappedName);
+}
+
+void CiftiFileColumnsTest::testSetColumns()
+{
+    AString outName = QDir::tempPath() + "/wb_columns_test_set.dtseries.nii";
+    const int64_t setIndices[] = { 2999, 5, 6, 7, 1200, 0, 1201 };//unsorted, with adjacent columns that get written together
+    vector<int64_t> indices(setIndices, setIndices + 7);
+    vector<float> columns(indices.size() * COLUMNS_TEST_ROWS);
+    for (size_t j = 0; j < indices.size(); ++j)
+    {
+        for (int64_t i = 0; i < COLUMNS_TEST_ROWS; ++i)
+        {
+            columns[i + COLUMNS_TEST_ROWS * j] = columnsTestValue(i, indices[j]);
+        }
+    }
+    vector<float> zeroRow(COLUMNS_TEST_ROW_LENGTH, 0.0f), scratchRow(COLUMNS_TEST_ROW_LENGTH);
+    for (int onDisk = 0; onDisk < 2; ++onDisk)
+    {
+        {
+            CiftiFile myFile;
+            if (onDisk) myFile.setWritingFile(outName);
+            myFile.setCiftiXML(makeColumnsTestXML());
+            for (int64_t i = 0; i < COLUMNS_TEST_ROWS; ++i)
+            {
+                myFile.setRow(zeroRow.data(), i);
+            }
+            myFile.setColumns(columns.data(), indices);
+            if (!onDisk) myFile.writeFile(outName);
+        }
+        CiftiFile testFile(outName);
+        for (int64_t i = 0; i < COLUMNS_TEST_ROWS && !failed(); ++i)
+        {
+            testFile.getRow(scratchRow.data(), i);
+            for (int64_t j = 0; j < COLUMNS_TEST_ROW_LENGTH; ++j)
+            {
+                bool written = (find(indices.begin(), indices.end(), j) != indices.end());
+                float expected = (written ? columnsTestValue(i, j) : 0.0f);
+                if (scratchRow[j] != expected)
+                {
+                    setFailed(AString("setColumns ") + (onDisk ? "on disk" : "in memory") + " gave wrong value at row " + AString::number(i) + ", column " + AString::number(j));
+                    break;
+                }
+            }
+        }
+    }
+    QFile::remove(outName);
+}
+
+void CiftiFileColumnsTest::testTruncatedFile()
+{
+    AString truncName = QDir::tempPath() + "/wb_columns_test_truncated.dtseries.nii";
+    writeColumnsTestFile(truncName, CiftiFile::NATIVE);
+    {
+        QFile truncFile(truncName);
+        if (!truncFile.resize(truncFile.size() - COLUMNS_TEST_ROW_LENGTH * sizeof(float) / 2))//cut off half of the last row
+        {
+            setFailed("unable to truncate test file");
+            QFile::remove(truncName);
+            return;
+        }
+    }
+    try
+    {//scope so the file gets closed before removing it, a short file must use the read path and throw instead of mapping pages past the end of the file
+        CiftiFile testFile(truncName);
+        if (testFile.getRowPointer(0) != NULL)
+        {
+            setFailed("truncated file was memory mapped");
+        }
+        vector<float> scratchRow(COLUMNS_TEST_ROW_LENGTH), scratchColumn(COLUMNS_TEST_ROWS);
+        testFile.getRow(scratchRow.data(), 0);
+        if (scratchRow[COLUMNS_TEST_ROW_LENGTH - 1] != columnsTestValue(0, COLUMNS_TEST_ROW_LENGTH - 1))
+        {
+            setFailed("complete row of truncated file has wrong values");
+        }
+        bool threw = false;
+        try
+        {
+            testFile.getRow(scratchRow.data(), COLUMNS_TEST_ROWS - 1);
+        } catch (DataFileException&) {
+            threw = true;
+        }
+        if (!threw) setFailed("getRow did not throw for the incomplete row of a truncated file");
+        testFile.getRow(scratchRow.data(), COLUMNS_TEST_ROWS - 1, true);//tolerateShortRead
+        if (scratchRow[0] != columnsTestValue(COLUMNS_TEST_ROWS - 1, 0))
+        {
+            setFailed("getRow with tolerateShortRead gave wrong values for the start of the incomplete row");
+        }
+        threw = false;
+        try
+        {
+            testFile.getColumn(scratchColumn.data(), COLUMNS_TEST_ROW_LENGTH - 1);
+        } catch (DataFileException&) {
+            threw = true;
+        }
+        if (!threw) setFailed("getColumn did not throw for a column past the end of a truncated file");
+    } catch (DataFileException& e) {
+        setFailed("unexpected exception with truncated file: " + e.whatString());
+    }
+    QFile::remove(truncName);
+}
@@ -19,10 +19,15 @@
 /*LICENSE_END*/
 #include "TestInterface.h"
 
+#include <stdint.h>
+#include <vector>
+
 #ifndef CIFTIFILETEST_H
 #define CIFTIFILETEST_H
 
 namespace caret {
+class CiftiFile;
+
 class CiftiFileTest : public TestInterface
 {
 public:
@@ -34,6 +39,19 @@ public:
     void testCiftiReadWriteOnDisk();
 };
 
+///uses only generated files in the temporary directory, so unlike CiftiFileTest it is run by ctest
+class CiftiFileColumnsTest : public TestInterface
+{
+public:
+    CiftiFileColumnsTest(const AString &identifier);
+    void execute();
+    void testGetColumns();
+    void testSetColumns();
+    void testTruncatedFile();
+private:
+    void checkColumns(const CiftiFile& file, const std::vector<int64_t>& indices, const AString& description);
+};
+
 } // namespace caret
 
 #endif // CIFTIFILETEST_H
@@ -0,0 +1,206 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiResampleTest.h"
+
+#include "AlgorithmCiftiResample.h"
+#include "CaretException.h"
+#include "CiftiFile.h"
+#include "FloatMatrix.h"
+#include "VolumeFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    vector<vector<float> > makeSform(const float spacing, const float origin[3])
+    {
+        vector<vector<float> > ret = FloatMatrix::zeros(4, 4).getMatrix();
+        for (int i = 0; i < 3; ++i)
+        {
+            ret[i][i] = spacing;
+            ret[i][3] = origin[i];
+        }
+        ret[3][3] = 1.0f;
+        return ret;
+    }
+
+    //two blobs, so each structure is cropped to a different part of the volume
+    CiftiBrainModelsMap makeModels(const int64_t dims[3], const vector<vector<float> >& sform)
+    {
+        CiftiBrainModelsMap ret;
+        VolumeSpace mySpace(dims, sform);
+        ret.setVolumeSpace(mySpace);
+        const StructureEnum::Enum structures[2] = { StructureEnum::THALAMUS_LEFT, StructureEnum::THALAMUS_RIGHT };
+        const float centers[2][3] = { { -5.0f, 2.0f, 3.0f }, { 6.0f, -1.0f, 4.0f } };
+        for (int s = 0; s < 2; ++s)
+        {
+            vector<int64_t> ijkList;
+            for (int64_t k = 0; k < dims[2]; ++k)
+            {
+                for (int64_t j = 0; j < dims[1]; ++j)
+                {
+                    for (int64_t i = 0; i < dims[0]; ++i)
+                    {
+                        float coord[3];
+                        mySpace.indexToSpace(i, j, k, coord);
+                        float dist2 = 0.0f;
+                        for (int d = 0; d < 3; ++d)
+                        {
+                            dist2 += (coord[d] - centers[s][d]) * (coord[d] - centers[s][d]);
+                        }
+                        if (dist2 < 36.0f)
+                        {
+                            ijkList.push_back(i);
+                            ijkList.push_back(j);
+                            ijkList.push_back(k);
+                        }
+                    }
+                }
+            }
+            ret.addVolumeModel(structures[s], ijkList);
+        }
+        return ret;
+    }
+}
+
+CiftiResampleTest::CiftiResampleTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+//resampling along rows uses precomputed source coordinates, resampling along columns still uses cifti separate and
+//AlgorithmVolumeAffineResample/AlgorithmVolumeWarpfieldResample, so the transposed input must give the same values
+void CiftiResampleTest::execute()
+{
+    const int64_t NUM_MAPS = 4;
+    const int64_t inDims[3] = { 12, 10, 8 }, refDims[3] = { 15, 13, 11 };
+    const float inOrigin[3] = { -12.0f, -10.0f, -6.0f }, refOrigin[3] = { -11.0f, -9.5f, -5.5f };
+    vector<vector<float> > inSform = makeSform(2.0f, inOrigin), refSform = makeSform(1.5f, refOrigin);
+    CiftiBrainModelsMap inModels = makeModels(inDims, inSform), refModels = makeModels(refDims, refSform);
+    int64_t numInElems = inModels.getLength(), numRefElems = refModels.getLength();
+    CiftiXML rowXML, colXML, templateXML;
+    rowXML.setNumberOfDimensions(2);
+    rowXML.setMap(CiftiXML::ALONG_ROW, inModels);
+    rowXML.setMap(CiftiXML::ALONG_COLUMN, CiftiSeriesMap(NUM_MAPS));
+    colXML.setNumberOfDimensions(2);
+    colXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(NUM_MAPS));
+    colXML.setMap(CiftiXML::ALONG_COLUMN, inModels);
+    templateXML = rowXML;
+    templateXML.setMap(CiftiXML::ALONG_ROW, refModels);
+    CiftiFile rowInput, colInput, templateFile;
+    rowInput.setCiftiXML(rowXML);
+    colInput.setCiftiXML(colXML);
+    templateFile.setCiftiXML(templateXML);
+    vector<float> scratch(numInElems * NUM_MAPS);
+    for (int64_t i = 0; i < (int64_t)scratch.size(); ++i)
+    {
+        scratch[i] = ((float)rand()) / RAND_MAX;
+    }
+    for (int64_t m = 0; m < NUM_MAPS; ++m)
+    {
+        rowInput.setRow(scratch.data() + m * numInElems, m);
+    }
+    vector<float> colRow(NUM_MAPS);
+    for (int64_t e = 0; e < numInElems; ++e)
+    {
+        for (int64_t m = 0; m < NUM_MAPS; ++m)
+        {
+            colRow[m] = scratch[m * numInElems + e];
+        }
+        colInput.setRow(colRow.data(), e);
+    }
+    FloatMatrix affine = FloatMatrix::identity(4);
+    const float ANGLE = 0.2f;
+    affine[0][0] = cos(ANGLE); affine[0][1] = -sin(ANGLE);
+    affine[1][0] = sin(ANGLE); affine[1][1] = cos(ANGLE);
+    affine[0][3] = 0.7f; affine[1][3] = -0.4f; affine[2][3] = 1.1f;
+    vector<int64_t> warpDims(4);
+    warpDims[0] = 12; warpDims[1] = 12; warpDims[2] = 9; warpDims[3] = 3;//doesn't cover all of the reference space, to test invalid displacements
+    const float warpOrigin[3] = { -12.0f, -10.0f, -5.0f };
+    VolumeFile warpfield(warpDims, makeSform(2.0f, warpOrigin));
+    for (int64_t k = 0; k < warpDims[2]; ++k)
+    {
+        for (int64_t j = 0; j < warpDims[1]; ++j)
+        {
+            for (int64_t i = 0; i < warpDims[0]; ++i)
+            {
+                warpfield.setValue(1.5f * sin(0.5f * j), i, j, k, 0);
+                warpfield.setValue(1.5f * cos(0.4f * k), i, j, k, 1);
+                warpfield.setValue(0.5f * sin(0.3f * i), i, j, k, 2);
+            }
+        }
+    }
+    const VolumeFile::InterpType methods[2] = { VolumeFile::TRILINEAR, VolumeFile::CUBIC };
+    const float dilations[2] = { 0.0f, 4.0f };
+    vector<float> rowOutRow(numRefElems), colOutRow(NUM_MAPS);
+    for (int useWarp = 0; useWarp < 2; ++useWarp)
+    {
+        for (int m = 0; m < 2; ++m)
+        {
+            for (int d = 0; d < 2; ++d)
+            {
+                AString condition = AString(useWarp ? "warpfield" : "affine") + (m == 0 ? ", trilinear" : ", cubic") + ", dilation " + AString::number(dilations[d]);
+                CiftiFile rowOutput, colOutput;
+                try
+                {
+                    if (useWarp)
+                    {
+                        AlgorithmCiftiResample(NULL, &rowInput, CiftiXML::ALONG_ROW, &templateFile, CiftiXML::ALONG_ROW, SurfaceResamplingMethodEnum::BARYCENTRIC, methods[m], &rowOutput,
+                                               false, dilations[d], 0.0f, &warpfield, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                        AlgorithmCiftiResample(NULL, &colInput, CiftiXML::ALONG_COLUMN, &templateFile, CiftiXML::ALONG_ROW, SurfaceResamplingMethodEnum::BARYCENTRIC, methods[m], &colOutput,
+                                               false, dilations[d], 0.0f, &warpfield, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                    } else {
+                        AlgorithmCiftiResample(NULL, &rowInput, CiftiXML::ALONG_ROW, &templateFile, CiftiXML::ALONG_ROW, SurfaceResamplingMethodEnum::BARYCENTRIC, methods[m], &rowOutput,
+                                               false, dilations[d], 0.0f, affine, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                        AlgorithmCiftiResample(NULL, &colInput, CiftiXML::ALONG_COLUMN, &templateFile, CiftiXML::ALONG_ROW, SurfaceResamplingMethodEnum::BARYCENTRIC, methods[m], &colOutput,
+                                               false, dilations[d], 0.0f, affine, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                    }
+                } catch (CaretException& e) {
+                    setFailed(condition + ", resampling failed: " + e.whatString());
+                    continue;
+                }
+                if (rowOutput.getNumberOfRows() != NUM_MAPS || rowOutput.getNumberOfColumns() != numRefElems ||
+                    colOutput.getNumberOfRows() != numRefElems || colOutput.getNumberOfColumns() != NUM_MAPS)
+                {
+                    setFailed(condition + ", output has wrong dimensions");
+                    continue;
+                }
+                int64_t numBad = 0;
+                for (int64_t row = 0; row < NUM_MAPS; ++row)
+                {
+                    rowOutput.getRow(rowOutRow.data(), row);
+                    for (int64_t e = 0; e < numRefElems; ++e)
+                    {
+                        colOutput.getRow(colOutRow.data(), e);
+                        float expected = colOutRow[row];//coordinates are computed with float index vs integer index math, so allow for rounding
+                        if (abs(rowOutRow[e] - expected) > 1e-4f * max(1.0f, abs(expected))) ++numBad;
+                    }
+                }
+                if (numBad != 0) setFailed(condition + ", " + AString::number(numBad) + " values differ from resampling along columns");
+            }
+        }
+    }
+}
@@ -0,0 +1,159 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiRowPipelineTest.h"
+
+#include "CaretException.h"
+#include "CiftiFile.h"
+#include "CiftiRowPipeline.h"
+
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //output row is the sum of the input row, followed by the row index
+    class SumRowStage : public CiftiRowPipeline::RowStage
+    {
+        int64_t m_rowLength;
+    public:
+        SumRowStage(const int64_t& rowLength) { m_rowLength = rowLength; }
+        void computeRow(const vector<int64_t>& index, const float* inRow, float* outRow, const int&)
+        {
+            float sum = 0.0f;
+            for (int64_t i = 0; i < m_rowLength; ++i)
+            {
+                sum += inRow[i];
+            }
+            outRow[0] = sum;
+            outRow[1] = index[0];
+            outRow[2] = index[1];
+        }
+    };
+
+    //checks that reads and writes happen in order, optionally throws from a compute call
+    class OrderCheckStage : public CiftiRowPipeline::Stage
+    {
+        int64_t m_nextRead, m_nextWrite, m_throwItem;
+        bool m_outOfOrder;
+    public:
+        OrderCheckStage(const int64_t& throwItem = -1)
+        {
+            m_nextRead = 0;
+            m_nextWrite = 0;
+            m_throwItem = throwItem;
+            m_outOfOrder = false;
+        }
+        void readItem(const int64_t& item, float* inputOut)
+        {
+            if (item != m_nextRead) m_outOfOrder = true;
+            ++m_nextRead;
+            inputOut[0] = item;
+        }
+        void computeItem(const int64_t& item, const float* input, float* output, const int&)
+        {
+            if (item == m_throwItem) throw CaretException("intentional failure");
+            output[0] = input[0] * 2.0f;
+        }
+        void writeItem(const int64_t& item, const float* output)
+        {
+            if (item != m_nextWrite || output[0] != item * 2.0f) m_outOfOrder = true;
+            ++m_nextWrite;
+        }
+        bool wasOutOfOrder() const { return m_outOfOrder; }
+        int64_t getNumWritten() const { return m_nextWrite; }
+    };
+}
+
+CiftiRowPipelineTest::CiftiRowPipelineTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void CiftiRowPipelineTest::execute()
+{
+    const int64_t ROW_LENGTH = 20, DIM2 = 13, DIM3 = 7;
+    CiftiXML inXML, outXML;
+    inXML.setNumberOfDimensions(3);
+    inXML.setMap(0, CiftiSeriesMap(ROW_LENGTH));
+    inXML.setMap(1, CiftiSeriesMap(DIM2));
+    inXML.setMap(2, CiftiSeriesMap(DIM3));
+    outXML = inXML;
+    outXML.setMap(0, CiftiSeriesMap(3));
+    CiftiFile inFile, outFile;
+    inFile.setCiftiXML(inXML);
+    outFile.setCiftiXML(outXML);
+    vector<float> scratchRow(ROW_LENGTH);
+    vector<int64_t> index(2);
+    for (index[1] = 0; index[1] < DIM3; ++index[1])
+    {
+        for (index[0] = 0; index[0] < DIM2; ++index[0])
+        {
+            for (int64_t i = 0; i < ROW_LENGTH; ++i)
+            {
+                scratchRow[i] = index[0] * 100 + index[1] * 10 + i;//small integers, so the sums are exact
+            }
+            inFile.setRow(scratchRow.data(), index);
+        }
+    }
+    const int64_t memLimits[] = { -1, 0, 500 };//default, one row per chunk, a few rows per chunk
+    for (int m = 0; m < 3; ++m)
+    {
+        SumRowStage myStage(ROW_LENGTH);
+        CiftiRowPipeline::runOverRows(&myStage, &inFile, &outFile, memLimits[m]);
+        float outRow[3];
+        for (index[1] = 0; index[1] < DIM3; ++index[1])
+        {
+            for (index[0] = 0; index[0] < DIM2; ++index[0])
+            {
+                outFile.getRow(outRow, index);
+                float expected = ROW_LENGTH * (index[0] * 100 + index[1] * 10) + ROW_LENGTH * (ROW_LENGTH - 1) / 2;
+                if (outRow[0] != expected || outRow[1] != index[0] || outRow[2] != index[1])
+                {
+                    setFailed("wrong output for row (" + AString::number(index[0]) + ", " + AString::number(index[1]) + ") with memory limit " + AString::number(memLimits[m]));
+                }
+            }
+        }
+    }
+    const int64_t itemCounts[] = { 1, 2, 17, 1000 };
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int m = 0; m < 3; ++m)
+        {
+            OrderCheckStage myStage;
+            CiftiRowPipeline::run(&myStage, itemCounts[c], 1, 1, memLimits[m]);
+            if (myStage.wasOutOfOrder() || myStage.getNumWritten() != itemCounts[c])
+            {
+                setFailed("items not read and written in order for " + AString::number(itemCounts[c]) + " items with memory limit " + AString::number(memLimits[m]));
+            }
+        }
+    }
+    OrderCheckStage throwStage(500);
+    bool caught = false;
+    try
+    {
+        CiftiRowPipeline::run(&throwStage, 1000, 1, 1, 100);
+    } catch (CaretException&) {
+        caught = true;
+    }
+    if (!caught) setFailed("exception from compute stage was not propagated");
+    if (throwStage.getNumWritten() > 500) setFailed("items after a failed item were written");
+}
@@ -0,0 +1,123 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "CiftiTransposeTest.h"
+
+#include "AlgorithmCiftiTranspose.h"
+#include "CiftiFile.h"
+#include "ElapsedTimer.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <iostream>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    void makeSquareishCifti(const AString& filename, const int64_t& numRows, const int64_t& rowLength)
+    {
+        CiftiXML myXML;
+        myXML.setNumberOfDimensions(2);
+        myXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(rowLength));
+        myXML.setMap(CiftiXML::ALONG_COLUMN, CiftiSeriesMap(numRows));
+        CiftiFile myFile;
+        myFile.setWritingFile(filename);//write directly, these get big
+        myFile.setCiftiXML(myXML);
+        vector<float> scratchRow(rowLength);
+        for (int64_t i = 0; i < numRows; ++i)
+        {
+            for (int64_t j = 0; j < rowLength; ++j)
+            {
+                scratchRow[j] = i * 1000.0f + j;//exact in float for the test sizes
+            }
+            myFile.setRow(scratchRow.data(), i);
+        }
+    }
+}
+
+CiftiTransposeTest::CiftiTransposeTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void CiftiTransposeTest::execute()
+{
+    const int64_t NUM_ROWS = 300, ROW_LENGTH = 200;
+    AString inName = QDir::tempPath() + "/wb_transpose_test_in.dtseries.nii";
+    makeSquareishCifti(inName, NUM_ROWS, ROW_LENGTH);
+    {//scope so the input gets closed before removing it
+        CiftiFile inFile(inName);
+        const float memLimits[] = { -1.0f, 0.0001f, 0.0f };//everything in memory, spill with several blocks and partitions, spill with single-element tiles
+        for (int m = 0; m < 3; ++m)
+        {
+            CiftiFile outFile;
+            AlgorithmCiftiTranspose(NULL, &inFile, &outFile, memLimits[m]);
+            if (outFile.getNumberOfRows() != ROW_LENGTH || outFile.getNumberOfColumns() != NUM_ROWS)
+            {
+                setFailed("transposed file has wrong dimensions with memory limit " + AString::number(memLimits[m]));
+                continue;
+            }
+            vector<float> scratchRow(NUM_ROWS);
+            for (int64_t i = 0; i < ROW_LENGTH && !failed(); ++i)
+            {
+                outFile.getRow(scratchRow.data(), i);
+                for (int64_t j = 0; j < NUM_ROWS; ++j)
+                {
+                    if (scratchRow[j] != j * 1000.0f + i)
+                    {
+                        setFailed("wrong value at output row " + AString::number(i) + ", column " + AString::number(j) + " with memory limit " + AString::number(memLimits[m]));
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    QFile::remove(inName);
+}
+
+CiftiTransposeBenchmark::CiftiTransposeBenchmark(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void CiftiTransposeBenchmark::execute()
+{
+    const int64_t sizes[] = { 32768, 65536, 91282 };
+    const float MEM_LIMIT_GB = 2.0f;
+    AString inName = QDir::tempPath() + "/wb_transpose_bench_in.dconn.nii", outName = QDir::tempPath() + "/wb_transpose_bench_out.dconn.nii";
+    for (int s = 0; s < 3; ++s)
+    {
+        cout << "creating " << sizes[s] << "x" << sizes[s] << " matrix..." << endl;
+        makeSquareishCifti(inName, sizes[s], sizes[s]);
+        {
+            CiftiFile inFile(inName);
+            CiftiFile outFile;
+            outFile.setWritingFile(outName);
+            ElapsedTimer myTimer;
+            myTimer.start();
+            AlgorithmCiftiTranspose(NULL, &inFile, &outFile, MEM_LIMIT_GB);
+            cout << sizes[s] << "x" << sizes[s] << " transpose with " << MEM_LIMIT_GB << "GB limit: " << myTimer.getElapsedTimeSeconds() << " seconds" << endl;
+        }
+        QFile::remove(inName);
+        QFile::remove(outName);
+    }
+}
@@ -0,0 +1,289 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ClusterLabelingTest.h"
+
+#include "AlgorithmMetricFindClusters.h"
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "AlgorithmVolumeFindClusters.h"
+#include "CaretPointer.h"
+#include "ClusterLabelingHelper.h"
+#include "FloatMatrix.h"
+#include "MetricFile.h"
+#include "SurfaceFile.h"
+#include "TopologyHelper.h"
+#include "VolumeFile.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //flood fill, scanning by index, so clusters are numbered in order of their lowest element
+    int64_t floodFillVolume(const vector<char>& marked, const int64_t dims[3], const int& connectivity, vector<int64_t>& labelsOut, vector<int64_t>& sizesOut)
+    {
+        int maxNonzero = (connectivity == 6 ? 1 : (connectivity == 18 ? 2 : 3));
+        int64_t frameSize = dims[0] * dims[1] * dims[2];
+        labelsOut.assign(frameSize, -1);
+        sizesOut.clear();
+        vector<int64_t> stack;
+        for (int64_t start = 0; start < frameSize; ++start)
+        {
+            if (!marked[start] || labelsOut[start] != -1) continue;
+            int64_t cluster = (int64_t)sizesOut.size();
+            sizesOut.push_back(0);
+            labelsOut[start] = cluster;
+            stack.push_back(start);
+            while (!stack.empty())
+            {
+                int64_t index = stack.back();
+                stack.pop_back();
+                ++sizesOut[cluster];
+                int64_t i = index % dims[0], j = (index / dims[0]) % dims[1], k = index / dims[0] / dims[1];
+                for (int dk = -1; dk <= 1; ++dk)
+                {
+                    for (int dj = -1; dj <= 1; ++dj)
+                    {
+                        for (int di = -1; di <= 1; ++di)
+                        {
+                            int nonzero = (di != 0) + (dj != 0) + (dk != 0);
+                            if (nonzero == 0 || nonzero > maxNonzero) continue;
+                            int64_t ni = i + di, nj = j + dj, nk = k + dk;
+                            if (ni < 0 || ni >= dims[0] || nj < 0 || nj >= dims[1] || nk < 0 || nk >= dims[2]) continue;
+                            int64_t neighIndex = ni + dims[0] * (nj + dims[1] * nk);
+                            if (marked[neighIndex] && labelsOut[neighIndex] == -1)
+                            {
+                                labelsOut[neighIndex] = cluster;
+                                stack.push_back(neighIndex);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return (int64_t)sizesOut.size();
+    }
+
+    int64_t floodFillSurface(const vector<char>& marked, const TopologyHelper* myTopoHelp, const vector<float>& nodeAreas, vector<int64_t>& labelsOut, vector<double>& areasOut)
+    {
+        int64_t numNodes = myTopoHelp->getNumberOfNodes();
+        labelsOut.assign(numNodes, -1);
+        int64_t numClusters = 0;
+        vector<int64_t> stack;
+        for (int64_t start = 0; start < numNodes; ++start)
+        {
+            if (!marked[start] || labelsOut[start] != -1) continue;
+            labelsOut[start] = numClusters;
+            stack.push_back(start);
+            while (!stack.empty())
+            {
+                int64_t node = stack.back();
+                stack.pop_back();
+                int32_t numNeigh = 0;
+                const int32_t* neighbors = myTopoHelp->getNodeNeighbors((int32_t)node, numNeigh);
+                for (int32_t n = 0; n < numNeigh; ++n)
+                {
+                    if (marked[neighbors[n]] && labelsOut[neighbors[n]] == -1)
+                    {
+                        labelsOut[neighbors[n]] = numClusters;
+                        stack.push_back(neighbors[n]);
+                    }
+                }
+            }
+            ++numClusters;
+        }
+        areasOut.assign(numClusters, 0.0);
+        for (int64_t node = 0; node < numNodes; ++node)
+        {//sum in index order, like the helper, so the areas match exactly
+            if (labelsOut[node] >= 0) areasOut[labelsOut[node]] += nodeAreas[node];
+        }
+        return numClusters;
+    }
+}
+
+ClusterLabelingTest::ClusterLabelingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void ClusterLabelingTest::execute()
+{
+    const int64_t dims[3] = { 50, 40, 30 };//more than one block of rows, so links between blocks get merged
+    const int64_t frameSize = dims[0] * dims[1] * dims[2];
+    const int densities[2] = { 25, 45 };//percent marked, sparse gives many small clusters, dense gives large ones that cross every block
+    vector<char> marked(frameSize);
+    vector<int64_t> labels(frameSize), expectLabels, sizes, noLabelSizes, expectSizes;
+    for (int d = 0; d < 2; ++d)
+    {
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            marked[i] = (rand() % 100 < densities[d]) ? 1 : 0;
+        }
+        const int connectivities[3] = { 6, 18, 26 };
+        for (int c = 0; c < 3; ++c)
+        {
+            AString condition = AString::number(densities[d]) + "% marked voxels with connectivity " + AString::number(connectivities[c]);
+            int64_t expectClusters = floodFillVolume(marked, dims, connectivities[c], expectLabels, expectSizes);
+            int64_t numClusters = ClusterLabelingHelper::labelVolume(marked.data(), dims, connectivities[c], labels.data(), sizes);
+            if (numClusters != expectClusters) setFailed(condition + ", found " + AString::number(numClusters) + " clusters, expected " + AString::number(expectClusters));
+            if (labels != expectLabels) setFailed(condition + ", cluster labels differ from flood fill");
+            if (sizes != expectSizes) setFailed(condition + ", cluster sizes differ from flood fill");
+            ClusterLabelingHelper::labelVolume(marked.data(), dims, connectivities[c], NULL, noLabelSizes);
+            if (noLabelSizes != expectSizes) setFailed(condition + ", cluster sizes without labels differ from flood fill");
+            vector<int64_t> starts, members;
+            ClusterLabelingHelper::getMembers(labels.data(), frameSize, numClusters, starts, members);
+            bool membersGood = ((int64_t)starts.size() == expectClusters + 1);
+            for (int64_t cluster = 0; membersGood && cluster < expectClusters; ++cluster)
+            {
+                if (starts[cluster + 1] - starts[cluster] != expectSizes[cluster]) membersGood = false;
+                for (int64_t m = starts[cluster]; membersGood && m < starts[cluster + 1]; ++m)
+                {
+                    if (expectLabels[members[m]] != cluster || (m > starts[cluster] && members[m] <= members[m - 1])) membersGood = false;
+                }
+            }
+            if (!membersGood) setFailed(condition + ", cluster members are wrong");
+        }
+    }
+    {//size-only path over every map, with the threshold, roi and connectivity rules of -volume-find-clusters
+        const int NUM_MAPS = 3;
+        vector<int64_t> volDims(dims, dims + 3);
+        volDims.push_back(NUM_MAPS);
+        VolumeFile batchVol, roiVol;
+        batchVol.reinitialize(volDims, FloatMatrix::identity(4).getMatrix());
+        roiVol.reinitialize(vector<int64_t>(dims, dims + 3), FloatMatrix::identity(4).getMatrix());
+        vector<vector<float> > frames(NUM_MAPS, vector<float>(frameSize));
+        vector<float> roiFrame(frameSize);
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            roiFrame[i] = (i % dims[0] < dims[0] / 2) ? 1.0f : 0.0f;
+        }
+        roiVol.setFrame(roiFrame.data());
+        for (int m = 0; m < NUM_MAPS; ++m)
+        {
+            for (int64_t i = 0; i < frameSize; ++i)
+            {
+                frames[m][i] = rand() % 100;
+            }
+            batchVol.setFrame(frames[m].data(), m);
+        }
+        for (int pass = 0; pass < 2; ++pass)
+        {//greater than with 26 neighbors, then less than inside the roi with 6 neighbors
+            bool lessThan = (pass == 1);
+            float threshold = (lessThan ? 40.5f : 60.5f);
+            int connectivity = (lessThan ? 6 : 26);
+            vector<vector<int64_t> > batchSizes;
+            AlgorithmVolumeFindClusters::getClusterSizes(&batchVol, threshold, batchSizes, lessThan, (lessThan ? &roiVol : NULL), connectivity);
+            if ((int)batchSizes.size() != NUM_MAPS)
+            {
+                setFailed("getClusterSizes gave " + AString::number(batchSizes.size()) + " maps, expected " + AString::number(NUM_MAPS));
+                continue;
+            }
+            for (int m = 0; m < NUM_MAPS; ++m)
+            {
+                for (int64_t i = 0; i < frameSize; ++i)
+                {
+                    marked[i] = (lessThan ? (roiFrame[i] > 0.0f && frames[m][i] < threshold) : frames[m][i] > threshold) ? 1 : 0;
+                }
+                floodFillVolume(marked, dims, connectivity, expectLabels, expectSizes);
+                if (batchSizes[m] != expectSizes) setFailed("getClusterSizes differs from flood fill in map " + AString::number(m) + " of pass " + AString::number(pass));
+            }
+        }
+    }
+    SurfaceFile mySurf;
+    AlgorithmSurfaceCreateSphere(NULL, 40000, &mySurf);//also more than one block
+    CaretPointer<TopologyHelper> myTopoHelp = mySurf.getTopologyHelper();
+    int64_t numNodes = mySurf.getNumberOfNodes();
+    vector<float> nodeAreas;
+    mySurf.computeNodeAreas(nodeAreas);
+    vector<char> nodeMarked(numNodes);
+    vector<int64_t> nodeLabels(numNodes), expectNodeLabels;
+    vector<double> areas, counts, expectAreas;
+    for (int d = 0; d < 2; ++d)
+    {
+        for (int64_t i = 0; i < numNodes; ++i)
+        {
+            nodeMarked[i] = (rand() % 100 < densities[d] + 20) ? 1 : 0;//surfaces have fewer neighbors, so mark more
+        }
+        AString condition = AString::number(densities[d] + 20) + "% marked vertices";
+        int64_t expectClusters = floodFillSurface(nodeMarked, myTopoHelp, nodeAreas, expectNodeLabels, expectAreas);
+        int64_t numClusters = ClusterLabelingHelper::labelSurface(nodeMarked.data(), myTopoHelp, nodeAreas.data(), nodeLabels.data(), areas);
+        if (numClusters != expectClusters) setFailed(condition + ", found " + AString::number(numClusters) + " clusters, expected " + AString::number(expectClusters));
+        if (nodeLabels != expectNodeLabels) setFailed(condition + ", cluster labels differ from flood fill");
+        if (areas != expectAreas) setFailed(condition + ", cluster areas differ from flood fill");
+        ClusterLabelingHelper::labelSurface(nodeMarked.data(), myTopoHelp, NULL, NULL, counts);
+        bool countsGood = ((int64_t)counts.size() == expectClusters);
+        for (int64_t i = 0; countsGood && i < numNodes; ++i)
+        {
+            if (expectNodeLabels[i] >= 0) counts[expectNodeLabels[i]] -= 1.0;
+        }
+        for (int64_t cluster = 0; countsGood && cluster < expectClusters; ++cluster)
+        {
+            if (counts[cluster] != 0.0) countsGood = false;
+        }
+        if (!countsGood) setFailed(condition + ", cluster vertex counts differ from flood fill");
+    }
+    {//size-only path over every column, with the threshold, roi and corrected area rules of -metric-find-clusters
+        const int NUM_COLS = 3;
+        MetricFile batchMetric, roiMetric, areaMetric;
+        batchMetric.setNumberOfNodesAndColumns(numNodes, NUM_COLS);
+        roiMetric.setNumberOfNodesAndColumns(numNodes, 1);
+        areaMetric.setNumberOfNodesAndColumns(numNodes, 1);
+        vector<vector<float> > columns(NUM_COLS, vector<float>(numNodes));
+        vector<float> roiData(numNodes), doubledAreas(numNodes);
+        for (int64_t i = 0; i < numNodes; ++i)
+        {
+            roiData[i] = (mySurf.getCoordinate(i)[2] > 0.0f) ? 1.0f : 0.0f;
+            doubledAreas[i] = nodeAreas[i] * 2.0f;
+        }
+        roiMetric.setValuesForColumn(0, roiData.data());
+        areaMetric.setValuesForColumn(0, doubledAreas.data());
+        for (int c = 0; c < NUM_COLS; ++c)
+        {
+            for (int64_t i = 0; i < numNodes; ++i)
+            {
+                columns[c][i] = rand() % 100;
+            }
+            batchMetric.setValuesForColumn(c, columns[c].data());
+        }
+        for (int pass = 0; pass < 2; ++pass)
+        {//greater than with computed areas, then less than inside the roi with corrected areas
+            bool lessThan = (pass == 1);
+            float threshold = (lessThan ? 60.5f : 40.5f);
+            vector<vector<double> > batchAreas;
+            AlgorithmMetricFindClusters::getClusterAreas(&mySurf, &batchMetric, threshold, batchAreas, lessThan, (lessThan ? &roiMetric : NULL), (lessThan ? &areaMetric : NULL));
+            if ((int)batchAreas.size() != NUM_COLS)
+            {
+                setFailed("getClusterAreas gave " + AString::number(batchAreas.size()) + " columns, expected " + AString::number(NUM_COLS));
+                continue;
+            }
+            for (int c = 0; c < NUM_COLS; ++c)
+            {
+                for (int64_t i = 0; i < numNodes; ++i)
+                {
+                    nodeMarked[i] = (lessThan ? (roiData[i] > 0.0f && columns[c][i] < threshold) : columns[c][i] > threshold) ? 1 : 0;
+                }
+                floodFillSurface(nodeMarked, myTopoHelp, (lessThan ? doubledAreas : nodeAreas), expectNodeLabels, expectAreas);
+                if (batchAreas[c] != expectAreas) setFailed("getClusterAreas differs from flood fill in column " + AString::number(c) + " of pass " + AString::number(pass));
+            }
+        }
+    }
+}
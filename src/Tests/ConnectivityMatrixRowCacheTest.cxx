@@ -0,0 +1,188 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ConnectivityMatrixRowCacheTest.h"
+
+#include "CiftiFile.h"
+#include "ConnectivityMatrixRowCache.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int64_t NUM_ROWS = 20, NUM_COLUMNS = 100;
+    const int64_t ROW_BYTES = NUM_COLUMNS * sizeof(float);
+    
+    float rowCacheTestValue(const int64_t& row, const int64_t& column)
+    {
+        return row * 1000.0f + column;//exact in float for the test sizes
+    }
+}
+
+ConnectivityMatrixRowCacheTest::ConnectivityMatrixRowCacheTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void ConnectivityMatrixRowCacheTest::checkRow(ConnectivityMatrixRowCache& rowCache, const CiftiFile& ciftiFile, const int64_t& rowIndex, const bool& expectHit)
+{
+    int64_t hitsBefore = rowCache.getNumberOfHits(), missesBefore = rowCache.getNumberOfMisses();
+    vector<float> row(NUM_COLUMNS, -1.0f);
+    rowCache.getRow(&ciftiFile, row.data(), rowIndex);
+    for (int64_t j = 0; j < NUM_COLUMNS; ++j)
+    {
+        if (row[j] != rowCacheTestValue(rowIndex, j))
+        {
+            setFailed("row " + AString::number(rowIndex) + " has wrong value in column " + AString::number(j));
+            break;
+        }
+    }
+    bool hit = (rowCache.getNumberOfHits() == hitsBefore + 1 && rowCache.getNumberOfMisses() == missesBefore);
+    bool miss = (rowCache.getNumberOfHits() == hitsBefore && rowCache.getNumberOfMisses() == missesBefore + 1);
+    if (expectHit ? !hit : !miss)
+    {
+        setFailed("row " + AString::number(rowIndex) + (expectHit ? " was not loaded from the cache" : " was expected to not be in the cache"));
+    }
+}
+
+void ConnectivityMatrixRowCacheTest::checkCounts(const ConnectivityMatrixRowCache& rowCache, const int64_t& cachedRows, const int64_t& hits, const int64_t& misses,
+                                                 const int64_t& prefetched, const AString& description)
+{
+    if (rowCache.getNumberOfCachedRows() != cachedRows || rowCache.getNumberOfHits() != hits ||
+        rowCache.getNumberOfMisses() != misses || rowCache.getNumberOfPrefetchedRows() != prefetched)
+    {
+        setFailed(description + ", cache has " + AString::number(rowCache.getNumberOfCachedRows()) + " rows, " + AString::number(rowCache.getNumberOfHits()) + " hits, " +
+                  AString::number(rowCache.getNumberOfMisses()) + " misses, " + AString::number(rowCache.getNumberOfPrefetchedRows()) + " prefetched, expected " +
+                  AString::number(cachedRows) + ", " + AString::number(hits) + ", " + AString::number(misses) + ", " + AString::number(prefetched));
+    }
+}
+
+void ConnectivityMatrixRowCacheTest::execute()
+{
+    AString fileName = QDir::tempPath() + "/wb_row_cache_test.dtseries.nii";
+    {
+        CiftiXML myXML;
+        myXML.setNumberOfDimensions(2);
+        myXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(NUM_COLUMNS));
+        myXML.setMap(CiftiXML::ALONG_COLUMN, CiftiSeriesMap(NUM_ROWS));
+        CiftiFile writer;
+        writer.setWritingFile(fileName);
+        writer.setCiftiXML(myXML);
+        vector<float> scratchRow(NUM_COLUMNS);
+        for (int64_t i = 0; i < NUM_ROWS; ++i)
+        {
+            for (int64_t j = 0; j < NUM_COLUMNS; ++j)
+            {
+                scratchRow[j] = rowCacheTestValue(i, j);
+            }
+            writer.setRow(scratchRow.data(), i);
+        }
+    }
+    {//scope so the file gets closed before removing it
+        CiftiFile onDisk(fileName);
+        if (onDisk.isInMemory())
+        {
+            setFailed("test file was read into memory, so its rows would not be cached");
+        } else {
+            {//room for 4 rows, least recently used is removed first
+                ConnectivityMatrixRowCache rowCache(4 * ROW_BYTES);
+                for (int64_t i = 0; i < 4; ++i)
+                {
+                    checkRow(rowCache, onDisk, i, false);
+                }
+                checkCounts(rowCache, 4, 0, 4, 0, "after filling the cache");
+                checkRow(rowCache, onDisk, 0, true);//usage order is now 0 3 2 1
+                checkRow(rowCache, onDisk, 4, false);//removes 1
+                checkRow(rowCache, onDisk, 2, true);
+                checkRow(rowCache, onDisk, 3, true);
+                checkRow(rowCache, onDisk, 0, true);//usage order is now 0 3 2 4
+                checkRow(rowCache, onDisk, 1, false);//removes 4
+                checkRow(rowCache, onDisk, 4, false);//removes 2
+                checkRow(rowCache, onDisk, 3, true);
+                checkRow(rowCache, onDisk, 2, false);//removes 0
+                checkRow(rowCache, onDisk, 0, false);//removes 1
+                checkCounts(rowCache, 4, 5, 9, 0, "after removing rows");
+                
+                rowCache.clear();
+                checkCounts(rowCache, 0, 0, 0, 0, "after clear");
+                const int64_t prefetchList[] = { 10, 11, 12, 13, 14 };//only half of the cache is prefetched, so 10 and 11
+                rowCache.prefetchRows(&onDisk, vector<int64_t>(prefetchList, prefetchList + 5));
+                rowCache.waitForPrefetching();
+                checkCounts(rowCache, 2, 0, 0, 2, "after prefetching");
+                checkRow(rowCache, onDisk, 10, true);
+                checkRow(rowCache, onDisk, 11, true);
+                checkRow(rowCache, onDisk, 12, false);
+                const int64_t cachedFirst[] = { 12, 12, 15, 16 };//12 is already cached, and duplicates are skipped
+                rowCache.prefetchRows(&onDisk, vector<int64_t>(cachedFirst, cachedFirst + 4));
+                rowCache.waitForPrefetching();
+                checkCounts(rowCache, 4, 2, 1, 4, "after prefetching past cached rows");
+                checkRow(rowCache, onDisk, 15, true);
+                checkRow(rowCache, onDisk, 16, true);
+            }
+            {//rows larger than the cache are never cached
+                ConnectivityMatrixRowCache tinyCache(ROW_BYTES - 1);
+                checkRow(tinyCache, onDisk, 0, false);
+                checkRow(tinyCache, onDisk, 0, false);
+                checkCounts(tinyCache, 0, 0, 2, 0, "with a cache smaller than a row");
+            }
+            {//room to prefetch every row
+                vector<int64_t> allRows(NUM_ROWS);
+                for (int64_t i = 0; i < NUM_ROWS; ++i)
+                {
+                    allRows[i] = i;
+                }
+                ConnectivityMatrixRowCache bigCache(2 * NUM_ROWS * ROW_BYTES);
+                bigCache.prefetchRows(&onDisk, allRows);
+                bigCache.clear();//stops the prefetch thread before removing rows, so nothing is added afterwards
+                bigCache.waitForPrefetching();
+                checkCounts(bigCache, 0, 0, 0, 0, "after cancelling prefetching with clear");
+                bigCache.prefetchRows(&onDisk, allRows);
+                bigCache.prefetchRows(&onDisk, vector<int64_t>(1, NUM_ROWS - 1));//cancels the first request, then queues the last row if it isn't cached yet
+                bigCache.waitForPrefetching();
+                int64_t prefetched = bigCache.getNumberOfPrefetchedRows();
+                if (bigCache.getNumberOfCachedRows() != prefetched || prefetched < 1 || prefetched > NUM_ROWS)
+                {
+                    setFailed("after replacing a prefetch request, cache has " + AString::number(bigCache.getNumberOfCachedRows()) + " rows and " +
+                              AString::number(prefetched) + " prefetched rows");
+                }
+                checkRow(bigCache, onDisk, NUM_ROWS - 1, true);
+                for (int64_t i = 0; i < NUM_ROWS - 1; ++i)
+                {//rows from the cancelled request may or may not have been read, but must have the right values
+                    vector<float> row(NUM_COLUMNS);
+                    bigCache.getRow(&onDisk, row.data(), i);
+                    if (row[NUM_COLUMNS - 1] != rowCacheTestValue(i, NUM_COLUMNS - 1)) setFailed("row " + AString::number(i) + " has wrong values after cancelled prefetching");
+                }
+                checkCounts(bigCache, NUM_ROWS, prefetched, NUM_ROWS - prefetched, prefetched, "after reading every row");
+                bigCache.prefetchRows(&onDisk, allRows);//nothing to read, all rows are cached
+                bigCache.clear();
+            }
+            {//destroying the cache while prefetching must stop the thread
+                ConnectivityMatrixRowCache abandonedCache(2 * NUM_ROWS * ROW_BYTES);
+                abandonedCache.prefetchRows(&onDisk, vector<int64_t>(1, 0));
+            }
+        }
+    }
+    QFile::remove(fileName);
+}
@@ -0,0 +1,154 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "DenseDynamicCorrelationTest.h"
+
+#include "CiftiBrainordinateDataSeriesFile.h"
+#include "CiftiConnectivityMatrixDenseDynamicFile.h"
+#include "CiftiFile.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int NUM_ROWS = 133, NUM_TIME_POINTS = 301;//odd sizes to exercise the kernel edges
+    const int CONSTANT_ROW = 5, NAN_ROW = 70;
+    
+    //straightforward double precision pearson correlation, zero when either row does not vary or is not finite, like the dense dynamic file
+    double referenceCorrelation(const vector<float>& row1, const vector<float>& row2)
+    {
+        double mean1 = 0.0, mean2 = 0.0;
+        for (int i = 0; i < NUM_TIME_POINTS; ++i)
+        {
+            mean1 += row1[i];
+            mean2 += row2[i];
+        }
+        mean1 /= NUM_TIME_POINTS;
+        mean2 /= NUM_TIME_POINTS;
+        double crossSum = 0.0, sqr1 = 0.0, sqr2 = 0.0;
+        for (int i = 0; i < NUM_TIME_POINTS; ++i)
+        {
+            double val1 = row1[i] - mean1, val2 = row2[i] - mean2;
+            crossSum += val1 * val2;
+            sqr1 += val1 * val1;
+            sqr2 += val2 * val2;
+        }
+        if (!(sqr1 > 0.0 && sqr2 > 0.0 && sqr1 * sqr2 < numeric_limits<double>::infinity())) return 0.0;//also false for NaN
+        return crossSum / sqrt(sqr1 * sqr2);
+    }
+}
+
+DenseDynamicCorrelationTest::DenseDynamicCorrelationTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void DenseDynamicCorrelationTest::execute()
+{
+    vector<vector<float> > inData(NUM_ROWS, vector<float>(NUM_TIME_POINTS));
+    for (int i = 0; i < NUM_ROWS; ++i)
+    {
+        for (int j = 0; j < NUM_TIME_POINTS; ++j)
+        {//shared signal with varying strength gives a spread of correlations, not just near zero
+            inData[i][j] = sin(j * 0.13f) * (i % 9 - 4) + sin(i * 0.37f + j * 0.11f) + rand() / (float)RAND_MAX + i % 7;
+        }
+    }
+    inData[CONSTANT_ROW].assign(NUM_TIME_POINTS, 3.0f);
+    inData[NAN_ROW][NUM_TIME_POINTS / 2] = numeric_limits<float>::quiet_NaN();
+    AString fileName = QDir::tempPath() + "/wb_dense_dynamic_test.dtseries.nii";
+    {
+        CiftiXML myXML;
+        myXML.setNumberOfDimensions(2);
+        myXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(NUM_TIME_POINTS));
+        CiftiBrainModelsMap myModels;
+        myModels.addSurfaceModel(NUM_ROWS, StructureEnum::CORTEX_LEFT);
+        myXML.setMap(CiftiXML::ALONG_COLUMN, myModels);
+        CiftiFile writer;
+        writer.setWritingFile(fileName);
+        writer.setCiftiXML(myXML);
+        for (int i = 0; i < NUM_ROWS; ++i)
+        {
+            writer.setRow(inData[i].data(), i);
+        }
+    }
+    {//scope so the file gets closed before removing it
+        CiftiBrainordinateDataSeriesFile seriesFile;
+        seriesFile.readFile(fileName);
+        CiftiConnectivityMatrixDenseDynamicFile* denseDynamicFile = seriesFile.getConnectivityMatrixDenseDynamicFile();
+        const int checkRows[] = { 0, CONSTANT_ROW, NAN_ROW, NUM_ROWS - 2, NUM_ROWS - 1 };
+        const int NUM_CHECK_ROWS = sizeof(checkRows) / sizeof(checkRows[0]);
+        const char* storageNames[2] = { "float", "bfloat16" };
+        const int64_t maximumFloatBytes[2] = { (int64_t)NUM_ROWS * NUM_TIME_POINTS * sizeof(float), 0 };
+        const float tolerances[2] = { 1e-5f, 1e-2f };//bfloat16 has 8 significant bits
+        vector<vector<float> > floatRows(NUM_CHECK_ROWS);
+        bool bfloat16Differs = false;
+        for (int s = 0; s < 2; ++s)
+        {
+            denseDynamicFile->setMaximumFloatDataBytes(maximumFloatBytes[s]);
+            denseDynamicFile->updateAfterReading(seriesFile.getCiftiFile());
+            if (!denseDynamicFile->isDataValid())
+            {
+                setFailed(AString("dense dynamic data is not valid with ") + storageNames[s] + " storage");
+                continue;
+            }
+            for (int c = 0; c < NUM_CHECK_ROWS; ++c)
+            {
+                const int i = checkRows[c];
+                denseDynamicFile->loadDataForRowIndex(i);
+                vector<float> loadedRow;
+                denseDynamicFile->getMapData(0, loadedRow);
+                if ((int)loadedRow.size() != NUM_ROWS)
+                {
+                    setFailed(AString("loaded row ") + AString::number(i) + " has wrong length with " + storageNames[s] + " storage");
+                    continue;
+                }
+                for (int j = 0; j < NUM_ROWS; ++j)
+                {
+                    double expected = (i == j ? 1.0 : referenceCorrelation(inData[i], inData[j]));
+                    if (!(fabs(loadedRow[j] - expected) <= tolerances[s]))//also catches NaN
+                    {
+                        setFailed(AString("mismatch with ") + storageNames[s] + " storage at row " + AString::number(i) + ", column " + AString::number(j) +
+                                  ": expected " + AString::number(expected) + ", got " + AString::number(loadedRow[j]));
+                        break;
+                    }
+                }
+                if (s == 0)
+                {
+                    floatRows[c] = loadedRow;
+                } else if (loadedRow != floatRows[c]) {
+                    bfloat16Differs = true;
+                }
+            }
+        }
+        if (!bfloat16Differs)
+        {
+            setFailed("bfloat16 storage gave the same values as float storage, so it was probably not used");
+        }
+    }
+    QFile::remove(fileName);
+}
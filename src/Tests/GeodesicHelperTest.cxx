@@ -19,10 +19,20 @@
 /*LICENSE_END*/
 #include "GeodesicHelperTest.h"
 
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "AlgorithmSurfaceGeodesicDistanceAllToAll.h"
+#include "CaretException.h"
+#include "CaretOMP.h"
+#include "CiftiFile.h"
+#include "ElapsedTimer.h"
 #include "GeodesicHelper.h"
+#include "MetricFile.h"
 #include "SurfaceFile.h"
+#include "TopologyHelper.h"
 
 #include <cstdlib>
+#include <iostream>
+#include <limits>
 
 using namespace caret;
 using namespace std;
@@ -97,3 +107,205 @@ void GeodesicHelperTest::execute()
         checkNodeLists(this, "Comparing normal to quad areas, getPathFollowingData", nodesNorm, nodesQuad);
     }
 }
+
+GeodesicHelperBatchTest::GeodesicHelperBatchTest(const AString& identifier): TestInterface(identifier)
+{
+}
+
+namespace
+{
+    class StoreReceiver : public GeodesicBatchReceiver
+    {
+    public:
+        vector<vector<int32_t> > m_nodes;
+        vector<vector<float> > m_dists;
+        vector<int> m_calls;
+        StoreReceiver(const int64_t& numRoots) : m_nodes(numRoots), m_dists(numRoots), m_calls(numRoots, 0)
+        {
+        }
+        void receive(const int64_t& rootIndex, const vector<int32_t>& nodes, const vector<float>& dists)
+        {//each root index is only received once, so no locking needed
+            m_nodes[rootIndex] = nodes;
+            m_dists[rootIndex] = dists;
+            ++m_calls[rootIndex];
+        }
+    };
+    
+    void checkBatch(GeodesicHelperBatchTest* theTest, const AString& condition, GeodesicHelper* batchHelp, GeodesicHelper* serialHelp, const vector<int32_t>& roots)
+    {
+        const float limits[] = { 10.0f, 40.0f, numeric_limits<float>::max(), -1.0f };
+        vector<int32_t> nodes;
+        vector<float> dists;
+        for (int l = 0; l < 4; ++l)
+        {
+            for (int smooth = 0; smooth < 2; ++smooth)
+            {
+                AString subCondition = condition + ", limit " + AString::number(limits[l]) + (smooth ? ", smooth" : ", naive");
+                StoreReceiver myReceiver((int64_t)roots.size());
+                batchHelp->getNodesToGeoDistBatch(roots, limits[l], &myReceiver, smooth != 0);
+                for (size_t i = 0; i < roots.size(); ++i)
+                {
+                    if (myReceiver.m_calls[i] != 1)
+                    {
+                        theTest->setFailed(subCondition + ", root index " + AString::number(i) + " received " + AString::number(myReceiver.m_calls[i]) + " times");
+                        return;
+                    }
+                    serialHelp->getNodesToGeoDist(roots[i], limits[l], nodes, dists, smooth != 0);
+                    if (myReceiver.m_nodes[i] != nodes || myReceiver.m_dists[i] != dists)
+                    {
+                        theTest->setFailed(subCondition + ", batch result differs from getNodesToGeoDist for root " + AString::number(roots[i]));
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    
+    void checkAllToAll(GeodesicHelperBatchTest* theTest, const AString& condition, const CiftiFile& myCifti, GeodesicHelper* serialHelp,
+                       const vector<int32_t>& roiNodes, const int32_t& numNodes, const float& limit)
+    {
+        int64_t numRoi = (int64_t)roiNodes.size();
+        const vector<int64_t>& dims = myCifti.getDimensions();
+        if (dims.size() != 2 || dims[0] != numRoi || dims[1] != numRoi)
+        {
+            theTest->setFailed(condition + ", output has wrong dimensions");
+            return;
+        }
+        vector<int64_t> nodeToIndex(numNodes, -1);
+        for (int64_t i = 0; i < numRoi; ++i)
+        {
+            nodeToIndex[roiNodes[i]] = i;
+        }
+        vector<float> row(numRoi), expected(numRoi);
+        vector<int32_t> nodes;
+        vector<float> dists;
+        for (int64_t i = 0; i < numRoi; ++i)
+        {
+            serialHelp->getNodesToGeoDist(roiNodes[i], (limit < 0.0f ? numeric_limits<float>::max() : limit), nodes, dists);
+            expected.assign(numRoi, -1.0f);
+            for (size_t j = 0; j < nodes.size(); ++j)
+            {
+                if (nodeToIndex[nodes[j]] >= 0) expected[nodeToIndex[nodes[j]]] = dists[j];
+            }
+            myCifti.getRow(row.data(), i);
+            if (row != expected)
+            {
+                theTest->setFailed(condition + ", row " + AString::number(i) + " differs from getNodesToGeoDist");
+                return;
+            }
+        }
+    }
+}
+
+void GeodesicHelperBatchTest::execute()
+{
+    SurfaceFile mySurf;
+    AlgorithmSurfaceCreateSphere(NULL, 4000, &mySurf);
+    mySurf.setStructure(StructureEnum::CORTEX_LEFT);
+    int32_t numNodes = mySurf.getNumberOfNodes();
+    CaretPointer<GeodesicHelper> batchHelp = mySurf.getGeodesicHelper();
+    CaretPointer<GeodesicHelper> serialHelp = mySurf.getGeodesicHelper();
+    const int NUM_ROOTS = 30;
+    vector<int32_t> roots;
+    for (int i = 0; i < NUM_ROOTS; ++i)
+    {
+        roots.push_back(rand() % numNodes);
+    }
+    roots.push_back(roots[0]);//a repeated root must get its own result
+    checkBatch(this, "default threads", batchHelp, serialHelp, roots);
+#ifdef CARET_OMP
+    int oldThreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    checkBatch(this, "one thread", batchHelp, serialHelp, roots);
+    omp_set_num_threads(oldThreads);
+#endif
+    vector<int32_t> badRoots(1, numNodes);
+    StoreReceiver badReceiver(1);
+    bool threw = false;
+    try
+    {
+        batchHelp->getNodesToGeoDistBatch(badRoots, 10.0f, &badReceiver);
+    } catch (CaretException&) {
+        threw = true;
+    }
+    if (!threw) setFailed("invalid root in batch didn't throw");
+    if (failed()) return;
+    SurfaceFile smallSurf;
+    AlgorithmSurfaceCreateSphere(NULL, 1500, &smallSurf);
+    smallSurf.setStructure(StructureEnum::CORTEX_LEFT);
+    int32_t smallNodes = smallSurf.getNumberOfNodes();
+    CaretPointer<GeodesicHelper> smallHelp = smallSurf.getGeodesicHelper();
+    vector<int32_t> allNodes(smallNodes);
+    for (int32_t i = 0; i < smallNodes; ++i)
+    {
+        allNodes[i] = i;
+    }
+    CiftiFile fullOut;
+    AlgorithmSurfaceGeodesicDistanceAllToAll(NULL, &smallSurf, &fullOut);
+    checkAllToAll(this, "all-to-all without roi or limit", fullOut, smallHelp, allNodes, smallNodes, -1.0f);
+    MetricFile roiMetric;
+    roiMetric.setNumberOfNodesAndColumns(smallNodes, 1);
+    roiMetric.setStructure(StructureEnum::CORTEX_LEFT);
+    vector<int32_t> roiNodes;
+    for (int32_t i = 0; i < smallNodes; ++i)
+    {
+        bool inside = (smallSurf.getCoordinate(i)[2] > 0.0f);
+        roiMetric.setValue(i, 0, inside ? 1.0f : 0.0f);
+        if (inside) roiNodes.push_back(i);
+    }
+    CiftiFile roiOut;
+    const float LIMIT = 30.0f;
+    AlgorithmSurfaceGeodesicDistanceAllToAll(NULL, &smallSurf, &roiOut, &roiMetric, LIMIT);
+    checkAllToAll(this, "all-to-all with roi and limit", roiOut, smallHelp, roiNodes, smallNodes, LIMIT);
+}
+
+GeodesicHelperBenchmark::GeodesicHelperBenchmark(const AString& identifier): TestInterface(identifier)
+{
+}
+
+void GeodesicHelperBenchmark::execute()
+{
+    SurfaceFile mySurf;
+    mySurf.readFile(m_default_path + "/gifti/Human.PALS_B12.LEFT_AVG_B1-12.FIDUCIAL_FLIRT.clean.73730.surf.gii");
+    int numNodes = mySurf.getNumberOfNodes();
+    const int CONSTRUCT_REPEATS = 10;
+    ElapsedTimer myTimer;
+    myTimer.start();
+    for (int i = 0; i < CONSTRUCT_REPEATS; ++i)
+    {
+        CaretPointer<TopologyHelperBase> topoBase(new TopologyHelperBase(&mySurf));
+        CaretPointer<TopologyHelperBase> topoBaseSorted(new TopologyHelperBase(&mySurf, true));
+    }
+    cout << "topology helper construction, unsorted and sorted: " << (myTimer.getElapsedTimeSeconds() / CONSTRUCT_REPEATS) << " seconds" << endl;
+    CaretPointer<GeodesicHelperBase> geoBase;
+    myTimer.start();
+    for (int i = 0; i < CONSTRUCT_REPEATS; ++i)
+    {
+        geoBase.grabNew(new GeodesicHelperBase(&mySurf));
+    }
+    cout << "geodesic helper construction: " << (myTimer.getElapsedTimeSeconds() / CONSTRUCT_REPEATS) << " seconds" << endl;
+    GeodesicHelper myHelp(geoBase);
+    vector<int32_t> nodes;
+    vector<float> dists;
+    const int NUM_ROOTS = 2000;
+    const float maxDists[] = { 5.0f, 10.0f, 20.0f };
+    for (int d = 0; d < 3; ++d)
+    {
+        for (int smooth = 0; smooth < 2; ++smooth)
+        {
+            srand(0);//same roots every time
+            myTimer.start();
+            for (int i = 0; i < NUM_ROOTS; ++i)
+            {
+                myHelp.getNodesToGeoDist(rand() % numNodes, maxDists[d], nodes, dists, smooth != 0);
+                if (nodes.empty())
+                {
+                    setFailed("getNodesToGeoDist didn't find the root node");
+                    return;
+                }
+            }
+            double seconds = myTimer.getElapsedTimeSeconds();
+            cout << "getNodesToGeoDist to " << maxDists[d] << "mm, " << (smooth ? "smooth" : "naive") << ": " << (NUM_ROOTS / seconds) << " roots per second" << endl;
+        }
+    }
+}
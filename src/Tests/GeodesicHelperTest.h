@@ -31,5 +31,20 @@ namespace caret {
         virtual void execute();
     };
 
+    class GeodesicHelperBatchTest : public TestInterface
+    {
+    public:
+        GeodesicHelperBatchTest(const AString& identifier);
+        virtual void execute();
+    };
+
+    ///only run when named, prints helper construction times and getNodesToGeoDist throughput on the test surface
+    class GeodesicHelperBenchmark : public TestInterface
+    {
+    public:
+        GeodesicHelperBenchmark(const AString& identifier);
+        virtual void execute();
+    };
+
 }
 #endif //__GEODESIC_HELPER_TEST_H__
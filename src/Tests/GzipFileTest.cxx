@@ -0,0 +1,312 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "GzipFileTest.h"
+
+#include "CaretBinaryFile.h"
+#include "CaretException.h"
+
+#include <QDir>
+#include <QFile>
+#include "zlib.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //compressible, but not trivially, so that there are many deflate blocks
+    void makeData(vector<unsigned char>& data, const int64_t& size)
+    {
+        data.resize(size);
+        for (int64_t i = 0; i < size; ++i)
+        {
+            data[i] = (unsigned char)(i % 7 == 0 ? rand() : i / 1000 + rand() % 4);
+        }
+    }
+    
+    void writeGzip(const AString& filename, const vector<unsigned char>& data)
+    {
+        CaretBinaryFile outFile(filename, CaretBinaryFile::WRITE_TRUNCATE);
+        outFile.write(data.data(), data.size());
+    }
+    
+    //a single ordinary gzip member, like files from gzip or other programs, so seeking back needs access points with saved windows
+    bool writePlainGzip(const AString& filename, const vector<unsigned char>& data)
+    {
+        gzFile outFile = gzopen(filename.toLocal8Bit().constData(), "wb");
+        if (outFile == NULL) return false;
+        const int64_t WRITE_SIZE = 1<<20;
+        bool ok = true;
+        for (int64_t done = 0; done < (int64_t)data.size(); done += WRITE_SIZE)
+        {
+            int toWrite = (int)min(WRITE_SIZE, (int64_t)data.size() - done);
+            if (gzwrite(outFile, data.data() + done, toWrite) != toWrite)
+            {
+                ok = false;
+                break;
+            }
+        }
+        if (gzclose(outFile) != Z_OK) ok = false;
+        return ok;
+    }
+    
+    void putLE32(unsigned char* out, const uint32_t& value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out[i] = (unsigned char)(value >> (8 * i));
+        }
+    }
+    
+    //one member with the same "WB" size subfield our writer uses, but of any size
+    bool makeTaggedMember(const vector<unsigned char>& data, vector<unsigned char>& memberOut)
+    {
+        const int64_t HEADER_SIZE = 20;
+        z_stream deflStrm;
+        deflStrm.zalloc = Z_NULL;
+        deflStrm.zfree = Z_NULL;
+        deflStrm.opaque = Z_NULL;
+        if (deflateInit2(&deflStrm, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+        int64_t bound = deflateBound(&deflStrm, data.size());
+        memberOut.resize(HEADER_SIZE + bound + 8);
+        deflStrm.next_in = (Bytef*)data.data();
+        deflStrm.avail_in = data.size();
+        deflStrm.next_out = memberOut.data() + HEADER_SIZE;
+        deflStrm.avail_out = bound;
+        int ret = deflate(&deflStrm, Z_FINISH);
+        int64_t deflatedSize = deflStrm.total_out;
+        deflateEnd(&deflStrm);
+        if (ret != Z_STREAM_END) return false;
+        int64_t memberSize = HEADER_SIZE + deflatedSize + 8;
+        const unsigned char header[16] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 255, 8, 0, 'W', 'B', 4, 0 };
+        memcpy(memberOut.data(), header, 16);
+        putLE32(memberOut.data() + 16, memberSize);
+        putLE32(memberOut.data() + HEADER_SIZE + deflatedSize, crc32(crc32(0, Z_NULL, 0), data.data(), data.size()));
+        putLE32(memberOut.data() + HEADER_SIZE + deflatedSize + 4, data.size());
+        memberOut.resize(memberSize);
+        return true;
+    }
+}
+
+GzipFileTest::GzipFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void GzipFileTest::execute()
+{
+    const int64_t SIZE1 = 20000000, SIZE2 = 7000017;//several index spans, and concatenate a second gzip member with an odd size
+    vector<unsigned char> data1, data2, expected;
+    makeData(data1, SIZE1);
+    makeData(data2, SIZE2);
+    expected = data1;
+    expected.insert(expected.end(), data2.begin(), data2.end());
+    AString name1 = QDir::tempPath() + "/wb_gzip_test_1.gz", name2 = QDir::tempPath() + "/wb_gzip_test_2.gz", catName = QDir::tempPath() + "/wb_gzip_test_cat.gz";
+    try
+    {
+        writeGzip(name1, data1);
+        writeGzip(name2, data2);
+        {//our writer makes many members in parallel, make sure the result is still a standard gzip file
+            gzFile checkFile = gzopen(name1.toLocal8Bit().constData(), "rb");
+            vector<unsigned char> checkData(SIZE1 + 1);
+            int64_t checkRead = 0;
+            if (checkFile != NULL)
+            {
+                int readret;
+                while ((readret = gzread(checkFile, checkData.data() + checkRead, checkData.size() - checkRead)) > 0) checkRead += readret;
+                gzclose(checkFile);
+            }
+            if (checkRead != SIZE1 || memcmp(checkData.data(), data1.data(), SIZE1) != 0) setFailed("zlib's gzread doesn't agree with what was written");
+        }
+        {
+            QFile in1(name1), in2(name2), catFile(catName);
+            if (!in1.open(QIODevice::ReadOnly) || !in2.open(QIODevice::ReadOnly) || !catFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            {
+                setFailed("unable to open temporary files");
+                return;
+            }
+            catFile.write(in1.readAll());
+            catFile.write(in2.readAll());
+        }
+        QFile::remove(catName + ".gzidx");
+        bool oldCaching = CaretBinaryFile::getGzipIndexCaching();
+        for (int pass = 0; pass < 3; ++pass)
+        {//without caching, building the index cache file, and using the index cache file
+            CaretBinaryFile::setGzipIndexCaching(pass > 0);
+            CaretBinaryFile inFile(catName);
+            vector<unsigned char> buffer;
+            int64_t crossStart = SIZE1 - 100;//forward first, then back from where the index is built, across the member boundary
+            int64_t offsets[] = { 0, crossStart, crossStart, SIZE1 + SIZE2 - 1000, 12345678, 5, SIZE1 + 3 };
+            for (int i = 0; i < (int)(sizeof(offsets) / sizeof(offsets[0])); ++i)
+            {
+                int64_t length = min((int64_t)300000, SIZE1 + SIZE2 - offsets[i]);
+                buffer.resize(length);
+                inFile.seek(offsets[i]);
+                inFile.read(buffer.data(), length);
+                if (inFile.pos() != offsets[i] + length || memcmp(buffer.data(), expected.data() + offsets[i], length) != 0)
+                {
+                    setFailed("wrong data after seeking to " + AString::number(offsets[i]) + " in pass " + AString::number(pass));
+                }
+            }
+            for (int i = 0; i < 100; ++i)
+            {
+                int64_t offset = ((int64_t)rand() * RAND_MAX + rand()) % (SIZE1 + SIZE2);
+                int64_t length = min((int64_t)(rand() % 100000), SIZE1 + SIZE2 - offset);
+                buffer.resize(length);
+                inFile.seek(offset);
+                inFile.read(buffer.data(), length);
+                if (memcmp(buffer.data(), expected.data() + offset, length) != 0)
+                {
+                    setFailed("wrong data after random seek to " + AString::number(offset) + " in pass " + AString::number(pass));
+                    break;
+                }
+            }
+            inFile.seek(SIZE1 + SIZE2 - 10);//reading past the end makes the index complete
+            int64_t numRead = 0;
+            buffer.resize(100);
+            inFile.read(buffer.data(), 100, &numRead);
+            if (numRead != 10) setFailed("wrong number of bytes read at end of file");
+            if (pass == 1 && !QFile::exists(catName + ".gzidx")) setFailed("index cache file was not written");
+        }
+        CaretBinaryFile::setGzipIndexCaching(oldCaching);
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    QFile::remove(name1);
+    QFile::remove(name2);
+    QFile::remove(catName);
+    QFile::remove(catName + ".gzidx");
+    testPlainGzip();
+    testOversizedMember();
+}
+
+void GzipFileTest::testPlainGzip()
+{
+    const int64_t SIZE = 20000000, WINDOW_SIZE = 32768;//about 4 access points in the middle of the member, 4MiB apart
+    vector<unsigned char> data;
+    makeData(data, SIZE);
+    AString name = QDir::tempPath() + "/wb_gzip_test_plain.gz";
+    QFile::remove(name + ".gzidx");
+    try
+    {
+        if (!writePlainGzip(name, data))
+        {
+            setFailed("unable to write plain gzip file");
+            return;
+        }
+        bool oldCaching = CaretBinaryFile::getGzipIndexCaching();
+        for (int pass = 0; pass < 3; ++pass)
+        {//without caching, building the index cache file, and restoring the saved windows from the index cache file
+            CaretBinaryFile::setGzipIndexCaching(pass > 0);
+            CaretBinaryFile inFile(name);
+            vector<unsigned char> buffer(100);
+            int64_t numRead = 0;
+            inFile.seek(SIZE - 10);//reading past the end makes the index complete, so the seeks below go backward
+            inFile.read(buffer.data(), 100, &numRead);
+            if (numRead != 10 || memcmp(buffer.data(), data.data() + SIZE - 10, 10) != 0) setFailed("wrong data at end of plain gzip file in pass " + AString::number(pass));
+            int64_t offsets[] = { SIZE - 1000, 17000000, 4194304 + 1000, 9000001, 100, 12600000, SIZE - 5 };
+            for (int i = 0; i < (int)(sizeof(offsets) / sizeof(offsets[0])); ++i)
+            {
+                int64_t length = min((int64_t)300000, SIZE - offsets[i]);
+                buffer.resize(length);
+                inFile.seek(offsets[i]);
+                inFile.read(buffer.data(), length);
+                if (inFile.pos() != offsets[i] + length || memcmp(buffer.data(), data.data() + offsets[i], length) != 0)
+                {
+                    setFailed("wrong data after seeking to " + AString::number(offsets[i]) + " in plain gzip file in pass " + AString::number(pass));
+                }
+            }
+            if (pass == 1)
+            {
+                QFile indexFile(name + ".gzidx");
+                if (!indexFile.exists() || indexFile.size() < 3 * WINDOW_SIZE)
+                {
+                    setFailed("index cache file for plain gzip file is missing the access point windows");
+                }
+            }
+        }
+        CaretBinaryFile::setGzipIndexCaching(oldCaching);
+    } catch (CaretException& e) {
+        setFailed("caught exception with plain gzip file: " + e.whatString());
+    }
+    QFile::remove(name);
+    QFile::remove(name + ".gzidx");
+}
+
+void GzipFileTest::testOversizedMember()
+{
+    const int64_t BIG_SIZE = (1<<26) + 3000001, SMALL_SIZE = 3000000;//a tagged member too large for the parallel batch, followed by ordinary batched members
+    vector<unsigned char> bigData, smallData, bigMember, expected;
+    makeData(bigData, BIG_SIZE);
+    makeData(smallData, SMALL_SIZE);
+    expected = bigData;
+    expected.insert(expected.end(), smallData.begin(), smallData.end());
+    const int64_t TOTAL_SIZE = BIG_SIZE + SMALL_SIZE;
+    AString smallName = QDir::tempPath() + "/wb_gzip_test_small.gz", name = QDir::tempPath() + "/wb_gzip_test_oversized.gz";
+    try
+    {
+        if (!makeTaggedMember(bigData, bigMember))
+        {
+            setFailed("unable to compress oversized member");
+            return;
+        }
+        writeGzip(smallName, smallData);
+        {
+            QFile smallFile(smallName), outFile(name);
+            if (!smallFile.open(QIODevice::ReadOnly) || !outFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            {
+                setFailed("unable to open temporary files");
+                return;
+            }
+            outFile.write((const char*)bigMember.data(), bigMember.size());
+            outFile.write(smallFile.readAll());
+        }
+        CaretBinaryFile inFile(name);
+        vector<unsigned char> buffer(TOTAL_SIZE + 100);
+        int64_t numRead = 0;
+        inFile.read(buffer.data(), buffer.size(), &numRead);
+        if (numRead != TOTAL_SIZE || memcmp(buffer.data(), expected.data(), TOTAL_SIZE) != 0) setFailed("wrong data reading file with oversized member");
+        int64_t offsets[] = { 1000, BIG_SIZE - 100, 50000000, BIG_SIZE + 1500000, 3 };//backward, then across into the batched members, then forward over the big member
+        for (int i = 0; i < (int)(sizeof(offsets) / sizeof(offsets[0])); ++i)
+        {
+            int64_t length = min((int64_t)300000, TOTAL_SIZE - offsets[i]);
+            inFile.seek(offsets[i]);
+            inFile.read(buffer.data(), length);
+            if (inFile.pos() != offsets[i] + length || memcmp(buffer.data(), expected.data() + offsets[i], length) != 0)
+            {
+                setFailed("wrong data after seeking to " + AString::number(offsets[i]) + " in file with oversized member");
+            }
+        }
+        CaretBinaryFile seekFile(name);
+        seekFile.seek(BIG_SIZE + 1000);//forward from the start of a fresh file, through the oversized member
+        seekFile.read(buffer.data(), 1000);
+        if (memcmp(buffer.data(), expected.data() + BIG_SIZE + 1000, 1000) != 0) setFailed("wrong data after seeking past oversized member");
+    } catch (CaretException& e) {
+        setFailed("caught exception with oversized member: " + e.whatString());
+    }
+    QFile::remove(smallName);
+    QFile::remove(name);
+    QFile::remove(name + ".gzidx");
+}
@@ -22,6 +22,7 @@
 #include "CaretMathExpression.h"
 
 #include <cmath>
+#include <cstdlib>
 
 using namespace caret;
 using namespace std;
@@ -55,4 +56,52 @@ void MathExpressionTest::execute()
     {
         setFailed("output value incorrect, expected " + AString::number(correctresult) + ", got " + AString::number(testresult));
     }
+    //array evaluation must give exactly the same results as evaluating one element at a time
+    const char* arrayExprs[] = { "x + y * z - x / y", "sin(x) + cos(y) * tan(z) + asin(x / 10) + acos(y / 10) + atan(z)", "sinh(x) - cosh(y) + tanh(z)",
+                                 "asinh(x) + acosh(abs(y) + 1) + atanh(z / 11)", "ln(x) + exp(y / 3) + log(abs(z)) + sqrt(x)",
+                                 "abs(y) + floor(z) + round(x) + ceil(y)", "atan2(x, y) + min(x, z) + max(y, z) + mod(x, y) + mod(x, 0) + clamp(x, y, z)",
+                                 "x > y", "x < y", "x >= y", "x <= y > z", "x == y", "x != y == z", "x || y && !z", "-x ^ 2 + x ^ -y", "PI * x / 0" };
+    const int numArrayExprs = sizeof(arrayExprs) / sizeof(arrayExprs[0]);
+    const int ARRAY_LENGTH = 3 * 4096 + 17;//multiple blocks, plus a partial one
+    vector<float> xArray(ARRAY_LENGTH), yArray(ARRAY_LENGTH), zArray(ARRAY_LENGTH), arrayOut(ARRAY_LENGTH);
+    for (int i = 0; i < ARRAY_LENGTH; ++i)
+    {
+        xArray[i] = (rand() % 2001 - 1000) / 100.0f;
+        yArray[i] = (i % 7 == 0 ? xArray[i] : (rand() % 2001 - 1000) / 100.0f);//exercise equality
+        zArray[i] = (rand() % 21 - 10);
+    }
+    for (int e = 0; e < numArrayExprs; ++e)
+    {
+        CaretMathExpression arrayExpr(arrayExprs[e]);
+        vector<AString> arrayVarNames = arrayExpr.getVarNames();
+        int numVars = (int)arrayVarNames.size();
+        vector<const float*> varData(numVars);
+        vector<int64_t> varStrides(numVars, 1);
+        for (int v = 0; v < numVars; ++v)
+        {
+            if (arrayVarNames[v] == "x") varData[v] = xArray.data();
+            if (arrayVarNames[v] == "y") varData[v] = yArray.data();
+            if (arrayVarNames[v] == "z")
+            {
+                varData[v] = zArray.data();
+                varStrides[v] = 0;//also test broadcasting
+            }
+        }
+        arrayExpr.evaluate(varData, varStrides, ARRAY_LENGTH, arrayOut.data());
+        vector<float> scalarVars(numVars);
+        for (int i = 0; i < ARRAY_LENGTH; ++i)
+        {
+            for (int v = 0; v < numVars; ++v)
+            {
+                scalarVars[v] = varData[v][i * varStrides[v]];
+            }
+            float expected = (float)arrayExpr.evaluate(scalarVars);
+            if (expected != arrayOut[i] && (expected == expected || arrayOut[i] == arrayOut[i]))//both NaN is a match
+            {
+                setFailed(AString("array evaluation of '") + arrayExprs[e] + "' differs at element " + AString::number(i) + ", expected " +
+                          AString::number(expected) + ", got " + AString::number(arrayOut[i]));
+                break;
+            }
+        }
+    }
 }
@@ -0,0 +1,140 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "MetricSmoothingTest.h"
+
+#include "CaretPointer.h"
+#include "MetricFile.h"
+#include "MetricSmoothingObject.h"
+#include "SurfaceFile.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    bool sameValues(const MetricFile& first, const MetricFile& second)
+    {
+        if (first.getNumberOfNodes() != second.getNumberOfNodes() || first.getNumberOfColumns() != second.getNumberOfColumns()) return false;
+        for (int c = 0; c < first.getNumberOfColumns(); ++c)
+        {
+            const float* firstData = first.getValuePointerForColumn(c), *secondData = second.getValuePointerForColumn(c);
+            for (int32_t i = 0; i < first.getNumberOfNodes(); ++i)
+            {
+                if (firstData[i] != secondData[i]) return false;
+            }
+        }
+        return true;
+    }
+    
+    //the multi-column path may use different instructions (fused multiply-add, etc), so allow for rounding
+    bool closeValues(const MetricFile& first, const MetricFile& second)
+    {
+        if (first.getNumberOfNodes() != second.getNumberOfNodes() || first.getNumberOfColumns() != second.getNumberOfColumns()) return false;
+        for (int c = 0; c < first.getNumberOfColumns(); ++c)
+        {
+            const float* firstData = first.getValuePointerForColumn(c), *secondData = second.getValuePointerForColumn(c);
+            for (int32_t i = 0; i < first.getNumberOfNodes(); ++i)
+            {
+                if (abs(firstData[i] - secondData[i]) > 1e-5f * max(1.0f, abs(firstData[i]))) return false;
+            }
+        }
+        return true;
+    }
+    
+    void removeCacheFiles(const AString& cacheDir)
+    {
+        QDir myDir(cacheDir);
+        QStringList cacheFiles = myDir.entryList(QStringList() << "*.wbsmooth");
+        for (int i = 0; i < cacheFiles.size(); ++i)
+        {
+            myDir.remove(cacheFiles[i]);
+        }
+    }
+}
+
+MetricSmoothingTest::MetricSmoothingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void MetricSmoothingTest::execute()
+{
+    SurfaceFile mySurf;
+    mySurf.readFile(m_default_path + "/gifti/Human.PALS_B12.LEFT_AVG_B1-12.FIDUCIAL_FLIRT.clean.73730.surf.gii");
+    int32_t numNodes = mySurf.getNumberOfNodes();
+    const int NUM_COLS = 70;//more than one block of columns in smoothMetric
+    MetricFile input, roi;
+    input.setNumberOfNodesAndColumns(numNodes, NUM_COLS);
+    roi.setNumberOfNodesAndColumns(numNodes, 1);
+    for (int32_t i = 0; i < numNodes; ++i)
+    {
+        for (int c = 0; c < NUM_COLS; ++c)
+        {
+            input.setValue(i, c, (rand() % 4 == 0 ? 0.0f : ((float)rand()) / RAND_MAX));//some zeros for fixZeros
+        }
+        roi.setValue(i, 0, (mySurf.getCoordinate(i)[1] > 0.0f ? 1.0f : 0.0f));
+    }
+    AString cacheDir = QDir::tempPath() + "/wb_smoothing_cache_test";
+    AString oldCacheDir = MetricSmoothingObject::getWeightCacheDirectory();
+    const MetricSmoothingObject::Method methods[] = { MetricSmoothingObject::GEO_GAUSS_AREA, MetricSmoothingObject::GEO_GAUSS_EQUAL, MetricSmoothingObject::GEO_GAUSS };
+    const float KERNEL = 2.0f;
+    removeCacheFiles(cacheDir);
+    for (int m = 0; m < 3; ++m)
+    {
+        for (int useRoi = 0; useRoi < 2; ++useRoi)
+        {
+            const MetricFile* roiPtr = (useRoi ? &roi : NULL);
+            AString condition = "method " + AString::number(m) + (useRoi ? " with roi" : " without roi");
+            MetricFile expected, written, loaded;
+            MetricSmoothingObject::setWeightCacheDirectory("");
+            MetricSmoothingObject uncached(&mySurf, KERNEL, roiPtr, methods[m]);
+            uncached.smoothMetric(&input, &expected);
+            for (int fixZeros = 0; fixZeros < 2; ++fixZeros)
+            {
+                MetricFile allColumns, byColumn;
+                uncached.smoothMetric(&input, &allColumns, roiPtr, fixZeros);
+                byColumn.setNumberOfNodesAndColumns(numNodes, NUM_COLS);
+                for (int c = 0; c < NUM_COLS; ++c)
+                {
+                    uncached.smoothColumn(&input, c, &byColumn, c, roiPtr, 0, fixZeros);
+                }
+                if (!closeValues(allColumns, byColumn)) setFailed(condition + (fixZeros ? ", fixing zeros" : "") + ", smoothing all columns together doesn't match smoothing each column");
+            }
+            MetricSmoothingObject::setWeightCacheDirectory(cacheDir);
+            MetricSmoothingObject(&mySurf, KERNEL, roiPtr, methods[m]).smoothMetric(&input, &written);
+            int numCacheFiles = QDir(cacheDir).entryList(QStringList() << "*.wbsmooth").size();
+            if (numCacheFiles != m * 2 + useRoi + 1) setFailed(condition + ", expected a new cache file, found " + AString::number(numCacheFiles) + " total");
+            MetricSmoothingObject(&mySurf, KERNEL, roiPtr, methods[m]).smoothMetric(&input, &loaded);
+            if (!sameValues(expected, written)) setFailed(condition + ", smoothing while writing the cache gave different values");
+            if (!sameValues(expected, loaded)) setFailed(condition + ", smoothing with cached weights gave different values");
+        }
+    }
+    removeCacheFiles(cacheDir);
+    QDir().rmdir(cacheDir);
+    MetricSmoothingObject::setWeightCacheDirectory(oldCacheDir);
+}
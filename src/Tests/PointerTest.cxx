@@ -18,11 +18,12 @@
  */
 /*LICENSE_END*/
 #include "PointerTest.h"
-//#include <iostream>
+#include <iostream>
 
 #include "CaretPointer.h"
 #include "CaretMutex.h"
 #include "CaretOMP.h"
+#include "ElapsedTimer.h"
 #include <QMutex>
 
 using namespace caret;
@@ -185,3 +186,46 @@ void PointerTest::execute()
         setFailed("object deleted incorrect number of times");
     }
 }
+
+PointerBenchmark::PointerBenchmark(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void PointerBenchmark::execute()
+{
+    const int64_t COPIES = 4000000;//total across all threads, so each line does the same amount of work
+    CaretPointer<int> sharedPointer(new int(1));
+    CaretArray<float> sharedArray(16, 1.0f);
+    for (int numThreads = 1; numThreads <= 64; numThreads *= 2)
+    {
+        int64_t checkSum = 0;
+        ElapsedTimer myTimer;
+        myTimer.start();
+#pragma omp CARET_PAR num_threads(numThreads)
+        {
+            int64_t myCheck = 0;
+#pragma omp CARET_FOR schedule(static)
+            for (int64_t i = 0; i < COPIES; ++i)
+            {//copy out of the same instances from all threads, like passing a member pointer by value inside a parallel loop
+                CaretPointer<int> myPointer = sharedPointer;
+                CaretArray<float> myArray = sharedArray;
+                myCheck += *myPointer + (int64_t)myArray[0];
+            }
+#pragma omp atomic
+            checkSum += myCheck;
+        }
+        double seconds = myTimer.getElapsedTimeSeconds();
+        if (checkSum != 2 * COPIES)
+        {
+            setFailed("wrong checksum with " + AString::number(numThreads) + " threads");
+        }
+        if (sharedPointer.getReferenceCount() != 1 || sharedArray.getReferenceCount() != 1)
+        {
+            setFailed("reference count not restored after " + AString::number(numThreads) + " threads");
+        }
+        cout << numThreads << " threads: " << (2 * COPIES / seconds / 1000000.0) << " million copies per second" << endl;
+#ifndef CARET_OMP
+        break;//without openmp, there is only one thread
+#endif
+    }
+}
@@ -31,5 +31,13 @@ namespace caret {
       virtual void execute();
    };
 
+   ///not run by ctest, prints copy throughput of CaretPointer and CaretArray from 1 to 64 threads
+   class PointerBenchmark : public TestInterface
+   {
+   public:
+      PointerBenchmark(const AString& identifier);
+      virtual void execute();
+   };
+
 }
 #endif //__POINTER_TEST_H__
@@ -0,0 +1,172 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "RayIntersectionTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretPointer.h"
+#include "SignedDistanceHelper.h"
+#include "SurfaceFile.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //Moller-Trumbore on a single triangle, written separately from SignedDistanceHelper so both can't share a mistake
+    bool bruteHitsTri(const SurfaceFile& mySurf, const int32_t& triangle, const double start[3], const double direction[3],
+                      const SignedDistanceHelper::RaySide& side, double& paramOut)
+    {
+        const int32_t* triNodes = mySurf.getTriangle(triangle);
+        const float* verts[3] = { mySurf.getCoordinate(triNodes[0]), mySurf.getCoordinate(triNodes[1]), mySurf.getCoordinate(triNodes[2]) };
+        double normal[3], edge1[3], edge2[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            edge1[i] = (double)verts[1][i] - verts[0][i];
+            edge2[i] = (double)verts[2][i] - verts[0][i];
+        }
+        normal[0] = edge1[1] * edge2[2] - edge1[2] * edge2[1];
+        normal[1] = edge1[2] * edge2[0] - edge1[0] * edge2[2];
+        normal[2] = edge1[0] * edge2[1] - edge1[1] * edge2[0];
+        double facing = normal[0] * direction[0] + normal[1] * direction[1] + normal[2] * direction[2];
+        if (facing == 0.0) return false;
+        //the vertices appear counterclockwise when the right hand normal points back toward the start of the ray
+        if (side == SignedDistanceHelper::COUNTERCLOCKWISE_SIDE && facing > 0.0) return false;
+        if (side == SignedDistanceHelper::CLOCKWISE_SIDE && facing < 0.0) return false;
+        double t = (normal[0] * (verts[0][0] - start[0]) + normal[1] * (verts[0][1] - start[1]) + normal[2] * (verts[0][2] - start[2])) / facing;
+        if (t < 0.0) return false;
+        double point[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            point[i] = start[i] + t * direction[i];
+        }
+        for (int i = 0; i < 3; ++i)
+        {//the hit point must be on the inner side of every edge
+            const float* edgeStart = verts[i];
+            const float* edgeEnd = verts[(i + 1) % 3];
+            double edge[3], toPoint[3];
+            for (int j = 0; j < 3; ++j)
+            {
+                edge[j] = (double)edgeEnd[j] - edgeStart[j];
+                toPoint[j] = point[j] - edgeStart[j];
+            }
+            double cross[3] = { edge[1] * toPoint[2] - edge[2] * toPoint[1], edge[2] * toPoint[0] - edge[0] * toPoint[2], edge[0] * toPoint[1] - edge[1] * toPoint[0] };
+            if (cross[0] * normal[0] + cross[1] * normal[1] + cross[2] * normal[2] < -1e-9 * (normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2])) return false;
+        }
+        paramOut = t;
+        return true;
+    }
+
+    bool bruteRayIntersection(const SurfaceFile& mySurf, const double start[3], const double direction[3], const SignedDistanceHelper::RaySide& side,
+                              int32_t& triangleOut, double& paramOut)
+    {
+        triangleOut = -1;
+        paramOut = -1.0;
+        int32_t numTris = mySurf.getNumberOfTriangles();
+        for (int32_t tri = 0; tri < numTris; ++tri)
+        {
+            double t;
+            if (bruteHitsTri(mySurf, tri, start, direction, side, t) && (triangleOut == -1 || t < paramOut))
+            {
+                triangleOut = tri;
+                paramOut = t;
+            }
+        }
+        return triangleOut != -1;
+    }
+
+    double randRange(const double& low, const double& high)
+    {
+        return low + (high - low) * rand() / RAND_MAX;
+    }
+}
+
+RayIntersectionTest::RayIntersectionTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void RayIntersectionTest::execute()
+{
+    SurfaceFile mySurf;
+    AlgorithmSurfaceCreateSphere(NULL, 4000, &mySurf);
+    int32_t numNodes = mySurf.getNumberOfNodes();
+    float radius = 0.0f;
+    for (int i = 0; i < 3; ++i)
+    {
+        radius = max(radius, abs(mySurf.getCoordinate(0)[i]));
+    }
+    for (int32_t i = 0; i < numNodes; ++i)
+    {//bumps, so that rays can pass in and out of the surface more than twice
+        const float* coord = mySurf.getCoordinate(i);
+        float scale = 1.0f + 0.3f * sin(5.0f * coord[0] / radius) * cos(4.0f * coord[1] / radius);
+        mySurf.setCoordinate(i, coord[0] * scale, coord[1] * scale, coord[2] * scale);
+    }
+    CaretPointer<SignedDistanceHelper> myHelper = mySurf.getSignedDistanceHelper();
+    const SignedDistanceHelper::RaySide sides[3] = { SignedDistanceHelper::EITHER_SIDE, SignedDistanceHelper::COUNTERCLOCKWISE_SIDE, SignedDistanceHelper::CLOCKWISE_SIDE };
+    const char* sideNames[3] = { "either side", "counterclockwise side", "clockwise side" };
+    const int NUM_RAYS = 300;
+    int numSidesDiffer = 0;
+    for (int ray = 0; ray < NUM_RAYS; ++ray)
+    {
+        float start[3], direction[3];
+        double startD[3], directionD[3];
+        bool inside = (ray % 3 == 0);//some rays start inside the surface, and some start outside and aim near the center
+        for (int i = 0; i < 3; ++i)
+        {
+            start[i] = (float)(inside ? randRange(-0.3, 0.3) * radius : randRange(-3.0, 3.0) * radius);
+            float target = (float)(randRange(-0.8, 0.8) * radius);
+            direction[i] = target - start[i];
+            startD[i] = start[i];
+            directionD[i] = direction[i];
+        }
+        int32_t hitTris[3];
+        for (int s = 0; s < 3; ++s)
+        {
+            int32_t triangle = -1, expectTriangle = -1;
+            float param = -1.0f;
+            double expectParam = -1.0;
+            bool found = myHelper->rayIntersection(start, direction, triangle, param, sides[s]);
+            bool expectFound = bruteRayIntersection(mySurf, startD, directionD, sides[s], expectTriangle, expectParam);
+            hitTris[s] = triangle;
+            AString condition = "ray " + AString::number(ray) + ", " + sideNames[s];
+            if (found != expectFound)
+            {
+                setFailed(condition + (found ? ", hit the surface, brute force missed" : ", missed the surface, brute force hit"));
+                continue;
+            }
+            if (!found) continue;
+            if (abs(param - expectParam) > 1e-4 * max(1.0, expectParam))
+            {
+                setFailed(condition + ", hit at " + AString::number(param) + ", brute force hit at " + AString::number(expectParam));
+                continue;
+            }
+            double triParam;
+            if (triangle != expectTriangle && !(bruteHitsTri(mySurf, triangle, startD, directionD, sides[s], triParam) && abs(triParam - expectParam) <= 1e-4 * max(1.0, expectParam)))
+            {//a ray through an edge or vertex may report any of the triangles that share it
+                setFailed(condition + ", hit triangle " + AString::number(triangle) + ", brute force hit triangle " + AString::number(expectTriangle));
+            }
+        }
+        if (hitTris[1] != -1 && hitTris[2] != -1 && hitTris[1] != hitTris[2]) ++numSidesDiffer;
+    }
+    if (numSidesDiffer == 0) setFailed("counterclockwise and clockwise sides never gave different triangles");
+}
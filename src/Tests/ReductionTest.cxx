@@ -0,0 +1,216 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "ReductionTest.h"
+
+#include "ReductionOperation.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    struct RefValWeight
+    {
+        float value, weight;
+        bool operator<(const RefValWeight& rhs) const { return value < rhs.value; }
+    };
+
+    //the reductions as they were written before selection and radix sorting, using std::stable_sort
+    float refMedian(const float* data, const int64_t& numElems)
+    {
+        vector<float> dataCopy(data, data + numElems);
+        stable_sort(dataCopy.begin(), dataCopy.end());
+        if ((numElems & 1) == 0)
+        {
+            return (dataCopy[numElems / 2 - 1] + dataCopy[numElems / 2]) / 2.0f;
+        } else {
+            return dataCopy[numElems / 2];
+        }
+    }
+
+    float refMode(const float* data, const int64_t& numElems)
+    {
+        vector<float> dataCopy(data, data + numElems);
+        stable_sort(dataCopy.begin(), dataCopy.end());
+        int64_t bestCount = 0, curCount = 1;
+        float bestval = -1.0f, curval = dataCopy[0];
+        for (int64_t i = 1; i < numElems; ++i)
+        {
+            if (dataCopy[i] == curval)
+            {
+                ++curCount;
+            } else {
+                if (curCount > bestCount)
+                {
+                    bestval = curval;
+                    bestCount = curCount;
+                }
+                curval = dataCopy[i];
+                curCount = 1;
+            }
+        }
+        if (curCount > bestCount) bestval = curval;
+        return bestval;
+    }
+
+    vector<RefValWeight> refSortWeighted(const float* data, const float* weights, const int64_t& numElems)
+    {
+        vector<RefValWeight> ret(numElems);
+        for (int64_t i = 0; i < numElems; ++i)
+        {
+            ret[i].value = data[i];
+            ret[i].weight = weights[i];
+        }
+        stable_sort(ret.begin(), ret.end());
+        return ret;
+    }
+
+    float refWeightedMedian(const float* data, const float* weights, const int64_t& numElems)
+    {
+        vector<RefValWeight> toSort = refSortWeighted(data, weights, numElems);
+        vector<double> weightaccum(numElems);
+        weightaccum[0] = toSort[0].weight;
+        for (int64_t i = 1; i < numElems; ++i)
+        {
+            weightaccum[i] = weightaccum[i - 1] + toSort[i].weight;
+        }
+        double target = weightaccum.back() / 2;
+        int64_t index = (int64_t)(lower_bound(weightaccum.begin(), weightaccum.end(), target) - weightaccum.begin());
+        if (index == numElems) --index;
+        if (numElems > 1 && index < (numElems - 1) && weightaccum[index] == target)
+        {
+            return (toSort[index].value + toSort[index + 1].value) / 2;
+        } else {
+            return toSort[index].value;
+        }
+    }
+
+    float refWeightedMode(const float* data, const float* weights, const int64_t& numElems)
+    {
+        vector<RefValWeight> toSort = refSortWeighted(data, weights, numElems);
+        float bestweight = -numeric_limits<float>::infinity(), curweight = toSort[0].weight;
+        float bestval = toSort[0].value, curval = toSort[0].value;
+        for (int64_t i = 1; i < numElems; ++i)
+        {
+            if (toSort[i].value == curval)
+            {
+                curweight += toSort[i].weight;
+            } else {
+                if (curweight > bestweight)
+                {
+                    bestval = curval;
+                    bestweight = curweight;
+                }
+                curval = toSort[i].value;
+                curweight = toSort[i].weight;
+            }
+        }
+        if (curweight > bestweight) bestval = curval;
+        return bestval;
+    }
+
+    //a stable sort keeps the first of the equal values, so -0 vs 0 in a mode result shows whether the radix sort is stable
+    bool sameBits(const float& first, const float& second)
+    {
+        return memcmp(&first, &second, sizeof(float)) == 0;
+    }
+
+    enum DataKind
+    {
+        CONTINUOUS,
+        SMALL_INTEGERS,//many ties, mixed -0 and 0
+        NEGATIVE,
+        CONSTANT,//every radix pass is skipped
+        NUM_KINDS
+    };
+
+    void makeData(const DataKind& kind, const int64_t& numElems, vector<float>& data, vector<float>& weights)
+    {
+        data.resize(numElems);
+        weights.resize(numElems);
+        for (int64_t i = 0; i < numElems; ++i)
+        {
+            switch (kind)
+            {
+                case CONTINUOUS:
+                    data[i] = rand() * 200.0f / RAND_MAX - 100.0f;
+                    break;
+                case SMALL_INTEGERS:
+                {
+                    int value = rand() % 11 - 5;
+                    data[i] = (value == 0 && rand() % 2 == 0) ? -0.0f : (float)value;
+                    break;
+                }
+                case NEGATIVE:
+                    data[i] = -1.0f - (rand() % 1000) * 0.25f;
+                    break;
+                case CONSTANT:
+                    data[i] = 3.5f;
+                    break;
+                default:
+                    break;
+            }
+            weights[i] = (float)(rand() % 4 + 1);//integer weights, so weight sums can tie exactly
+        }
+    }
+}
+
+ReductionTest::ReductionTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void ReductionTest::execute()
+{
+    const int64_t sizes[] = { 1, 2, 7, 10, 255, 256, 257, 1000, 1001, 40000 };//both sides of the radix sort cutoff
+    const int numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    const char* kindNames[NUM_KINDS] = { "continuous", "small integer", "negative", "constant" };
+    vector<float> data, weights;
+    for (int kind = 0; kind < NUM_KINDS; ++kind)
+    {
+        for (int s = 0; s < numSizes; ++s)
+        {
+            makeData((DataKind)kind, sizes[s], data, weights);
+            AString condition = AString(kindNames[kind]) + " data with " + AString::number(sizes[s]) + " elements";
+            float median = ReductionOperation::reduce(data.data(), sizes[s], ReductionEnum::MEDIAN), expectMedian = refMedian(data.data(), sizes[s]);
+            if (median != expectMedian) setFailed(condition + ", median is " + AString::number(median) + ", expected " + AString::number(expectMedian));
+            float mode = ReductionOperation::reduce(data.data(), sizes[s], ReductionEnum::MODE), expectMode = refMode(data.data(), sizes[s]);
+            if (!sameBits(mode, expectMode)) setFailed(condition + ", mode is " + AString::number(mode) + ", expected " + AString::number(expectMode));
+            float weightedMedian = ReductionOperation::reduceWeighted(data.data(), weights.data(), sizes[s], ReductionEnum::MEDIAN);
+            float expectWeightedMedian = refWeightedMedian(data.data(), weights.data(), sizes[s]);
+            if (!sameBits(weightedMedian, expectWeightedMedian))
+            {
+                setFailed(condition + ", weighted median is " + AString::number(weightedMedian) + ", expected " + AString::number(expectWeightedMedian));
+            }
+            float weightedMode = ReductionOperation::reduceWeighted(data.data(), weights.data(), sizes[s], ReductionEnum::MODE);
+            float expectWeightedMode = refWeightedMode(data.data(), weights.data(), sizes[s]);
+            if (!sameBits(weightedMode, expectWeightedMode))
+            {
+                setFailed(condition + ", weighted mode is " + AString::number(weightedMode) + ", expected " + AString::number(expectWeightedMode));
+            }
+        }
+    }
+}
@@ -0,0 +1,126 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "SparseFileTest.h"
+
+#include "ByteOrderEnum.h"
+#include "CaretException.h"
+#include "CaretSparseFile.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+SparseFileTest::SparseFileTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void SparseFileTest::execute()
+{
+    const int64_t ROW_LENGTH = 50, NUM_ROWS = 37;
+    CiftiXML myXML;
+    myXML.setNumberOfDimensions(2);
+    myXML.setMap(CiftiXML::ALONG_ROW, CiftiSeriesMap(ROW_LENGTH));
+    myXML.setMap(CiftiXML::ALONG_COLUMN, CiftiSeriesMap(NUM_ROWS));
+    vector<int64_t> expected(NUM_ROWS * ROW_LENGTH, 0);
+    for (int64_t row = 0; row < NUM_ROWS; ++row)
+    {
+        if (row == 5) continue;//an empty row
+        for (int64_t i = 0; i < ROW_LENGTH; ++i)
+        {
+            if (rand() % 10 == 0) expected[row * ROW_LENGTH + i] = rand() % 1000 + 1;
+        }
+    }
+    AString fileName = QDir::tempPath() + "/wb_sparse_test.trajTEMP.wbsparse";
+    bool oldMapping = CaretSparseFile::getMemoryMapping();
+    try
+    {
+        {
+            CaretSparseFileWriter myWriter(fileName, myXML);
+            for (int64_t row = 0; row < NUM_ROWS; ++row)
+            {
+                myWriter.writeRow(row, expected.data() + row * ROW_LENGTH);
+            }
+        }
+        for (int mapping = 0; mapping < 2; ++mapping)
+        {//mapped, then through the row cache
+            CaretSparseFile::setMemoryMapping(mapping == 0);
+            CaretSparseFile myFile(fileName);
+            CaretSparseFile::setMemoryMapping(oldMapping);
+            bool expectMapped = (mapping == 0 && !ByteOrderEnum::isSystemBigEndian());//values are stored little endian, so big endian systems never map them
+            if (myFile.isMapped() != expectMapped) setFailed(AString("sparse file was ") + (expectMapped ? "not " : "") + "memory mapped in pass " + AString::number(mapping));
+            if (myFile.getDimensions()[0] != ROW_LENGTH || myFile.getDimensions()[1] != NUM_ROWS) setFailed("wrong dimensions read from sparse file");
+            vector<int64_t> rowScratch(ROW_LENGTH), indices, values;
+            for (int64_t access = 0; access < 3 * NUM_ROWS; ++access)
+            {//forward, then backward, then scattered, so the cached reads both hit and evict
+                int64_t row = access;
+                if (access >= 2 * NUM_ROWS)
+                {
+                    row = (access * 7) % NUM_ROWS;
+                } else if (access >= NUM_ROWS) {
+                    row = 2 * NUM_ROWS - 1 - access;
+                }
+                myFile.getRow(row, rowScratch.data());
+                myFile.getRowSparse(row, indices, values);
+                int64_t sparsePos = 0;
+                for (int64_t i = 0; i < ROW_LENGTH; ++i)
+                {
+                    int64_t thisExpected = expected[row * ROW_LENGTH + i];
+                    if (rowScratch[i] != thisExpected) setFailed("dense row " + AString::number(row) + " differs at index " + AString::number(i));
+                    if (thisExpected != 0)
+                    {
+                        if (sparsePos >= (int64_t)indices.size() || indices[sparsePos] != i || values[sparsePos] != thisExpected)
+                        {
+                            setFailed("sparse row " + AString::number(row) + " differs at index " + AString::number(i));
+                        }
+                        ++sparsePos;
+                    }
+                }
+                if (sparsePos != (int64_t)indices.size()) setFailed("sparse row " + AString::number(row) + " has extra entries");
+            }
+        }
+        {
+            QFile truncFile(fileName);
+            if (!truncFile.resize(8 + 2 * sizeof(int64_t) + NUM_ROWS * sizeof(int64_t) + 2 * sizeof(int64_t))) setFailed("unable to truncate sparse file");//keep only the first index, value pair
+        }
+        for (int mapping = 0; mapping < 2; ++mapping)
+        {//a truncated values section must be an error when opening, not a crash when reading rows
+            CaretSparseFile::setMemoryMapping(mapping == 0);
+            bool threw = false;
+            try
+            {
+                CaretSparseFile myFile(fileName);
+            } catch (DataFileException&) {
+                threw = true;
+            }
+            CaretSparseFile::setMemoryMapping(oldMapping);
+            if (!threw) setFailed("opening truncated sparse file did not throw in pass " + AString::number(mapping));
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    CaretSparseFile::setMemoryMapping(oldMapping);
+    QFile::remove(fileName);
+}
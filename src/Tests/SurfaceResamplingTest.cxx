@@ -0,0 +1,127 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "SurfaceResamplingTest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "SurfaceFile.h"
+#include "SurfaceResamplingHelper.h"
+
+#include <QDir>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //everything the weights are used for, so a cache that changes any weight shows up
+    struct ResampleOutputs
+    {
+        vector<float> normal, largest, validRoi;
+        vector<int32_t> popular;
+    };
+
+    ResampleOutputs resampleAll(const SurfaceResamplingHelper& myHelper, const vector<float>& data, const vector<int32_t>& labels, const int32_t& numNewNodes)
+    {
+        ResampleOutputs ret;
+        ret.normal.resize(numNewNodes);
+        ret.largest.resize(numNewNodes);
+        ret.validRoi.resize(numNewNodes);
+        ret.popular.resize(numNewNodes);
+        myHelper.resampleNormal(data.data(), ret.normal.data());
+        myHelper.resampleLargest(data.data(), ret.largest.data());
+        myHelper.getResampleValidROI(ret.validRoi.data());
+        myHelper.resamplePopular(labels.data(), ret.popular.data());
+        return ret;
+    }
+
+    bool sameOutputs(const ResampleOutputs& first, const ResampleOutputs& second)
+    {
+        return first.normal == second.normal && first.largest == second.largest && first.validRoi == second.validRoi && first.popular == second.popular;
+    }
+
+    void removeCacheFiles(const AString& cacheDir)
+    {
+        QDir myDir(cacheDir);
+        QStringList cacheFiles = myDir.entryList(QStringList() << "*.wbresample");
+        for (int i = 0; i < cacheFiles.size(); ++i)
+        {
+            myDir.remove(cacheFiles[i]);
+        }
+    }
+}
+
+SurfaceResamplingTest::SurfaceResamplingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void SurfaceResamplingTest::execute()
+{
+    SurfaceFile curSphere, newSphere;
+    AlgorithmSurfaceCreateSphere(NULL, 1000, &curSphere);
+    AlgorithmSurfaceCreateSphere(NULL, 3000, &newSphere);
+    int32_t numCurNodes = curSphere.getNumberOfNodes(), numNewNodes = newSphere.getNumberOfNodes();
+    const float ANGLE = 0.1f;//rotate the new sphere so that its vertices don't land on the current sphere's vertices
+    for (int32_t i = 0; i < numNewNodes; ++i)
+    {
+        const float* coord = newSphere.getCoordinate(i);
+        newSphere.setCoordinate(i, coord[0] * cos(ANGLE) - coord[1] * sin(ANGLE), coord[0] * sin(ANGLE) + coord[1] * cos(ANGLE), coord[2]);
+    }
+    vector<float> curAreas, newAreas;
+    curSphere.computeNodeAreas(curAreas);
+    newSphere.computeNodeAreas(newAreas);
+    vector<float> data(numCurNodes), roi(numCurNodes);
+    vector<int32_t> labels(numCurNodes);
+    for (int32_t i = 0; i < numCurNodes; ++i)
+    {
+        data[i] = ((float)rand()) / RAND_MAX;
+        labels[i] = rand() % 5;
+        roi[i] = (curSphere.getCoordinate(i)[2] > 0.0f ? 1.0f : 0.0f);
+    }
+    AString cacheDir = QDir::tempPath() + "/wb_resampling_cache_test";
+    AString oldCacheDir = SurfaceResamplingHelper::getWeightCacheDirectory();
+    const SurfaceResamplingMethodEnum::Enum methods[] = { SurfaceResamplingMethodEnum::BARYCENTRIC, SurfaceResamplingMethodEnum::ADAP_BARY_AREA };
+    removeCacheFiles(cacheDir);
+    for (int m = 0; m < 2; ++m)
+    {
+        for (int useRoi = 0; useRoi < 2; ++useRoi)
+        {
+            const float* roiPtr = (useRoi ? roi.data() : NULL);
+            AString condition = SurfaceResamplingMethodEnum::toName(methods[m]) + (useRoi ? " with roi" : " without roi");
+            SurfaceResamplingHelper::setWeightCacheDirectory("");
+            ResampleOutputs expected = resampleAll(SurfaceResamplingHelper(methods[m], &curSphere, &newSphere, curAreas.data(), newAreas.data(), roiPtr), data, labels, numNewNodes);
+            SurfaceResamplingHelper::setWeightCacheDirectory(cacheDir);
+            ResampleOutputs written = resampleAll(SurfaceResamplingHelper(methods[m], &curSphere, &newSphere, curAreas.data(), newAreas.data(), roiPtr), data, labels, numNewNodes);
+            int numCacheFiles = QDir(cacheDir).entryList(QStringList() << "*.wbresample").size();
+            if (numCacheFiles != m * 2 + useRoi + 1) setFailed(condition + ", expected a new cache file, found " + AString::number(numCacheFiles) + " total");
+            ResampleOutputs loaded = resampleAll(SurfaceResamplingHelper(methods[m], &curSphere, &newSphere, curAreas.data(), newAreas.data(), roiPtr), data, labels, numNewNodes);
+            if (QDir(cacheDir).entryList(QStringList() << "*.wbresample").size() != numCacheFiles) setFailed(condition + ", cached weights were not reused");
+            if (!sameOutputs(expected, written)) setFailed(condition + ", resampling while writing the cache gave different values");
+            if (!sameOutputs(expected, loaded)) setFailed(condition + ", resampling with cached weights gave different values");
+        }
+    }
+    removeCacheFiles(cacheDir);
+    QDir().rmdir(cacheDir);
+    SurfaceResamplingHelper::setWeightCacheDirectory(oldCacheDir);
+}
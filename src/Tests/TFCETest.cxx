@@ -0,0 +1,201 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "TFCETest.h"
+
+#include "AlgorithmSurfaceCreateSphere.h"
+#include "CaretPointer.h"
+#include "SurfaceFile.h"
+#include "TFCEHelper.h"
+#include "TopologyHelper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //TFCE straight from the definition: at each distinct value, find the clusters of everything at or above it with a flood fill,
+    //and add the integral of extent^E * h^H over the threshold interval down to the next lower value
+    void bruteForceTFCE(const vector<float>& data, const float* roiData, const vector<vector<int64_t> >& neighbors, const vector<float>& elemWeights,
+                        const float& param_e, const float& param_h, vector<double>& dataOut)
+    {
+        int64_t numElems = (int64_t)data.size();
+        dataOut.assign(numElems, 0.0);
+        for (int sign = 1; sign >= -1; sign -= 2)
+        {
+            vector<float> values(numElems, 0.0f), levels;
+            for (int64_t i = 0; i < numElems; ++i)
+            {
+                if (roiData != NULL && !(roiData[i] > 0.0f)) continue;
+                values[i] = sign * data[i];
+                if (values[i] > 0.0f) levels.push_back(values[i]);
+            }
+            sort(levels.begin(), levels.end());
+            levels.erase(unique(levels.begin(), levels.end()), levels.end());
+            double integrated_h = param_h + 1.0;
+            double prevLevel = 0.0;
+            vector<int64_t> component(numElems), stack, members;
+            for (size_t l = 0; l < levels.size(); ++l)
+            {
+                double sliceIntegral = (pow((double)levels[l], integrated_h) - pow(prevLevel, integrated_h)) / integrated_h;
+                prevLevel = levels[l];
+                component.assign(numElems, -1);
+                for (int64_t start = 0; start < numElems; ++start)
+                {
+                    if (values[start] < levels[l] || component[start] != -1) continue;
+                    component[start] = start;
+                    stack.push_back(start);
+                    members.clear();
+                    double extent = 0.0;
+                    while (!stack.empty())
+                    {
+                        int64_t elem = stack.back();
+                        stack.pop_back();
+                        members.push_back(elem);
+                        extent += elemWeights[elem];
+                        for (size_t n = 0; n < neighbors[elem].size(); ++n)
+                        {
+                            int64_t neighbor = neighbors[elem][n];
+                            if (values[neighbor] >= levels[l] && component[neighbor] == -1)
+                            {
+                                component[neighbor] = start;
+                                stack.push_back(neighbor);
+                            }
+                        }
+                    }
+                    double slice = pow(extent, (double)param_e) * sliceIntegral;
+                    for (size_t m = 0; m < members.size(); ++m)
+                    {
+                        dataOut[members[m]] += sign * slice;
+                    }
+                }
+            }
+        }
+    }
+
+    //values on a coarse grid so that many elements tie, both signs, with some exact zeros
+    vector<float> makeData(const int64_t& numElems)
+    {
+        vector<float> ret(numElems);
+        for (int64_t i = 0; i < numElems; ++i)
+        {
+            ret[i] = (rand() % 41 - 20) * 0.25f;
+        }
+        return ret;
+    }
+
+    int64_t countMismatches(const vector<float>& computed, const vector<double>& expected)
+    {
+        int64_t ret = 0;
+        for (size_t i = 0; i < computed.size(); ++i)
+        {
+            if (abs(computed[i] - expected[i]) > 1e-4 * max(1.0, abs(expected[i]))) ++ret;
+        }
+        return ret;
+    }
+}
+
+TFCETest::TFCETest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void TFCETest::execute()
+{
+    const float param_e[2] = { 1.0f, 0.5f }, param_h = 2.0f;//surface and volume defaults
+    SurfaceFile mySurf;
+    AlgorithmSurfaceCreateSphere(NULL, 642, &mySurf);
+    int64_t numNodes = mySurf.getNumberOfNodes();
+    vector<float> nodeAreas;
+    mySurf.computeNodeAreas(nodeAreas);
+    CaretPointer<TopologyHelper> myTopoHelp = mySurf.getTopologyHelper();
+    vector<vector<int64_t> > nodeNeighbors(numNodes);
+    for (int32_t node = 0; node < (int32_t)numNodes; ++node)
+    {
+        int32_t numNeigh = 0;
+        const int32_t* neighbors = myTopoHelp->getNodeNeighbors(node, numNeigh);
+        nodeNeighbors[node].assign(neighbors, neighbors + numNeigh);
+    }
+    const int64_t dims[3] = { 10, 9, 8 };
+    const float VOXEL_VOLUME = 2.0f;
+    int64_t numVoxels = dims[0] * dims[1] * dims[2];
+    vector<float> voxelWeights(numVoxels, VOXEL_VOLUME);
+    vector<vector<int64_t> > voxelNeighbors(numVoxels);
+    for (int64_t k = 0; k < dims[2]; ++k)
+    {
+        for (int64_t j = 0; j < dims[1]; ++j)
+        {
+            for (int64_t i = 0; i < dims[0]; ++i)
+            {
+                int64_t index = i + dims[0] * (j + dims[1] * k);
+                if (i > 0) voxelNeighbors[index].push_back(index - 1);
+                if (i + 1 < dims[0]) voxelNeighbors[index].push_back(index + 1);
+                if (j > 0) voxelNeighbors[index].push_back(index - dims[0]);
+                if (j + 1 < dims[1]) voxelNeighbors[index].push_back(index + dims[0]);
+                if (k > 0) voxelNeighbors[index].push_back(index - dims[0] * dims[1]);
+                if (k + 1 < dims[2]) voxelNeighbors[index].push_back(index + dims[0] * dims[1]);
+            }
+        }
+    }
+    TFCEHelper surfTFCE(myTopoHelp, nodeAreas.data()), volTFCE(dims, VOXEL_VOLUME);
+    const TFCEHelper* helpers[2] = { &surfTFCE, &volTFCE };
+    const vector<vector<int64_t> >* neighborLists[2] = { &nodeNeighbors, &voxelNeighbors };
+    const vector<float>* weightLists[2] = { &nodeAreas, &voxelWeights };
+    const char* modeNames[2] = { "surface", "volume" };
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        int64_t numElems = helpers[mode]->getNumberOfElements();
+        if (numElems != (int64_t)neighborLists[mode]->size())
+        {
+            setFailed(AString(modeNames[mode]) + " TFCE has the wrong number of elements");
+            continue;
+        }
+        vector<float> roi(numElems);
+        for (int64_t i = 0; i < numElems; ++i)
+        {
+            roi[i] = (rand() % 5 == 0 ? 0.0f : 1.0f);
+        }
+        for (int useRoi = 0; useRoi < 2; ++useRoi)
+        {
+            const float* roiData = (useRoi ? roi.data() : NULL);
+            vector<float> data = makeData(numElems), computed(numElems);
+            for (int flip = 0; flip < 2; ++flip)
+            {//the same map negated, so each cluster goes through the other pass
+                if (flip)
+                {
+                    for (int64_t i = 0; i < numElems; ++i) data[i] = -data[i];
+                }
+                vector<double> expected;
+                helpers[mode]->compute(data.data(), computed.data(), roiData, param_e[mode], param_h);
+                bruteForceTFCE(data, roiData, *(neighborLists[mode]), *(weightLists[mode]), param_e[mode], param_h, expected);
+                int64_t numBad = countMismatches(computed, expected);
+                if (numBad != 0)
+                {
+                    setFailed(AString(modeNames[mode]) + (useRoi ? " with roi" : " without roi") + (flip ? ", negated" : "") + ", " +
+                              AString::number(numBad) + " values differ from brute force TFCE");
+                }
+            }
+        }
+    }
+}
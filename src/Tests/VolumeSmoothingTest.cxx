@@ -0,0 +1,172 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeSmoothingTest.h"
+
+#include "AlgorithmVolumeSmoothing.h"
+#include "CaretException.h"
+#include "FloatMatrix.h"
+#include "VolumeFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    //the direct separable loops used for small kernels, on an orthogonal volume with the given spacing
+    void directSmoothing(const VolumeFile& inVol, const float& kernel, const float spacing[3], const VolumeFile* roiVol, const bool& fixZeros, vector<float>& output)
+    {
+        vector<int64_t> myDims;
+        inVol.getDimensions(myDims);
+        int64_t frameSize = myDims[0] * myDims[1] * myDims[2];
+        const float* inFrame = inVol.getFrame();
+        const float* roiFrame = (roiVol == NULL ? NULL : roiVol->getFrame());
+        vector<float> data(frameSize), weights(frameSize);
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            if ((roiFrame == NULL || roiFrame[i] > 0.0f) && (!fixZeros || inFrame[i] != 0.0f))
+            {
+                data[i] = inFrame[i];
+                weights[i] = 1.0f;
+            } else {
+                data[i] = 0.0f;
+                weights[i] = 0.0f;
+            }
+        }
+        int64_t stride = 1;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            int range = max(1, (int)floor(kernel * 3.0f / spacing[axis]));
+            vector<float> kernelWeights(2 * range + 1);
+            for (int i = 0; i < 2 * range + 1; ++i)
+            {
+                float tempf = spacing[axis] * (i - range) / kernel;
+                kernelWeights[i] = exp(-tempf * tempf / 2.0f);
+            }
+            vector<float> newData(frameSize), newWeights(frameSize);
+            for (int64_t index = 0; index < frameSize; ++index)
+            {
+                int64_t pos = (index / stride) % myDims[axis];
+                int64_t kmin = max((int64_t)0, pos - range), kmax = min(myDims[axis], pos + range + 1);
+                float sum = 0.0f, weightsum = 0.0f;
+                for (int64_t k = kmin; k < kmax; ++k)
+                {
+                    int64_t other = index + (k - pos) * stride;
+                    float weight = kernelWeights[k - pos + range];
+                    sum += weight * data[other];
+                    weightsum += weight * weights[other];
+                }
+                newData[index] = sum;
+                newWeights[index] = weightsum;
+            }
+            data = newData;
+            weights = newWeights;
+            stride *= myDims[axis];
+        }
+        output.resize(frameSize);
+        for (int64_t i = 0; i < frameSize; ++i)
+        {
+            if ((roiFrame == NULL || roiFrame[i] > 0.0f) && weights[i] != 0.0f)
+            {
+                output[i] = data[i] / weights[i];
+            } else {
+                output[i] = 0.0f;
+            }
+        }
+    }
+}
+
+VolumeSmoothingTest::VolumeSmoothingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void VolumeSmoothingTest::execute()
+{
+    //with a 7mm kernel, the 1mm axis uses a line filter with range 21, FFT when exact, the 4mm axis uses small direct convolution,
+    //and the 2mm axis uses direct convolution with range 10, so every line filter is used somewhere
+    const float KERNEL = 7.0f, DATA_RANGE = 10.0f;
+    const float spacing[3] = { 1.0f, 4.0f, 2.0f };
+    vector<int64_t> myDims;
+    myDims.push_back(40);
+    myDims.push_back(30);
+    myDims.push_back(12);
+    FloatMatrix indexSpace = FloatMatrix::zeros(4, 4);
+    for (int i = 0; i < 3; ++i)
+    {
+        indexSpace[i][i] = spacing[i];
+    }
+    indexSpace[3][3] = 1.0f;
+    try
+    {
+        VolumeFile denseVol, cornerVol, roiVol;
+        denseVol.reinitialize(myDims, indexSpace.getMatrix());
+        cornerVol.reinitialize(myDims, indexSpace.getMatrix());
+        roiVol.reinitialize(myDims, indexSpace.getMatrix());
+        for (int64_t k = 0; k < myDims[2]; ++k)
+        {
+            for (int64_t j = 0; j < myDims[1]; ++j)
+            {
+                for (int64_t i = 0; i < myDims[0]; ++i)
+                {
+                    float value = DATA_RANGE * (rand() + 1.0f) / (RAND_MAX + 1.0f);
+                    denseVol.setValue(value, i, j, k);
+                    cornerVol.setValue((i > 8 || j > 6) ? 0.0f : value, i, j, k);//so -fix-zeros leaves voxels with nothing in their kernel box
+                    roiVol.setValue((i < 25 && k > 2) ? 1.0f : 0.0f, i, j, k);
+                }
+            }
+        }
+        for (int useRoi = 0; useRoi < 2; ++useRoi)
+        {
+            for (int fixZeros = 0; fixZeros < 2; ++fixZeros)
+            {
+                AString condition = AString(useRoi ? "with roi" : "without roi") + (fixZeros ? ", fixing zeros" : "");
+                const VolumeFile* roiPtr = (useRoi ? &roiVol : NULL);
+                const VolumeFile& inVol = (fixZeros ? cornerVol : denseVol);
+                VolumeFile outVol;
+                AlgorithmVolumeSmoothing(NULL, &inVol, KERNEL, &outVol, roiPtr, fixZeros);
+                vector<float> expected;
+                directSmoothing(inVol, KERNEL, spacing, roiPtr, fixZeros, expected);
+                //without a mask, the recursive filter approximates the untruncated gaussian, otherwise the kernels are exact
+                float tolerance = (useRoi || fixZeros ? 1e-4f : 0.01f * DATA_RANGE);
+                const float* outFrame = outVol.getFrame();
+                for (int64_t i = 0; i < (int64_t)expected.size(); ++i)
+                {
+                    if ((outFrame[i] == 0.0f) != (expected[i] == 0.0f))
+                    {//input values are never zero, so zero output means no weight in the kernel box or outside the roi
+                        setFailed(condition + ", voxel " + AString::number(i) + " is " + AString::number(outFrame[i]) + " instead of " + AString::number(expected[i]));
+                        break;
+                    }
+                    if (abs(outFrame[i] - expected[i]) > tolerance * max(1.0f, abs(expected[i])))
+                    {
+                        setFailed(condition + ", voxel " + AString::number(i) + " differs from direct smoothing by " + AString::number(outFrame[i] - expected[i]));
+                        break;
+                    }
+                }
+            }
+        }
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+}
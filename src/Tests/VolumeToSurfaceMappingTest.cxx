@@ -0,0 +1,182 @@
+/*LICENSE_START*/
+/*
+ *  Copyright (C) 2014  Washington University School of Medicine
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+/*LICENSE_END*/
+
+#include "VolumeToSurfaceMappingTest.h"
+
+#include "AlgorithmVolumeToSurfaceMapping.h"
+#include "CaretException.h"
+#include "FloatMatrix.h"
+#include "MetricFile.h"
+#include "RibbonMappingHelper.h"
+#include "SurfaceFile.h"
+#include "VolumeFile.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace caret;
+using namespace std;
+
+namespace
+{
+    const int GRID_SIZE = 8;
+    
+    //a gently curved sheet over the middle of the volume, triangles wound so normals point toward +z
+    void makeSheet(SurfaceFile& surfOut, const float& height)
+    {
+        surfOut.setNumberOfNodesAndTriangles(GRID_SIZE * GRID_SIZE, 2 * (GRID_SIZE - 1) * (GRID_SIZE - 1));
+        for (int j = 0; j < GRID_SIZE; ++j)
+        {
+            for (int i = 0; i < GRID_SIZE; ++i)
+            {
+                float x = 4.0f + 1.5f * i, y = 4.0f + 1.5f * j;
+                surfOut.setCoordinate(i + j * GRID_SIZE, x, y, height + 0.5f * sin(x / 3.0f) * cos(y / 4.0f));
+            }
+        }
+        int32_t triangle = 0;
+        for (int j = 0; j < GRID_SIZE - 1; ++j)
+        {
+            for (int i = 0; i < GRID_SIZE - 1; ++i)
+            {
+                int32_t corner = i + j * GRID_SIZE;
+                surfOut.setTriangle(triangle++, corner, corner + 1, corner + GRID_SIZE);
+                surfOut.setTriangle(triangle++, corner + 1, corner + GRID_SIZE + 1, corner + GRID_SIZE);
+            }
+        }
+        surfOut.computeNormals();
+    }
+    
+    bool sameValues(const MetricFile& first, const MetricFile& second)
+    {
+        if (first.getNumberOfNodes() != second.getNumberOfNodes() || first.getNumberOfColumns() != second.getNumberOfColumns()) return false;
+        for (int c = 0; c < first.getNumberOfColumns(); ++c)
+        {
+            const float* firstData = first.getValuePointerForColumn(c), *secondData = second.getValuePointerForColumn(c);
+            for (int32_t i = 0; i < first.getNumberOfNodes(); ++i)
+            {
+                if (firstData[i] != secondData[i]) return false;
+            }
+        }
+        return true;
+    }
+    
+    bool anyNonzero(const MetricFile& metric)
+    {
+        for (int c = 0; c < metric.getNumberOfColumns(); ++c)
+        {
+            const float* data = metric.getValuePointerForColumn(c);
+            for (int32_t i = 0; i < metric.getNumberOfNodes(); ++i)
+            {
+                if (data[i] != 0.0f) return true;
+            }
+        }
+        return false;
+    }
+}
+
+VolumeToSurfaceMappingTest::VolumeToSurfaceMappingTest(const AString& identifier) : TestInterface(identifier)
+{
+}
+
+void VolumeToSurfaceMappingTest::execute()
+{
+    vector<int64_t> myDims;
+    myDims.push_back(20);
+    myDims.push_back(20);
+    myDims.push_back(16);
+    myDims.push_back(2);//more than one frame, so each map uses the same weights
+    FloatMatrix indexSpace = FloatMatrix::identity(4);
+    VolumeFile inVol, roiVol;
+    inVol.reinitialize(myDims, indexSpace.getMatrix());
+    myDims.resize(3);
+    roiVol.reinitialize(myDims, indexSpace.getMatrix());
+    for (int64_t k = 0; k < myDims[2]; ++k)
+    {
+        for (int64_t j = 0; j < myDims[1]; ++j)
+        {
+            for (int64_t i = 0; i < myDims[0]; ++i)
+            {
+                inVol.setValue(((float)rand()) / RAND_MAX, i, j, k, 0);
+                inVol.setValue(((float)rand()) / RAND_MAX, i, j, k, 1);
+                roiVol.setValue((k >= 4 && k <= 10) ? 1.0f : 0.0f, i, j, k);
+            }
+        }
+    }
+    SurfaceFile innerSurf, midSurf, outerSurf;
+    makeSheet(innerSurf, 5.0f);
+    makeSheet(midSurf, 7.0f);
+    makeSheet(outerSurf, 9.0f);
+    MetricFile thickness;
+    thickness.setNumberOfNodesAndColumns(GRID_SIZE * GRID_SIZE, 1);
+    for (int32_t i = 0; i < GRID_SIZE * GRID_SIZE; ++i)
+    {
+        thickness.setValue(i, 0, 4.0f);
+    }
+    AString fileName = QDir::tempPath() + "/wb_volume_to_surface_test.weights";
+    try
+    {
+        for (int method = 0; method < 2; ++method)
+        {
+            AString methodName = (method == 0 ? "ribbon constrained" : "myelin style");
+            MetricFile computed, fromFile;
+            VertexVoxelWeights computedWeights, loadedWeights;
+            if (method == 0)
+            {
+                AlgorithmVolumeToSurfaceMapping(NULL, &inVol, &midSurf, &computed, &innerSurf, &outerSurf, NULL, 3, -1, -1, NULL, &computedWeights);
+            } else {
+                AlgorithmVolumeToSurfaceMapping(NULL, &inVol, &midSurf, &computed, &roiVol, &thickness, 2.0f, -1, &computedWeights);
+            }
+            if (!anyNonzero(computed)) setFailed(methodName + " mapping found no voxels for the test surface");
+            computedWeights.writeFile(fileName);
+            loadedWeights.readFile(fileName);
+            if (loadedWeights.getNumberOfNodes() != computedWeights.getNumberOfNodes() || loadedWeights.isNormalized() != computedWeights.isNormalized() ||
+                !loadedWeights.getVolumeSpace().matches(computedWeights.getVolumeSpace()))
+            {
+                setFailed(methodName + " weights file has different vertices, normalization or volume space after reading");
+            }
+            vector<float> computedApplied(GRID_SIZE * GRID_SIZE), loadedApplied(GRID_SIZE * GRID_SIZE);
+            computedWeights.apply(inVol.getFrame(1), computedApplied.data());
+            loadedWeights.apply(inVol.getFrame(1), loadedApplied.data());
+            if (computedApplied != loadedApplied) setFailed(methodName + " weights differ after writing and reading the weights file");
+            AlgorithmVolumeToSurfaceMapping(NULL, &inVol, &midSurf, &fromFile, loadedWeights);
+            if (!sameValues(computed, fromFile)) setFailed(methodName + " mapping with the weights file differs from recomputing the weights");
+        }
+        {
+            QFile truncateFile(fileName);
+            truncateFile.resize(truncateFile.size() - 4);
+        }
+        bool threw = false;
+        try
+        {
+            VertexVoxelWeights truncated;
+            truncated.readFile(fileName);
+        } catch (CaretException&) {
+            threw = true;
+        }
+        if (!threw) setFailed("reading a truncated weights file didn't throw");
+    } catch (CaretException& e) {
+        setFailed("caught exception: " + e.whatString());
+    }
+    QFile::remove(fileName);
+}
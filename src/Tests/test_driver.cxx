@@ -33,20 +33,36 @@
 #include "CaretException.h"
 
 //tests
+#include "CiftiCorrelationTest.h"
 #include "CiftiFileTest.h"
+#include "CiftiResampleTest.h"
+#include "CiftiRowPipelineTest.h"
+#include "CiftiTransposeTest.h"
+#include "ClusterLabelingTest.h"
+#include "ConnectivityMatrixRowCacheTest.h"
+#include "DenseDynamicCorrelationTest.h"
 #include "GeodesicHelperTest.h"
+#include "GzipFileTest.h"
 #include "HttpTest.h"
 #include "HeapTest.h"
 #include "LookupTest.h"
 #include "MathExpressionTest.h"
+#include "MetricSmoothingTest.h"
 #include "NiftiTest.h"
 #include "PointerTest.h"
 #include "ProgressTest.h"
 #include "QuatTest.h"
+#include "RayIntersectionTest.h"
+#include "ReductionTest.h"
+#include "SparseFileTest.h"
 #include "StatisticsTest.h"
+#include "SurfaceResamplingTest.h"
+#include "TFCETest.h"
 #include "TimerTest.h"
 #include "TopologyHelperTest.h"
 #include "VolumeFileTest.h"
+#include "VolumeSmoothingTest.h"
+#include "VolumeToSurfaceMappingTest.h"
 #include "XnatTest.h"
 
 using namespace std;
@@ -60,6 +76,23 @@ void freeTestList(vector<TestInterface*>& mylist)
     }
 }
 
+void runTest(TestInterface* mytest, int& failCount)
+{
+    try
+    {
+        mytest->execute();
+    } catch (CaretException& e) {
+        ++failCount;
+        cout << "Test " << mytest->getIdentifier() << " failed, exception: " << e.whatString() << endl;
+        return;//skip trying failed() and getFailMessage()
+    }
+    if (mytest->failed())
+    {
+        ++failCount;
+        cout << "Test " << mytest->getIdentifier() << " failed: " << mytest->getFailMessage() << endl;
+    }
+}
+
 int main(int argc, char** argv)
 {
     srand(time(NULL));
@@ -68,22 +101,44 @@ int main(int argc, char** argv)
         caret_global_commandLine_init(argc, argv);
         SessionManager::createSessionManager(ApplicationTypeEnum::APPLICATION_TYPE_COMMAND_LINE);
         vector<TestInterface*> mytests;
+        mytests.push_back(new CiftiCorrelationTest("cifticorrelation"));
         mytests.push_back(new CiftiFileTest("ciftifile"));
+        mytests.push_back(new CiftiFileColumnsTest("ciftifilecolumns"));
+        mytests.push_back(new CiftiResampleTest("ciftiresample"));
+        mytests.push_back(new CiftiRowPipelineTest("ciftirowpipeline"));
+        mytests.push_back(new CiftiTransposeTest("ciftitranspose"));
+        mytests.push_back(new ClusterLabelingTest("clusterlabeling"));
+        mytests.push_back(new ConnectivityMatrixRowCacheTest("connectivityrowcache"));
+        mytests.push_back(new DenseDynamicCorrelationTest("densedynamiccorrelation"));
         mytests.push_back(new GeodesicHelperTest("geohelp"));
+        mytests.push_back(new GeodesicHelperBatchTest("geohelpbatch"));
+        mytests.push_back(new GzipFileTest("gzipfile"));
         mytests.push_back(new HeapTest("heap"));
         mytests.push_back(new HttpTest("http"));
         mytests.push_back(new LookupTest("lookup"));
         mytests.push_back(new MathExpressionTest("mathexpression"));
+        mytests.push_back(new MetricSmoothingTest("metricsmoothing"));
         mytests.push_back(new NiftiFileTest("niftifile"));
         mytests.push_back(new NiftiHeaderTest("niftiheader"));
         mytests.push_back(new PointerTest("pointer"));
         mytests.push_back(new ProgressTest("progress"));
         mytests.push_back(new QuatTest("quaternion"));
+        mytests.push_back(new RayIntersectionTest("rayintersection"));
+        mytests.push_back(new ReductionTest("reduction"));
+        mytests.push_back(new SparseFileTest("sparsefile"));
         mytests.push_back(new StatisticsTest("statistics"));
+        mytests.push_back(new SurfaceResamplingTest("surfaceresampling"));
+        mytests.push_back(new TFCETest("tfce"));
         mytests.push_back(new TimerTest("timer"));
         mytests.push_back(new TopologyHelperTest("topohelp"));
         mytests.push_back(new VolumeFileTest("volumefile"));
+        mytests.push_back(new VolumeSmoothingTest("volumesmoothing"));
+        mytests.push_back(new VolumeToSurfaceMappingTest("volumetosurface"));
         mytests.push_back(new XnatTest("xnat"));
+        vector<TestInterface*> mybenchmarks;//slow and resource hungry, so they only run when named, never from "all"
+        mybenchmarks.push_back(new CiftiTransposeBenchmark("ciftitransposebench"));
+        mybenchmarks.push_back(new GeodesicHelperBenchmark("geohelpbench"));
+        mybenchmarks.push_back(new PointerBenchmark("pointerbench"));
         if (argc < 2)
         {
             cout << "No test specified, please specify one of the following:" << endl;
@@ -91,7 +146,13 @@ int main(int argc, char** argv)
             {
                 cout << mytests[i]->getIdentifier() << endl;
             }
+            cout << "or all to run all of the above, benchmarks must be specified individually:" << endl;
+            for (int i = 0; i < (int)mybenchmarks.size(); ++i)
+            {
+                cout << mybenchmarks[i]->getIdentifier() << endl;
+            }
             freeTestList(mytests);
+            freeTestList(mybenchmarks);
             return 1;//no test specified, fail
         }
         int failCount = 0;
@@ -101,22 +162,18 @@ int main(int argc, char** argv)
             {
                 if (mytests[j]->getIdentifier() == AString(argv[i]) || "all" == AString(argv[i]))
                 {
-                    try
-                    {
-                        mytests[j]->execute();
-                    } catch (CaretException& e) {
-                        ++failCount;
-                        cout << "Test " << mytests[j]->getIdentifier() << " failed, exception: " << e.whatString() << endl;
-                        continue;//skip trying failed() and getFailMessage()
-                    }
-                    if (mytests[j]->failed())
-                    {
-                        ++failCount;
-                        cout << "Test " << mytests[j]->getIdentifier() << " failed: " << mytests[j]->getFailMessage() << endl;
-                    }
+                    runTest(mytests[j], failCount);
+                }
+            }
+            for (int j = 0; j < (int)mybenchmarks.size(); ++j)
+            {
+                if (mybenchmarks[j]->getIdentifier() == AString(argv[i]))
+                {
+                    runTest(mybenchmarks[j], failCount);
                 }
             }
         }
+        freeTestList(mybenchmarks);
         freeTestList(mytests);
         if (failCount != 0)
         {